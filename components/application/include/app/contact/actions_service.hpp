@@ -10,6 +10,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#include "ble_rpc.hpp"
 #include "ble_uart.hpp"
 #include "chat_api.hpp"
 #include "nvs_rw.hpp"
@@ -42,36 +43,31 @@ inline std::vector<std::pair<std::string, std::string>> parse_pending_requests(
     return out;
 }
 
+// Reads {"ok":..,"error":..} from a friend request result frame.
+inline void parse_action_result(const std::string& js, ContactActionResult& result) {
+    StaticJsonDocument<512> doc;
+    if (deserializeJson(doc, js) != DeserializationError::Ok) return;
+    result.ok = doc["ok"].as<bool>();
+    if (doc["error"]) {
+        const char* e = doc["error"].as<const char*>();
+        if (e) result.error_message = e;
+    }
+}
+
 inline ContactActionResult send_friend_request(const std::string& friend_code,
                                                bool use_ble) {
     ContactActionResult result;
 
     if (use_ble) {
-        long long rid = esp_timer_get_time();
-        std::string req = std::string("{ \"id\":\"") + std::to_string(rid) +
+        const std::string rid = blerpc::next_id();
+        std::string req = std::string("{ \"id\":\"") + rid +
                           "\", \"type\": \"send_friend_request\", "
                           "\"code\": \"" +
                           friend_code + "\" }\n";
-        ble_uart_send(reinterpret_cast<const uint8_t*>(req.c_str()), req.size());
-
-        const int timeout_ms = 3000;
-        int waited = 0;
-        while (waited < timeout_ms) {
-            std::string rid_s = get_nvs((char*)"ble_result_id");
-            if (rid_s == std::to_string(rid)) {
-                std::string j = get_nvs((char*)"ble_last_result");
-                StaticJsonDocument<512> doc;
-                if (deserializeJson(doc, j) == DeserializationError::Ok) {
-                    result.ok = doc["ok"].as<bool>();
-                    if (doc["error"]) {
-                        const char* e = doc["error"].as<const char*>();
-                        if (e) result.error_message = e;
-                    }
-                }
-                return result;
-            }
-            vTaskDelay(50 / portTICK_PERIOD_MS);
-            waited += 50;
+        blerpc::Call call =
+            blerpc::start(rid, req, {"friend_request_result"});
+        if (call.valid() && blerpc::wait(call, 3000)) {
+            parse_action_result(call.response(), result);
         }
         return result;
     }
@@ -98,26 +94,17 @@ inline ContactActionResult send_friend_request(const std::string& friend_code,
 inline std::vector<std::pair<std::string, std::string>> fetch_pending_requests(
     bool use_ble, std::function<void()> feed_wdt = nullptr) {
     if (use_ble) {
-        long long rid = esp_timer_get_time();
-        std::string req = std::string("{ \"id\":\"") + std::to_string(rid) +
+        const std::string rid = blerpc::next_id();
+        std::string req = std::string("{ \"id\":\"") + rid +
                           "\", \"type\": \"get_pending\" }\n";
-        ble_uart_clear_cached_pending();
-        ble_uart_send(reinterpret_cast<const uint8_t*>(req.c_str()), req.size());
-
-        const int timeout_ms = 2500;
-        int waited = 0;
-        while (waited < timeout_ms) {
-            if (feed_wdt) feed_wdt();
-            std::string js = ble_uart_get_cached_pending();
-            if (!js.empty()) {
-                auto out = parse_pending_requests(js);
-                ble_uart_clear_cached_pending();
-                if (!out.empty()) return out;
-            }
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            waited += 100;
+        blerpc::Call call =
+            blerpc::start(rid, req, {"pending_requests"}, {"requests"});
+        blerpc::Hooks hooks;
+        hooks.on_tick = feed_wdt;
+        if (call.valid() && blerpc::wait(call, 2500, hooks)) {
+            auto out = parse_pending_requests(call.response());
+            if (!out.empty()) return out;
         }
-        ble_uart_clear_cached_pending();
     }
 
     auto& api = chatapi::shared_client(true);
@@ -137,32 +124,16 @@ inline ContactActionResult respond_friend_request(const std::string& request_id,
     ContactActionResult result;
 
     if (use_ble) {
-        long long crid = esp_timer_get_time();
-        std::string req = std::string("{ \"id\":\"") + std::to_string(crid) +
+        const std::string crid = blerpc::next_id();
+        std::string req = std::string("{ \"id\":\"") + crid +
                           "\", \"type\": \"respond_friend_request\", "
                           "\"request_id\": \"" +
                           request_id + "\", \"accept\": " +
                           (accept ? "true" : "false") + " }\n";
-        ble_uart_send(reinterpret_cast<const uint8_t*>(req.c_str()), req.size());
-
-        const int timeout_ms = 2000;
-        int waited = 0;
-        while (waited < timeout_ms) {
-            std::string rid_s = get_nvs((char*)"ble_result_id");
-            if (rid_s == std::to_string(crid)) {
-                std::string j = get_nvs((char*)"ble_last_result");
-                StaticJsonDocument<512> dd;
-                if (deserializeJson(dd, j) == DeserializationError::Ok) {
-                    result.ok = dd["ok"].as<bool>();
-                    if (dd["error"]) {
-                        const char* e = dd["error"].as<const char*>();
-                        if (e) result.error_message = e;
-                    }
-                }
-                return result;
-            }
-            vTaskDelay(50 / portTICK_PERIOD_MS);
-            waited += 50;
+        blerpc::Call call =
+            blerpc::start(crid, req, {"respond_friend_request_result"});
+        if (call.valid() && blerpc::wait(call, 2000)) {
+            parse_action_result(call.response(), result);
         }
         return result;
     }
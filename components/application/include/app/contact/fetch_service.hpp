@@ -6,6 +6,7 @@
 
 #include <ArduinoJson.h>
 
+#include "ble_rpc.hpp"
 #include "ble_uart.hpp"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
@@ -55,46 +56,32 @@ inline bool fetch_contacts_via_ble(const std::string& my_username,
                                    const FetchLoopHooks& hooks = {}) {
     if (!ble_uart_is_ready()) return false;
 
-    long long rid = esp_timer_get_time();
-    const std::string rid_str = std::to_string(rid);
-    // Drop stale payload before sending a new request.
-    ble_uart_clear_cached_contacts();
-    std::string req = std::string("{ \"id\":\"") + std::to_string(rid) +
+    BleBulkScope bulk;
+    const std::string rid = blerpc::next_id();
+    std::string req = std::string("{ \"id\":\"") + rid +
                       "\", \"type\": \"get_friends\" }\n";
-    ble_uart_send(reinterpret_cast<const uint8_t*>(req.c_str()), req.size());
-
-    int waited = 0;
-    while (waited < timeout_ms) {
-        std::string js = ble_uart_get_cached_contacts();
-        if (!js.empty()) {
-            DynamicJsonDocument doc(6144);
-            if (deserializeJson(doc, js) == DeserializationError::Ok) {
-                bool id_mismatch = false;
-                JsonVariant idv = doc["id"];
-                if (!idv.isNull()) {
-                    const char* resp_id = idv.as<const char*>();
-                    if (resp_id != nullptr && rid_str != resp_id) {
-                        id_mismatch = true;
-                    }
-                }
-
-                if (!id_mismatch &&
-                    parse_contacts_payload(js, my_username, out)) {
-                        // Consume once to avoid reusing old contacts payload.
-                        ble_uart_clear_cached_contacts();
-                        return true;
-                }
-            }
+    blerpc::Call call = blerpc::start(rid, req, {"friends", "contacts"});
+    if (!call.valid()) return false;
+
+    blerpc::Hooks wait_hooks;
+    wait_hooks.on_tick = hooks.on_tick;
+    wait_hooks.should_cancel = hooks.should_cancel;
+    // A frame that does not parse as a contact list (e.g. a partial push)
+    // does not end the request; keep waiting for the rest of the timeout.
+    const int64_t deadline_us =
+        esp_timer_get_time() + static_cast<int64_t>(timeout_ms) * 1000;
+    while (true) {
+        const int64_t left_us = deadline_us - esp_timer_get_time();
+        if (left_us <= 0 ||
+            !blerpc::wait(call, static_cast<uint32_t>((left_us + 999) / 1000),
+                          wait_hooks)) {
+            return false;
         }
-        if (hooks.on_tick) hooks.on_tick();
-        if (hooks.should_cancel && hooks.should_cancel()) return false;
-
-        vTaskDelay(100 / portTICK_PERIOD_MS);
-        waited += 100;
+        if (parse_contacts_payload(call.response(), my_username, out)) {
+            return true;
+        }
+        call.rearm();
     }
-    // Ensure timeout leaves no stale payload.
-    ble_uart_clear_cached_contacts();
-    return false;
 }
 
 inline HttpClient::FriendsResponse fetch_contacts_via_http(
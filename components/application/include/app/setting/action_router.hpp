@@ -19,6 +19,7 @@ enum class Action {
     Develop,
     Profile,
     Rtc,
+    P2pRelay,
     OpenChat,
     Composer,
     FactoryReset,
@@ -54,6 +55,8 @@ inline Action resolve(ui::Key key, bool triggered) {
             return Action::Profile;
         case ui::Key::SettingsRtc:
             return Action::Rtc;
+        case ui::Key::SettingsP2pRelay:
+            return Action::P2pRelay;
         case ui::Key::SettingsOpenChat:
             return Action::OpenChat;
         case ui::Key::SettingsComposer:
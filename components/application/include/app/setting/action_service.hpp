@@ -19,6 +19,14 @@ inline bool toggle_auto_update() {
     return on;
 }
 
+inline bool p2p_relay_enabled() { return get_nvs((char*)"p2p_relay") == "true"; }
+
+inline bool toggle_p2p_relay() {
+    const bool on = !p2p_relay_enabled();
+    save_nvs((char*)"p2p_relay", on ? std::string("true") : std::string("false"));
+    return on;
+}
+
 inline bool toggle_vibration() {
     bool on = joystick_haptics_enabled();
     on = !on;
@@ -36,6 +36,12 @@ inline std::string build_label(ui::Key key, ui::Lang lang) {
                ui::text(on ? ui::Key::LabelOn : ui::Key::LabelOff, lang) + "]";
     }
 
+    if (key == ui::Key::SettingsP2pRelay) {
+        bool on = (get_nvs((char*)"p2p_relay") == "true");
+        return std::string(ui::text(ui::Key::SettingsP2pRelay, lang)) + " [" +
+               ui::text(on ? ui::Key::LabelOn : ui::Key::LabelOff, lang) + "]";
+    }
+
     if (key == ui::Key::SettingsVibration) {
         bool on = joystick_haptics_enabled();
         return std::string(ui::text(ui::Key::SettingsVibration, lang)) + " [" +
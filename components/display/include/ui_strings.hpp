@@ -19,6 +19,7 @@ enum class Key {
     SettingsVibration,
     SettingsBootSound,
     SettingsRtc,
+    SettingsP2pRelay,
     SettingsOpenChat,
     SettingsComposer,
     SettingsAutoUpdate,
@@ -64,6 +65,7 @@ inline const char* text(Key key, Lang lang = current_lang()) {
             case Key::SettingsVibration: return "バイブ";
             case Key::SettingsBootSound: return "ブートサウンド";
             case Key::SettingsRtc: return "リアルタイムチャット";
+            case Key::SettingsP2pRelay: return "チャットリレー";
             case Key::SettingsOpenChat: return "オープンチャット";
             case Key::SettingsComposer: return "コンポーザ";
             case Key::SettingsAutoUpdate: return "オートアップデート";
@@ -102,6 +104,7 @@ inline const char* text(Key key, Lang lang = current_lang()) {
         case Key::SettingsVibration: return "Vibration";
         case Key::SettingsBootSound: return "Boot Sound";
         case Key::SettingsRtc: return "Real Time Chat";
+        case Key::SettingsP2pRelay: return "Chat Relay";
         case Key::SettingsOpenChat: return "Open Chat";
         case Key::SettingsComposer: return "Composer";
         case Key::SettingsAutoUpdate: return "Auto Update";
@@ -0,0 +1,194 @@
+// Dirty-region tracking for the OLED sprite.
+//
+// The SSD1306 is addressed in pages of 8 rows; a flush sends a column range
+// of one or more whole pages. FrameDiff keeps a copy of the last frame that
+// was pushed, compares the next frame against it page by page and returns
+// the page-aligned rectangles that changed, merging neighbouring pages when
+// one window is cheaper than two.
+//
+// Works on the raw sprite buffer at any colour depth: a changed byte maps
+// back to the pixels it holds. Pure logic; the caller owns the panel.
+//
+// pack_pages() converts a 1-bpp sprite (rows of MSB-first bytes, the
+// LovyanGFX layout) into the controller's page layout: one byte per column
+// per page, bit 0 the top row. That is what the panel stores, so a 1-bpp
+// frame can be sent without going through a colour conversion.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace oledflush {
+
+constexpr int kPageRows = 8;
+// Column + page address commands in front of every window.
+constexpr int kWindowCmdBytes = 6;
+
+struct Rect {
+    int x = 0;
+    int y = 0;
+    int w = 0;
+    int h = 0;
+};
+
+// SPI bytes to refresh `r` (1 bit per pixel, whole pages).
+inline int flush_bytes(const Rect& r) {
+    return kWindowCmdBytes + r.w * ((r.h + kPageRows - 1) / kPageRows);
+}
+
+// Packs `r` (page aligned: r.y and r.h multiples of kPageRows, or ending at
+// the frame bottom) of a 1-bpp frame into `out`, pages in order, r.w bytes
+// each. `out` needs flush_bytes(r) - kWindowCmdBytes bytes. Returns the bytes
+// written.
+inline size_t pack_pages(const uint8_t* frame, size_t stride, int frame_h, const Rect& r,
+                         uint8_t* out) {
+    size_t n = 0;
+    for (int y0 = r.y; y0 < r.y + r.h; y0 += kPageRows) {
+        const int rows = frame_h - y0 < kPageRows ? frame_h - y0 : kPageRows;
+        const uint8_t* page = frame + size_t(y0) * stride;
+        for (int x = r.x; x < r.x + r.w; ++x) {
+            const uint8_t* src = page + (x >> 3);
+            const uint8_t mask = uint8_t(0x80u >> (x & 7));
+            uint8_t col = 0;
+            for (int i = 0; i < rows; ++i) {
+                if (src[size_t(i) * stride] & mask) col |= uint8_t(1u << i);
+            }
+            out[n++] = col;
+        }
+    }
+    return n;
+}
+
+// Appends one page-high rect to `out`, folding it into the previous rect when
+// that one ends right above it and a single window is cheaper.
+inline void append_page(std::vector<Rect>& out, const Rect& page) {
+    if (!out.empty()) {
+        Rect& last = out.back();
+        if (last.y + last.h == page.y) {
+            Rect merged;
+            merged.x = last.x < page.x ? last.x : page.x;
+            const int right_a = last.x + last.w;
+            const int right_b = page.x + page.w;
+            merged.w = (right_a > right_b ? right_a : right_b) - merged.x;
+            merged.y = last.y;
+            merged.h = last.h + page.h;
+            if (flush_bytes(merged) <= flush_bytes(last) + flush_bytes(page)) {
+                last = merged;
+                return;
+            }
+        }
+    }
+    out.push_back(page);
+}
+
+// Union of two rect lists from diff(), as page-aligned rects again. Used when
+// a frame that was not sent yet is folded into the next one.
+inline void merge_rects(const std::vector<Rect>& a, const std::vector<Rect>& b, int width,
+                        int height, std::vector<Rect>& out) {
+    constexpr int kMaxPages = 16;
+    const int pages = (height + kPageRows - 1) / kPageRows;
+    out.clear();
+    if (pages > kMaxPages) {
+        out.push_back({0, 0, width, height});
+        return;
+    }
+    int lo[kMaxPages];
+    int hi[kMaxPages];
+    for (int p = 0; p < pages; ++p) {
+        lo[p] = width;
+        hi[p] = 0;
+    }
+    for (const auto* list : {&a, &b}) {
+        for (const auto& r : *list) {
+            for (int p = r.y / kPageRows; p * kPageRows < r.y + r.h; ++p) {
+                if (r.x < lo[p]) lo[p] = r.x;
+                if (r.x + r.w > hi[p]) hi[p] = r.x + r.w;
+            }
+        }
+    }
+    for (int p = 0; p < pages; ++p) {
+        if (hi[p] <= lo[p]) continue;
+        const int y0 = p * kPageRows;
+        const int rows = height - y0 < kPageRows ? height - y0 : kPageRows;
+        append_page(out, {lo[p], y0, hi[p] - lo[p], rows});
+    }
+}
+
+class FrameDiff {
+   public:
+    // Frame geometry; a change drops the shadow so the next diff is full.
+    void configure(const void* buffer, int width, int height, int bpp, size_t stride) {
+        if (buffer == buffer_ && width == width_ && height == height_ && bpp == bpp_ &&
+            stride == stride_) {
+            return;
+        }
+        buffer_ = buffer;
+        width_ = width;
+        height_ = height;
+        bpp_ = bpp;
+        stride_ = stride;
+        shadow_.assign(stride * size_t(height), 0);
+        valid_ = false;
+    }
+
+    // Forget the panel contents, e.g. after something drew to it directly.
+    void invalidate() { valid_ = false; }
+    bool valid() const { return valid_; }
+
+    // Compares `frame` with the last pushed frame and records it as pushed.
+    // Fills `out` with the rectangles to flush; the whole frame when the
+    // shadow is not valid. Returns the number of rectangles.
+    size_t diff(const uint8_t* frame, std::vector<Rect>& out) {
+        out.clear();
+        if (!valid_) {
+            memcpy(shadow_.data(), frame, shadow_.size());
+            valid_ = true;
+            out.push_back({0, 0, width_, height_});
+            return out.size();
+        }
+        for (int y0 = 0; y0 < height_; y0 += kPageRows) {
+            const int rows = height_ - y0 < kPageRows ? height_ - y0 : kPageRows;
+            int lo = stride_bytes();
+            int hi = -1;
+            for (int y = y0; y < y0 + rows; ++y) {
+                const size_t off = size_t(y) * stride_;
+                uint8_t* old_row = shadow_.data() + off;
+                const uint8_t* new_row = frame + off;
+                if (memcmp(old_row, new_row, stride_) == 0) continue;
+                int b = 0;
+                while (old_row[b] == new_row[b]) ++b;
+                int e = stride_bytes() - 1;
+                while (old_row[e] == new_row[e]) --e;
+                if (b < lo) lo = b;
+                if (e > hi) hi = e;
+                memcpy(old_row + b, new_row + b, size_t(e - b + 1));
+            }
+            if (hi < 0) continue;
+            Rect page;
+            page.x = pixel_of(lo);
+            page.w = pixel_of(hi + 1) - page.x;
+            if (page.x + page.w > width_) page.w = width_ - page.x;
+            page.y = y0;
+            page.h = rows;
+            append_page(out, page);
+        }
+        return out.size();
+    }
+
+   private:
+    int stride_bytes() const { return int(stride_); }
+    // First pixel stored in byte `b` of a row.
+    int pixel_of(int b) const { return int((int64_t(b) * 8) / bpp_); }
+
+    const void* buffer_ = nullptr;
+    int width_ = 0;
+    int height_ = 0;
+    int bpp_ = 0;
+    size_t stride_ = 0;
+    std::vector<uint8_t> shadow_;
+    bool valid_ = false;
+};
+
+}  // namespace oledflush
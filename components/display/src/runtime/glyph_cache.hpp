@@ -0,0 +1,190 @@
+// Pre-rasterized glyphs for OLED text.
+//
+// Screen text mixes a Latin base font with Japanese fonts picked per
+// character. Walking such a string the straightforward way costs, for every
+// character of every frame, a substring allocation, a font choice (which
+// queries the font tables for metrics) and a trip through the font renderer.
+// GlyphCache keeps each (face, codepoint) already rasterized as a 1-bpp
+// bitmap together with its advance, so hot text is a hash lookup and a bit
+// blit per character.
+//
+// Bitmaps use the LovyanGFX 1-bpp layout (rows of MSB-first bytes, each row
+// padded to a whole byte), which is also what drawBitmap() takes and what a
+// 1-bpp sprite stores. Pure logic: the caller provides the memory (PSRAM on
+// the device) and rasterizes misses.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace glyphcache {
+
+// Largest glyph cell that is cached; bigger fonts are drawn directly.
+constexpr int kMaxSide = 32;
+
+// Decodes one UTF-8 character at `p` and advances `p` past it. A byte that
+// does not start a valid sequence is returned as itself. Returns 0 without
+// advancing when the last sequence is cut off.
+inline uint32_t next_codepoint(const char*& p, const char* end) {
+    const uint8_t b0 = uint8_t(p[0]);
+    int len = 1;
+    uint32_t cp = b0;
+    if ((b0 & 0xE0u) == 0xC0u) {
+        len = 2;
+        cp = b0 & 0x1Fu;
+    } else if ((b0 & 0xF0u) == 0xE0u) {
+        len = 3;
+        cp = b0 & 0x0Fu;
+    } else if ((b0 & 0xF8u) == 0xF0u) {
+        len = 4;
+        cp = b0 & 0x07u;
+    }
+    if (end - p < len) return 0;
+    for (int i = 1; i < len; ++i) cp = (cp << 6) | (uint8_t(p[i]) & 0x3Fu);
+    p += len;
+    return cp;
+}
+
+constexpr size_t row_bytes(int w) { return size_t(w + 7) / 8; }
+constexpr size_t bitmap_bytes(int w, int h) { return row_bytes(w) * size_t(h); }
+
+struct Glyph {
+    const void* face = nullptr;  // nullptr: empty slot
+    uint32_t cp = 0;
+    uint32_t offset = 0;  // bitmap position in the pool
+    uint8_t w = 0;        // cell width (= advance, clipped to kMaxSide)
+    uint8_t h = 0;
+    uint8_t advance = 0;    // cursor advance
+    uint8_t y_advance = 0;  // line height of the font that drew it
+};
+
+class GlyphCache {
+   public:
+    static constexpr size_t kSlots = 512;  // power of two
+    static constexpr size_t kMaxGlyphs = kSlots * 3 / 4;
+
+    struct Stats {
+        uint32_t glyphs = 0;
+        uint32_t flushes = 0;
+        size_t pool_used = 0;
+        size_t pool_size = 0;
+    };
+
+    // Takes `bytes` of caller-owned memory: the slot table first, bitmaps
+    // after it. Returns false when it is too small to be useful.
+    bool attach(void* memory, size_t bytes) {
+        constexpr size_t kTableBytes = kSlots * sizeof(Glyph);
+        if (!memory || bytes < kTableBytes + bitmap_bytes(kMaxSide, kMaxSide)) {
+            return false;
+        }
+        slots_ = static_cast<Glyph*>(memory);
+        pool_ = static_cast<uint8_t*>(memory) + kTableBytes;
+        stats_.pool_size = bytes - kTableBytes;
+        clear();
+        stats_.flushes = 0;
+        return true;
+    }
+
+    bool ready() const { return slots_ != nullptr; }
+    const Stats& stats() const { return stats_; }
+    const uint8_t* bits(const Glyph& g) const { return pool_ + g.offset; }
+
+    const Glyph* find(const void* face, uint32_t cp) const {
+        if (!slots_) return nullptr;
+        for (size_t i = hash(face, cp);; i = (i + 1) & (kSlots - 1)) {
+            const Glyph& g = slots_[i];
+            if (!g.face) return nullptr;
+            if (g.face == face && g.cp == cp) return &g;
+        }
+    }
+
+    // Copies `bits` (bitmap_bytes(w, h) bytes) in. When the table or the
+    // pool is full everything is dropped first; the screens on this device
+    // use a few hundred distinct glyphs, so that is rare.
+    const Glyph* insert(const void* face, uint32_t cp, int w, int h, int advance,
+                        int y_advance, const uint8_t* bits) {
+        if (!slots_ || w <= 0 || h <= 0 || w > kMaxSide || h > kMaxSide) return nullptr;
+        const size_t n = bitmap_bytes(w, h);
+        if (stats_.glyphs >= kMaxGlyphs || stats_.pool_used + n > stats_.pool_size) {
+            clear();
+            ++stats_.flushes;
+        }
+        size_t i = hash(face, cp);
+        while (slots_[i].face) {
+            if (slots_[i].face == face && slots_[i].cp == cp) return &slots_[i];
+            i = (i + 1) & (kSlots - 1);
+        }
+        Glyph& g = slots_[i];
+        g.face = face;
+        g.cp = cp;
+        g.offset = uint32_t(stats_.pool_used);
+        g.w = uint8_t(w);
+        g.h = uint8_t(h);
+        g.advance = uint8_t(advance);
+        g.y_advance = uint8_t(y_advance);
+        std::memcpy(pool_ + stats_.pool_used, bits, n);
+        stats_.pool_used += n;
+        ++stats_.glyphs;
+        return &g;
+    }
+
+    void clear() {
+        if (slots_) std::memset(static_cast<void*>(slots_), 0, kSlots * sizeof(Glyph));
+        stats_.glyphs = 0;
+        stats_.pool_used = 0;
+    }
+
+   private:
+    static size_t hash(const void* face, uint32_t cp) {
+        uint32_t h = uint32_t(reinterpret_cast<uintptr_t>(face) >> 2) * 0x9E3779B1u;
+        h ^= cp * 0x85EBCA77u;
+        h ^= h >> 15;
+        return h & (kSlots - 1);
+    }
+
+    Glyph* slots_ = nullptr;
+    uint8_t* pool_ = nullptr;
+    Stats stats_;
+};
+
+// Draws a glyph bitmap into a 1-bpp frame (`stride` bytes per row) with its
+// top-left corner at (x, y), clipped to the frame. Set bits become `fg`;
+// with `opaque` the clear bits of the cell become !fg, as text drawn with a
+// background colour does.
+inline void blit_1bpp(uint8_t* frame, size_t stride, int frame_w, int frame_h, int x, int y,
+                      const uint8_t* bits, int w, int h, bool fg, bool opaque) {
+    const size_t rb = row_bytes(w);
+    const uint32_t cover = w >= 32 ? 0xFFFFFFFFu : ~(0xFFFFFFFFu >> w);
+    int db0 = (x < 0 ? 0 : x) >> 3;
+    int db1 = (x + w - 1 < frame_w ? x + w - 1 : frame_w - 1) >> 3;
+    if (x + w <= 0 || db0 > db1) return;
+    for (int r = 0; r < h; ++r) {
+        const int dy = y + r;
+        if (dy < 0) continue;
+        if (dy >= frame_h) break;
+        uint32_t src = 0;
+        for (size_t i = 0; i < rb; ++i) src |= uint32_t(bits[r * rb + i]) << (24 - 8 * i);
+        src &= cover;
+        uint8_t* dst = frame + size_t(dy) * stride;
+        for (int db = db0; db <= db1; ++db) {
+            // Glyph column of this byte's leftmost pixel (-7..31).
+            const int o = db * 8 - x;
+            const uint8_t v = uint8_t((o >= 0 ? src << o : src >> -o) >> 24);
+            uint8_t m = uint8_t((o >= 0 ? cover << o : cover >> -o) >> 24);
+            if (db * 8 + 8 > frame_w) m &= uint8_t(0xFF << (db * 8 + 8 - frame_w));
+            uint8_t d = dst[db];
+            if (opaque) {
+                d = uint8_t((d & ~m) | ((fg ? v : ~v) & m));
+            } else if (fg) {
+                d = uint8_t(d | (v & m));
+            } else {
+                d = uint8_t(d & ~(v & m));
+            }
+            dst[db] = d;
+        }
+    }
+}
+
+}  // namespace glyphcache
@@ -9,6 +9,7 @@
 #include <vector>
 #include <cctype>
 #include <memory>
+#include <mutex>
 #include <unordered_set>
 
 #define LGFX_USE_V1
@@ -43,6 +44,7 @@
 #include <app/contact/domain.hpp>
 #include <headupdaisy_font.hpp>
 #include <misaki_font.hpp>
+#include "sdkconfig.h"
 #include "esp_attr.h"
 #include "esp_err.h"
 #include "esp_heap_caps.h"
@@ -74,6 +76,12 @@
 #include "freertos/event_groups.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "driver/spi_master.h"
+#include "soc/soc.h"
+#include "frame_diff.hpp"
+#include "glyph_cache.hpp"
 #include <ctype.h>
 
 #pragma once
@@ -93,6 +101,15 @@ inline bool wifi_is_connected() {
     return esp_wifi_sta_get_ap_info(&ap) == ESP_OK;
 }
 
+// SSD1309 の SCLK は最小周期 100ns（10MHz）。実機で確かめた 400kHz を既定に
+// し、8MHz などへの引き上げは menuconfig（MOBUS_OLED_SPI_HZ）で行う
+#ifdef CONFIG_MOBUS_OLED_SPI_HZ
+constexpr uint32_t kOledSpiHz = CONFIG_MOBUS_OLED_SPI_HZ;
+#else
+constexpr uint32_t kOledSpiHz = 400 * 1000;
+#endif
+static_assert(kOledSpiHz <= 10 * 1000 * 1000, "SSD1309 の SPI クロック上限を超えている");
+
 class LGFX : public lgfx::LGFX_Device {
     lgfx::Panel_SSD1306
         _panel_instance;  // SSD1309 は SH110x ドライバで動作可能
@@ -107,10 +124,11 @@ class LGFX : public lgfx::LGFX_Device {
                 SPI3_HOST;     // ESP32-S3では SPI2_HOST または SPI3_HOST
             cfg.spi_mode = 0;  // SSD1309のSPIモードは0
 
-            cfg.freq_write = 400000;  // 8MHz程度が安定（モジュールによる）
+            cfg.freq_write = kOledSpiHz;
             cfg.freq_read = 0;        // dev/ 読み取り不要なため 0
             cfg.spi_3wire = false;    // DCピン使用するので false
             cfg.use_lock = true;
+            cfg.dma_channel = SPI_DMA_CH_AUTO;  // 差分転送は DMA で非同期に送る
 
             // 接続ピン（あなたの配線に基づく）
             cfg.pin_sclk = 2;   // SCK
@@ -151,6 +169,9 @@ class LGFX : public lgfx::LGFX_Device {
 
         setPanel(&_panel_instance);
     }
+
+    // 1bpp スプライトをページ形式のまま送るために使う
+    lgfx::Bus_SPI &bus() { return _bus_instance; }
 };
 
 static LGFX lcd;
@@ -181,9 +202,8 @@ inline uint16_t utf8_to_u16_codepoint(const std::string &utf8) {
 }
 
 inline const lgfx::IFont *select_display_font(const lgfx::IFont *base_font,
-                                              const std::string &utf8_char) {
+                                              uint32_t cp) {
     if (!base_font) base_font = &fonts::Font0;
-    const uint16_t cp = utf8_to_u16_codepoint(utf8_char);
     if (cp == 0) return base_font;
 
     // Only switch fonts for Japanese blocks (keep ASCII on the base font).
@@ -220,6 +240,11 @@ inline const lgfx::IFont *select_display_font(const lgfx::IFont *base_font,
     return fallback;
 }
 
+inline const lgfx::IFont *select_display_font(const lgfx::IFont *base_font,
+                                              const std::string &utf8_char) {
+    return select_display_font(base_font, utf8_to_u16_codepoint(utf8_char));
+}
+
 inline const lgfx::IFont *select_ime_font(int input_lang,
                                           const lgfx::IFont *base_font,
                                           const std::string &utf8_char) {
@@ -237,6 +262,200 @@ inline const lgfx::IFont *select_chat_input_font(const std::string &utf8_char) {
     return &fonts::lgfxJapanGothic_12;
 }
 
+// 文字ごとの substr / フォント選択 / print をやめ、(フェイス, コードポイント)
+// ごとに 1bpp へラスタライズ済みのグリフを PSRAM に持って描く
+using GlyphFontSelector = const lgfx::IFont *(*)(const lgfx::IFont *, uint32_t);
+
+// ベースフォントと文字ごとのフォントの選び方の組。キャッシュのキーになる
+struct TextFace {
+    const lgfx::IFont *base;
+    GlyphFontSelector select;
+};
+
+// MessageBox の本文用: ひらがな後半〜カタカナ（E3 82 xx / E3 83 xx）だけ日本語
+inline const lgfx::IFont *select_message_font(const lgfx::IFont *base_font,
+                                              uint32_t cp) {
+    if (cp >= 0x3080u && cp <= 0x30FFu) return &fonts::lgfxJapanGothic_12;
+    return base_font;
+}
+
+const TextFace kFont2DisplayFace{
+    &fonts::Font2, static_cast<GlyphFontSelector>(&select_display_font)};
+const TextFace kFont2MessageFace{&fonts::Font2, &select_message_font};
+
+struct GlyphTextState {
+    static constexpr size_t kCacheBytes = 32 * 1024;
+    glyphcache::GlyphCache cache;
+    LGFX_Sprite scratch;  // 取りこぼしたグリフを描く 32x32 の 1bpp
+    bool attach_tried = false;
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t uncached = 0;  // print に任せた文字
+};
+
+GlyphTextState g_glyph_text;
+
+inline bool glyph_cache_ready() {
+    auto &g = g_glyph_text;
+    if (g.cache.ready()) return true;
+    if (g.attach_tried) return false;
+    g.attach_tried = true;
+    g.scratch.setPsram(false);
+    g.scratch.setColorDepth(1);
+    void *mem = heap_caps_malloc(GlyphTextState::kCacheBytes,
+                                 MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!mem ||
+        !g.scratch.createSprite(glyphcache::kMaxSide, glyphcache::kMaxSide) ||
+        !g.cache.attach(mem, GlyphTextState::kCacheBytes)) {
+        heap_caps_free(mem);
+        g.scratch.deleteSprite();
+        ESP_LOGW(TAG, "[UI] glyph cache unavailable, drawing text directly");
+        return false;
+    }
+    ESP_LOGI(TAG, "[UI] glyph cache %u bytes in PSRAM",
+             static_cast<unsigned>(GlyphTextState::kCacheBytes));
+    return true;
+}
+
+// キャッシュにない文字をスクラッチに描いて取り込む。描けない大きさなら nullptr
+inline const glyphcache::Glyph *glyph_cache_load(const TextFace &face,
+                                                 uint32_t cp, const char *utf8,
+                                                 size_t len) {
+    constexpr int kSide = glyphcache::kMaxSide;
+    auto &g = g_glyph_text;
+    const lgfx::IFont *font = face.select(face.base, cp);
+    lgfx::FontMetrics metrics = {};
+    font->getDefaultMetric(&metrics);
+
+    char ch[5] = {};
+    std::memcpy(ch, utf8, len);
+    g.scratch.setFont(font);
+    g.scratch.setTextColor(0xFFFFFFu);
+    g.scratch.setTextWrap(false);
+    g.scratch.fillScreen(0x000000u);
+    g.scratch.setCursor(0, 0);
+    g.scratch.print(ch);
+    const int advance = g.scratch.getCursorX();
+    const int height = std::max<int>(metrics.height, metrics.y_advance);
+    if (advance <= 0 || advance > kSide || height <= 0 || height > kSide) {
+        return nullptr;
+    }
+
+    uint8_t bits[glyphcache::bitmap_bytes(kSide, kSide)];
+    const auto *src = static_cast<const uint8_t *>(g.scratch.getBuffer());
+    const size_t src_stride = glyphcache::row_bytes(kSide);
+    const size_t rb = glyphcache::row_bytes(advance);
+    for (int y = 0; y < height; ++y) {
+        std::memcpy(bits + y * rb, src + y * src_stride, rb);
+    }
+    return g.cache.insert(&face, cp, advance, height, advance,
+                          metrics.y_advance, bits);
+}
+
+inline const glyphcache::Glyph *glyph_cache_get(const TextFace &face,
+                                                uint32_t cp, const char *utf8,
+                                                size_t len) {
+    auto &g = g_glyph_text;
+    if (const auto *glyph = g.cache.find(&face, cp)) {
+        ++g.hits;
+        return glyph;
+    }
+    ++g.misses;
+    return glyph_cache_load(face, cp, utf8, len);
+}
+
+// キャッシュを使えない文字（制御文字・大きすぎる文字・文字サイズ 1 以外）は
+// 従来どおりフォントを切り替えて print する
+inline void print_uncached_char(const TextFace &face, uint32_t cp,
+                                const char *utf8, size_t len, int &x, int &y) {
+    char ch[5] = {};
+    std::memcpy(ch, utf8, len);
+    ++g_glyph_text.uncached;
+    sprite.setCursor(x, y);
+    sprite.setFont(face.select(face.base, cp));
+    sprite.print(ch);
+    x = sprite.getCursorX();
+    y = sprite.getCursorY();
+}
+
+// sprite のカーソル位置から text を描き、カーソルを進める。wrap は
+// setTextWrap(true) と同じ右端での折り返し。終わるとフォントは face.base
+inline void draw_cached_text(const TextFace &face, const std::string &text,
+                             bool wrap) {
+    const auto style = sprite.getTextStyle();
+    const bool cacheable =
+        style.size_x == 1 && style.size_y == 1 && glyph_cache_ready();
+    const bool fg = style.fore_rgb888 != 0;
+    const bool opaque = style.fore_rgb888 != style.back_rgb888;
+    // 1bpp のスプライトにはバッファへ直接ビットを置く
+    auto *frame = (sprite.getColorDepth() & 0xFF) == 1
+                      ? static_cast<uint8_t *>(sprite.getBuffer())
+                      : nullptr;
+    const size_t stride = glyphcache::row_bytes(sprite.width());
+    int x = sprite.getCursorX();
+    int y = sprite.getCursorY();
+    const char *p = text.data();
+    const char *end = p + text.size();
+    while (p < end) {
+        const char *start = p;
+        const uint32_t cp = glyphcache::next_codepoint(p, end);
+        if (cp == 0) break;
+        const size_t len = static_cast<size_t>(p - start);
+        const glyphcache::Glyph *glyph =
+            cacheable && cp >= 0x20u ? glyph_cache_get(face, cp, start, len)
+                                     : nullptr;
+        if (!glyph) {
+            print_uncached_char(face, cp, start, len, x, y);
+            continue;
+        }
+        if (wrap && x + glyph->advance > sprite.width()) {
+            x = 0;
+            y += glyph->y_advance;
+        }
+        const uint8_t *bits = g_glyph_text.cache.bits(*glyph);
+        if (frame) {
+            glyphcache::blit_1bpp(frame, stride, sprite.width(), sprite.height(),
+                                  x, y, bits, glyph->w, glyph->h, fg, opaque);
+        } else if (opaque) {
+            sprite.drawBitmap(x, y, bits, glyph->w, glyph->h, style.fore_rgb888,
+                              style.back_rgb888);
+        } else {
+            sprite.drawBitmap(x, y, bits, glyph->w, glyph->h,
+                              style.fore_rgb888);
+        }
+        x += glyph->advance;
+    }
+    sprite.setCursor(x, y);
+    sprite.setFont(face.base);
+}
+
+// draw_cached_text で描いたときの幅（折り返しなし）
+inline int cached_text_width(const TextFace &face, const std::string &text) {
+    const bool cacheable = glyph_cache_ready();
+    int width = 0;
+    const char *p = text.data();
+    const char *end = p + text.size();
+    while (p < end) {
+        const char *start = p;
+        const uint32_t cp = glyphcache::next_codepoint(p, end);
+        if (cp == 0) break;
+        const size_t len = static_cast<size_t>(p - start);
+        const glyphcache::Glyph *glyph =
+            cacheable && cp >= 0x20u ? glyph_cache_get(face, cp, start, len)
+                                     : nullptr;
+        if (glyph) {
+            width += glyph->advance;
+            continue;
+        }
+        char ch[5] = {};
+        std::memcpy(ch, start, len);
+        sprite.setFont(face.select(face.base, cp));
+        width += sprite.textWidth(ch);
+    }
+    sprite.setFont(face.base);
+    return width;
+}
+
 inline void wrap_char_set_index(int &select_y_index, int char_set_length) {
     if (char_set_length <= 0) {
         select_y_index = 0;
@@ -327,12 +546,131 @@ struct SpriteState {
     bool ready = false;
     int width = 0;
     int height = 0;
-    int depth = 0;
+    int depth = 0;  // 要求された深さ（実際の深さは sprite.getColorDepth()）
+};
+
+// パネルはモノクロなので、スプライトは 1bpp（128x64 で 1KB）を内部 RAM に
+// 置くのを基本にする。確保できないときだけ従来の深さ/PSRAM に落とす
+constexpr uint8_t kOledSpriteDepth = 1;
+
+struct SpriteAttempt {
+    uint8_t depth;
+    bool use_psram;
+};
+constexpr SpriteAttempt kOledSpriteAttempts[] = {
+    {1, false}, {1, true},  {8, true},
+    {8, false}, {4, true},  {4, false},
 };
 
 bool g_oled_ready = false;
 SpriteState g_sprite_state;
 
+// 差分転送: 前回送った内容と比べ、変化した SSD1306 ページ/列だけを送る
+constexpr int64_t kOledXferHistMs[] = {1, 2, 5, 10, 20, 50};
+constexpr size_t kOledXferBuckets = std::size(kOledXferHistMs) + 1;
+
+struct OledFlushStats {
+    uint32_t frames = 0;   // push_sprite_safe の呼び出し
+    uint32_t full = 0;     // 全画面転送
+    uint32_t partial = 0;  // 差分転送
+    uint32_t skipped = 0;  // 変化なし
+    uint32_t rects = 0;
+    uint64_t bytes = 0;    // パネルへ送ったバイト数（コマンド込みの概算）
+    uint32_t bytes_per_sec = 0;
+    uint32_t frames_per_sec = 0;
+    uint32_t native = 0;   // 1bpp をページ形式で直接送った回数
+    uint32_t avg_push_us = 0;  // UI タスク側の時間（転送待ちは含まない）
+    uint32_t max_push_us = 0;
+    uint32_t replaced = 0;     // 送信待ちのフレームを次のフレームにまとめた回数
+    uint32_t sync = 0;         // 表示タスクなしで同期送信した回数
+    // 転送 1 フレームの時間: <1, <2, <5, <10, <20, <50, >=50 ms
+    uint32_t xfer_hist[kOledXferBuckets] = {};
+    uint32_t screen_switches = 0;
+    uint32_t sprite_allocs = 0;
+    uint32_t last_switch_us = 0;  // oled_begin_screen の呼び出しから戻るまで
+    uint32_t max_switch_us = 0;
+    // 初回だけ測る lcd.init() と createSprite の時間。表示タスク以前は画面を
+    // 切り替えるたびにこの両方をしていたので、switch_us と比べる基準になる
+    uint32_t cold_init_us = 0;
+    uint32_t cold_alloc_us = 0;
+    uint32_t releases = 0;  // kReleaseSurface
+};
+
+struct OledFlushState {
+    oledflush::FrameDiff diff;
+    std::vector<oledflush::Rect> rects;
+    std::vector<oledflush::Rect> merged;
+    int rotation = -1;
+    int64_t last_full_us = 0;
+    int64_t window_start_us = 0;
+    uint64_t window_bytes = 0;
+    uint32_t window_frames = 0;
+    uint64_t window_push_us = 0;
+    uint8_t pages[128 * 64 / 8];
+    OledFlushStats stats;
+};
+
+OledFlushState g_oled_flush;
+
+// 表示タスク: lcd の初期化、スプライトの確保、パネルへの転送はすべてこの
+// タスクが行う。画面のタスクはスプライトに描いてフレームを渡すだけ。
+// 1bpp のフレームは 2 面のバッファの空いている方へページ形式で詰めてキューに
+// 入れ、DMA 転送を待たずに戻る
+struct OledFlushJob {
+    enum State : uint8_t { kFree, kFilling, kQueued, kSending };
+    State state = kFree;
+    uint8_t *data = nullptr;  // DMA 可能な内部 RAM
+    std::vector<oledflush::Rect> rects;
+};
+
+struct OledCommand {
+    enum Type : uint8_t {
+        kFrame,        // 送信待ちのバッファを送る
+        kSync,         // それまでのフレームを送り終えるのを待つだけ
+        kInit,         // lcd の初期化（初回のみ）
+        kSurface,      // スプライトの確保（同じ大きさ/深さなら何もしない）
+        kBeginScreen,  // 画面の切り替え
+        kPushSprite,   // 1bpp 以外のスプライトを LovyanGFX 経由で送る
+        kReleaseSurface,  // スプライトを解放する（HTTP などでヒープを空ける）
+    };
+    Type type = kFrame;
+    int width = 0;
+    int height = 0;
+    int depth = 0;
+    int32_t x = 0;
+    int32_t y = 0;
+    bool clip = false;  // kPushSprite: g_oled_flush.rects の範囲だけ送る
+    const char *context = "";
+    SemaphoreHandle_t done = nullptr;
+    bool *ok = nullptr;
+};
+
+struct OledOwner {
+    static constexpr uint32_t kTaskStackWords = 4096;
+    static constexpr UBaseType_t kQueueDepth = 8;
+    std::mutex mu;  // jobs と stats.xfer_hist
+    std::mutex start_mu;
+    OledFlushJob jobs[2];
+    QueueHandle_t queue = nullptr;
+    TaskHandle_t task = nullptr;
+    StaticTask_t task_buffer;
+    StackType_t *task_stack = nullptr;
+    bool start_failed = false;
+};
+
+OledOwner g_oled_owner;
+
+StackType_t *allocate_internal_stack(StackType_t *&slot, size_t words,
+                                     const char *label);
+
+// 直接 lcd に描いた（init/clear/回転）あとに呼ぶ。次の push は全画面になる
+inline void oled_flush_invalidate() { g_oled_flush.diff.invalidate(); }
+
+inline OledFlushStats oled_flush_stats() {
+    std::lock_guard<std::mutex> lock(g_oled_owner.mu);
+    return g_oled_flush.stats;
+}
+
 inline void log_memory_state(const char *reason, const char *context) {
     ESP_LOGE(TAG, "%s (%s free=%u, largest=%u, psram=%u)", reason, context,
              static_cast<unsigned>(heap_caps_get_free_size(MALLOC_CAP_INTERNAL |
@@ -343,10 +681,12 @@ inline void log_memory_state(const char *reason, const char *context) {
                  heap_caps_get_free_size(MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)));
 }
 
-bool ensure_lcd_ready(const char *context) {
+// 以下 oled_*_local は表示タスク上（表示タスクがなければ呼び出し元）で動く
+inline bool oled_lcd_ready_local(const char *context) {
     if (g_oled_ready) return true;
     sprite.deleteSprite();
     g_sprite_state.ready = false;
+    const int64_t t0 = esp_timer_get_time();
     if (!lcd.init()) {
         g_oled_ready = false;
         log_memory_state("[OLED] lcd.init failed", context);
@@ -355,43 +695,480 @@ bool ensure_lcd_ready(const char *context) {
     lcd.clearDisplay();
     lcd.setRotation(2);
     lcd.fillScreen(0x000000u);
+    oled_flush_invalidate();
+    if (g_oled_flush.stats.cold_init_us == 0) {
+        g_oled_flush.stats.cold_init_us =
+            static_cast<uint32_t>(esp_timer_get_time() - t0);
+    }
+    ESP_LOGI(TAG, "[OLED] SPI %u Hz (actual %d Hz)",
+             static_cast<unsigned>(kOledSpiHz),
+             spi_get_actual_clock(APB_CLK_FREQ, kOledSpiHz, 128));
     g_oled_ready = true;
     return true;
 }
 
-bool ensure_sprite_surface(int width, int height, int depth,
-                           const char *context) {
-    if (!ensure_lcd_ready(context)) return false;
+inline bool oled_sprite_surface_local(int width, int height, int depth,
+                                      const char *context) {
+    if (!oled_lcd_ready_local(context)) return false;
     if (g_sprite_state.ready && sprite.getBuffer() != nullptr &&
         g_sprite_state.width == width && g_sprite_state.height == height &&
         g_sprite_state.depth == depth) {
         return true;
     }
 
+    // 1bpp は小さいので内部 RAM を先に試し、だめなら従来の深さに落とす
+    const SpriteAttempt fixed[] = {{uint8_t(depth), true},
+                                   {uint8_t(depth), false}};
+    const SpriteAttempt *begin = fixed;
+    const SpriteAttempt *end = std::end(fixed);
+    if (depth == kOledSpriteDepth) {
+        begin = std::begin(kOledSpriteAttempts);
+        end = std::end(kOledSpriteAttempts);
+    }
     sprite.deleteSprite();
-    sprite.setPsram(true);
-    sprite.setColorDepth(depth);
-    if (!sprite.createSprite(width, height)) {
-        g_sprite_state.ready = false;
-        ESP_LOGE(
-            TAG, "[OLED] sprite.createSprite failed (%s, free=%u, largest=%u)",
-            context,
-            static_cast<unsigned>(heap_caps_get_free_size(MALLOC_CAP_DEFAULT)),
-            static_cast<unsigned>(
-                heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT)));
+    g_sprite_state.ready = false;
+    const int64_t t0 = esp_timer_get_time();
+    for (const auto *attempt = begin; attempt != end; ++attempt) {
+        sprite.setPsram(attempt->use_psram);
+        sprite.setColorDepth(attempt->depth);
+        if (!sprite.createSprite(width, height)) continue;
+        ++g_oled_flush.stats.sprite_allocs;
+        if (g_oled_flush.stats.cold_alloc_us == 0) {
+            g_oled_flush.stats.cold_alloc_us =
+                static_cast<uint32_t>(esp_timer_get_time() - t0);
+        }
+        ESP_LOGI(TAG, "[OLED] sprite %dx%d depth=%u psram=%s (%s)", width,
+                 height, attempt->depth, attempt->use_psram ? "true" : "false",
+                 context);
+        g_sprite_state.ready = true;
+        g_sprite_state.width = width;
+        g_sprite_state.height = height;
+        g_sprite_state.depth = depth;
+        return true;
+    }
+    ESP_LOGE(TAG, "[OLED] sprite.createSprite failed (%s, free=%u, largest=%u)",
+             context,
+             static_cast<unsigned>(heap_caps_get_free_size(MALLOC_CAP_DEFAULT)),
+             static_cast<unsigned>(
+                 heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT)));
+    return false;
+}
+
+// SSD1306 のウィンドウ（列 x0..x1, ページ p0..p1）へページ形式のデータを送る
+inline void oled_write_pages(const oledflush::Rect &r, const uint8_t *data,
+                             size_t len, bool use_dma) {
+    const int p0 = r.y / oledflush::kPageRows;
+    const int p1 = (r.y + r.h - 1) / oledflush::kPageRows;
+    lcd.startWrite();
+    lcd.writeCommand(0x21);  // column address
+    lcd.writeCommand(r.x);
+    lcd.writeCommand(r.x + r.w - 1);
+    lcd.writeCommand(0x22);  // page address
+    lcd.writeCommand(p0);
+    lcd.writeCommand(p1);
+    lcd.bus().writeBytes(data, len, true, use_dma);
+    lcd.endWrite();
+}
+
+inline void oled_push_sprite_local(const OledCommand &cmd) {
+    if (!cmd.clip) {
+        sprite.pushSprite(&lcd, cmd.x, cmd.y);
+        return;
+    }
+    // Panel_SSD1306 は変更範囲を 1 つの矩形で持つので、矩形ごとに
+    // 転送を閉じて表示させる
+    for (const auto &r : g_oled_flush.rects) {
+        lcd.setClipRect(r.x, r.y, r.w, r.h);
+        sprite.pushSprite(&lcd, 0, 0);
+        lcd.display();
+    }
+    lcd.clearClipRect();
+}
+
+inline bool oled_run_local(const OledCommand &cmd) {
+    switch (cmd.type) {
+        case OledCommand::kFrame:
+        case OledCommand::kSync:
+            return true;
+        case OledCommand::kInit:
+            return oled_lcd_ready_local(cmd.context);
+        case OledCommand::kSurface:
+            return oled_sprite_surface_local(cmd.width, cmd.height, cmd.depth,
+                                             cmd.context);
+        case OledCommand::kBeginScreen:
+            if (!oled_lcd_ready_local(cmd.context)) return false;
+            if (lcd.getRotation() != 2) lcd.setRotation(2);
+            if (!oled_sprite_surface_local(lcd.width(), lcd.height(), cmd.depth,
+                                           cmd.context)) {
+                return false;
+            }
+            // パネルは消さない。前の画面の最後のフレームとの差分だけが送られる
+            sprite.fillScreen(0x000000u);
+            sprite.setCursor(0, 0);
+            return true;
+        case OledCommand::kPushSprite:
+            if (!g_oled_ready || sprite.getBuffer() == nullptr) return false;
+            oled_push_sprite_local(cmd);
+            return true;
+        case OledCommand::kReleaseSurface:
+            sprite.deleteSprite();
+            g_sprite_state.ready = false;
+            ++g_oled_flush.stats.releases;
+            ESP_LOGI(TAG, "[OLED] sprite released (%s)", cmd.context);
+            return true;
+    }
+    return false;
+}
+
+// 送信待ちのバッファがあれば送る（表示タスク上で動く）
+inline void oled_send_queued() {
+    auto &o = g_oled_owner;
+    for (;;) {
+        OledFlushJob *job = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(o.mu);
+            for (auto &j : o.jobs) {
+                if (j.state == OledFlushJob::kQueued) {
+                    j.state = OledFlushJob::kSending;
+                    job = &j;
+                    break;
+                }
+            }
+        }
+        if (!job) return;
+        const int64_t t0 = esp_timer_get_time();
+        size_t off = 0;
+        for (const auto &r : job->rects) {
+            const size_t len =
+                oledflush::flush_bytes(r) - oledflush::kWindowCmdBytes;
+            oled_write_pages(r, job->data + off, len, true);
+            off += len;
+        }
+        const int64_t ms = (esp_timer_get_time() - t0) / 1000;
+        size_t bucket = 0;
+        while (bucket < std::size(kOledXferHistMs) &&
+               ms >= kOledXferHistMs[bucket]) {
+            ++bucket;
+        }
+        std::lock_guard<std::mutex> lock(o.mu);
+        ++g_oled_flush.stats.xfer_hist[bucket];
+        job->state = OledFlushJob::kFree;
+    }
+}
+
+inline void oled_owner_task(void *) {
+    auto &o = g_oled_owner;
+    for (;;) {
+        OledCommand cmd;
+        if (xQueueReceive(o.queue, &cmd, portMAX_DELAY) != pdTRUE) continue;
+        // コマンドより前に渡されたフレームを先に送る（順序を保つ）
+        oled_send_queued();
+        if (cmd.type == OledCommand::kFrame) continue;
+        const bool ok = oled_run_local(cmd);
+        if (cmd.ok) *cmd.ok = ok;
+        if (cmd.done) xSemaphoreGive(cmd.done);
+    }
+}
+
+inline bool oled_owner_start() {
+    auto &o = g_oled_owner;
+    if (o.task) return true;
+    std::lock_guard<std::mutex> lock(o.start_mu);
+    if (o.task) return true;
+    if (o.start_failed) return false;
+    o.start_failed = true;
+    for (auto &j : o.jobs) {
+        if (!j.data) {
+            j.data = static_cast<uint8_t *>(heap_caps_malloc(
+                sizeof(g_oled_flush.pages), MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL));
+        }
+        if (!j.data) {
+            ESP_LOGW(TAG, "[OLED] flush buffer alloc failed, drawing inline");
+            return false;
+        }
+        j.rects.reserve(64 / oledflush::kPageRows);
+    }
+    if (!o.queue) o.queue = xQueueCreate(OledOwner::kQueueDepth, sizeof(OledCommand));
+    if (!o.queue ||
+        !allocate_internal_stack(o.task_stack, OledOwner::kTaskStackWords,
+                                 "oled")) {
+        ESP_LOGW(TAG, "[OLED] display task alloc failed, drawing inline");
         return false;
     }
-    g_sprite_state.ready = true;
-    g_sprite_state.width = width;
-    g_sprite_state.height = height;
-    g_sprite_state.depth = depth;
-    return true;
+    // 転送完了待ちはビジーウェイトなので UI（core 0）とは別のコアに置く
+    o.task = xTaskCreateStaticPinnedToCore(
+        &oled_owner_task, "oled", OledOwner::kTaskStackWords, NULL, 5,
+        o.task_stack, &o.task_buffer, 1);
+    o.start_failed = o.task == nullptr;
+    return o.task != nullptr;
+}
+
+// 表示タスクでコマンドを実行して終わるまで待つ。表示タスクが作れなかった
+// ときは呼び出し元でそのまま実行する
+inline bool oled_call(OledCommand cmd) {
+    auto &o = g_oled_owner;
+    if (!oled_owner_start() || xTaskGetCurrentTaskHandle() == o.task) {
+        return oled_run_local(cmd);
+    }
+    StaticSemaphore_t done_buffer;
+    bool ok = false;
+    cmd.done = xSemaphoreCreateBinaryStatic(&done_buffer);
+    cmd.ok = &ok;
+    xQueueSend(o.queue, &cmd, portMAX_DELAY);
+    xSemaphoreTake(cmd.done, portMAX_DELAY);
+    vSemaphoreDelete(cmd.done);
+    return ok;
+}
+
+bool ensure_lcd_ready(const char *context) {
+    if (g_oled_ready) return true;
+    OledCommand cmd;
+    cmd.type = OledCommand::kInit;
+    cmd.context = context;
+    return oled_call(cmd);
+}
+
+bool ensure_sprite_surface(int width, int height, int depth,
+                           const char *context) {
+    OledCommand cmd;
+    cmd.type = OledCommand::kSurface;
+    cmd.width = width;
+    cmd.height = height;
+    cmd.depth = depth;
+    cmd.context = context;
+    return oled_call(cmd);
+}
+
+// 画面のタスクがスプライトを消すときはこれを使う（sprite.deleteSprite() を
+// 直接呼ぶと g_sprite_state が確保済みのまま残り、次の確保が飛ばされる）
+bool release_sprite_surface(const char *context) {
+    OledCommand cmd;
+    cmd.type = OledCommand::kReleaseSurface;
+    cmd.context = context;
+    return oled_call(cmd);
+}
+
+// 画面の入口で呼ぶ。lcd の初期化とスプライトの確保は最初の一度だけで、
+// 以降は同じスプライトを消して使い回す（フォント等の設定は呼び出し側で）
+inline bool oled_begin_screen(const char *context,
+                              int depth = kOledSpriteDepth) {
+    const int64_t t0 = esp_timer_get_time();
+    const uint32_t allocs = g_oled_flush.stats.sprite_allocs;
+    OledCommand cmd;
+    cmd.type = OledCommand::kBeginScreen;
+    cmd.depth = depth;
+    cmd.context = context;
+    const bool ok = oled_call(cmd);
+    auto &s = g_oled_flush.stats;
+    s.last_switch_us = static_cast<uint32_t>(esp_timer_get_time() - t0);
+    if (s.last_switch_us > s.max_switch_us) s.max_switch_us = s.last_switch_us;
+    ++s.screen_switches;
+    ESP_LOGI(TAG,
+             "[OLED] screen %s ready in %uus (max %uus, alloc=%s; old path "
+             "init %uus + sprite %uus)%s",
+             context, static_cast<unsigned>(s.last_switch_us),
+             static_cast<unsigned>(s.max_switch_us),
+             s.sprite_allocs != allocs ? "yes" : "no",
+             static_cast<unsigned>(s.cold_init_us),
+             static_cast<unsigned>(s.cold_alloc_us), ok ? "" : " FAILED");
+    return ok;
+}
+
+// 詰めるバッファを取る。送信待ちが残っていればそれを取り上げて次の
+// フレームにまとめる（呼び出し側はその rects も含めて詰め直す）。送信待ちは
+// 常に 1 つだけなので、転送の順序が入れ替わることはない
+inline OledFlushJob *oled_pipeline_acquire(bool *replaced) {
+    auto &o = g_oled_owner;
+    *replaced = false;
+    std::lock_guard<std::mutex> lock(o.mu);
+    for (auto &j : o.jobs) {
+        if (j.state == OledFlushJob::kQueued) {
+            j.state = OledFlushJob::kFilling;
+            *replaced = true;
+            return &j;
+        }
+    }
+    for (auto &j : o.jobs) {
+        if (j.state == OledFlushJob::kFree) {
+            j.state = OledFlushJob::kFilling;
+            return &j;
+        }
+    }
+    return nullptr;
+}
+
+inline void oled_pipeline_submit(OledFlushJob *job, bool send) {
+    {
+        std::lock_guard<std::mutex> lock(g_oled_owner.mu);
+        job->state = send ? OledFlushJob::kQueued : OledFlushJob::kFree;
+    }
+    if (!send) return;
+    // キューが詰まっていても、送信待ちは次のコマンドの前に必ず送られる
+    OledCommand cmd;
+    cmd.type = OledCommand::kFrame;
+    xQueueSend(g_oled_owner.queue, &cmd, 0);
 }
 
 inline void push_sprite_safe(int32_t x, int32_t y) {
+    // 取りこぼしがあっても画面が戻るように、一定間隔で全画面を送り直す
+    constexpr int64_t kFullRefreshUs = 5 * 1000 * 1000;
+    constexpr int64_t kStatsWindowUs = 10 * 1000 * 1000;
     if (!g_oled_ready) return;
     if (sprite.getBuffer() == nullptr) return;
-    sprite.pushSprite(&lcd, x, y);
+
+    auto &f = g_oled_flush;
+    const int64_t now = esp_timer_get_time();
+    const int w = sprite.width();
+    const int h = sprite.height();
+    const int bpp = sprite.getColorDepth() & 0xFF;
+    ++f.stats.frames;
+    ++f.window_frames;
+
+    OledCommand push;
+    push.type = OledCommand::kPushSprite;
+    push.x = x;
+    push.y = y;
+    const bool diffable = x == 0 && y == 0 && w == lcd.width() &&
+                          h == lcd.height() && bpp > 0 && h > 0;
+    if (!diffable) {
+        f.diff.invalidate();
+        oled_call(push);
+        const uint64_t sent = oledflush::flush_bytes({0, 0, w, h});
+        ++f.stats.full;
+        f.stats.bytes += sent;
+        f.window_bytes += sent;
+    } else {
+        if (lcd.getRotation() != f.rotation ||
+            now - f.last_full_us >= kFullRefreshUs) {
+            f.rotation = lcd.getRotation();
+            f.diff.invalidate();
+        }
+        const size_t stride = sprite.bufferLength() / h;
+        f.diff.configure(sprite.getBuffer(), w, h, bpp, stride);
+        // 1bpp でパネルと同じ向き（rotation 2 = パネル内部は無回転）なら
+        // ページ形式に詰め替えて直接送る。色変換もパネル側バッファも通らない
+        const bool native = bpp == 1 && f.rotation == 2 &&
+                            size_t(w) * h / 8 <= sizeof(f.pages);
+        const bool owner = g_oled_owner.task != nullptr;
+        OledFlushJob *job = nullptr;
+        bool replaced = false;
+        if (native && owner) {
+            job = oled_pipeline_acquire(&replaced);
+            if (replaced) ++f.stats.replaced;
+        }
+        const bool full = !f.diff.valid();
+        if (full) f.last_full_us = now;
+        const auto *frame = static_cast<const uint8_t *>(sprite.getBuffer());
+        f.diff.diff(frame, f.rects);
+        if (replaced) {
+            // 送られなかった前のフレームの範囲も、今のフレームの内容で送る
+            oledflush::merge_rects(job->rects, f.rects, w, h, f.merged);
+            f.rects.swap(f.merged);
+        }
+        if (f.rects.empty()) {
+            ++f.stats.skipped;
+            if (job) oled_pipeline_submit(job, false);
+        } else if (native && job) {
+            size_t off = 0;
+            for (const auto &r : f.rects) {
+                off += oledflush::pack_pages(frame, stride, h, r, job->data + off);
+            }
+            job->rects = f.rects;
+            oled_pipeline_submit(job, true);
+            ++f.stats.native;
+        } else if (native && !owner) {
+            for (const auto &r : f.rects) {
+                const size_t len =
+                    oledflush::pack_pages(frame, stride, h, r, f.pages);
+                oled_write_pages(r, f.pages, len, false);
+            }
+            ++f.stats.native;
+            ++f.stats.sync;
+        } else if (native) {
+            // 2 面とも使用中（複数タスクから同時に push された）。今回は送らず
+            // 次の push で全画面を送る
+            f.diff.invalidate();
+            f.rects.clear();
+            ++f.stats.skipped;
+        } else {
+            push.clip = !(full || (f.rects.size() == 1 &&
+                                   f.rects[0].w == w && f.rects[0].h == h));
+            oled_call(push);
+        }
+        if (!f.rects.empty()) {
+            if (full) {
+                ++f.stats.full;
+            } else {
+                ++f.stats.partial;
+            }
+        }
+        for (const auto &r : f.rects) {
+            const uint64_t sent = oledflush::flush_bytes(r);
+            f.stats.bytes += sent;
+            f.window_bytes += sent;
+        }
+        f.stats.rects += f.rects.size();
+    }
+
+    const int64_t push_us = esp_timer_get_time() - now;
+    f.window_push_us += push_us;
+    if (push_us > f.stats.max_push_us) {
+        f.stats.max_push_us = static_cast<uint32_t>(push_us);
+    }
+
+    if (f.window_start_us == 0) f.window_start_us = now;
+    const int64_t elapsed = now - f.window_start_us;
+    if (elapsed >= kStatsWindowUs) {
+        f.stats.bytes_per_sec =
+            static_cast<uint32_t>(f.window_bytes * 1000000 / elapsed);
+        f.stats.frames_per_sec =
+            static_cast<uint32_t>(uint64_t(f.window_frames) * 1000000 / elapsed);
+        f.stats.avg_push_us =
+            static_cast<uint32_t>(f.window_push_us / f.window_frames);
+        ESP_LOGI(TAG,
+                 "[OLED] flush %u B/s %u fps push=%uus (max %uus) depth=%d "
+                 "sprite=%uB (frames=%u full=%u partial=%u skipped=%u "
+                 "rects=%u native=%u)",
+                 static_cast<unsigned>(f.stats.bytes_per_sec),
+                 static_cast<unsigned>(f.stats.frames_per_sec),
+                 static_cast<unsigned>(f.stats.avg_push_us),
+                 static_cast<unsigned>(f.stats.max_push_us), bpp,
+                 static_cast<unsigned>(sprite.bufferLength()),
+                 static_cast<unsigned>(f.stats.frames),
+                 static_cast<unsigned>(f.stats.full),
+                 static_cast<unsigned>(f.stats.partial),
+                 static_cast<unsigned>(f.stats.skipped),
+                 static_cast<unsigned>(f.stats.rects),
+                 static_cast<unsigned>(f.stats.native));
+        uint32_t hist[kOledXferBuckets];
+        {
+            std::lock_guard<std::mutex> lock(g_oled_owner.mu);
+            std::copy(std::begin(f.stats.xfer_hist),
+                      std::end(f.stats.xfer_hist), hist);
+        }
+        ESP_LOGI(TAG,
+                 "[OLED] xfer ms <1:%u <2:%u <5:%u <10:%u <20:%u <50:%u "
+                 ">=50:%u (replaced=%u sync=%u switches=%u allocs=%u "
+                 "releases=%u glyph hit=%u miss=%u direct=%u n=%u flush=%u)",
+                 static_cast<unsigned>(hist[0]), static_cast<unsigned>(hist[1]),
+                 static_cast<unsigned>(hist[2]), static_cast<unsigned>(hist[3]),
+                 static_cast<unsigned>(hist[4]), static_cast<unsigned>(hist[5]),
+                 static_cast<unsigned>(hist[6]),
+                 static_cast<unsigned>(f.stats.replaced),
+                 static_cast<unsigned>(f.stats.sync),
+                 static_cast<unsigned>(f.stats.screen_switches),
+                 static_cast<unsigned>(f.stats.sprite_allocs),
+                 static_cast<unsigned>(f.stats.releases),
+                 static_cast<unsigned>(g_glyph_text.hits),
+                 static_cast<unsigned>(g_glyph_text.misses),
+                 static_cast<unsigned>(g_glyph_text.uncached),
+                 static_cast<unsigned>(g_glyph_text.cache.stats().glyphs),
+                 static_cast<unsigned>(g_glyph_text.cache.stats().flushes));
+        f.window_start_us = now;
+        f.window_bytes = 0;
+        f.window_frames = 0;
+        f.window_push_us = 0;
+    }
 }
 
 StackType_t *allocate_internal_stack(StackType_t *&slot, size_t words,
@@ -416,6 +1193,7 @@ StackType_t *allocate_internal_stack(StackType_t *&slot, size_t words,
 #include <chat_api.hpp>
 #include <ota_client.hpp>
 #include <mqtt_runtime.h>
+#include <espnow_runtime.h>
 #include <ble_uart.hpp>
 #include "esp_app_desc.h"
 #include "esp_ota_ops.h"
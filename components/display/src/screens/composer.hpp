@@ -33,12 +33,10 @@ class Composer {
     }
 
     static void composer_task(void *pv) {
-        lcd.init();
-        lcd.setRotation(2);
-        sprite.setColorDepth(8);
+        // 灰色（0x7BEF）の枠を描くので 8bpp のまま
+        oled_begin_screen("Composer", 8);
         sprite.setFont(&fonts::Font2);
         sprite.setTextWrap(false);
-        sprite.createSprite(lcd.width(), lcd.height());
 
         Joystick joystick;
         Button type_button(GPIO_NUM_46);
@@ -77,46 +77,16 @@ class ContactBook {
         };
         status_panel_api.present = [&]() { push_sprite_safe(0, 0); };
 
+        oled_begin_screen("ContactBook");
         auto recreate_contact_sprite = [&](int width, int height) -> bool {
-            struct Attempt {
-                uint8_t depth;
-                bool use_psram;
-            };
-            constexpr Attempt attempts[] = {
-                {8, true},  {8, false}, {4, true},
-                {4, false}, {1, true},  {1, false},
-            };
-
-            sprite.deleteSprite();
-            for (const auto &attempt : attempts) {
-                sprite.setPsram(attempt.use_psram);
-                sprite.setColorDepth(attempt.depth);
-                sprite.setFont(&fonts::Font2);
-                sprite.setTextWrap(true);
-                if (sprite.createSprite(width, height)) {
-                    ESP_LOGD("CONTACT",
-                             "Sprite created %dx%d depth=%u psram=%s (free=%u "
-                             "largest=%u)",
-                             width, height, attempt.depth,
-                             attempt.use_psram ? "true" : "false",
-                             (unsigned)heap_caps_get_free_size(
-                                 MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
-                             (unsigned)heap_caps_get_largest_free_block(
-                                 MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
-                    return true;
-                }
-                ESP_LOGD("CONTACT",
-                         "createSprite(%d,%d) depth=%u psram=%s failed "
-                         "(free=%u largest=%u)",
-                         width, height, attempt.depth,
-                         attempt.use_psram ? "true" : "false",
-                         (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL |
-                                                           MALLOC_CAP_8BIT),
-                         (unsigned)heap_caps_get_largest_free_block(
-                             MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
-                sprite.deleteSprite();
+            // 確保済みなら表示タスク側で再利用される
+            if (!ensure_sprite_surface(width, height, kOledSpriteDepth,
+                                       "ContactBook")) {
+                return false;
             }
-            return false;
+            sprite.setFont(&fonts::Font2);
+            sprite.setTextWrap(true);
+            return true;
         };
         if (!recreate_contact_sprite(lcd.width(), lcd.height())) {
             finish_task();
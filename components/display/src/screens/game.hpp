@@ -41,12 +41,9 @@ class Game {
         }
         wdt_registered_ = wdt_registered;
 
-        lcd.init();
-        lcd.setRotation(2);
-        sprite.setColorDepth(8);
+        oled_begin_screen("Game");
         sprite.setFont(&fonts::Font2);
         sprite.setTextWrap(false);
-        sprite.createSprite(lcd.width(), lcd.height());
 
         Joystick joystick;
         Button type_button(GPIO_NUM_46);
@@ -98,12 +95,9 @@ class Game {
 
         HapticMotor &haptic = HapticMotor::instance();
 
-        lcd.setRotation(2);
-
-        sprite.setColorDepth(8);
+        oled_begin_screen("GameRound");
         sprite.setFont(&fonts::Font4);
         sprite.setTextWrap(true);  // 右端到達時のカーソル折り返しを禁止
-        sprite.createSprite(lcd.width(), lcd.height());
 
         char letters[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
 
@@ -449,10 +443,9 @@ static void play_morse_message(const std::string &text,
     auto &buzzer = audio::speaker();
     buzzer.init();
 
-    sprite.setColorDepth(8);
+    oled_begin_screen("MorsePlayback");
     sprite.setFont(&fonts::Font2);
     sprite.setTextWrap(true);
-    sprite.createSprite(lcd.width(), lcd.height());
 
     const TickType_t dot_ticks = pdMS_TO_TICKS(60);
     const TickType_t dash_ticks = pdMS_TO_TICKS(180);
@@ -468,31 +461,12 @@ static void play_morse_message(const std::string &text,
             sprite.drawCenterString(header.c_str(), cx, 15);
         }
         const std::string line = display + morse_part;
-        int total_w = 0;
-        for (size_t p = 0; p < line.size();) {
-            int char_len =
-                utf8_char_length(static_cast<unsigned char>(line[p]));
-            if (char_len <= 0) char_len = 1;
-            if (p + (size_t)char_len > line.size()) break;
-            std::string ch = line.substr(p, (size_t)char_len);
-            sprite.setFont(select_display_font(&fonts::Font2, ch));
-            total_w += sprite.textWidth(ch.c_str());
-            p += (size_t)char_len;
-        }
+        const int total_w = cached_text_width(kFont2DisplayFace, line);
         int x = cx - (total_w / 2);
         if (x < 0) x = 0;
         sprite.setCursor(x, cy);
         sprite.setTextWrap(false);
-        for (size_t p = 0; p < line.size();) {
-            int char_len =
-                utf8_char_length(static_cast<unsigned char>(line[p]));
-            if (char_len <= 0) char_len = 1;
-            if (p + (size_t)char_len > line.size()) break;
-            std::string ch = line.substr(p, (size_t)char_len);
-            sprite.setFont(select_display_font(&fonts::Font2, ch));
-            sprite.print(ch.c_str());
-            p += (size_t)char_len;
-        }
+        draw_cached_text(kFont2DisplayFace, line, false);
         push_sprite_safe(0, 0);
     };
 
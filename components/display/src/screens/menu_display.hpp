@@ -52,8 +52,6 @@ class MenuDisplay {
         // TODO: Buttonクラスではなく別で実装する
         Button charge_stat(GPIO_NUM_8);
 
-        lcd.setRotation(2);
-
         ui::menu::ViewState view_state;
         ui::menu::Presenter presenter(view_state);
         ui::menu::Renderer renderer;
@@ -62,7 +60,7 @@ class MenuDisplay {
         const int icon_pos_y[3] = {22, 22, 22};
 
         auto ensure_menu_sprite = [&]() -> bool {
-            if (!ensure_sprite_surface(lcd.width(), lcd.height(), 8,
+            if (!ensure_sprite_surface(lcd.width(), lcd.height(), kOledSpriteDepth,
                                        "MenuDisplay")) {
                 return false;
             }
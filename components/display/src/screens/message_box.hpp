@@ -47,7 +47,7 @@ class MessageBox {
 
     static void box_task(void *pvParameters) {
         // nvs_main(); // removed demo call
-        lcd.init();
+        oled_begin_screen("MessageBox");
 
         TalkDisplay talk;
         Joystick joystick;
@@ -64,41 +64,14 @@ class MessageBox {
         push_sprite_safe(0, 0);
 
         auto recreate_message_sprite = [&](int width, int height) -> bool {
-            struct Attempt {
-                uint8_t depth;
-                bool use_psram;
-            };
-            constexpr Attempt attempts[] = {
-                {8, true},  {8, false}, {4, true},
-                {4, false}, {1, true},  {1, false},
-            };
-
-            sprite.deleteSprite();
-            for (const auto &attempt : attempts) {
-                sprite.setPsram(attempt.use_psram);
-                sprite.setColorDepth(attempt.depth);
-                sprite.setFont(&fonts::Font2);
-                sprite.setTextWrap(true);
-                if (sprite.createSprite(width, height)) {
-                    ESP_LOGI(
-                        TAG,
-                        "[UI] message sprite %dx%d depth=%u psram=%s created",
-                        width, height, attempt.depth,
-                        attempt.use_psram ? "true" : "false");
-                    return true;
-                }
-                ESP_LOGW(
-                    TAG,
-                    "[UI] message sprite alloc fail %dx%d depth=%u psram=%s"
-                    " (free=%u largest=%u)",
-                    width, height, attempt.depth,
-                    attempt.use_psram ? "true" : "false",
-                    (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL |
-                                                      MALLOC_CAP_8BIT),
-                    (unsigned)heap_caps_get_largest_free_block(
-                        MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+            // 確保済みなら表示タスク側で再利用される
+            if (!ensure_sprite_surface(width, height, kOledSpriteDepth,
+                                       "MessageBox")) {
+                return false;
             }
-            return false;
+            sprite.setFont(&fonts::Font2);
+            sprite.setTextWrap(true);
+            return true;
         };
         if (!recreate_message_sprite(lcd.width(), lcd.height())) {
             running_flag = false;
@@ -117,7 +90,7 @@ class MessageBox {
             TAG,
             "[BLE] Opening message box (identifier=%s short=%s friend_id=%s)",
             chat_to.c_str(), active_short_id.c_str(), active_friend_id.c_str());
-        JsonDocument res;
+        chatapi::MessageHistory res;
         int64_t last_history_poll_us = 0;
         constexpr int64_t kHistoryPollIntervalUs = 8LL * 1000LL * 1000LL;
         ui::messagebox::ViewState view_state;
@@ -145,6 +118,9 @@ class MessageBox {
             const std::string friend_for_req =
                 !active_friend_id.empty() ? active_friend_id : fid;
 
+            // Short connection interval until the history has arrived;
+            // the scope end logs the transfer rate.
+            BleBulkScope bulk;
             long long rid = esp_timer_get_time();
             ESP_LOGI(TAG,
                      "[BLE] Requesting chat history (id=%s short=%s "
@@ -152,12 +128,11 @@ class MessageBox {
                      fid.c_str(), short_for_req.c_str(), friend_for_req.c_str(),
                      rid);
 
-            // Clear previous BLE messages so only fresh response is read
-            ble_uart_clear_cached_messages();
-            // Phone app should reply with a frame in BLE RAM cache.
+            // The phone answers with a frame carrying the same id.
             // Include redundant identifier fields to maximise compatibility across app versions.
+            const std::string rid_str = std::to_string(rid);
             StaticJsonDocument<256> doc;
-            doc["id"] = std::to_string(rid);
+            doc["id"] = rid_str;
             doc["type"] = "get_messages";
             JsonObject payload = doc.createNestedObject("payload");
             payload["friend_id"] = friend_for_req;
@@ -168,261 +143,69 @@ class MessageBox {
             serializeJson(doc, req);
             req.push_back('\n');
             ESP_LOGI(TAG, "[BLE] Sync request payload: %s", req.c_str());
-            int tx_res = ble_uart_send(
-                reinterpret_cast<const uint8_t *>(req.c_str()), req.size());
-            if (tx_res != 0) {
-                ESP_LOGW(TAG, "[BLE] Failed to send sync request (err=%d)",
-                         tx_res);
+            // Older apps answer with any type as long as "messages" is there.
+            blerpc::Call call =
+                blerpc::start(rid_str, req, {"messages"}, {"messages"});
+            if (!call.valid()) {
+                ESP_LOGW(TAG, "[BLE] Failed to send sync request");
+                return false;
             }
-
-            int waited = 0;
-            while (waited < timeout_ms) {
-                std::string js = ble_uart_get_cached_messages();
-                if (!js.empty()) {
-                    ble_uart_clear_cached_messages();
-                }
-                if (!js.empty()) {
-                    ESP_LOGI(TAG, "[BLE] Received cached response (%zu bytes)",
-                             js.size());
-                    DynamicJsonDocument in(4096);
-                    DeserializationError err = deserializeJson(in, js);
-                    if (err == DeserializationError::Ok) {
-                        int count = 0;
-                        // Prefer payload.messages when present.
-                        if (in["payload"]["messages"].is<JsonArray>()) {
-                            // Handle { type:..., payload: { messages:[...] } }
-                            DynamicJsonDocument out(4096);
-                            auto arr = out.createNestedArray("messages");
-                            std::string my_id = get_nvs((char *)"user_id");
-                            std::string my_name = get_nvs((char *)"user_name");
-                            std::string my_short = get_nvs((char *)"short_id");
-                            std::string my_login = get_nvs((char *)"login_id");
-                            std::string my_username =
-                                get_nvs((char *)"username");
-                            if (my_name.empty()) my_name = my_login;
-                            if (my_name.empty()) my_name = my_username;
-                            if (my_name.empty()) my_name = my_short;
-                            if (my_name.empty()) my_name = "me";
-                            const std::string friend_id =
-                                !active_friend_id.empty() ? active_friend_id
-                                                          : fid;
-                            const std::string friend_short =
-                                !active_short_id.empty() ? active_short_id
-                                                         : fid;
-                            for (JsonObject m :
-                                 in["payload"]["messages"].as<JsonArray>()) {
-                                JsonObject o = arr.createNestedObject();
-                                const char *content =
-                                    m["content"].as<const char *>();
-                                const char *msg =
-                                    m["message"].as<const char *>();
-                                o["message"] =
-                                    content ? content : (msg ? msg : "");
-                                const char *sender =
-                                    m["sender_id"].as<const char *>();
-                                const char *receiver =
-                                    m["receiver_id"].as<const char *>();
-                                const char *from_field =
-                                    m["from"].as<const char *>();
-                                bool is_friend = false;
-                                bool is_me = false;
-                                if (sender && !*sender) sender = nullptr;
-                                if (receiver && !*receiver) receiver = nullptr;
-                                if (sender && !friend_id.empty() &&
-                                    friend_id == sender) {
-                                    is_friend = true;
-                                } else if (receiver && !friend_id.empty() &&
-                                           friend_id == receiver) {
-                                    is_me = true;
-                                } else if (sender && !my_id.empty() &&
-                                           my_id == sender) {
-                                    is_me = true;
-                                } else if (receiver && !my_id.empty() &&
-                                           my_id == receiver) {
-                                    is_friend = true;
-                                } else if (from_field &&
-                                           !friend_short.empty() &&
-                                           friend_short == from_field) {
-                                    is_friend = true;
-                                } else if (from_field &&
-                                           (!my_short.empty() &&
-                                            my_short == from_field)) {
-                                    is_me = true;
-                                } else if (from_field &&
-                                           (!my_login.empty() &&
-                                            my_login == from_field)) {
-                                    is_me = true;
-                                } else if (from_field &&
-                                           (!my_username.empty() &&
-                                            my_username == from_field)) {
-                                    is_me = true;
-                                } else if (from_field &&
-                                           (!my_name.empty() &&
-                                            my_name == from_field)) {
-                                    is_me = true;
-                                }
-                                o["from"] =
-                                    is_me ? my_name.c_str() : fid.c_str();
-                                const char *mid = m["id"].as<const char *>();
-                                if (!mid)
-                                    mid = m["message_id"].as<const char *>();
-                                if (mid && mid[0] != '\0') o["id"] = mid;
-                                const char *created =
-                                    m["created_at"].as<const char *>();
-                                if (created && created[0] != '\0')
-                                    o["created_at"] = created;
-                                if (m.containsKey("is_read")) {
-                                    o["is_read"] = m["is_read"].as<bool>();
-                                }
-                            }
-                            count = arr.size();
-                            std::string outBuf;
-                            serializeJson(out, outBuf);
-                            deserializeJson(res, outBuf);
-                        } else {
-                            // Accept legacy shape only when sender/receiver IDs
-                            // are absent.
-                            bool legacy = false;
-                            bool has_sender_receiver = false;
-                            if (in["messages"].is<JsonArray>()) {
-                                for (JsonObject m :
-                                     in["messages"].as<JsonArray>()) {
-                                    if (m.containsKey("sender_id") ||
-                                        m.containsKey("receiver_id")) {
-                                        has_sender_receiver = true;
-                                    }
-                                    if (m.containsKey("message") &&
-                                        m.containsKey("from")) {
-                                        legacy = true;
-                                    }
-                                }
-                            }
-                            if (legacy && !has_sender_receiver) {
-                                std::string outBuf;
-                                serializeJson(in, outBuf);
-                                deserializeJson(res, outBuf);
-                                count =
-                                    res["messages"].is<JsonArray>()
-                                        ? res["messages"].as<JsonArray>().size()
-                                        : 0;
-                            } else if (in["messages"].is<JsonArray>()) {
-                                // Transform {content,sender_id,receiver_id} ->
-                                // {message,from}
-                                DynamicJsonDocument out(4096);
-                                auto arr = out.createNestedArray("messages");
-                                std::string my_id = get_nvs((char *)"user_id");
-                                std::string my_name =
-                                    get_nvs((char *)"user_name");
-                                std::string my_short =
-                                    get_nvs((char *)"short_id");
-                                std::string my_login =
-                                    get_nvs((char *)"login_id");
-                                std::string my_username =
-                                    get_nvs((char *)"username");
-                                if (my_name.empty()) my_name = my_login;
-                                if (my_name.empty()) my_name = my_username;
-                                if (my_name.empty()) my_name = my_short;
-                                if (my_name.empty()) my_name = "me";
-                                const std::string friend_id =
-                                    !active_friend_id.empty() ? active_friend_id
-                                                              : fid;
-                                const std::string friend_short =
-                                    !active_short_id.empty() ? active_short_id
-                                                             : fid;
-                                for (JsonObject m :
-                                     in["messages"].as<JsonArray>()) {
-                                    JsonObject o = arr.createNestedObject();
-                                    const char *content =
-                                        m["content"].as<const char *>();
-                                    const char *msg =
-                                        m["message"].as<const char *>();
-                                    o["message"] =
-                                        content ? content : (msg ? msg : "");
-                                    const char *sender =
-                                        m["sender_id"].as<const char *>();
-                                    const char *receiver =
-                                        m["receiver_id"].as<const char *>();
-                                    const char *from_field =
-                                        m["from"].as<const char *>();
-                                    bool is_friend = false;
-                                    bool is_me = false;
-                                    if (sender && !*sender) sender = nullptr;
-                                    if (receiver && !*receiver)
-                                        receiver = nullptr;
-                                    if (sender && !friend_id.empty() &&
-                                        friend_id == sender) {
-                                        is_friend = true;
-                                    } else if (receiver && !friend_id.empty() &&
-                                               friend_id == receiver) {
-                                        is_me = true;
-                                    } else if (sender && !my_id.empty() &&
-                                               my_id == sender) {
-                                        is_me = true;
-                                    } else if (receiver && !my_id.empty() &&
-                                               my_id == receiver) {
-                                        is_friend = true;
-                                    } else if (from_field &&
-                                               !friend_short.empty() &&
-                                               friend_short == from_field) {
-                                        is_friend = true;
-                                    } else if (from_field &&
-                                               (!my_short.empty() &&
-                                                my_short == from_field)) {
-                                        is_me = true;
-                                    } else if (from_field &&
-                                               (!my_login.empty() &&
-                                                my_login == from_field)) {
-                                        is_me = true;
-                                    } else if (from_field &&
-                                               (!my_username.empty() &&
-                                                my_username == from_field)) {
-                                        is_me = true;
-                                    } else if (from_field &&
-                                               (!my_name.empty() &&
-                                                my_name == from_field)) {
-                                        is_me = true;
-                                    }
-                                    o["from"] =
-                                        is_me ? my_name.c_str() : fid.c_str();
-                                    const char *mid =
-                                        m["id"].as<const char *>();
-                                    if (!mid)
-                                        mid =
-                                            m["message_id"].as<const char *>();
-                                    if (mid && mid[0] != '\0') o["id"] = mid;
-                                    const char *created =
-                                        m["created_at"].as<const char *>();
-                                    if (created && created[0] != '\0')
-                                        o["created_at"] = created;
-                                    if (m.containsKey("is_read")) {
-                                        o["is_read"] = m["is_read"].as<bool>();
-                                    }
-                                }
-                                count = arr.size();
-                                std::string outBuf;
-                                serializeJson(out, outBuf);
-                                deserializeJson(res, outBuf);
-                            } else {
-                                ESP_LOGW(
-                                    TAG,
-                                    "[BLE] Unexpected JSON shape for messages");
-                            }
-                        }
-                        ESP_LOGI(TAG, "[BLE] Parsed %d message(s) via BLE",
-                                 count);
-                        return true;
-                    }
-                    ESP_LOGW(TAG, "[BLE] JSON parse error: %s", err.c_str());
-                }
-                if ((waited % 1000) == 0) {
-                    ESP_LOGI(TAG, "[BLE] Waiting for sync response... %d ms",
-                             waited);
-                }
-                vTaskDelay(50 / portTICK_PERIOD_MS);
-                waited += 50;
+            if (!blerpc::wait(call, timeout_ms)) {
+                ESP_LOGW(TAG, "[BLE] Timeout awaiting history (friend=%s)",
+                         fid.c_str());
+                return false;
+            }
+            const std::string &js = call.response();
+            ESP_LOGI(TAG, "[BLE] Received response (%zu bytes)",
+                     js.size());
+            std::string my_id = get_nvs((char *)"user_id");
+            std::string my_name = get_nvs((char *)"user_name");
+            std::string my_short = get_nvs((char *)"short_id");
+            std::string my_login = get_nvs((char *)"login_id");
+            std::string my_username = get_nvs((char *)"username");
+            if (my_name.empty()) my_name = my_login;
+            if (my_name.empty()) my_name = my_username;
+            if (my_name.empty()) my_name = my_short;
+            if (my_name.empty()) my_name = "me";
+            const std::string friend_id =
+                !active_friend_id.empty() ? active_friend_id : fid;
+            const std::string friend_short =
+                !active_short_id.empty() ? active_short_id : fid;
+            // Phone app versions disagree on which identifiers they
+            // send; check the strongest ones first.
+            auto is_outgoing = [&](const char *sender,
+                                   const char *receiver,
+                                   const char *from_field) {
+                if (sender && !friend_id.empty() && friend_id == sender)
+                    return false;
+                if (receiver && !friend_id.empty() &&
+                    friend_id == receiver)
+                    return true;
+                if (sender && !my_id.empty() && my_id == sender)
+                    return true;
+                if (receiver && !my_id.empty() && my_id == receiver)
+                    return false;
+                if (!from_field) return false;
+                if (!friend_short.empty() && friend_short == from_field)
+                    return false;
+                return (!my_short.empty() && my_short == from_field) ||
+                       (!my_login.empty() && my_login == from_field) ||
+                       (!my_username.empty() &&
+                        my_username == from_field) ||
+                       (!my_name.empty() && my_name == from_field);
+            };
+            chatapi::MessageHistory parsed;
+            if (chatapi::parse_message_history(js, is_outgoing,
+                                               parsed)) {
+                res = std::move(parsed);
+                ESP_LOGI(TAG,
+                         "[BLE] Parsed %u message(s) via BLE "
+                         "(%zu bytes in %lld ms)",
+                         static_cast<unsigned>(res.size()), js.size(),
+                         (esp_timer_get_time() - rid) / 1000);
+                return true;
             }
-            ESP_LOGW(TAG, "[BLE] Timeout awaiting history (friend=%s)",
-                     fid.c_str());
+            ESP_LOGW(TAG, "[BLE] JSON parse error");
             return false;
         };
 
@@ -437,7 +220,7 @@ class MessageBox {
                                                        MALLOC_CAP_8BIT),
                      (unsigned)heap_caps_get_largest_free_block(
                          MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
-            sprite.deleteSprite();
+            release_sprite_surface("MessageBox");
             res = http_client.get_message(server_chat_id);
             (void)recreate_message_sprite(lcd.width(), lcd.height());
         }
@@ -451,29 +234,19 @@ class MessageBox {
         view_state.header_text = chat_title;
         bool mark_all_done = false;
 
-        if (res["messages"].is<JsonArray>()) {
-            for (JsonObject msg : res["messages"].as<JsonArray>()) {
-                bool unread = true;
-                if (msg.containsKey("is_read")) {
-                    unread = !msg["is_read"].as<bool>();
-                }
-                if (!unread) continue;
-                const char *from = msg["from"].as<const char *>();
-                if (from && !my_name.empty() && my_name == from) {
-                    continue;  // 自分の送信分はスキップ
-                }
-                const char *content = msg["message"].as<const char *>();
-                if (!content || content[0] == '\0') {
-                    continue;
-                }
-                if (!mark_all_done) {
-                    mark_all_done =
-                        http_client.mark_all_messages_read(server_chat_id);
-                }
-                play_morse_message(content, morse_header);
-                msg["is_read"] = true;
-                vTaskDelay(pdMS_TO_TICKS(200));
+        for (size_t i = 0; i < res.size(); ++i) {
+            const auto &msg = res[i];
+            if (!msg.unread()) continue;
+            if (msg.outgoing) continue;  // 自分の送信分はスキップ
+            const std::string content(res.content(msg));
+            if (content.empty()) continue;
+            if (!mark_all_done) {
+                mark_all_done =
+                    http_client.mark_all_messages_read(server_chat_id);
             }
+            play_morse_message(content.c_str(), morse_header);
+            res.mark_read(i);
+            vTaskDelay(pdMS_TO_TICKS(200));
         }
 
         // 通知を非表示
@@ -498,23 +271,7 @@ class MessageBox {
             sprite.setCursor(14, cursor_y);
         };
         render_api.draw_text = [&](int, const std::string &message) {
-            size_t pos = 0;
-            while (pos < message.length()) {
-                uint8_t c = static_cast<uint8_t>(message[pos]);
-                size_t char_len = utf8_char_length(c);
-                if (char_len == 0 || pos + char_len > message.size()) {
-                    char_len = 1;
-                }
-                std::string ch = message.substr(pos, char_len);
-                if (ch.size() >= 2 && (uint8_t)ch[0] == 0xE3 &&
-                    ((uint8_t)ch[1] == 0x82 || (uint8_t)ch[1] == 0x83)) {
-                    sprite.setFont(&fonts::lgfxJapanGothic_12);
-                } else {
-                    sprite.setFont(&fonts::Font2);
-                }
-                sprite.print(ch.c_str());
-                pos += char_len;
-            }
+            draw_cached_text(kFont2MessageFace, message, true);
         };
         render_api.draw_header =
             [&](const std::string &header_text, const std::string &chat_to_text) {
@@ -534,28 +291,11 @@ class MessageBox {
 
         auto rebuild_message_view = [&](bool jump_to_bottom) {
             view_state.message_views.clear();
-            if (res["messages"].is<JsonArray>()) {
-                for (JsonObject msg : res["messages"].as<JsonArray>()) {
-                    view_state.message_views.push_back({msg});
-                }
-                std::stable_sort(
-                    view_state.message_views.begin(), view_state.message_views.end(),
-                    [](const ui::messagebox::ViewEntry &a,
-                       const ui::messagebox::ViewEntry &b) {
-                        const char *created_a =
-                            a.obj["created_at"] | static_cast<const char *>("");
-                        const char *created_b =
-                            b.obj["created_at"] | static_cast<const char *>("");
-                        int cmp = strcmp(created_a, created_b);
-                        if (cmp == 0) {
-                            const char *id_a =
-                                a.obj["id"] | static_cast<const char *>("");
-                            const char *id_b =
-                                b.obj["id"] | static_cast<const char *>("");
-                            return strcmp(id_a, id_b) < 0;
-                        }
-                        return cmp < 0;
-                    });
+            res.sort_chronological();
+            view_state.message_views.reserve(res.size());
+            for (const auto &msg : res.records()) {
+                view_state.message_views.push_back(
+                    {res.content(msg), !msg.outgoing});
             }
             view_state.min_offset_y =
                 (int)((int)view_state.font_height * 2 -
@@ -568,43 +308,35 @@ class MessageBox {
             }
         };
 
-        auto newest_incoming_info = [&](const JsonDocument &doc)
+        auto newest_incoming_info = [&](const chatapi::MessageHistory &history)
             -> std::pair<std::string, std::string> {
-            std::string latest_created;
-            std::string latest_id;
-            std::string latest_content;
-            bool found = false;
-            if (!doc["messages"].is<JsonArrayConst>()) {
-                return {"", ""};
-            }
-            for (JsonObjectConst msg : doc["messages"].as<JsonArrayConst>()) {
-                const char *from = msg["from"].as<const char *>();
-                if (!from || my_name == from) continue;
-                const char *created = msg["created_at"].as<const char *>();
-                const char *id = msg["id"].as<const char *>();
-                if (!id) id = msg["message_id"].as<const char *>();
-                const char *content = msg["message"].as<const char *>();
-                const std::string created_s = created ? created : "";
-                const std::string id_s = id ? id : "";
-                if (!found || created_s > latest_created ||
-                    (created_s == latest_created && id_s > latest_id)) {
-                    latest_created = created_s;
-                    latest_id = id_s;
-                    latest_content = content ? content : "";
-                    found = true;
+            const chatapi::MessageHistory::Record *latest = nullptr;
+            for (const auto &msg : history.records()) {
+                if (msg.outgoing) continue;
+                if (!latest ||
+                    history.created_at(msg) > history.created_at(*latest) ||
+                    (history.created_at(msg) == history.created_at(*latest) &&
+                     history.id(msg) > history.id(*latest))) {
+                    latest = &msg;
                 }
             }
-            if (!found) return {"", ""};
-            return {latest_created + "|" + latest_id + "|" + latest_content,
-                    latest_content};
+            if (!latest) return {"", ""};
+            std::string content(history.content(*latest));
+            std::string sig(history.created_at(*latest));
+            sig += "|";
+            sig += history.id(*latest);
+            sig += "|";
+            sig += content;
+            return {sig, content};
         };
 
         auto refresh_history = [&](int ble_timeout_ms,
                                    bool animate_on_new) -> bool {
-            JsonDocument refreshed;
+            chatapi::MessageHistory refreshed;
+            const auto before_info = newest_incoming_info(res);
             bool ok = false;
             if (fetch_messages_via_ble(chat_to, ble_timeout_ms)) {
-                refreshed = res;
+                refreshed = std::move(res);
                 ok = true;
             } else {
                 if (!wifi_is_connected()) {
@@ -612,7 +344,7 @@ class MessageBox {
                     return false;
                 }
                 ESP_LOGI(TAG, "[HTTP] Refresh history via Wi-Fi");
-                sprite.deleteSprite();
+                release_sprite_surface("MessageBox");
                 refreshed = http_client.get_message(server_chat_id);
                 if (!recreate_message_sprite(lcd.width(), lcd.height())) {
                     ESP_LOGE(TAG, "[UI] message sprite recreate failed after HTTP");
@@ -625,7 +357,6 @@ class MessageBox {
             }
             if (!ok) return false;
 
-            const auto before_info = newest_incoming_info(res);
             const auto after_info = newest_incoming_info(refreshed);
             const std::string &before_sig = before_info.first;
             const std::string &after_sig = after_info.first;
@@ -668,11 +399,11 @@ class MessageBox {
                 break;
             }
             if (command == ui::messagebox::Presenter::Command::Compose) {
-                sprite.deleteSprite();
-                res.clear();
-                res = JsonDocument();
+                release_sprite_surface("MessageBox");
+                // Drop the history while the composer owns the heap.
+                view_state.message_views.clear();
+                res = chatapi::MessageHistory();
                 const bool sent = talk.start_talk_task(chat_to);
-                res = JsonDocument();
                 if (!recreate_message_sprite(lcd.width(), lcd.height())) {
                     running_flag = false;
                     task_handle_ = nullptr;
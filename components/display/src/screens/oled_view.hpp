@@ -9,7 +9,7 @@ class Oled {
 
         constexpr int kBootWidth = 128;
         constexpr int kBootHeight = 64;
-        if (!ensure_sprite_surface(kBootWidth, kBootHeight, 8, "BootDisplay")) {
+        if (!ensure_sprite_surface(kBootWidth, kBootHeight, kOledSpriteDepth, "BootDisplay")) {
             return;
         }
 
@@ -24,12 +24,7 @@ class Oled {
         setenv("TZ", "JST-9", 1);
         tzset();
 
-        lcd.init();
-        lcd.clearDisplay();
-        lcd.setRotation(2);
-        lcd.fillScreen(0x000000u);
-
-        sprite.createSprite(lcd.width(), lcd.height());
+        oled_begin_screen("Watch");
 
         Button type_button(GPIO_NUM_46);
         Button enter_button(GPIO_NUM_5);
@@ -103,13 +98,7 @@ class Oled {
     }
 
     void ShowImage(const unsigned char img[]) {
-        lcd.init();
-        // lcd.clearDisplay();
-        lcd.setRotation(2);
-        // lcd.fillScreen(0x000000u);
-
-        sprite.createSprite(lcd.width(), lcd.height());
-        sprite.fillScreen(0x000000u);
+        oled_begin_screen("Image");
         // sprite.drawPixel(64, 32);
 
         sprite.drawBitmap(55, 25, img, 16, 22, TFT_WHITE, TFT_BLACK);
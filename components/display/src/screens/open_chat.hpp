@@ -38,7 +38,7 @@ StaticTask_t OpenChat::task_buffer_;
 StackType_t *OpenChat::task_stack_ = nullptr;
 
 bool OpenChat::recreate_room_sprite() {
-    return ensure_sprite_surface(lcd.width(), lcd.height(), 8, "OpenChat");
+    return ensure_sprite_surface(lcd.width(), lcd.height(), kOledSpriteDepth, "OpenChat");
 }
 
 bool OpenChat::compose_morse_message(std::string &out,
@@ -291,7 +291,10 @@ void OpenChat::open_chat_task(void *pvParameters) {
 
         std::string topic =
             std::string("chat/open/") + rooms[selector_state.selected].topic_suffix;
-        int listener_id = mqtt_rt_add_listener(topic.c_str());
+        // Room messages can be as large as any publish the runtime accepts.
+        static char *pop_buf = nullptr;
+        if (!pop_buf) pop_buf = mqtt_rt_alloc_pop_buffer();
+        int listener_id = pop_buf ? mqtt_rt_add_listener(topic.c_str()) : -1;
         if (listener_id < 0) {
             recreate_room_sprite();
             sprite.setFont(&fonts::Font2);
@@ -426,8 +429,9 @@ void OpenChat::open_chat_task(void *pvParameters) {
 
         while (stay_in_room && running_flag) {
             // pump incoming messages
-            char buf[512];
-            while (mqtt_rt_listener_pop(listener_id, buf, sizeof(buf))) {
+            char *buf = pop_buf;
+            while (mqtt_rt_listener_pop(listener_id, buf,
+                                        MQTT_RT_POP_BUFFER_BYTES)) {
                 DynamicJsonDocument doc(768);
                 if (deserializeJson(doc, buf) != DeserializationError::Ok) {
                     continue;
@@ -457,6 +461,14 @@ void OpenChat::open_chat_task(void *pvParameters) {
                 }
                 add_message(std::move(msg), msg_id);
             }
+            // Room messages are not stored anywhere else, so show the gap
+            // when a burst outgrew the listener ring.
+            if (const uint32_t lost = mqtt_rt_take_overwritten(listener_id)) {
+                ChatMessage gap;
+                gap.user = "*";
+                gap.text = std::to_string(lost) + " missed";
+                add_message(std::move(gap), std::string());
+            }
 
             draw_room();
 
@@ -499,12 +511,13 @@ void OpenChat::open_chat_task(void *pvParameters) {
                     payload["id"] = msg_id;
                     std::string json;
                     serializeJson(payload, json);
-                    int mid =
+                    // Only queues; the MQTT runtime sends once connected.
+                    int err =
                         mqtt_rt_publish(topic.c_str(), json.c_str(), 1, false);
-                    if (mid < 0) {
+                    if (err < 0) {
                         ESP_LOGW("OPEN_CHAT",
-                                 "Publish failed (topic=%s err=%d)",
-                                 topic.c_str(), mid);
+                                 "Publish not queued (topic=%s err=%d)",
+                                 topic.c_str(), err);
                     }
                     ChatMessage local;
                     local.user = username;
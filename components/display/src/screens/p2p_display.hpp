@@ -10,12 +10,8 @@ class P2P_Display {
     std::string long_push_text = "_";
     std::string short_push_text = ".";
 
-    static std::string received_text;
-
-    // ESP NOW
-    // 送信先のMACアドレス
-    uint8_t peer_mac[6] = {0xFF, 0xFF, 0xFF,
-                           0xFF, 0xFF, 0xFF};  // ブロードキャストも可
+    std::string received_text = "";
+    std::string last_sent_text = "";
 
     // std::map<std::string, std::string> P2P_Display::morse_code = morse_code;
     int release_time = 0;
@@ -34,80 +30,36 @@ class P2P_Display {
         vTaskDelay(2000 / portTICK_PERIOD_MS);
     };
 
-    static void espnow_send_cb(const uint8_t *mac_addr,
-                               esp_now_send_status_t status) {
-        ESP_LOGI(TAG, "送信完了: %s",
-                 status == ESP_NOW_SEND_SUCCESS ? "成功" : "失敗");
-    }
-
     void p2p_init() {
-        // esp_err_t result = esp_now_init();
-        // ESP_LOGE(TAG, "esp_now_send result: %s", esp_err_to_name(result));
-        // ESP_ERROR_CHECK(result);
-
-        {
-            esp_err_t err = esp_now_init();
-            if (err != ESP_OK && err != ESP_ERR_ESPNOW_EXIST) {
-                ESP_ERROR_CHECK(err);
-            }
-        }
-        ESP_ERROR_CHECK(esp_now_register_send_cb(espnow_send_cb));
-
-        esp_now_peer_info_t peerInfo = {
-            .channel = 0,
-            .ifidx = WIFI_IF_STA,
-            .encrypt = false,
-        };
-
-        memset(peerInfo.lmk, 0, ESP_NOW_KEY_LEN);  // ← これを追加
-        memcpy(peerInfo.peer_addr, peer_mac, 6);
-        {
-            esp_err_t err = esp_now_add_peer(&peerInfo);
-            if (err == ESP_ERR_ESPNOW_EXIST) {
-                // Re-entering the realtime chat: peer may already exist.
-                // Prefer modify; fall back to delete+add.
-                esp_err_t m = esp_now_mod_peer(&peerInfo);
-                if (m != ESP_OK) {
-                    (void)esp_now_del_peer(peerInfo.peer_addr);
-                    ESP_ERROR_CHECK(esp_now_add_peer(&peerInfo));
-                }
-            } else {
-                ESP_ERROR_CHECK(err);
-            }
+        espnow_rt_set_relay(app::settingaction::p2p_relay_enabled(),
+                            ESPNOW_RT_DEFAULT_TTL);
+        espnow_rt_set_identity(get_nvs((char *)"short_id").c_str());
+        if (espnow_rt_start() != 0) {
+            ESP_LOGE(TAG, "ESP-NOW transport start failed");
         }
-
         esp_wifi_set_max_tx_power(84);
-
-        espnow_recv();
     }
 
-    void espnow_send(std::string message) {
-        if (message == "") {
+    // Mirrors the input line to peers; only changes go on air.
+    void espnow_send(const std::string &message) {
+        if (message == "" || message == last_sent_text) {
             return;
         }
-        esp_err_t err = esp_now_send(peer_mac, (uint8_t *)message.c_str(),
-                                     strlen(message.c_str()));
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "esp_now_send failed: %s", esp_err_to_name(err));
-        }
-    }
-
-    static void espnow_recv_cb(const esp_now_recv_info_t *recv_info,
-                               const uint8_t *data, int len) {
-        if (data && len > 0) {
-            received_text =
-                std::string(reinterpret_cast<const char *>(data), len);
-            ESP_LOGI(TAG, "受信: %s", received_text.c_str());
+        // nullptr: discovered peers by unicast, else broadcast.
+        int rc = espnow_rt_send(nullptr, message.data(), message.size());
+        if (rc == 0) {
+            last_sent_text = message;
         } else {
-            ESP_LOGW(TAG, "無効なデータ受信");
+            ESP_LOGW(TAG, "espnow_rt_send rejected (%d)", rc);
         }
     }
 
-    void espnow_recv(void) {
-        esp_err_t err = esp_now_register_recv_cb(espnow_recv_cb);
-        if (err != ESP_OK) {
-            ESP_LOGW(TAG, "esp_now_register_recv_cb failed: %s",
-                     esp_err_to_name(err));
+    // Keeps the newest message the transport task has reassembled.
+    void espnow_recv() {
+        static char buf[ESPNOW_RT_MAX_MESSAGE];
+        size_t len;
+        while ((len = espnow_rt_recv(nullptr, buf, sizeof(buf))) > 0) {
+            received_text.assign(buf, len);
         }
     }
 
@@ -131,19 +83,17 @@ class P2P_Display {
             joystick.reset_timer();
         };
 
-        sprite.setColorDepth(8);
+        oled_begin_screen("P2P");
         sprite.setFont(&fonts::Font2);
 
         // sprite.setFont(&fonts::Font2);
         // sprite.setFont(&fonts::FreeMono9pt7b);
         sprite.setTextWrap(true);  // 右端到達時のカーソル折り返しを禁止
-        sprite.createSprite(lcd.width(), lcd.height());
 
         // カーソル点滅制御用タイマー
         long long int t = esp_timer_get_time();
 
         size_t input_switch_pos = 0;
-        size_t pos = 0;
         bool tone_playing = false;
 
         while (true) {
@@ -216,6 +166,7 @@ class P2P_Display {
                     tone_playing = false;
                 }
                 clear_inputs();
+                espnow_rt_stop();
                 return;
             } else if (joystick_state.left) {
                 if (tone_playing) {
@@ -224,6 +175,7 @@ class P2P_Display {
                     tone_playing = false;
                 }
                 clear_inputs();
+                espnow_rt_stop();
                 return;
             } else if (joystick_state.pushed_right_edge) {
                 input_lang = input_lang * -1;
@@ -248,7 +200,6 @@ class P2P_Display {
             // Enter(送信)キーの判定ロジック
             if (enter_button_state.pushed and message_text != "") {
                 message_text = "";
-                pos = 0;
                 input_switch_pos = 0;
                 enter_button.clear_button_state();
             }
@@ -267,49 +218,13 @@ class P2P_Display {
             sprite.fillRect(0, 0, 128, 64, 0);
             sprite.setCursor(0, 0);
 
-            pos = 0;
-            while (pos < display_text.length()) {
-                uint8_t c = display_text[pos];
-                int char_len = 1;
-                if ((c & 0xE0) == 0xC0)
-                    char_len = 2;
-                else if ((c & 0xF0) == 0xE0)
-                    char_len = 3;
-
-                if (pos + char_len <= display_text.length()) {
-                    std::string ch = display_text.substr(pos, char_len);
-
-                    sprite.setFont(select_display_font(&fonts::Font2, ch));
-
-                    sprite.print(ch.c_str());
-                    pos += char_len;
-                } else {
-                    break;
-                }
-            }
+            draw_cached_text(kFont2DisplayFace, display_text, true);
 
             // 受信したメッセージを描画
+            espnow_recv();
             sprite.drawFastHLine(0, 32, 128, 0xFFFF);
             sprite.setCursor(0, 35);
-            {
-                size_t rpos = 0;
-                while (rpos < received_text.length()) {
-                    uint8_t c = received_text[rpos];
-                    int char_len = 1;
-                    if ((c & 0xE0) == 0xC0)
-                        char_len = 2;
-                    else if ((c & 0xF0) == 0xE0)
-                        char_len = 3;
-                    if (rpos + char_len <= received_text.length()) {
-                        std::string ch = received_text.substr(rpos, char_len);
-                        sprite.setFont(select_display_font(&fonts::Font2, ch));
-                        sprite.print(ch.c_str());
-                        rpos += char_len;
-                    } else {
-                        break;
-                    }
-                }
-            }
+            draw_cached_text(kFont2DisplayFace, received_text, true);
 
             push_sprite_safe(0, 0);
 
@@ -346,7 +261,6 @@ class P2P_Display {
         vTaskDelete(NULL);
     };
 };
-std::string P2P_Display::received_text = "";
 
 void Profile() {
     printf("Profile!!!\n");
@@ -356,8 +270,7 @@ void Profile() {
     Button back_button(GPIO_NUM_3);
     Button enter_button(GPIO_NUM_5);
 
-    lcd.fillScreen(0x000000u);
-    sprite.createSprite(lcd.width(), lcd.height());
+    oled_begin_screen("Profile");
     sprite.setTextColor(0xFFFFFFu, 0x000000u);
     sprite.setFont(&fonts::Font2);
 
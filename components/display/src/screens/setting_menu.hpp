@@ -27,8 +27,6 @@ class SettingMenu {
     }
 
     static void message_menue_task(void *pvParameters) {
-        lcd.init();
-
         WiFiSetting wifi_setting;
         OpenChat open_chat;
 
@@ -65,24 +63,23 @@ class SettingMenu {
             vTaskDelete(NULL);
         };
 
-        lcd.setRotation(2);
         // int MAX_SETTINGS = 20; // unused
         int ITEM_PER_PAGE = 4;
 
-        sprite.setColorDepth(8);
+        oled_begin_screen("SettingMenu");
         sprite.setFont(&fonts::Font4);
         sprite.setTextWrap(true);  // 右端到達時のカーソル折り返しを禁止
-        sprite.createSprite(lcd.width(), lcd.height());
 
-        const std::array<ui::Key, 16> setting_keys = {
+        const std::array<ui::Key, 17> setting_keys = {
             ui::Key::SettingsProfile,    ui::Key::SettingsWifi,
             ui::Key::SettingsBluetooth,  ui::Key::SettingsLanguage,
             ui::Key::SettingsSound,      ui::Key::SettingsVibration,
             ui::Key::SettingsBootSound,  ui::Key::SettingsRtc,
-            ui::Key::SettingsOpenChat,   ui::Key::SettingsComposer,
-            ui::Key::SettingsAutoUpdate, ui::Key::SettingsOtaManifest,
-            ui::Key::SettingsUpdateNow,  ui::Key::SettingsFirmwareInfo,
-            ui::Key::SettingsDevelop,    ui::Key::SettingsFactoryReset,
+            ui::Key::SettingsP2pRelay,   ui::Key::SettingsOpenChat,
+            ui::Key::SettingsComposer,   ui::Key::SettingsAutoUpdate,
+            ui::Key::SettingsOtaManifest, ui::Key::SettingsUpdateNow,
+            ui::Key::SettingsFirmwareInfo, ui::Key::SettingsDevelop,
+            ui::Key::SettingsFactoryReset,
         };
 
         ui::settingmenu::ViewState view_state;
@@ -160,6 +157,11 @@ class SettingMenu {
             p2p.morse_p2p();
             reset_controls(true);
         };
+        auto run_p2p_relay_action = [&]() {
+            const bool on = app::settingaction::toggle_p2p_relay();
+            show_status(on ? "Chat Relay: ON" : "Chat Relay: OFF", "", 800);
+            reset_controls(false);
+        };
         auto run_open_chat_action = [&]() {
             reset_controls(true);
             open_chat.running_flag = true;
@@ -183,8 +185,12 @@ class SettingMenu {
             .joystick = joystick,
             .feed_wdt = feed_wdt,
             .present = [&]() { push_sprite_safe(0, 0); },
-            .delete_sprite = [&]() { sprite.deleteSprite(); },
-            .recreate_sprite = [&]() { sprite.createSprite(lcd.width(), lcd.height()); },
+            .delete_sprite = [&]() { release_sprite_surface("SettingMenu"); },
+            .recreate_sprite =
+                [&]() {
+                    ensure_sprite_surface(lcd.width(), lcd.height(),
+                                          kOledSpriteDepth, "SettingMenu");
+                },
             .mqtt_pause = mqtt_rt_pause,
             .mqtt_resume = mqtt_rt_resume,
             .wifi_connected = wifi_is_connected,
@@ -309,6 +315,9 @@ class SettingMenu {
                 case app::settingmenuaction::Action::Rtc:
                     run_rtc_action();
                     break;
+                case app::settingmenuaction::Action::P2pRelay:
+                    run_p2p_relay_action();
+                    break;
                 case app::settingmenuaction::Action::OpenChat:
                     run_open_chat_action();
                     break;
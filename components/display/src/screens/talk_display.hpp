@@ -73,8 +73,7 @@ class TalkDisplay {
 
     static bool run_talk_session(const std::string &chat_to) {
         ESP_LOGI(TAG, "[Talk] session start");
-        lcd.init();
-        lcd.setRotation(0);
+        oled_begin_screen("Talk");
 
         auto &buzzer = audio::speaker();
         buzzer.init();
@@ -90,42 +89,15 @@ class TalkDisplay {
         enter_button.long_push_thresh = 300000;  // ~300ms
         const std::string server_chat_id = resolve_chat_backend_id(chat_to);
 
-        lcd.setRotation(2);
-
         auto ensure_talk_sprite = [&](int width, int height) -> bool {
-            struct Attempt {
-                uint8_t depth;
-                bool use_psram;
-            };
-            constexpr Attempt attempts[] = {
-                {8, true},  {8, false}, {4, true},
-                {4, false}, {1, true},  {1, false},
-            };
-
-            sprite.deleteSprite();
-            for (const auto &attempt : attempts) {
-                sprite.setPsram(attempt.use_psram);
-                sprite.setColorDepth(attempt.depth);
-                sprite.setFont(&fonts::Font2);
-                sprite.setTextWrap(true);
-                if (sprite.createSprite(width, height)) {
-                    ESP_LOGI(TAG,
-                             "[UI] talk sprite %dx%d depth=%u psram=%s created",
-                             width, height, attempt.depth,
-                             attempt.use_psram ? "true" : "false");
-                    return true;
-                }
-                ESP_LOGW(TAG,
-                         "[UI] talk sprite alloc fail %dx%d depth=%u psram=%s"
-                         " (free=%u largest=%u)",
-                         width, height, attempt.depth,
-                         attempt.use_psram ? "true" : "false",
-                         (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL |
-                                                           MALLOC_CAP_8BIT),
-                         (unsigned)heap_caps_get_largest_free_block(
-                             MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+            // 確保済みなら表示タスク側で再利用される
+            if (!ensure_sprite_surface(width, height, kOledSpriteDepth,
+                                       "Talk")) {
+                return false;
             }
-            return false;
+            sprite.setFont(&fonts::Font2);
+            sprite.setTextWrap(true);
+            return true;
         };
 
         if (!ensure_talk_sprite(lcd.width(), lcd.height())) {
@@ -241,36 +213,10 @@ class TalkDisplay {
                 ESP_LOGI(TAG, "[Talk] send message to %s (bytes=%zu)",
                          server_chat_id.c_str(), input_state.message_text.size());
 
-                http_client.post_message(server_chat_id, input_state.message_text);
-                // Also relay via BLE to phone app if connected
-                if (!wifi_is_connected() && ble_uart_is_ready()) {
-                    auto esc = [](const std::string &s) {
-                        std::string o;
-                        o.reserve(s.size() + 8);
-                        for (char c : s) {
-                            if (c == '\\' || c == '"') {
-                                o.push_back('\\');
-                                o.push_back(c);
-                            } else if (c == '\n') {
-                                o += "\\n";
-                            } else if (c == '\r') { /* skip */
-                            } else {
-                                o.push_back(c);
-                            }
-                        }
-                        return o;
-                    };
-                    long long rid = esp_timer_get_time();
-                    std::string json = std::string("{ \"id\":\"") +
-                                       std::to_string(rid) +
-                                       "\", \"type\": \"send_message\", "
-                                       "\"payload\": { \"receiver_id\": \"" +
-                                       esc(chat_to) + "\", \"content\": \"" +
-                                       esc(input_state.message_text) + "\" } }\n";
-                    ble_uart_send(
-                        reinterpret_cast<const uint8_t *>(json.c_str()),
-                        json.size());
-                }
+                // Queued in the outbox; goes out over Wi-Fi, or via the BLE
+                // relay to the phone app when only BLE is up.
+                http_client.post_message(server_chat_id,
+                                         input_state.message_text, chat_to);
                 input_state.message_text = "";
                 pos = 0;
                 input_state.input_switch_pos = 0;
@@ -329,7 +275,7 @@ class TalkDisplay {
         std::string().swap(morse_text);
         std::string().swap(message_text);
         std::string().swap(alphabet_text);
-        sprite.deleteSprite();
+        release_sprite_surface("Talk");
         if (tone_playing) {
             buzzer.stop_tone();
             tone_playing = false;
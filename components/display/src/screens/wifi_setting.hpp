@@ -319,7 +319,7 @@ class WiFiSetting {
     }
 
     static void run_wifi_setting_flow(bool auto_exit_on_connected = false) {
-        if (!ensure_sprite_surface(128, 64, 8,
+        if (!ensure_sprite_surface(128, 64, kOledSpriteDepth,
                                    "WiFiSetting::run_wifi_setting_flow")) {
             ESP_LOGE(TAG, "Wi-Fi setting flow aborted: sprite unavailable");
             return;
@@ -8,8 +8,10 @@
 //
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <mutex>
 
@@ -17,6 +19,7 @@
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_netif.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 
@@ -35,11 +38,23 @@
 #include <nvs_rw.hpp>
 
 #include <notification_bridge.hpp>
+#include <outbox.hpp>
 
+#include "include/ble_frame.hpp"
+#include "include/ble_rpc.hpp"
+#include "include/ble_tx_queue.hpp"
 #include "include/ble_uart.hpp"
 
-// Forward declaration
-static void handle_frame_from_phone(const std::string& frame);
+// Forward declarations
+static void handle_frame_from_phone(std::string_view frame);
+
+// Per-stack hooks used by the shared TX queue and link profile code.
+using TxRc = bletx::Rc;
+static TxRc tx_notify(const uint8_t* data, size_t len);
+static size_t tx_chunk_max();
+static void apply_link_profile(bool bulk);
+static void tx_kick();
+static void tx_clear();
 
 #define GATTS_TAG "BLE_UART"
 
@@ -51,6 +66,29 @@ static std::string g_cached_contacts;
 static std::string g_cached_pending;
 static std::string g_cached_messages;
 static std::mutex g_cache_mutex;
+// RX reassembly; only touched from the BLE host/GATT callback task.
+static bleframe::Decoder g_rx_decoder;
+// BLE_UART_PEER_* bits from the phone's hello; cleared on disconnect.
+static std::atomic<uint32_t> g_peer_caps{0};
+static constexpr size_t kRxRingBytes = 16 * 1024;
+static constexpr size_t kRxMaxFrame = 12 * 1024;
+// Largest ATT MTU we offer; 247 lets one notification fill a 251-byte LL
+// packet once data length extension is on.
+static constexpr uint16_t kPreferredMtu = 247;
+static constexpr uint16_t kDleTxOctets = 251;
+static constexpr uint16_t kDleTxTimeUs = 2120;
+// Connection parameters (1.25 ms interval units, 10 ms timeout units),
+// chosen inside Apple's accessory guidelines so iOS accepts them.
+struct LinkProfile {
+    uint16_t itvl_min;
+    uint16_t itvl_max;
+    uint16_t latency;
+    uint16_t timeout;
+};
+static constexpr LinkProfile kBulkProfile = {12, 24, 0, 500};  // 15-30 ms
+static constexpr LinkProfile kIdleProfile = {40, 80, 4, 600};  // 50-100 ms
+static std::atomic<int> g_bulk_refs{0};
+static ble_uart_link_stats_t g_link_stats = {};
 extern EventGroupHandle_t s_wifi_event_group;
 
 // Network helpers used to free/recover memory around BLE usage
@@ -70,8 +108,10 @@ static bool wifi_has_link() {
 
 // Define shared frame handler outside of BLE implementation branches so
 // both NimBLE and Bluedroid paths can link against it.
-static void handle_frame_from_phone(const std::string& frame) {
-    ESP_LOGI(GATTS_TAG, "RXFrame: %s", frame.c_str());
+static void handle_frame_from_phone(std::string_view frame) {
+    ESP_LOGI(GATTS_TAG, "RXFrame: %.*s", (int)frame.size(), frame.data());
+    // Responses to an in-flight request go straight to the waiting task.
+    if (blerpc::deliver(frame)) return;
     auto extract_json_string_field = [&](const char* key) -> std::string {
         std::string token = std::string("\"") + key + "\"";
         size_t p = frame.find(token);
@@ -82,24 +122,41 @@ static void handle_frame_from_phone(const std::string& frame) {
         if (q1 == std::string::npos) return std::string();
         size_t q2 = frame.find('"', q1 + 1);
         if (q2 == std::string::npos || q2 <= q1 + 1) return std::string();
-        return frame.substr(q1 + 1, q2 - q1 - 1);
+        return std::string(frame.substr(q1 + 1, q2 - q1 - 1));
     };
     const std::string msg_type = extract_json_string_field("type");
 
+    if (msg_type == "hello") {
+        uint32_t caps = 0;
+        const size_t acks = frame.find("\"acks\"");
+        if (acks != std::string::npos) {
+            const std::string_view list = frame.substr(acks, frame.find(']', acks) - acks);
+            if (list.find("\"send_message\"") != std::string::npos) {
+                caps |= BLE_UART_PEER_ACKS_SEND_MESSAGE;
+            }
+        }
+        g_peer_caps.store(caps);
+        ESP_LOGI(GATTS_TAG, "Phone hello: caps=0x%x", (unsigned)caps);
+        // The outbox may already have flushed fire-and-forget on subscribe;
+        // anything still queued now goes out with acknowledgements.
+        if (caps) outbox::on_transport_ready("ble");
+        return;
+    }
+
     if (frame.find("\"type\":\"new_message\"") != std::string::npos) {
         notification_bridge::handle_external_message();
     }
     // Cache friends/contacts list sent from phone app
     if (msg_type == "friends" || msg_type == "contacts") {
         std::lock_guard<std::mutex> lock(g_cache_mutex);
-        g_cached_contacts = frame;
+        g_cached_contacts.assign(frame.data(), frame.size());
         ESP_LOGI(GATTS_TAG, "Cached contact list in RAM");
     }
     // Cache messages list for current friend
     if (frame.find("\"type\":\"messages\"") != std::string::npos) {
         {
             std::lock_guard<std::mutex> lock(g_cache_mutex);
-            g_cached_messages = frame;
+            g_cached_messages.assign(frame.data(), frame.size());
         }
         ESP_LOGI(GATTS_TAG, "Cached messages in RAM");
     }
@@ -107,7 +164,7 @@ static void handle_frame_from_phone(const std::string& frame) {
     else if (frame.find("\"messages\"") != std::string::npos) {
         {
             std::lock_guard<std::mutex> lock(g_cache_mutex);
-            g_cached_messages = frame;
+            g_cached_messages.assign(frame.data(), frame.size());
         }
         ESP_LOGI(GATTS_TAG, "Cached messages in RAM (fallback)");
     }
@@ -116,7 +173,7 @@ static void handle_frame_from_phone(const std::string& frame) {
         frame.find("\"requests\"") != std::string::npos) {
         {
             std::lock_guard<std::mutex> lock(g_cache_mutex);
-            g_cached_pending = frame;
+            g_cached_pending.assign(frame.data(), frame.size());
         }
         ESP_LOGI(GATTS_TAG, "Cached pending requests in RAM");
     }
@@ -133,17 +190,60 @@ static void handle_frame_from_phone(const std::string& frame) {
                 if (q1 != std::string::npos) {
                     size_t q2 = frame.find('"', q1 + 1);
                     if (q2 != std::string::npos && q2 > q1 + 1) {
-                        id = frame.substr(q1 + 1, q2 - q1 - 1);
+                        id = std::string(frame.substr(q1 + 1, q2 - q1 - 1));
                     }
                 }
             }
         }
         if (!id.empty()) save_nvs((char*)"ble_result_id", id);
-        save_nvs((char*)"ble_last_result", frame);
+        save_nvs((char*)"ble_last_result", std::string(frame));
         ESP_LOGI(GATTS_TAG, "Saved BLE last result (id=%s)", id.c_str());
     }
 }
 
+// Feeds one RX characteristic write to the frame decoder. Legacy newline /
+// JSON frames and v1 binary frames may be interleaved on the same link.
+static void feed_rx(const uint8_t* data, size_t len) {
+    if (!g_rx_decoder.ready() && !g_rx_decoder.init(kRxRingBytes, kRxMaxFrame)) {
+        ESP_LOGE(GATTS_TAG, "RX decoder alloc failed");
+        return;
+    }
+    g_link_stats.rx_bytes += len;
+    g_rx_decoder.feed(data, len, [](bleframe::Type, std::string_view frame) {
+        handle_frame_from_phone(frame);
+    });
+}
+
+static void log_rx_stats() {
+    const auto st = g_rx_decoder.stats();
+    ESP_LOGI(GATTS_TAG,
+             "RX frames=%u binary=%u crc_err=%u bad_hdr=%u oversized=%u overflow=%u peak=%uB",
+             (unsigned)st.frames, (unsigned)st.binary_frames, (unsigned)st.crc_errors,
+             (unsigned)st.bad_headers, (unsigned)st.oversized, (unsigned)st.overflows,
+             (unsigned)st.peak_bytes);
+    if (st.compressed_frames > 0) {
+        ESP_LOGI(GATTS_TAG, "RX lzd1 frames=%u wire=%uB json=%uB errors=%u",
+                 (unsigned)st.compressed_frames, (unsigned)st.compressed_bytes,
+                 (unsigned)st.decompressed_bytes, (unsigned)st.decode_errors);
+    }
+}
+
+// Tells the phone which framing and compression this firmware decodes. Apps
+// that ignore it keep sending plain newline JSON; newer ones answer with a
+// hello of their own listing the requests they acknowledge (g_peer_caps).
+// Also restarts the TX drain for frames queued before the phone subscribed.
+static void send_hello() {
+    static const char kHello[] =
+        "{\"type\":\"hello\",\"frame\":1,\"compress\":[\"lzd1\"]}\n";
+    if (ble_uart_send(reinterpret_cast<const uint8_t*>(kHello), sizeof(kHello) - 1) != 0) {
+        tx_kick();
+    }
+}
+
+extern "C" int ble_uart_peer_frame_version(void) { return g_rx_decoder.peer_version(); }
+
+extern "C" uint32_t ble_uart_peer_caps(void) { return g_peer_caps.load(); }
+
 std::string ble_uart_get_cached_contacts() {
     std::lock_guard<std::mutex> lock(g_cache_mutex);
     return g_cached_contacts;
@@ -216,10 +316,8 @@ static const ble_uuid128_t UUID_TX =
                      0xA3, 0xB5, 0x03, 0x00, 0x40, 0x6E);
 
 static uint16_t tx_val_handle = 0;
-static std::string rx_buffer;
 static uint16_t g_conn_handle = BLE_HS_CONN_HANDLE_NONE;
 static bool g_notify_enabled_flag = false;
-static std::string g_pending_frame;
 
 static int gatt_access_cb(uint16_t conn_handle, uint16_t attr_handle,
                           struct ble_gatt_access_ctxt* ctxt, void* arg) {
@@ -227,49 +325,10 @@ static int gatt_access_cb(uint16_t conn_handle, uint16_t attr_handle,
     (void)attr_handle;
     (void)arg;
     if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
-        // Append all fragments from mbuf chain
-        struct os_mbuf* om = ctxt->om;
-        while (om) {
-            rx_buffer.append((const char*)om->om_data, om->om_len);
-            om = SLIST_NEXT(om, om_next);
+        // Walk the mbuf chain; each fragment goes straight to the decoder.
+        for (struct os_mbuf* om = ctxt->om; om; om = SLIST_NEXT(om, om_next)) {
+            feed_rx(om->om_data, om->om_len);
         }
-        // First, handle newline-delimited frames
-        size_t idx;
-        while ((idx = rx_buffer.find('\n')) != std::string::npos) {
-            std::string frame = rx_buffer.substr(0, idx);
-            rx_buffer.erase(0, idx + 1);
-            if (!frame.empty()) handle_frame_from_phone(frame);
-        }
-        // Also try to extract complete JSON objects without newline
-        // by matching balanced braces outside quotes.
-        auto extract_json = [&]() -> bool {
-            size_t start = rx_buffer.find('{');
-            if (start == std::string::npos) { rx_buffer.clear(); return false; }
-            bool in_string = false; bool escape = false; int depth = 0;
-            for (size_t i = start; i < rx_buffer.size(); ++i) {
-                char c = rx_buffer[i];
-                if (in_string) {
-                    if (escape) { escape = false; }
-                    else if (c == '\\') { escape = true; }
-                    else if (c == '"') { in_string = false; }
-                } else {
-                    if (c == '"') in_string = true;
-                    else if (c == '{') depth++;
-                    else if (c == '}') { depth--; if (depth == 0) {
-                        std::string frame = rx_buffer.substr(start, i - start + 1);
-                        rx_buffer.erase(0, i + 1);
-                        handle_frame_from_phone(frame);
-                        return true;
-                    }}
-                }
-            }
-            // Not complete yet; keep buffer starting from '{'
-            if (start > 0) rx_buffer.erase(0, start);
-            return false;
-        };
-        // Extract as many complete JSON objects as possible
-        int guard = 0;
-        while (extract_json() && guard++ < 4) {}
     }
     return 0;
 }
@@ -300,12 +359,37 @@ static void gatt_build_and_register() {
     g_gatt_registered = true;
 }
 
+static void apply_link_profile(bool bulk) {
+    const uint16_t conn = g_conn_handle;
+    if (conn == BLE_HS_CONN_HANDLE_NONE) return;
+    const LinkProfile& lp = bulk ? kBulkProfile : kIdleProfile;
+    struct ble_gap_upd_params params = {};
+    params.itvl_min = lp.itvl_min;
+    params.itvl_max = lp.itvl_max;
+    params.latency = lp.latency;
+    params.supervision_timeout = lp.timeout;
+    int rc = ble_gap_update_params(conn, &params);
+    if (rc != 0) ESP_LOGW(GATTS_TAG, "conn param update failed; rc=%d", rc);
+#if defined(CONFIG_BT_NIMBLE_50_FEATURE_SUPPORT)
+    if (bulk) {
+        (void)ble_gap_set_prefered_le_phy(conn, BLE_GAP_LE_PHY_2M_MASK,
+                                          BLE_GAP_LE_PHY_2M_MASK,
+                                          BLE_GAP_LE_PHY_CODED_ANY);
+    }
+#endif
+}
+
 static int gap_event(struct ble_gap_event* event, void* arg) {
     switch (event->type) {
         case BLE_GAP_EVENT_CONNECT:
             if (event->connect.status == 0) {
                 g_conn_handle = event->connect.conn_handle;
                 ESP_LOGI(GATTS_TAG, "GAP connected; handle=%u", g_conn_handle);
+                // MTU and DLE stay up for the whole link; only the
+                // connection interval follows the bulk/idle profile.
+                (void)ble_gattc_exchange_mtu(g_conn_handle, nullptr, nullptr);
+                (void)ble_gap_set_data_len(g_conn_handle, kDleTxOctets, kDleTxTimeUs);
+                apply_link_profile(g_bulk_refs.load() > 0);
             } else {
                 ESP_LOGW(GATTS_TAG, "GAP connect fail; status=%d", event->connect.status);
                 g_conn_handle = BLE_HS_CONN_HANDLE_NONE;
@@ -326,7 +410,10 @@ static int gap_event(struct ble_gap_event* event, void* arg) {
             ESP_LOGI(GATTS_TAG, "GAP disconnected; reason=%d", event->disconnect.reason);
             g_conn_handle = BLE_HS_CONN_HANDLE_NONE;
             g_notify_enabled_flag = false;
-            g_pending_frame.clear();
+            tx_clear();
+            log_rx_stats();
+            g_rx_decoder.reset();
+            g_peer_caps.store(0);
             // Restart advertising
             {
                 uint8_t own_addr_type = 0;
@@ -343,13 +430,21 @@ static int gap_event(struct ble_gap_event* event, void* arg) {
         case BLE_GAP_EVENT_SUBSCRIBE:
             g_notify_enabled_flag = event->subscribe.cur_notify;
             ESP_LOGI(GATTS_TAG, "GAP subscribe: notify=%d handle=%u", (int)g_notify_enabled_flag, event->subscribe.conn_handle);
-            if (g_notify_enabled_flag && !g_pending_frame.empty()) {
-                // Flush pending frame now that notifications are enabled
-                const std::string frame = g_pending_frame;
-                g_pending_frame.clear();
-                ble_uart_send(reinterpret_cast<const uint8_t*>(frame.data()), frame.size());
+            if (g_notify_enabled_flag) send_hello();
+            if (g_notify_enabled_flag) outbox::on_transport_ready("ble");
+            return 0;
+        case BLE_GAP_EVENT_MTU:
+            g_link_stats.mtu = event->mtu.value;
+            ESP_LOGI(GATTS_TAG, "ATT MTU %u", (unsigned)event->mtu.value);
+            return 0;
+        case BLE_GAP_EVENT_CONN_UPDATE: {
+            struct ble_gap_conn_desc desc;
+            if (ble_gap_conn_find(event->conn_update.conn_handle, &desc) == 0) {
+                ESP_LOGI(GATTS_TAG, "conn interval %u x1.25ms latency %u",
+                         (unsigned)desc.conn_itvl, (unsigned)desc.conn_latency);
             }
             return 0;
+        }
         default:
             return 0;
     }
@@ -464,6 +559,7 @@ extern "C" void ble_uart_enable(void) {
     ble_store_config_init();
 #endif
 
+    (void)ble_att_set_preferred_mtu(kPreferredMtu);
     // Register GATT services before starting NimBLE host task.
     gatt_build_and_register();
     ble_svc_gap_init();
@@ -495,32 +591,23 @@ extern "C" int ble_uart_is_ready(void) {
     return g_stack_inited ? 1 : 0;
 }
 
-extern "C" int ble_uart_send(const uint8_t* data, size_t len) {
-    if (!g_stack_inited || tx_val_handle == 0) return -1;
-    if (!g_notify_enabled_flag || g_conn_handle == BLE_HS_CONN_HANDLE_NONE) {
-        // Queue single pending frame until notifications are enabled
-        g_pending_frame.assign(reinterpret_cast<const char*>(data), len);
-        ESP_LOGI(GATTS_TAG, "Queue frame until notify enabled (%u bytes)", (unsigned)len);
-        return 0;
-    }
-    uint16_t mtu = ble_att_mtu(g_conn_handle);
-    size_t mtu_payload = (mtu > 3) ? (mtu - 3) : 20;
-    size_t offset = 0;
-    while (offset < len) {
-        size_t chunk = len - offset;
-        if (chunk > mtu_payload) chunk = mtu_payload;
-        struct os_mbuf* om = ble_hs_mbuf_from_flat(data + offset, chunk);
-        if (!om) return -2;
-        int rc = ble_gatts_notify_custom(g_conn_handle, tx_val_handle, om);
-        if (rc != 0) return -3;
-        offset += chunk;
-    }
-    return 0;
+static size_t tx_chunk_max() {
+    const uint16_t mtu = ble_att_mtu(g_conn_handle);
+    return (mtu > 3) ? (mtu - 3) : 20;
 }
 
-extern "C" int ble_uart_send_str(const char* s) {
-    if (!s) return -1;
-    return ble_uart_send(reinterpret_cast<const uint8_t*>(s), strlen(s));
+static TxRc tx_notify(const uint8_t* data, size_t len) {
+    if (!g_stack_inited || tx_val_handle == 0 || !g_notify_enabled_flag ||
+        g_conn_handle == BLE_HS_CONN_HANDLE_NONE) {
+        return TxRc::kNoLink;
+    }
+    struct os_mbuf* om = ble_hs_mbuf_from_flat(data, len);
+    if (!om) return TxRc::kBusy;
+    // The mbuf is consumed on success and on error.
+    const int rc = ble_gatts_notify_custom(g_conn_handle, tx_val_handle, om);
+    if (rc == 0) return TxRc::kOk;
+    if (rc == BLE_HS_ENOMEM || rc == BLE_HS_EBUSY) return TxRc::kBusy;
+    return TxRc::kFail;
 }
 
 extern "C" int ble_uart_last_err(void) { return g_last_err; }
@@ -561,15 +648,15 @@ static esp_gatt_if_t gatts_if_global = ESP_GATT_IF_NONE;
 static uint16_t conn_id_global = 0xFFFF;
 static bool notify_enabled = false;
 static uint16_t current_mtu = 23;  // default
+static esp_bd_addr_t remote_bda_global = {};
+// Set by ESP_GATTS_CONGEST_EVT; the TX queue waits while the stack is full.
+static std::atomic<bool> tx_congested{false};
 static bool adv_started = false;
 // Track ADV/Scan Rsp config completion to start advertising at right time
 static uint8_t adv_config_done = 0;
 #define ADV_CONFIG_FLAG        (1 << 0)
 #define SCAN_RSP_CONFIG_FLAG   (1 << 1)
 
-// RX buffer to collect newline-terminated frames
-static std::string rx_buffer;
-
 // Attribute table
 static const uint16_t primary_service_uuid = ESP_GATT_UUID_PRI_SERVICE;
 static const uint16_t character_declaration_uuid = ESP_GATT_UUID_CHAR_DECLARE;
@@ -677,11 +764,47 @@ static void gap_cb(esp_gap_ble_cb_event_t event,
             break;
         case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
             break;
+        case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+            ESP_LOGI(GATTS_TAG, "conn interval %u x1.25ms latency %u (status=%d)",
+                     (unsigned)param->update_conn_params.conn_int,
+                     (unsigned)param->update_conn_params.latency,
+                     (int)param->update_conn_params.status);
+            break;
+        case ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT:
+            ESP_LOGI(GATTS_TAG, "data length tx=%u rx=%u (status=%d)",
+                     (unsigned)param->pkt_data_length_cmpl.params.tx_len,
+                     (unsigned)param->pkt_data_length_cmpl.params.rx_len,
+                     (int)param->pkt_data_length_cmpl.status);
+            break;
         default:
             break;
     }
 }
 
+static void apply_link_profile(bool bulk) {
+    if (conn_id_global == 0xFFFF) return;
+    const LinkProfile& lp = bulk ? kBulkProfile : kIdleProfile;
+    esp_ble_conn_update_params_t params = {};
+    memcpy(params.bda, remote_bda_global, sizeof(esp_bd_addr_t));
+    params.min_int = lp.itvl_min;
+    params.max_int = lp.itvl_max;
+    params.latency = lp.latency;
+    params.timeout = lp.timeout;
+    esp_err_t err = esp_ble_gap_update_conn_params(&params);
+    if (err != ESP_OK) {
+        ESP_LOGW(GATTS_TAG, "conn param update failed: %s", esp_err_to_name(err));
+    }
+#if defined(CONFIG_BT_BLE_50_FEATURES_SUPPORTED)
+    // The original ESP32 controller is BLE 4.2; 2M PHY needs a BLE 5 target.
+    if (bulk) {
+        (void)esp_ble_gap_set_preferred_phy(remote_bda_global, 0,
+                                            ESP_BLE_GAP_PHY_2M_PREF_MASK,
+                                            ESP_BLE_GAP_PHY_2M_PREF_MASK,
+                                            ESP_BLE_GAP_PHY_OPTIONS_NO_PREF);
+    }
+#endif
+}
+
 static void gatts_cb(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
                      esp_ble_gatts_cb_param_t* param) {
     switch (event) {
@@ -711,11 +834,21 @@ static void gatts_cb(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
             break;
         case ESP_GATTS_CONNECT_EVT:
             conn_id_global = param->connect.conn_id;
+            memcpy(remote_bda_global, param->connect.remote_bda, sizeof(esp_bd_addr_t));
             notify_enabled = false;
+            tx_congested = false;
+            // DLE stays on for the whole link; the phone drives the MTU
+            // exchange up to the local MTU set at enable.
+            (void)esp_ble_gap_set_pkt_data_len(remote_bda_global, kDleTxOctets);
+            apply_link_profile(g_bulk_refs.load() > 0);
             break;
         case ESP_GATTS_DISCONNECT_EVT:
             conn_id_global = 0xFFFF;
             notify_enabled = false;
+            tx_clear();
+            log_rx_stats();
+            g_rx_decoder.reset();
+            g_peer_caps.store(0);
             start_advertising();
             break;
         case ESP_GATTS_WRITE_EVT:
@@ -723,47 +856,20 @@ static void gatts_cb(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
                 param->write.len == 2) {
                 uint16_t v = param->write.value[1] << 8 | param->write.value[0];
                 notify_enabled = (v != 0);
+                if (notify_enabled) send_hello();
+                if (notify_enabled) outbox::on_transport_ready("ble");
             } else if (param->write.handle == gatt_handle_table[IDX_RX_VAL]) {
-                const uint8_t* d = param->write.value;
-                uint16_t l = param->write.len;
-                rx_buffer.append((const char*)d, (const char*)d + l);
-                // Newline-delimited frames first
-                size_t idx;
-                while ((idx = rx_buffer.find('\n')) != std::string::npos) {
-                    std::string frame = rx_buffer.substr(0, idx);
-                    rx_buffer.erase(0, idx + 1);
-                    if (!frame.empty()) handle_frame_from_phone(frame);
-                }
-                // Try balanced-JSON extraction without newline
-                auto extract_json = [&]() -> bool {
-                    size_t start = rx_buffer.find('{');
-                    if (start == std::string::npos) { rx_buffer.clear(); return false; }
-                    bool in_string = false; bool escape = false; int depth = 0;
-                    for (size_t i = start; i < rx_buffer.size(); ++i) {
-                        char c = rx_buffer[i];
-                        if (in_string) {
-                            if (escape) { escape = false; }
-                            else if (c == '\\') { escape = true; }
-                            else if (c == '"') { in_string = false; }
-                        } else {
-                            if (c == '"') in_string = true;
-                            else if (c == '{') depth++;
-                            else if (c == '}') { depth--; if (depth == 0) {
-                                std::string frame = rx_buffer.substr(start, i - start + 1);
-                                rx_buffer.erase(0, i + 1);
-                                handle_frame_from_phone(frame);
-                                return true;
-                            }}
-                        }
-                    }
-                    if (start > 0) rx_buffer.erase(0, start);
-                    return false;
-                };
-                int guard = 0; while (extract_json() && guard++ < 4) {}
+                feed_rx(param->write.value, param->write.len);
             }
             break;
         case ESP_GATTS_MTU_EVT:
             current_mtu = param->mtu.mtu;
+            g_link_stats.mtu = current_mtu;
+            ESP_LOGI(GATTS_TAG, "ATT MTU %u", (unsigned)current_mtu);
+            break;
+        case ESP_GATTS_CONGEST_EVT:
+            tx_congested = param->congest.congested;
+            if (!tx_congested) tx_kick();
             break;
         default:
             break;
@@ -836,6 +942,7 @@ extern "C" void ble_uart_enable(void) {
         g_last_err = err;
         goto fail_disable_bluedroid;
     }
+    (void)esp_ble_gatt_set_local_mtu(kPreferredMtu);
     err = esp_ble_gatts_app_register(0x42);
     if (err != ESP_OK) {
         ESP_LOGE(GATTS_TAG, "gatts_app_register failed: %s",
@@ -880,24 +987,18 @@ extern "C" int ble_uart_is_ready(void) {
 
 extern "C" int ble_uart_last_err(void) { return g_last_err; }
 
-extern "C" int ble_uart_send(const uint8_t* data, size_t len) {
-    if (!ble_uart_is_ready()) return -1;
-    size_t mtu_payload = (current_mtu > 3) ? (current_mtu - 3) : 20;
-    size_t offset = 0;
-    while (offset < len) {
-        size_t chunk = std::min(mtu_payload, len - offset);
-        esp_err_t err = esp_ble_gatts_send_indicate(
-            gatts_if_global, conn_id_global, gatt_handle_table[IDX_TX_VAL],
-            chunk, const_cast<uint8_t*>(data + offset), false);
-        if (err != ESP_OK) return -2;
-        offset += chunk;
-    }
-    return 0;
+static size_t tx_chunk_max() {
+    return (current_mtu > 3) ? (current_mtu - 3) : 20;
 }
 
-extern "C" int ble_uart_send_str(const char* s) {
-    if (!s) return -1;
-    return ble_uart_send(reinterpret_cast<const uint8_t*>(s), strlen(s));
+static TxRc tx_notify(const uint8_t* data, size_t len) {
+    if (!ble_uart_is_ready()) return TxRc::kNoLink;
+    if (tx_congested) return TxRc::kBusy;
+    // Fails only when the BTC queue cannot take the message; retry later.
+    esp_err_t err = esp_ble_gatts_send_indicate(
+        gatts_if_global, conn_id_global, gatt_handle_table[IDX_TX_VAL], len,
+        const_cast<uint8_t*>(data), false);
+    return err == ESP_OK ? TxRc::kOk : TxRc::kBusy;
 }
 
 #else
@@ -907,14 +1008,128 @@ extern "C" void ble_uart_enable(void) {}
 extern "C" void ble_uart_disable(void) {}
 extern "C" int ble_uart_is_ready(void) { return 0; }
 extern "C" int ble_uart_last_err(void) { return -1; }
+static size_t tx_chunk_max() { return 20; }
+static TxRc tx_notify(const uint8_t*, size_t) { return TxRc::kNoLink; }
+static void apply_link_profile(bool) {}
+
+#endif
+
+// Outbound notification queue shared by both stacks (bletx::Queue).
+// ble_uart_send only appends; the drain runs on the esp_timer task.
+namespace {
+struct TxQueue {
+    std::mutex m;
+    bletx::Queue q;
+    esp_timer_handle_t timer = nullptr;
+    // Set when a disconnect could not take the lock; the drain clears.
+    std::atomic<bool> clear_pending{false};
+};
+TxQueue g_tx;
+int64_t g_bulk_start_us = 0;
+uint32_t g_bulk_rx_start = 0;
+uint32_t g_bulk_tx_start = 0;
+
+// Mirrors the queue counters into g_link_stats; called with g_tx.m held.
+void tx_sync_stats_locked() {
+    const bletx::Stats& st = g_tx.q.stats();
+    g_link_stats.tx_bytes = st.bytes;
+    g_link_stats.tx_notifications = st.notifications;
+    g_link_stats.tx_busy = st.busy;
+    g_link_stats.tx_dropped = st.dropped();
+    g_link_stats.tx_queue_peak = st.peak_bytes;
+}
+
+void tx_drain(void*) {
+    std::lock_guard<std::mutex> lk(g_tx.m);
+    if (g_tx.clear_pending.exchange(false)) g_tx.q.clear();
+    const uint32_t dropped = g_tx.q.stats().dropped();
+    const int64_t next = g_tx.q.drain(esp_timer_get_time(), tx_chunk_max(), tx_notify);
+    if (g_tx.q.stats().dropped() != dropped) {
+        ESP_LOGW(GATTS_TAG, "TX dropped %u frame(s) (stalled or stale)",
+                 (unsigned)(g_tx.q.stats().dropped() - dropped));
+    }
+    tx_sync_stats_locked();
+    if (next != bletx::Queue::kIdle) esp_timer_start_once(g_tx.timer, next);
+}
+
+bool tx_init() {
+    if (g_tx.timer) return true;
+    esp_timer_create_args_t args = {};
+    args.callback = &tx_drain;
+    args.name = "ble_tx";
+    return esp_timer_create(&args, &g_tx.timer) == ESP_OK;
+}
+}  // namespace
+
+// Lock-free: also called from the BLE stack's callback task, which the
+// drain may be waiting on while it holds g_tx.m.
+static void tx_kick() {
+    if (!g_tx.timer) return;
+    esp_timer_stop(g_tx.timer);
+    esp_timer_start_once(g_tx.timer, 0);
+}
+
+static void tx_clear() {
+    std::unique_lock<std::mutex> lk(g_tx.m, std::try_to_lock);
+    if (!lk.owns_lock()) {
+        g_tx.clear_pending = true;
+        tx_kick();
+        return;
+    }
+    g_tx.q.clear();
+    tx_sync_stats_locked();
+    if (g_tx.timer) esp_timer_stop(g_tx.timer);
+}
+
 extern "C" int ble_uart_send(const uint8_t* data, size_t len) {
-    (void)data;
-    (void)len;
-    return -1;
+    if (!g_stack_inited || !data || len == 0) return -1;
+    if (!tx_init()) return -2;
+    {
+        std::lock_guard<std::mutex> lk(g_tx.m);
+        const bool ok = g_tx.q.push(data, len, esp_timer_get_time());
+        tx_sync_stats_locked();
+        if (!ok) {
+            ESP_LOGW(GATTS_TAG, "TX queue full; rejecting %u byte frame", (unsigned)len);
+            return -3;
+        }
+    }
+    tx_kick();
+    return 0;
 }
+
 extern "C" int ble_uart_send_str(const char* s) {
-    (void)s;
-    return -1;
+    if (!s) return -1;
+    return ble_uart_send(reinterpret_cast<const uint8_t*>(s), strlen(s));
 }
 
-#endif
+extern "C" void ble_uart_bulk_begin(void) {
+    if (g_bulk_refs.fetch_add(1) != 0) return;
+    g_bulk_start_us = esp_timer_get_time();
+    g_bulk_rx_start = g_link_stats.rx_bytes;
+    g_bulk_tx_start = g_link_stats.tx_bytes;
+    apply_link_profile(true);
+}
+
+extern "C" void ble_uart_bulk_end(void) {
+    int refs = g_bulk_refs.load();
+    do {
+        if (refs <= 0) return;
+    } while (!g_bulk_refs.compare_exchange_weak(refs, refs - 1));
+    if (refs != 1) return;
+    apply_link_profile(false);
+    const int64_t us = esp_timer_get_time() - g_bulk_start_us;
+    g_link_stats.last_bulk_rx_bytes = g_link_stats.rx_bytes - g_bulk_rx_start;
+    g_link_stats.last_bulk_tx_bytes = g_link_stats.tx_bytes - g_bulk_tx_start;
+    g_link_stats.last_bulk_ms = static_cast<uint32_t>(us / 1000);
+    const uint32_t total = g_link_stats.last_bulk_rx_bytes + g_link_stats.last_bulk_tx_bytes;
+    ESP_LOGI(GATTS_TAG, "bulk: rx=%uB tx=%uB in %u ms (%u B/s, mtu=%u)",
+             (unsigned)g_link_stats.last_bulk_rx_bytes,
+             (unsigned)g_link_stats.last_bulk_tx_bytes,
+             (unsigned)g_link_stats.last_bulk_ms,
+             (unsigned)(us > 0 ? (uint64_t)total * 1000000ULL / (uint64_t)us : 0),
+             (unsigned)g_link_stats.mtu);
+}
+
+extern "C" void ble_uart_get_link_stats(ble_uart_link_stats_t* out) {
+    if (out) *out = g_link_stats;
+}
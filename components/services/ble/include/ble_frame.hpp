@@ -0,0 +1,346 @@
+// Incremental frame decoder for the BLE UART RX characteristic.
+//
+// Two framings share the byte stream and are told apart by the first byte of
+// each frame:
+//  - v1 binary: [0xA5][version][type][len u16 LE][crc16 u16 LE][payload].
+//    crc16 is CRC-16/CCITT-FALSE over the payload. A bad header or CRC drops
+//    the magic byte and resynchronises on the following bytes.
+//  - legacy text (current phone app): a frame ends at '\n', or at the brace
+//    that closes the first top-level JSON object. Bytes before that '{' are
+//    discarded when the object closes without a newline.
+//
+// A v1 frame of type kJsonLzd carries LZD1-compressed JSON (ble_lzd.hpp),
+// sent only after the peer has seen our hello; it is decompressed straight
+// from the ring into the frame buffer and delivered as kJson.
+//
+// Writes land in a fixed-capacity byte ring and every byte is scanned once;
+// the brace/string state is carried across writes. A completed frame is
+// copied once into a preallocated frame buffer and handed to the sink as a
+// view, so the NimBLE host task never allocates on the RX path.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "esp_heap_caps.h"
+
+#include "ble_lzd.hpp"
+
+namespace bleframe {
+
+constexpr uint8_t kMagic = 0xA5;
+constexpr uint8_t kVersion = 1;
+constexpr size_t kHeaderBytes = 7;
+
+enum class Type : uint8_t {
+    kText = 0,  // legacy newline / brace-delimited frame
+    kJson = 1,     // UTF-8 JSON document
+    kJsonLzd = 2,  // LZD1-compressed JSON document
+};
+
+inline uint16_t crc16(const uint8_t* data, size_t len, uint16_t crc = 0xFFFF) {
+    static const uint16_t kNibble[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF};
+    for (size_t i = 0; i < len; ++i) {
+        crc = static_cast<uint16_t>((crc << 4) ^ kNibble[(crc >> 12) ^ (data[i] >> 4)]);
+        crc = static_cast<uint16_t>((crc << 4) ^ kNibble[(crc >> 12) ^ (data[i] & 0x0F)]);
+    }
+    return crc;
+}
+
+// Appends a v1 frame to out. Returns false if the payload is too large.
+inline bool encode(Type type, const void* payload, size_t len, std::string& out) {
+    if (len > 0xFFFF) return false;
+    const auto* p = static_cast<const uint8_t*>(payload);
+    const uint16_t crc = crc16(p, len);
+    const uint8_t hdr[kHeaderBytes] = {
+        kMagic,
+        kVersion,
+        static_cast<uint8_t>(type),
+        static_cast<uint8_t>(len & 0xFF),
+        static_cast<uint8_t>(len >> 8),
+        static_cast<uint8_t>(crc & 0xFF),
+        static_cast<uint8_t>(crc >> 8)};
+    out.append(reinterpret_cast<const char*>(hdr), kHeaderBytes);
+    out.append(reinterpret_cast<const char*>(p), len);
+    return true;
+}
+
+class Decoder {
+   public:
+    struct Stats {
+        uint32_t frames = 0;
+        uint32_t binary_frames = 0;
+        uint32_t crc_errors = 0;
+        uint32_t bad_headers = 0;
+        uint32_t oversized = 0;  // frame longer than the frame buffer
+        uint32_t compressed_frames = 0;
+        uint32_t compressed_bytes = 0;    // wire payload of those frames
+        uint32_t decompressed_bytes = 0;  // what they expanded to
+        uint32_t decode_errors = 0;
+        uint32_t overflows = 0;  // ring full, buffered bytes discarded
+        uint32_t peak_bytes = 0;
+    };
+
+    Decoder() = default;
+    Decoder(const Decoder&) = delete;
+    Decoder& operator=(const Decoder&) = delete;
+    ~Decoder() {
+        if (ring_) heap_caps_free(ring_);
+        if (frame_) heap_caps_free(frame_);
+    }
+
+    // ring_bytes is rounded up to a power of two; max_frame caps one frame.
+    bool init(size_t ring_bytes, size_t max_frame) {
+        if (ring_) return true;
+        size_t pow2 = 64;
+        while (pow2 < ring_bytes) pow2 <<= 1;
+        max_frame = std::min<size_t>(max_frame, 0xFFFF);
+        ring_ = alloc(pow2);
+        frame_ = alloc(max_frame + 1);
+        if (!ring_ || !frame_) {
+            if (ring_) heap_caps_free(ring_);
+            if (frame_) heap_caps_free(frame_);
+            ring_ = frame_ = nullptr;
+            return false;
+        }
+        cap_ = static_cast<uint32_t>(pow2);
+        max_frame_ = static_cast<uint32_t>(max_frame);
+        return true;
+    }
+
+    bool ready() const { return ring_ != nullptr; }
+
+    // Drops any partial frame and the peer's framing version; call on
+    // disconnect.
+    void reset() {
+        head_ = tail_ = scan_ = 0;
+        peer_version_ = 0;
+        start_frame();
+    }
+
+    // Feeds one GATT write. sink(Type, std::string_view) runs once per
+    // complete frame; the view is valid only during the call.
+    template <typename Sink>
+    void feed(const uint8_t* data, size_t len, Sink&& sink) {
+        if (!ring_) return;
+        while (len > 0) {
+            uint32_t room = cap_ - (head_ - tail_);
+            if (room == 0) {
+                // A frame this long cannot complete; start over.
+                ++stats_.overflows;
+                tail_ = scan_ = head_;
+                start_frame();
+                room = cap_;
+            }
+            const size_t n = std::min<size_t>(len, room);
+            write_bytes(head_, data, n);
+            head_ += static_cast<uint32_t>(n);
+            data += n;
+            len -= n;
+            stats_.peak_bytes = std::max(stats_.peak_bytes, head_ - tail_);
+            process(sink);
+        }
+    }
+
+    // Highest framing version the peer has used (0 = legacy text only).
+    uint8_t peer_version() const { return peer_version_; }
+    Stats stats() const { return stats_; }
+
+   private:
+    enum class Mode : uint8_t { kIdle, kText, kBinary };
+
+    static uint8_t* alloc(size_t bytes) {
+        auto* p = static_cast<uint8_t*>(
+            heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+        if (!p) {
+            p = static_cast<uint8_t*>(
+                heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+        }
+        return p;
+    }
+
+    void start_frame() {
+        mode_ = Mode::kIdle;
+        json_start_ = 0;
+        has_json_ = false;
+        depth_ = 0;
+        in_string_ = false;
+        escape_ = false;
+    }
+
+    uint8_t at(uint32_t pos) const { return ring_[pos & (cap_ - 1)]; }
+
+    template <typename Sink>
+    void process(Sink& sink) {
+        while (scan_ != head_ || mode_ == Mode::kBinary) {
+            if (mode_ == Mode::kIdle) {
+                const uint8_t c = at(tail_);
+                if (c == kMagic) {
+                    mode_ = Mode::kBinary;
+                } else if (c == '\n' || c == '\r') {
+                    scan_ = ++tail_;
+                    continue;
+                } else {
+                    mode_ = Mode::kText;
+                }
+            }
+            if (mode_ == Mode::kBinary) {
+                if (!step_binary(sink)) return;
+                continue;
+            }
+            step_text(sink);
+        }
+    }
+
+    // Returns false when more bytes are needed.
+    template <typename Sink>
+    bool step_binary(Sink& sink) {
+        if (head_ - tail_ < kHeaderBytes) {
+            scan_ = head_;
+            return false;
+        }
+        const uint8_t version = at(tail_ + 1);
+        const uint8_t type = at(tail_ + 2);
+        const uint32_t len = at(tail_ + 3) | (uint32_t(at(tail_ + 4)) << 8);
+        const uint16_t crc = static_cast<uint16_t>(at(tail_ + 5) | (at(tail_ + 6) << 8));
+        if (version == 0 || version > kVersion || len > max_frame_ ||
+            kHeaderBytes + len > cap_) {
+            ++stats_.bad_headers;
+            resync();
+            return true;
+        }
+        if (head_ - tail_ < kHeaderBytes + len) {
+            scan_ = head_;
+            return false;
+        }
+        // The payload may wrap; CRC and decode both walk the two halves in
+        // place.
+        const uint32_t off = (tail_ + kHeaderBytes) & (cap_ - 1);
+        const uint32_t first = std::min<uint32_t>(len, cap_ - off);
+        const uint16_t got = crc16(ring_, len - first, crc16(ring_ + off, first));
+        if (got != crc) {
+            ++stats_.crc_errors;
+            resync();
+            return true;
+        }
+        tail_ += kHeaderBytes + len;
+        scan_ = tail_;
+        start_frame();
+        peer_version_ = std::max(peer_version_, version);
+        uint32_t out_len = len;
+        Type out_type = static_cast<Type>(type);
+        if (out_type == Type::kJsonLzd) {
+            lzd::Decoder dec(frame_, max_frame_);
+            if (!dec.feed(ring_ + off, first) || !dec.feed(ring_, len - first) ||
+                !dec.finish()) {
+                ++stats_.decode_errors;
+                return true;
+            }
+            out_len = static_cast<uint32_t>(dec.size());
+            out_type = Type::kJson;
+            ++stats_.compressed_frames;
+            stats_.compressed_bytes += len;
+            stats_.decompressed_bytes += out_len;
+        } else {
+            memcpy(frame_, ring_ + off, first);
+            memcpy(frame_ + first, ring_, len - first);
+        }
+        frame_[out_len] = '\0';
+        ++stats_.frames;
+        ++stats_.binary_frames;
+        sink(out_type, std::string_view(reinterpret_cast<const char*>(frame_), out_len));
+        return true;
+    }
+
+    // Skips the magic byte and rescans what follows as ordinary input.
+    void resync() {
+        scan_ = ++tail_;
+        start_frame();
+    }
+
+    template <typename Sink>
+    void step_text(Sink& sink) {
+        const uint32_t pos = scan_++;
+        const uint8_t c = at(pos);
+        if (c == '\n') {
+            emit(sink, tail_, pos - tail_);
+            tail_ = scan_;
+            start_frame();
+            return;
+        }
+        if (has_json_) {
+            if (in_string_) {
+                if (escape_) escape_ = false;
+                else if (c == '\\') escape_ = true;
+                else if (c == '"') in_string_ = false;
+            } else if (c == '"') {
+                in_string_ = true;
+            } else if (c == '{') {
+                ++depth_;
+            } else if (c == '}' && --depth_ == 0) {
+                emit(sink, json_start_, pos + 1 - json_start_);
+                tail_ = scan_;
+                start_frame();
+                return;
+            }
+        } else if (c == '{') {
+            has_json_ = true;
+            json_start_ = pos;
+            depth_ = 1;
+        }
+        if (scan_ - tail_ > max_frame_) {
+            ++stats_.oversized;
+            tail_ = scan_;
+            start_frame();
+        }
+    }
+
+    template <typename Sink>
+    void emit(Sink& sink, uint32_t from, uint32_t len) {
+        if (len == 0) return;
+        read_bytes(from, frame_, len);
+        frame_[len] = '\0';
+        ++stats_.frames;
+        sink(Type::kText, std::string_view(reinterpret_cast<const char*>(frame_), len));
+    }
+
+    void write_bytes(uint32_t pos, const uint8_t* src, size_t len) {
+        const uint32_t off = pos & (cap_ - 1);
+        const size_t first = std::min<size_t>(len, cap_ - off);
+        memcpy(ring_ + off, src, first);
+        memcpy(ring_, src + first, len - first);
+    }
+
+    void read_bytes(uint32_t pos, uint8_t* dst, size_t len) const {
+        const uint32_t off = pos & (cap_ - 1);
+        const size_t first = std::min<size_t>(len, cap_ - off);
+        memcpy(dst, ring_ + off, first);
+        memcpy(dst + first, ring_, len - first);
+    }
+
+    uint8_t* ring_ = nullptr;
+    uint8_t* frame_ = nullptr;
+    uint32_t cap_ = 0;
+    uint32_t max_frame_ = 0;
+    // Free-running positions: tail_ = start of the current frame, scan_ =
+    // next byte to examine, head_ = end of buffered data.
+    uint32_t head_ = 0;
+    uint32_t tail_ = 0;
+    uint32_t scan_ = 0;
+    Mode mode_ = Mode::kIdle;
+    uint32_t json_start_ = 0;
+    bool has_json_ = false;
+    int depth_ = 0;
+    bool in_string_ = false;
+    bool escape_ = false;
+    uint8_t peer_version_ = 0;
+    Stats stats_;
+};
+
+}  // namespace bleframe
@@ -0,0 +1,183 @@
+// LZD1: byte-oriented LZ77 with a preset JSON dictionary for relay frames.
+//
+// History and contact frames are short JSON documents that repeat the same
+// keys, so a dictionary of those keys lets even the first object in a frame
+// compress. The window is the dictionary followed by the output produced so
+// far; a match may start in the dictionary and run into the output.
+//
+// Token stream:
+//   0x00-0x7F  literal run of (c + 1) bytes, which follow
+//   0x80-0xFF  match of ((c & 0x7F) + kMinMatch) bytes at distance d,
+//              d = u16 LE that follows (1 = previous byte)
+//
+// The decoder is incremental: input can arrive in pieces (e.g. both halves
+// of a wrapped ring buffer) and output goes straight into the caller's
+// buffer. The encoder is a greedy single-probe hash matcher meant for the
+// phone side and host tooling.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lzd {
+
+constexpr size_t kMinMatch = 3;
+constexpr size_t kMaxMatch = 0x7F + kMinMatch;
+constexpr size_t kMaxLiteralRun = 0x80;
+constexpr size_t kMaxDistance = 0xFFFF;
+
+// Changing this breaks compatibility with peers; bump the codec name instead.
+constexpr std::string_view kDictionary =
+    "{\"ok\":true,\"error\":null,\"type\":\"friend_request_result\"}"
+    "{\"type\":\"pending_requests\",\"requests\":[{\"request_id\":\"\","
+    "\"username\":\"\"}]}"
+    "{\"type\":\"friends\",\"contacts\":[],\"friends\":[{\"id\":\"\","
+    "\"friend_id\":\"\",\"user_name\":\"\",\"display_name\":\"\","
+    "\"nickname\":\"\",\"login_id\":\"\",\"short_id\":\"\",\"username\":\"\","
+    "\"unread_count\":0,\"has_unread\":false},"
+    "{\"id\":\"\",\"type\":\"messages\",\"messages\":[{\"id\":\"\","
+    "\"message_id\":\"\",\"from\":\"\",\"message\":\"\",\"payload\":{"
+    "\"sender_id\":\"\",\"receiver_id\":\"\",\"content\":\"\","
+    "\"created_at\":\"2025-01-01T00:00:00.000Z\",\"is_read\":false},"
+    "{\"id\":\"";
+
+class Decoder {
+   public:
+    Decoder(uint8_t* out, size_t cap) : out_(out), cap_(cap) {}
+
+    // Consumes the next piece of input. Returns false on corrupt input or
+    // when the output would exceed the buffer; the decoder is then dead.
+    bool feed(const uint8_t* in, size_t len) {
+        for (size_t i = 0; i < len && ok_;) {
+            switch (state_) {
+                case State::kControl: {
+                    const uint8_t c = in[i++];
+                    if (c < 0x80) {
+                        need_ = size_t(c) + 1;
+                        state_ = State::kLiteral;
+                    } else {
+                        need_ = size_t(c & 0x7F) + kMinMatch;
+                        state_ = State::kDistLo;
+                    }
+                    break;
+                }
+                case State::kLiteral: {
+                    size_t n = len - i < need_ ? len - i : need_;
+                    if (size_ + n > cap_) return fail();
+                    memcpy(out_ + size_, in + i, n);
+                    size_ += n;
+                    i += n;
+                    need_ -= n;
+                    if (need_ == 0) state_ = State::kControl;
+                    break;
+                }
+                case State::kDistLo:
+                    dist_ = in[i++];
+                    state_ = State::kDistHi;
+                    break;
+                case State::kDistHi:
+                    dist_ |= size_t(in[i++]) << 8;
+                    if (!copy_match()) return fail();
+                    state_ = State::kControl;
+                    break;
+            }
+        }
+        return ok_;
+    }
+
+    // True once the input ended on a token boundary.
+    bool finish() const { return ok_ && state_ == State::kControl; }
+    size_t size() const { return size_; }
+
+   private:
+    enum class State : uint8_t { kControl, kLiteral, kDistLo, kDistHi };
+
+    bool fail() {
+        ok_ = false;
+        return false;
+    }
+
+    bool copy_match() {
+        const size_t window = kDictionary.size() + size_;
+        if (dist_ == 0 || dist_ > window || size_ + need_ > cap_) return false;
+        // Byte-wise: the source may overlap the bytes being written.
+        size_t src = window - dist_;
+        for (size_t k = 0; k < need_; ++k, ++src) {
+            out_[size_++] = src < kDictionary.size()
+                                ? static_cast<uint8_t>(kDictionary[src])
+                                : out_[src - kDictionary.size()];
+        }
+        return true;
+    }
+
+    uint8_t* out_;
+    size_t cap_;
+    size_t size_ = 0;
+    size_t need_ = 0;
+    size_t dist_ = 0;
+    State state_ = State::kControl;
+    bool ok_ = true;
+};
+
+// Appends the LZD1 encoding of `in` to `out`.
+inline void encode(std::string_view in, std::string& out) {
+    const std::string_view dict = kDictionary;
+    std::string win;
+    win.reserve(dict.size() + in.size());
+    win.append(dict.data(), dict.size());
+    win.append(in.data(), in.size());
+    constexpr int kHashBits = 12;
+    std::vector<int32_t> head(size_t(1) << kHashBits, -1);
+    auto hash = [&](size_t p) {
+        const uint32_t v = uint8_t(win[p]) | (uint8_t(win[p + 1]) << 8) |
+                           (uint32_t(uint8_t(win[p + 2])) << 16);
+        return (v * 2654435761u) >> (32 - kHashBits);
+    };
+    for (size_t p = 0; p + kMinMatch <= dict.size(); ++p) head[hash(p)] = int32_t(p);
+
+    size_t lit_start = dict.size();
+    auto flush_literals = [&](size_t end) {
+        while (lit_start < end) {
+            const size_t n = std::min(end - lit_start, kMaxLiteralRun);
+            out.push_back(static_cast<char>(n - 1));
+            out.append(win, lit_start, n);
+            lit_start += n;
+        }
+    };
+    size_t p = dict.size();
+    while (p < win.size()) {
+        size_t best = 0;
+        size_t dist = 0;
+        if (p + kMinMatch <= win.size()) {
+            const uint32_t h = hash(p);
+            const int32_t cand = head[h];
+            head[h] = int32_t(p);
+            if (cand >= 0 && p - size_t(cand) <= kMaxDistance) {
+                const size_t limit = std::min(kMaxMatch, win.size() - p);
+                while (best < limit && win[size_t(cand) + best] == win[p + best]) ++best;
+                dist = p - size_t(cand);
+            }
+        }
+        if (best < kMinMatch) {
+            ++p;
+            continue;
+        }
+        flush_literals(p);
+        out.push_back(static_cast<char>(0x80 | (best - kMinMatch)));
+        out.push_back(static_cast<char>(dist & 0xFF));
+        out.push_back(static_cast<char>(dist >> 8));
+        for (size_t k = 1; k < best && p + k + kMinMatch <= win.size(); ++k) {
+            head[hash(p + k)] = int32_t(p + k);
+        }
+        p += best;
+        lit_start = p;
+    }
+    flush_literals(win.size());
+}
+
+}  // namespace lzd
@@ -0,0 +1,293 @@
+// Request/response correlation for the BLE relay.
+//
+// A caller registers a pending entry under the request id before sending,
+// then sleeps on a dedicated task-notification index. The RX path reads the response's
+// top-level "id" once and hands the frame to the matching entry, waking the
+// caller, so nothing polls the frame caches or re-parses a frame to find
+// out whether it is the one being waited for. Several calls may be in
+// flight at once (e.g. contacts and pending requests).
+//
+// Older phone app versions do not always echo the id, and some do not set a
+// matching type either; a call can name the response types it accepts and the
+// keys such a response must carry (e.g. "messages"), and an id-less frame
+// with one of those types or keys completes the oldest matching call.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "ble_uart.hpp"
+
+namespace blerpc {
+
+static const char* RPC_TAG = "BleRpc";
+
+// Index 0 belongs to whatever else the caller waits on (mqtt_rt_wait_event,
+// worker wakeups), so RPC completions use their own slot.
+static constexpr UBaseType_t kNotifyIndex = 1;
+static_assert(configTASK_NOTIFICATION_ARRAY_ENTRIES > kNotifyIndex,
+              "set CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES >= 2");
+
+struct Hooks {
+    std::function<void()> on_tick;
+    std::function<bool()> should_cancel;
+    uint32_t tick_ms = 100;
+};
+
+namespace detail {
+
+static constexpr size_t kMaxPending = 8;
+
+struct Pending {
+    std::string id;
+    std::vector<std::string> types;
+    std::vector<std::string> keys;
+    TaskHandle_t waiter = nullptr;
+    std::atomic<bool> done{false};
+    std::string response;
+};
+
+struct State {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<Pending>> pending;
+    uint32_t completed = 0;
+    uint32_t unmatched = 0;
+};
+
+inline State& state() {
+    static State s;
+    return s;
+}
+
+inline std::string_view skip_ws(std::string_view s) {
+    size_t i = 0;
+    while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n')) {
+        ++i;
+    }
+    return s.substr(i);
+}
+
+inline void unregister(const std::shared_ptr<Pending>& p) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.pending.erase(std::remove(s.pending.begin(), s.pending.end(), p), s.pending.end());
+}
+
+// Finds `key` as an object key at nesting depth 1..max_depth and returns the
+// text after its colon (whitespace skipped), or an empty view.
+inline std::string_view find_key(std::string_view json, std::string_view key,
+                                 int max_depth) {
+    int depth = 0;
+    size_t i = 0;
+    while (i < json.size()) {
+        const char c = json[i];
+        if (c == '{' || c == '[') {
+            ++depth;
+            ++i;
+            continue;
+        }
+        if (c == '}' || c == ']') {
+            --depth;
+            ++i;
+            continue;
+        }
+        if (c != '"') {
+            ++i;
+            continue;
+        }
+        size_t end = i + 1;
+        while (end < json.size() && json[end] != '"') {
+            end += (json[end] == '\\') ? 2 : 1;
+        }
+        if (end >= json.size()) return {};
+        const std::string_view str = json.substr(i + 1, end - i - 1);
+        i = end + 1;
+        std::string_view rest = skip_ws(json.substr(i));
+        if (rest.empty() || rest.front() != ':') continue;  // a value
+        if (depth < 1 || depth > max_depth || str != key) continue;
+        return skip_ws(rest.substr(1));
+    }
+    return {};
+}
+
+}  // namespace detail
+
+// Returns the raw (still escaped) string value of a top-level key, or an
+// empty view if the key is absent, nested or not a string.
+inline std::string_view top_level_string(std::string_view json, std::string_view key) {
+    const std::string_view rest = detail::find_key(json, key, 1);
+    if (rest.empty() || rest.front() != '"') return {};
+    size_t v = 1;
+    while (v < rest.size() && rest[v] != '"') v += (rest[v] == '\\') ? 2 : 1;
+    if (v >= rest.size()) return {};
+    return rest.substr(1, v - 1);
+}
+
+// True if `key` is a key of the top-level object or of an object directly
+// inside it (the relay wraps some replies in "payload").
+inline bool has_key(std::string_view json, std::string_view key) {
+    return !detail::find_key(json, key, 2).empty();
+}
+
+// Move-only handle for one request in flight. Destroying it unregisters the
+// request, so a late response falls through to the frame caches.
+class Call {
+   public:
+    Call() = default;
+    explicit Call(std::shared_ptr<detail::Pending> p) : p_(std::move(p)) {}
+    Call(Call&&) = default;
+    Call& operator=(Call&& other) {
+        if (this != &other) {
+            cancel();
+            p_ = std::move(other.p_);
+        }
+        return *this;
+    }
+    Call(const Call&) = delete;
+    Call& operator=(const Call&) = delete;
+    ~Call() { cancel(); }
+
+    bool valid() const { return p_ != nullptr; }
+    bool done() const { return p_ && p_->done.load(std::memory_order_acquire); }
+    const std::string& id() const { return p_->id; }
+    // Only meaningful once done() is true.
+    std::string& response() { return p_->response; }
+
+    // Waits for another response to the same request, for callers that got
+    // one they could not use.
+    void rearm() {
+        if (!p_) return;
+        auto& s = detail::state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        p_->response.clear();
+        p_->done.store(false, std::memory_order_release);
+    }
+
+    void cancel() {
+        if (!p_) return;
+        detail::unregister(p_);
+        p_.reset();
+    }
+
+   private:
+    std::shared_ptr<detail::Pending> p_;
+};
+
+// Fresh request id; unique for the lifetime of the boot.
+inline std::string next_id() { return std::to_string(esp_timer_get_time()); }
+
+// Registers `id` for the calling task and sends `frame`. For peers that do
+// not echo the id, response_types lists the accepted "type" values and
+// response_keys the keys (see has_key) that identify a response whatever its
+// type. Returns an invalid Call if the table is full or the send was rejected.
+inline Call start(const std::string& id, const std::string& frame,
+                  std::initializer_list<const char*> response_types = {},
+                  std::initializer_list<const char*> response_keys = {}) {
+    auto p = std::make_shared<detail::Pending>();
+    p->id = id;
+    for (const char* t : response_types) p->types.emplace_back(t);
+    for (const char* k : response_keys) p->keys.emplace_back(k);
+    p->waiter = xTaskGetCurrentTaskHandle();
+    // Drop a completion left over from an earlier call on this task.
+    (void)ulTaskNotifyTakeIndexed(kNotifyIndex, pdTRUE, 0);
+    {
+        auto& s = detail::state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (s.pending.size() >= detail::kMaxPending) {
+            ESP_LOGW(RPC_TAG, "pending table full; dropping request %s", id.c_str());
+            return Call();
+        }
+        s.pending.push_back(p);
+    }
+    if (ble_uart_send(reinterpret_cast<const uint8_t*>(frame.data()), frame.size()) != 0) {
+        detail::unregister(p);
+        return Call();
+    }
+    return Call(std::move(p));
+}
+
+// RX path: completes the call this frame answers. Returns false if no call
+// was waiting for it.
+inline bool deliver(std::string_view frame) {
+    const std::string_view id = top_level_string(frame, "id");
+    const std::string_view type = id.empty() ? top_level_string(frame, "type")
+                                             : std::string_view();
+    std::shared_ptr<detail::Pending> hit;
+    auto& s = detail::state();
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        for (auto& p : s.pending) {
+            if (p->done.load(std::memory_order_relaxed)) continue;
+            bool match;
+            if (!id.empty()) {
+                match = p->id == id;
+            } else {
+                match = std::find(p->types.begin(), p->types.end(), type) !=
+                        p->types.end();
+                for (size_t k = 0; !match && k < p->keys.size(); ++k) {
+                    match = has_key(frame, p->keys[k]);
+                }
+            }
+            if (match) {
+                hit = p;
+                break;
+            }
+        }
+        if (!hit) {
+            if (!id.empty()) ++s.unmatched;
+            return false;
+        }
+        hit->response.assign(frame.data(), frame.size());
+        hit->done.store(true, std::memory_order_release);
+        ++s.completed;
+        // Under the lock: once Call::cancel() has unregistered the entry its
+        // task is never notified for it again.
+        if (hit->waiter) xTaskNotifyGiveIndexed(hit->waiter, kNotifyIndex);
+    }
+    return true;
+}
+
+// Blocks until every call completed, the timeout elapsed or should_cancel
+// returned true. Returns true only if all completed. Calls must have been
+// started from this task.
+inline bool wait_all(std::initializer_list<Call*> calls, uint32_t timeout_ms,
+                     const Hooks& hooks = {}) {
+    const int64_t deadline = esp_timer_get_time() + int64_t(timeout_ms) * 1000;
+    const bool ticking = hooks.on_tick || hooks.should_cancel;
+    while (true) {
+        bool all = true;
+        for (Call* c : calls) {
+            if (!c || !c->valid()) return false;
+            all = all && c->done();
+        }
+        if (all) return true;
+        const int64_t left_us = deadline - esp_timer_get_time();
+        if (left_us <= 0) return false;
+        uint32_t slice_ms = static_cast<uint32_t>((left_us + 999) / 1000);
+        if (ticking) slice_ms = std::min(slice_ms, hooks.tick_ms);
+        ulTaskNotifyTakeIndexed(kNotifyIndex, pdTRUE,
+                                std::max<TickType_t>(pdMS_TO_TICKS(slice_ms), 1));
+        if (hooks.on_tick) hooks.on_tick();
+        if (hooks.should_cancel && hooks.should_cancel()) return false;
+    }
+}
+
+inline bool wait(Call& call, uint32_t timeout_ms, const Hooks& hooks = {}) {
+    return wait_all({&call}, timeout_ms, hooks);
+}
+
+}  // namespace blerpc
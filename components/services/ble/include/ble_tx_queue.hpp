@@ -0,0 +1,168 @@
+// Outbound notification queue for the BLE UART TX characteristic.
+//
+// ble_uart_send() only appends a frame here; a drain (an esp_timer callback
+// in ble_uart.cpp) splits the head frame into MTU-sized notifications and
+// hands them to the stack. When the stack reports ENOMEM or congestion the
+// drain backs off (backoff_min_us..backoff_max_us, doubling) and resumes the
+// same frame at the same offset instead of dropping the rest of it; a frame
+// refused for stall_drop_us is dropped so one bad link cannot wedge the queue.
+//
+// Frames queued while no phone is subscribed wait for it, but only for
+// stale_us: an RPC request older than its caller's timeout is useless, and
+// a burst of them would otherwise fill the queue and be replayed all at
+// once on subscribe.
+//
+// Like espnowrt::Link, the queue takes the time as an argument, has no
+// locking and no ESP-IDF dependencies, so tools/ble_tx_bench can drive it
+// against a simulated stack.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+namespace bletx {
+
+// Result of one notification attempt.
+enum class Rc : uint8_t { kOk, kBusy, kFail, kNoLink };
+
+struct Limits {
+    size_t max_frames = 16;
+    size_t budget_bytes = 8 * 1024;
+    uint32_t backoff_min_us = 2000;
+    uint32_t backoff_max_us = 50000;
+    int64_t stall_drop_us = 5LL * 1000LL * 1000LL;
+    int64_t stale_us = 10LL * 1000LL * 1000LL;
+};
+
+struct Stats {
+    uint32_t notifications = 0;
+    uint32_t bytes = 0;       // payload bytes accepted by the stack
+    uint32_t busy = 0;        // ENOMEM/congestion backoffs
+    uint32_t rejected = 0;    // push() refused: queue full
+    uint32_t stalled = 0;     // dropped after stall_drop_us of kBusy
+    uint32_t failed = 0;      // dropped on a hard notify error
+    uint32_t expired = 0;     // dropped unsent after stale_us without a link
+    uint32_t cleared = 0;     // dropped by clear() (disconnect)
+    uint32_t peak_bytes = 0;
+
+    uint32_t dropped() const { return rejected + stalled + failed + expired + cleared; }
+};
+
+class Queue {
+   public:
+    // drain() result when nothing needs a timer: the queue is empty or waits
+    // for a subscriber (the owner drains again on subscribe or push).
+    static constexpr int64_t kIdle = -1;
+
+    explicit Queue(const Limits& limits = Limits()) : limits_(limits) {}
+
+    // Returns false (and counts a rejection) when the frame does not fit.
+    bool push(const void* data, size_t len, int64_t now_us) {
+        if (waiting_link_) expire(now_us);
+        if (frames_.size() >= limits_.max_frames || bytes_ + len > limits_.budget_bytes) {
+            ++stats_.rejected;
+            return false;
+        }
+        frames_.push_back(Frame{std::string(static_cast<const char*>(data), len), now_us});
+        bytes_ += len;
+        stats_.peak_bytes = std::max<uint32_t>(stats_.peak_bytes, static_cast<uint32_t>(bytes_));
+        return true;
+    }
+
+    // Notifies from the head frame while `notify(const uint8_t*, size_t)`
+    // accepts chunks of at most chunk_max bytes. Returns the delay in
+    // microseconds before the next attempt, or kIdle.
+    template <typename Notify>
+    int64_t drain(int64_t now_us, size_t chunk_max, Notify&& notify) {
+        if (waiting_link_) expire(now_us);  // subscribed again: skip the stale
+        while (!frames_.empty()) {
+            const std::string& data = frames_.front().data;
+            const size_t chunk = std::min(chunk_max, data.size() - offset_);
+            const Rc rc = notify(reinterpret_cast<const uint8_t*>(data.data()) + offset_, chunk);
+            if (rc == Rc::kNoLink) {
+                waiting_link_ = true;
+                expire(now_us);
+                return kIdle;
+            }
+            waiting_link_ = false;
+            if (rc == Rc::kBusy) {
+                ++stats_.busy;
+                if (!stalled_) {
+                    stalled_ = true;
+                    stalled_since_us_ = now_us;
+                }
+                if (now_us - stalled_since_us_ < limits_.stall_drop_us) {
+                    backoff_us_ = std::min(std::max(backoff_us_ * 2, limits_.backoff_min_us),
+                                           limits_.backoff_max_us);
+                    return backoff_us_;
+                }
+                ++stats_.stalled;
+                stalled_ = false;
+                pop();
+                continue;
+            }
+            stalled_ = false;
+            backoff_us_ = 0;
+            if (rc == Rc::kFail) {
+                ++stats_.failed;
+                pop();
+                continue;
+            }
+            offset_ += chunk;
+            stats_.bytes += static_cast<uint32_t>(chunk);
+            ++stats_.notifications;
+            if (offset_ >= data.size()) pop();
+        }
+        return kIdle;
+    }
+
+    void clear() {
+        stats_.cleared += static_cast<uint32_t>(frames_.size());
+        frames_.clear();
+        bytes_ = 0;
+        offset_ = 0;
+        stalled_ = false;
+        backoff_us_ = 0;
+        waiting_link_ = false;
+    }
+
+    bool empty() const { return frames_.empty(); }
+    size_t frames() const { return frames_.size(); }
+    size_t bytes() const { return bytes_; }
+    const Stats& stats() const { return stats_; }
+
+   private:
+    struct Frame {
+        std::string data;
+        int64_t queued_us;
+    };
+
+    void pop() {
+        bytes_ -= frames_.front().data.size();
+        frames_.pop_front();
+        offset_ = 0;
+    }
+
+    // Frames are in arrival order, so the stale ones are at the head.
+    void expire(int64_t now_us) {
+        while (!frames_.empty() && now_us - frames_.front().queued_us > limits_.stale_us) {
+            ++stats_.expired;
+            pop();
+        }
+    }
+
+    Limits limits_;
+    std::deque<Frame> frames_;
+    size_t bytes_ = 0;
+    size_t offset_ = 0;  // bytes of the head frame already notified
+    bool stalled_ = false;
+    int64_t stalled_since_us_ = 0;
+    uint32_t backoff_us_ = 0;
+    bool waiting_link_ = false;  // last attempt found no subscriber
+    Stats stats_;
+};
+
+}  // namespace bletx
@@ -27,12 +27,47 @@ int ble_uart_is_ready(void);
 // Returns 0 on last successful enable, or a negative/ESP_ERR_* code on failure.
 int ble_uart_last_err(void);
 
-// Send bytes via TX (Notify). Splits into MTU-sized chunks. Returns 0 on ok.
+// Queue bytes for TX (Notify). A background drain splits them into
+// MTU-sized notifications and waits out ENOMEM/congestion. Frames queued
+// before the phone subscribes are sent once it does; the queue is cleared
+// on disconnect. Returns 0 when queued, <0 if not initialised or full.
 int ble_uart_send(const uint8_t* data, size_t len);
 
 // Convenience: send a zero-terminated string.
 int ble_uart_send_str(const char* s);
 
+// RX framing the phone has used on this link: 0 = newline/JSON text only,
+// 1 = length/type/CRC binary frames (see ble_frame.hpp).
+int ble_uart_peer_frame_version(void);
+
+// Optional behaviour the phone announced by answering our hello with its own
+// ({"type":"hello","acks":["send_message"]}). Cleared on disconnect; 0 for
+// apps that never answer.
+#define BLE_UART_PEER_ACKS_SEND_MESSAGE 0x1u  // replies send_message_result
+uint32_t ble_uart_peer_caps(void);
+
+// Bulk transfer hint (history/contact sync). While at least one caller holds
+// it the link uses a short connection interval (and 2M PHY where the
+// controller supports it); the last end returns to the idle profile and
+// logs the transfer rate. Nests.
+void ble_uart_bulk_begin(void);
+void ble_uart_bulk_end(void);
+
+typedef struct {
+    uint32_t mtu;
+    uint32_t rx_bytes;
+    uint32_t tx_bytes;
+    uint32_t tx_notifications;
+    uint32_t tx_busy;        // ENOMEM/congestion backoffs
+    uint32_t tx_dropped;     // rejected, stalled out, expired unsent or cleared
+    uint32_t tx_queue_peak;  // bytes
+    uint32_t last_bulk_rx_bytes;
+    uint32_t last_bulk_tx_bytes;
+    uint32_t last_bulk_ms;
+} ble_uart_link_stats_t;
+
+void ble_uart_get_link_stats(ble_uart_link_stats_t* out);
+
 #ifdef __cplusplus
 }
 
@@ -43,4 +78,13 @@ std::string ble_uart_get_cached_pending();
 void ble_uart_clear_cached_pending();
 std::string ble_uart_get_cached_messages();
 void ble_uart_clear_cached_messages();
+
+// Holds the bulk throughput profile for the lifetime of the scope.
+class BleBulkScope {
+   public:
+    BleBulkScope() { ble_uart_bulk_begin(); }
+    ~BleBulkScope() { ble_uart_bulk_end(); }
+    BleBulkScope(const BleBulkScope&) = delete;
+    BleBulkScope& operator=(const BleBulkScope&) = delete;
+};
 #endif
@@ -0,0 +1,483 @@
+// ESP-NOW transport runtime: owns esp_now and the espnowrt::Link.
+//
+// The Wi-Fi task only copies raw frames into a fixed-size FreeRTOS queue;
+// the transport task feeds them to the link, sends ACKs and retransmits.
+// Completed messages wait in the link's preallocated inbox until the UI task
+// pops them.
+//
+// The task also runs discovery. It broadcasts a beacon every kBeaconMs and
+// answers new peers straight away. While no peer is known and the station
+// is not associated (so nothing pins the channel), it hops to a random
+// channel every kSweepDwellMs until it hears a beacon. A beacon heard
+// through adjacent-channel leakage names the real channel, and the task
+// moves there. Known peers are registered with esp_now on their channel,
+// and broadcasts go to them as acknowledged unicasts.
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#include "esp_log.h"
+#include "esp_now.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include "espnow_link.hpp"
+#include "espnow_peers.hpp"
+#include "espnow_runtime.h"
+
+static const char* TAG = "ESPNOW_RT";
+
+static_assert(ESPNOW_RT_MAX_MESSAGE == espnowrt::kMaxMessage, "keep in sync");
+static_assert(ESPNOW_RT_MAX_FLOOD_MESSAGE == espnowrt::kMaxFloodMessage, "keep in sync");
+static_assert(espnowrt::kFrameMax == ESP_NOW_MAX_DATA_LEN, "frame size");
+
+namespace {
+constexpr size_t kRxQueueDepth = 16;
+constexpr uint32_t kTaskStack = 3072;
+constexpr uint32_t kIdleWaitMs = 1000;
+constexpr int64_t kBeaconMs = 1000;
+constexpr int64_t kSweepDwellMs = 350;
+// A peer not heard for this long is not unicast to and does not hold the
+// channel; it stays in the table until evicted.
+constexpr int64_t kPeerFreshMs = 5000;
+// esp_now allows ESP_NOW_MAX_TOTAL_PEER_NUM; keep room for the broadcast
+// peer and explicit espnow_rt_send() targets.
+constexpr size_t kMaxPeers = ESP_NOW_MAX_TOTAL_PEER_NUM - 4;
+static_assert(kMaxPeers <= espnowrt::PeerTable::kMaxCapacity,
+              "peer table scratch smaller than kMaxPeers");
+constexpr uint8_t kMaxChannel = 13;
+// Past this many peers a single broadcast is cheaper than one unicast each
+// (and the link only has a few send slots).
+constexpr size_t kMaxUnicastFanout = 3;
+
+struct RawFrame {
+    espnowrt::Mac src;
+    int8_t rssi;
+    uint8_t len;
+    uint8_t data[espnowrt::kFrameMax];
+};
+
+struct State {
+    // Guards link; taken by the transport task and by send/recv callers.
+    std::mutex m;
+    std::unique_ptr<espnowrt::Link> link;
+    QueueHandle_t rx_q = nullptr;
+    TaskHandle_t task = nullptr;
+    volatile bool stopping = false;
+    // Bumped from the Wi-Fi task callbacks without taking m.
+    std::atomic<uint32_t> rx_dropped{0};
+    std::atomic<uint32_t> mac_fail{0};
+    std::atomic<uint32_t> mac_ok{0};
+    // Flood relay settings; survive stop/start.
+    bool relay = false;
+    uint8_t flood_ttl = 0;
+    // Discovery; guarded by m.
+    espnowrt::PeerTable peers{kMaxPeers};
+    espnowrt::Mac self{};
+    std::string short_id;
+    uint16_t beacon_seq = 0;
+    uint8_t channel = 0;
+    int64_t started_us = 0;
+    int64_t first_peer_us = -1;
+    int64_t next_beacon_us = 0;
+    int64_t next_hop_us = 0;
+    uint32_t beacons_tx = 0;
+    uint32_t beacons_rx = 0;
+    uint32_t channel_hops = 0;
+    uint32_t unicast_fanout = 0;
+} S;
+
+const espnowrt::Mac kBroadcast = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+bool radio_send(const espnowrt::Mac& dst, const uint8_t* frame, size_t len)
+{
+    const esp_err_t err = esp_now_send(dst.data(), frame, len);
+    if (err != ESP_OK && err != ESP_ERR_ESPNOW_NO_MEM) {
+        ESP_LOGW(TAG, "esp_now_send failed: %s", esp_err_to_name(err));
+    }
+    return err == ESP_OK;
+}
+
+void on_send(const uint8_t*, esp_now_send_status_t status)
+{
+    if (status == ESP_NOW_SEND_SUCCESS) {
+        ++S.mac_ok;
+    } else {
+        ++S.mac_fail;
+    }
+}
+
+// Wi-Fi task: copy and hand off, nothing else.
+void on_recv(const esp_now_recv_info_t* info, const uint8_t* data, int len)
+{
+    if (!info || !data || len <= 0 || len > (int)espnowrt::kFrameMax) return;
+    RawFrame f;
+    memcpy(f.src.data(), info->src_addr, espnowrt::kMacLen);
+    f.rssi = info->rx_ctrl ? static_cast<int8_t>(info->rx_ctrl->rssi) : 0;
+    f.len = static_cast<uint8_t>(len);
+    memcpy(f.data, data, len);
+    if (!S.rx_q || xQueueSend(S.rx_q, &f, 0) != pdTRUE) ++S.rx_dropped;
+}
+
+// The station owns the channel while associated.
+bool channel_fixed()
+{
+    wifi_ap_record_t ap;
+    return esp_wifi_sta_get_ap_info(&ap) == ESP_OK;
+}
+
+uint8_t current_channel()
+{
+    uint8_t primary = 0;
+    wifi_second_chan_t second = WIFI_SECOND_CHAN_NONE;
+    if (esp_wifi_get_channel(&primary, &second) != ESP_OK) return 0;
+    return primary;
+}
+
+bool set_channel(uint8_t ch)
+{
+    if (ch == 0 || ch > kMaxChannel || ch == S.channel || channel_fixed()) return false;
+    if (esp_wifi_set_channel(ch, WIFI_SECOND_CHAN_NONE) != ESP_OK) return false;
+    S.channel = ch;
+    ++S.channel_hops;
+    return true;
+}
+
+void send_beacon(int64_t now)
+{
+    uint8_t frame[espnowrt::kFrameMax];
+    espnowrt::Beacon b;
+    b.channel = S.channel;
+    b.flags = channel_fixed() ? espnowrt::kBeaconChannelFixed : 0;
+    b.short_id = S.short_id;
+    const size_t len = espnowrt::encode_beacon(S.beacon_seq++, b, frame);
+    if (radio_send(kBroadcast, frame, len)) ++S.beacons_tx;
+    S.next_beacon_us = now + kBeaconMs * 1000;
+}
+
+bool has_fresh_peer(int64_t now)
+{
+    espnowrt::Mac one;
+    return S.peers.fresh(now, kPeerFreshMs * 1000, S.channel, &one, 1) > 0;
+}
+
+void register_peer(const espnowrt::Mac& mac, uint8_t channel)
+{
+    esp_now_peer_info_t peer = {};
+    memcpy(peer.peer_addr, mac.data(), espnowrt::kMacLen);
+    peer.channel = channel;
+    peer.ifidx = WIFI_IF_STA;
+    peer.encrypt = false;
+    esp_err_t err = esp_now_is_peer_exist(peer.peer_addr) ? esp_now_mod_peer(&peer)
+                                                           : esp_now_add_peer(&peer);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "peer " MACSTR ": %s", MAC2STR(peer.peer_addr), esp_err_to_name(err));
+    }
+}
+
+void on_beacon(const RawFrame& f, int64_t now)
+{
+    espnowrt::Beacon b;
+    if (!espnowrt::parse_beacon(f.data, f.len, &b)) return;
+    ++S.beacons_rx;
+    const uint8_t old_channel = [&] {
+        const auto* p = S.peers.find(f.src);
+        return p ? p->channel : uint8_t(0);
+    }();
+    const auto u = S.peers.on_beacon(f.src, b, f.rssi, now);
+    if (u.evicted) esp_now_del_peer(u.evicted_mac.data());
+    if (u.added || old_channel != b.channel) register_peer(f.src, b.channel);
+    if (u.added) {
+        if (S.first_peer_us < 0) {
+            S.first_peer_us = now;
+            ESP_LOGI(TAG, "first peer %s after %lld ms (ch %u, rssi %d)", u.peer->short_id,
+                     (long long)((now - S.started_us) / 1000), (unsigned)b.channel,
+                     (int)f.rssi);
+        }
+        // Answer right away so the other side does not wait a full period.
+        send_beacon(now);
+    }
+    // Heard through leakage from a neighbouring channel. Follow a peer
+    // whose station pins its channel; between two free nodes the lower MAC
+    // stays put so they do not swap channels forever.
+    if (b.channel != S.channel &&
+        ((b.flags & espnowrt::kBeaconChannelFixed) || f.src < S.self)) {
+        if (set_channel(b.channel)) send_beacon(now);
+    }
+}
+
+void discover(int64_t now)
+{
+    if (!has_fresh_peer(now) && !channel_fixed() && now >= S.next_hop_us) {
+        S.next_hop_us = now + kSweepDwellMs * 1000;
+        if (set_channel(static_cast<uint8_t>(1 + esp_random() % kMaxChannel))) {
+            send_beacon(now);
+        }
+    } else {
+        S.channel = current_channel();
+    }
+    if (now >= S.next_beacon_us) send_beacon(now);
+}
+
+void handle_frame(const RawFrame& f, int64_t now)
+{
+    // len 0 is the wake-up posted by espnow_rt_stop.
+    if (f.len == 0) return;
+    if (espnowrt::is_beacon(f.data, f.len)) {
+        on_beacon(f, now);
+        return;
+    }
+    S.peers.touch(f.src, f.rssi, now);
+    S.link->on_frame(f.src, f.data, f.len, now);
+}
+
+void transport_task(void*)
+{
+    RawFrame f;
+    while (!S.stopping) {
+        TickType_t wait = pdMS_TO_TICKS(kIdleWaitMs);
+        {
+            std::lock_guard<std::mutex> lk(S.m);
+            const int64_t next = std::min({S.link->next_deadline(), S.next_beacon_us,
+                                           has_fresh_peer(esp_timer_get_time())
+                                               ? INT64_MAX
+                                               : S.next_hop_us});
+            const int64_t due = next - esp_timer_get_time();
+            if (due < int64_t(kIdleWaitMs) * 1000) {
+                wait = std::max<TickType_t>(pdMS_TO_TICKS(due > 0 ? (due + 999) / 1000 : 0), 1);
+            }
+        }
+        const bool got = xQueueReceive(S.rx_q, &f, wait) == pdTRUE;
+        std::lock_guard<std::mutex> lk(S.m);
+        const int64_t now = esp_timer_get_time();
+        if (got) handle_frame(f, now);
+        while (xQueueReceive(S.rx_q, &f, 0) == pdTRUE) handle_frame(f, now);
+        discover(now);
+        S.link->pump(now);
+    }
+    S.task = nullptr;
+    vTaskDelete(nullptr);
+}
+
+}  // namespace
+
+int espnow_rt_start(void)
+{
+    if (S.task) return 0;
+    esp_err_t err = esp_now_init();
+    if (err != ESP_OK && err != ESP_ERR_ESPNOW_EXIST) {
+        ESP_LOGE(TAG, "esp_now_init failed: %s", esp_err_to_name(err));
+        return -1;
+    }
+    esp_now_register_send_cb(on_send);
+    esp_now_register_recv_cb(on_recv);
+
+    esp_now_peer_info_t peer = {};
+    memcpy(peer.peer_addr, kBroadcast.data(), espnowrt::kMacLen);
+    peer.channel = 0;
+    peer.ifidx = WIFI_IF_STA;
+    peer.encrypt = false;
+    err = esp_now_add_peer(&peer);
+    if (err == ESP_ERR_ESPNOW_EXIST) err = esp_now_mod_peer(&peer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "broadcast peer: %s", esp_err_to_name(err));
+        return -1;
+    }
+
+    if (!S.rx_q) S.rx_q = xQueueCreate(kRxQueueDepth, sizeof(RawFrame));
+    if (!S.rx_q) return -2;
+    {
+        std::lock_guard<std::mutex> lk(S.m);
+        if (!S.link) {
+            espnowrt::Link::Config cfg;
+            cfg.first_seq = static_cast<uint16_t>(esp_random());
+            cfg.seed = esp_random();
+            esp_wifi_get_mac(WIFI_IF_STA, cfg.self.data());
+            S.self = cfg.self;
+            cfg.relay = S.relay;
+            cfg.flood_ttl = S.flood_ttl;
+            S.link = std::make_unique<espnowrt::Link>(radio_send, cfg);
+        }
+    }
+    S.started_us = esp_timer_get_time();
+    S.first_peer_us = -1;
+    S.channel = current_channel();
+    S.next_beacon_us = S.started_us;
+    S.next_hop_us = S.started_us + kSweepDwellMs * 1000;
+    S.stopping = false;
+    if (xTaskCreate(&transport_task, "espnow_rt", kTaskStack, nullptr, 5, &S.task) != pdPASS) {
+        S.task = nullptr;
+        ESP_LOGE(TAG, "transport task create failed");
+        return -2;
+    }
+    return 0;
+}
+
+void espnow_rt_stop(void)
+{
+    if (!S.task) return;
+    S.stopping = true;
+    RawFrame wake = {};
+    xQueueSend(S.rx_q, &wake, 0);
+    while (S.task) vTaskDelay(pdMS_TO_TICKS(10));
+    esp_now_unregister_recv_cb();
+    esp_now_unregister_send_cb();
+    esp_now_deinit();
+    xQueueReset(S.rx_q);
+    const auto& st = S.link->stats();
+    ESP_LOGI(TAG, "stopped: sent=%u delivered=%u failed=%u retx=%u rx=%u dup=%u bad=%u dropped=%u",
+             (unsigned)st.sent, (unsigned)st.delivered, (unsigned)st.failed,
+             (unsigned)st.retransmits, (unsigned)st.received, (unsigned)st.duplicates,
+             (unsigned)st.bad_frames, (unsigned)S.rx_dropped);
+    ESP_LOGI(TAG, "relay: forwarded=%u suppressed=%u dropped=%u", (unsigned)st.relayed,
+             (unsigned)st.relay_suppressed, (unsigned)st.relay_dropped);
+    // Delivery: end-to-end ACKs for unicast, plus what the MAC layer saw.
+    ESP_LOGI(TAG, "peers=%u discovery=%lldms beacons tx=%u rx=%u hops=%u acked=%u/%u mac ok=%u fail=%u",
+             (unsigned)S.peers.size(),
+             (long long)(S.first_peer_us < 0 ? -1 : (S.first_peer_us - S.started_us) / 1000),
+             (unsigned)S.beacons_tx, (unsigned)S.beacons_rx, (unsigned)S.channel_hops,
+             (unsigned)st.acked, (unsigned)(st.acked + st.failed), (unsigned)S.mac_ok,
+             (unsigned)S.mac_fail);
+    std::lock_guard<std::mutex> lk(S.m);
+    S.link.reset();
+    // esp_now_deinit dropped the registrations; rediscover on next start.
+    S.peers = espnowrt::PeerTable(kMaxPeers);
+}
+
+void espnow_rt_set_relay(bool enable, uint8_t ttl)
+{
+    std::lock_guard<std::mutex> lk(S.m);
+    S.relay = enable;
+    S.flood_ttl = enable ? ttl : 0;
+    if (S.link) S.link->set_flood(S.relay, S.flood_ttl);
+    ESP_LOGI(TAG, "relay %s ttl=%u", enable ? "on" : "off", (unsigned)S.flood_ttl);
+}
+
+void espnow_rt_set_identity(const char* short_id)
+{
+    std::lock_guard<std::mutex> lk(S.m);
+    S.short_id = short_id ? short_id : "";
+    if (S.short_id.size() > espnowrt::kShortIdMax) S.short_id.resize(espnowrt::kShortIdMax);
+}
+
+// Unicast to each fresh peer on our channel; -4 when broadcast fits better.
+// All or nothing: a partial fan-out would make the caller's retry resend to
+// the peers already queued, under new sequence numbers they cannot dedupe.
+static int send_to_peers(const uint8_t* data, size_t len, int64_t now)
+{
+    espnowrt::Mac to[kMaxUnicastFanout + 1];
+    const size_t n = S.peers.fresh(now, kPeerFreshMs * 1000, S.channel, to,
+                                   kMaxUnicastFanout + 1);
+    if (n == 0 || n > kMaxUnicastFanout) return -4;
+    if (len > espnowrt::kMaxMessage) return -2;
+    // S.m is held, so the slots counted here are still free below.
+    if (S.link->free_tx_slots() < n) return -3;
+    for (size_t i = 0; i < n; ++i) {
+        S.link->send(to[i], data, len, now);
+    }
+    ++S.unicast_fanout;
+    return 0;
+}
+
+int espnow_rt_send(const uint8_t* mac, const void* data, size_t len)
+{
+    if (!data || len == 0) return -1;
+    if (!mac) {
+        std::lock_guard<std::mutex> lk(S.m);
+        if (!S.link) return -1;
+        // Flooding needs broadcasts so relays can pick them up.
+        if (!S.relay) {
+            const int rc = send_to_peers(static_cast<const uint8_t*>(data), len,
+                                         esp_timer_get_time());
+            if (rc != -4) return rc;
+        }
+    }
+    espnowrt::Mac dst = kBroadcast;
+    if (mac) memcpy(dst.data(), mac, espnowrt::kMacLen);
+    if (mac && !espnowrt::is_broadcast(dst) && !esp_now_is_peer_exist(mac)) {
+        esp_now_peer_info_t peer = {};
+        memcpy(peer.peer_addr, mac, espnowrt::kMacLen);
+        peer.ifidx = WIFI_IF_STA;
+        if (esp_now_add_peer(&peer) != ESP_OK) return -1;
+    }
+    std::lock_guard<std::mutex> lk(S.m);
+    if (!S.link) return -1;
+    switch (S.link->send(dst, static_cast<const uint8_t*>(data), len, esp_timer_get_time())) {
+        case espnowrt::Link::Send::kQueued:
+            return 0;
+        case espnowrt::Link::Send::kTooLarge:
+            return -2;
+        case espnowrt::Link::Send::kBusy:
+            return -3;
+    }
+    return -1;
+}
+
+size_t espnow_rt_recv(uint8_t* from_mac, void* out, size_t out_cap)
+{
+    // Static: a Message is ~2 KB, too large for UI task stacks.
+    static espnowrt::Link::Message msg;
+    std::lock_guard<std::mutex> lk(S.m);
+    if (!S.link || !S.link->pop(&msg)) return 0;
+    if (from_mac) memcpy(from_mac, msg.from.data(), espnowrt::kMacLen);
+    const size_t n = msg.len < out_cap ? msg.len : out_cap;
+    if (out && n) memcpy(out, msg.data, n);
+    return n;
+}
+
+void espnow_rt_get_stats(espnow_rt_stats_t* out)
+{
+    if (!out) return;
+    *out = {};
+    std::lock_guard<std::mutex> lk(S.m);
+    if (S.link) {
+        const auto& st = S.link->stats();
+        out->sent = st.sent;
+        out->delivered = st.delivered;
+        out->failed = st.failed;
+        out->busy = st.busy;
+        out->retransmits = st.retransmits;
+        out->received = st.received;
+        out->duplicates = st.duplicates;
+        out->bad_frames = st.bad_frames;
+        out->relayed = st.relayed;
+        out->relay_suppressed = st.relay_suppressed;
+        out->acked = st.acked;
+    }
+    out->rx_dropped = S.rx_dropped;
+    out->mac_ok = S.mac_ok;
+    out->mac_fail = S.mac_fail;
+    out->peers = static_cast<uint32_t>(S.peers.size());
+    out->channel = S.channel;
+    out->discovery_ms = S.first_peer_us < 0
+                            ? UINT32_MAX
+                            : static_cast<uint32_t>((S.first_peer_us - S.started_us) / 1000);
+    out->beacons_tx = S.beacons_tx;
+    out->beacons_rx = S.beacons_rx;
+    out->channel_hops = S.channel_hops;
+    out->unicast_fanout = S.unicast_fanout;
+}
+
+size_t espnow_rt_get_peers(espnow_rt_peer_t* out, size_t cap)
+{
+    std::lock_guard<std::mutex> lk(S.m);
+    const int64_t now = esp_timer_get_time();
+    size_t n = 0;
+    for (const auto& p : S.peers.peers()) {
+        if (!p.used || n == cap) continue;
+        espnow_rt_peer_t& o = out[n++];
+        memcpy(o.mac, p.mac.data(), espnowrt::kMacLen);
+        memcpy(o.short_id, p.short_id, sizeof(o.short_id));
+        o.channel = p.channel;
+        o.rssi = p.rssi;
+        o.age_ms = static_cast<uint32_t>((now - p.last_seen_us) / 1000);
+    }
+    return n;
+}
@@ -5,11 +5,14 @@
 
 #include <string>
 #include <cstring>
+#include <strings.h>
 #include <stdlib.h>
 #include <mutex>
 #include <algorithm>
+#include <array>
 
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_http_client.h"
 #include "esp_tls.h"
 #if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
@@ -20,6 +23,8 @@
 
 #include <ArduinoJson.h>
 
+#include "tls_session_cache.hpp"
+
 namespace chatapi {
 
 static const char* CHAT_TAG = "ChatAPI";
@@ -316,18 +321,26 @@ class ChatApiClient {
         return ESP_OK;
     }
 
+    // client_message_id identifies the outbox entry so the phone relay and a
+    // server that honours it can drop a repeat; ChatApiClient itself does not
+    // resend this POST after it may have been delivered.
     esp_err_t send_message(const std::string& receiver_identifier,
                            const std::string& content,
-                           std::string* out_response = nullptr) {
+                           std::string* out_response = nullptr,
+                           int* out_status = nullptr,
+                           const std::string& client_message_id = std::string()) {
         if (!has_token()) return ESP_ERR_INVALID_STATE;
         StaticJsonDocument<512> body;
         body["receiver_id"] = receiver_identifier;
         body["content"] = content;
+        if (!client_message_id.empty()) {
+            body["client_message_id"] = client_message_id;
+        }
         std::string payload;
         serializeJson(body, payload);
         std::string resp;
         auto err = perform_request("POST", "/api/messages/send", payload, resp,
-                                   /*auth*/ true, nullptr);
+                                   /*auth*/ true, out_status);
         if (err == ESP_OK && out_response) *out_response = resp;
         return err;
     }
@@ -344,12 +357,55 @@ class ChatApiClient {
                                out_status);
     }
 
+    // Incremental variant: only messages newer than since_id, and a 304 when
+    // the server's ETag still matches. Either may be empty.
+    esp_err_t get_messages_since(const std::string& friend_identifier,
+                                 int limit, const std::string& since_id,
+                                 const std::string& etag,
+                                 std::string& out_response, int* out_status,
+                                 std::string* out_etag) {
+        if (!has_token()) return ESP_ERR_INVALID_STATE;
+        if (limit < 1 || limit > 100) limit = 50;
+        std::string path = "/api/friends/" + friend_identifier +
+                           "/messages?limit=" + std::to_string(limit);
+        if (!since_id.empty()) path += "&since_id=" + url_encode(since_id);
+        return perform_request("GET", path.c_str(), "", out_response,
+                               /*auth*/ true, out_status, etag, out_etag);
+    }
+
     esp_err_t get_unread_count(std::string& out_response) {
         if (!has_token()) return ESP_ERR_INVALID_STATE;
         return perform_request("GET", "/api/messages/unread/count", "", out_response,
                                /*auth*/ true, nullptr);
     }
 
+    // Deep-sleep wake variant: bypasses the connection pool (which does not
+    // survive sleep) and resumes the TLS session cached in RTC memory.
+    esp_err_t get_unread_count_on_wake(std::string& out_response,
+                                       int* out_status = nullptr) {
+        if (!has_token()) return ESP_ERR_INVALID_STATE;
+        auto ctx = snapshot();
+        if (ctx.scheme != "https") {
+            return perform_request("GET", "/api/messages/unread/count", "",
+                                   out_response, /*auth*/ true, out_status);
+        }
+        std::lock_guard<std::mutex> req_lock(request_mutex_);
+        tls_resume::HandshakeInfo info;
+        int status = 0;
+        esp_err_t err = tls_resume::https_get(
+            ctx.host, ctx.port, "/api/messages/unread/count",
+            std::string("Bearer ") + ctx.token, out_response, &status, &info,
+            request_timeout_ms_);
+        tls_resume::record_wake(info);
+        if (err != ESP_OK) {
+            ESP_LOGE(CHAT_TAG, "wake GET unread/count failed: %s",
+                     esp_err_to_name(err));
+            return err;
+        }
+        if (out_status) *out_status = status;
+        return ESP_OK;
+    }
+
     esp_err_t send_friend_request(const std::string& receiver_identifier,
                                   std::string* out_response, int* out_status) {
         if (!has_token()) return ESP_ERR_INVALID_STATE;
@@ -383,10 +439,12 @@ class ChatApiClient {
         return perform_request("PUT", path.c_str(), "", resp, /*auth*/ true, nullptr);
     }
 
-    esp_err_t get_friends(std::string& out_response, int* out_status = nullptr) {
+    esp_err_t get_friends(std::string& out_response, int* out_status = nullptr,
+                          const std::string& etag = std::string(),
+                          std::string* out_etag = nullptr) {
         if (!has_token()) return ESP_ERR_INVALID_STATE;
         return perform_request("GET", "/api/friends", "", out_response,
-                               /*auth*/ true, out_status);
+                               /*auth*/ true, out_status, etag, out_etag);
     }
 
     esp_err_t get_pending_requests(std::string& out_response,
@@ -426,6 +484,28 @@ class ChatApiClient {
         return ESP_OK;
     }
 
+    struct PoolStats {
+        uint32_t requests = 0;
+        uint32_t handshakes = 0;
+        uint32_t reused = 0;
+        uint32_t stale_recoveries = 0;
+        // Pooled socket failed after a non-idempotent request may have been
+        // sent; surfaced to the caller instead of resent.
+        uint32_t unsafe_not_retried = 0;
+    };
+
+    PoolStats pool_stats() const {
+        std::lock_guard<std::mutex> lock(request_mutex_);
+        return pool_stats_;
+    }
+
+    // Close every pooled connection, e.g. before deep sleep or after the
+    // network interface went down.
+    void close_idle_connections() {
+        std::lock_guard<std::mutex> lock(request_mutex_);
+        for (auto& conn : pool_) close_connection(conn);
+    }
+
    private:
     struct EndpointSnapshot {
         std::string host;
@@ -441,15 +521,20 @@ class ChatApiClient {
 
     struct ResponseBuffer {
         std::string* out;
+        std::string* etag = nullptr;
     };
 
     static esp_err_t _handle_events(esp_http_client_event_t* evt) {
         if (!evt) return ESP_OK;
+        auto* buf = static_cast<ResponseBuffer*>(evt->user_data);
         if (evt->event_id == HTTP_EVENT_ON_DATA && evt->data && evt->data_len > 0) {
-            auto* buf = static_cast<ResponseBuffer*>(evt->user_data);
             if (buf && buf->out) {
                 buf->out->append(static_cast<const char*>(evt->data), evt->data_len);
             }
+        } else if (evt->event_id == HTTP_EVENT_ON_HEADER && buf && buf->etag &&
+                   evt->header_key && evt->header_value &&
+                   strcasecmp(evt->header_key, "ETag") == 0) {
+            *buf->etag = evt->header_value;
         }
         return ESP_OK;
     }
@@ -486,68 +571,251 @@ class ChatApiClient {
         }
     }
 
-    esp_err_t perform_request(const char* method, const char* path,
-                              const std::string& body, std::string& out_resp,
-                              bool auth, int* out_status) {
-        std::lock_guard<std::mutex> req_lock(request_mutex_);
-        auto ctx = snapshot();
-        std::string host = ctx.host;
-        int port = ctx.port;
-        std::string scheme = ctx.scheme;
-        std::string token = ctx.token;
+    // One long-lived esp_http_client per scheme://host:port. Reusing the
+    // handle keeps the socket and TLS session open between requests, so only
+    // the first request to an endpoint pays the TCP + TLS handshake.
+    struct PooledConnection {
+        std::string key;
+        esp_http_client_handle_t client = nullptr;
+        ResponseBuffer sink{nullptr};
+        int64_t last_used_us = 0;
+        uint32_t requests = 0;
+    };
+
+    static constexpr size_t kMaxPooledConnections = 2;
+    static constexpr int64_t kPoolIdleTimeoutUs = 30LL * 1000LL * 1000LL;
+    // A non-idempotent request cannot be resent if its pooled socket turns
+    // out to be dead, so it only reuses one that was active this recently.
+    static constexpr int64_t kUnsafeReuseIdleUs = 5LL * 1000LL * 1000LL;
+
+    // Failed before the request left the device: resending is safe for any
+    // method.
+    static bool is_unsent_request_error(esp_err_t err) {
+        return err == ESP_ERR_HTTP_CONNECT || err == ESP_ERR_HTTP_WRITE_DATA;
+    }
+
+    // Failed while waiting for the response. On a pooled socket this is
+    // usually the server having closed it while idle, but the request may
+    // already have been processed, so only idempotent requests are resent.
+    static bool is_stale_response_error(esp_err_t err) {
+        return err == ESP_ERR_HTTP_FETCH_HEADER || err == ESP_ERR_HTTP_EAGAIN ||
+               err == ESP_ERR_HTTP_CONNECTION_CLOSED || err == ESP_FAIL;
+    }
+
+    // Only GETs are resent once the request may have reached the server.
+    // The API does not document deduplication for any PUT or POST
+    // (client_message_id is for the outbox and the phone relay), so those
+    // surface the error and the caller decides whether to retry.
+    static bool is_idempotent(const char* method) {
+        return strcmp(method, "GET") == 0;
+    }
 
+    static void close_connection(PooledConnection& conn) {
+        if (conn.client) {
+            esp_http_client_cleanup(conn.client);
+            conn.client = nullptr;
+        }
+    }
+
+    void evict_idle_connections_locked(int64_t now_us) {
+        for (auto& conn : pool_) {
+            if (conn.client && now_us - conn.last_used_us >= kPoolIdleTimeoutUs) {
+                ESP_LOGD(CHAT_TAG, "pool: evict idle %s (requests=%u)",
+                         conn.key.c_str(), static_cast<unsigned>(conn.requests));
+                close_connection(conn);
+            }
+        }
+    }
+
+    esp_http_client_handle_t open_connection(const EndpointSnapshot& ctx,
+                                             const std::string& url,
+                                             ResponseBuffer* sink) {
         esp_http_client_config_t cfg = {};
-        ResponseBuffer resp_buf{&out_resp};
-        std::string url = scheme + "://" + host + ":" + std::to_string(port) + path;
         cfg.url = url.c_str();
         cfg.event_handler = _handle_events;
-        cfg.user_data = &resp_buf;
-        cfg.transport_type = (scheme == "https") ? HTTP_TRANSPORT_OVER_SSL : HTTP_TRANSPORT_OVER_TCP;
+        cfg.user_data = sink;
+        cfg.transport_type = (ctx.scheme == "https") ? HTTP_TRANSPORT_OVER_SSL
+                                                     : HTTP_TRANSPORT_OVER_TCP;
         cfg.timeout_ms = request_timeout_ms_;
-        cfg.keep_alive_enable = false;
+        // TCP keep-alive probes let a dead pooled socket fail fast instead of
+        // stalling the next request for the full timeout.
+        cfg.keep_alive_enable = true;
+        cfg.keep_alive_idle = 5;
+        cfg.keep_alive_interval = 5;
+        cfg.keep_alive_count = 3;
         cfg.buffer_size = 1024;
         cfg.buffer_size_tx = 512;
-        if (is_ipv4_literal(host)) {
+        if (is_ipv4_literal(ctx.host)) {
             cfg.skip_cert_common_name_check = true;
         }
 #if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
-        if (scheme == "https") cfg.crt_bundle_attach = esp_crt_bundle_attach;
+        if (ctx.scheme == "https") cfg.crt_bundle_attach = esp_crt_bundle_attach;
 #else
         extern const unsigned char ca_cert_pem_start[] asm("_binary_ca_cert_pem_start");
         extern const unsigned char ca_cert_pem_end[]   asm("_binary_ca_cert_pem_end");
-        if (scheme == "https") cfg.cert_pem = (const char*)ca_cert_pem_start;
+        if (ctx.scheme == "https") cfg.cert_pem = (const char*)ca_cert_pem_start;
 #endif
-
-        ESP_LOGI(CHAT_TAG, "HTTP %s %s", method, url.c_str());
-
-        esp_http_client_handle_t client = esp_http_client_init(&cfg);
-        if (!client) return ESP_FAIL;
-
+        return esp_http_client_init(&cfg);
+    }
+
+    PooledConnection* acquire_connection_locked(const EndpointSnapshot& ctx,
+                                                const std::string& key,
+                                                const std::string& url,
+                                                bool* out_reused) {
+        const int64_t now_us = esp_timer_get_time();
+        evict_idle_connections_locked(now_us);
+        PooledConnection* slot = nullptr;
+        for (auto& conn : pool_) {
+            if (!conn.client || conn.key != key) continue;
+            if (esp_http_client_set_url(conn.client, url.c_str()) == ESP_OK) {
+                conn.last_used_us = now_us;
+                *out_reused = true;
+                return &conn;
+            }
+            // The pooled handle rejected the URL; rebuild it in place.
+            close_connection(conn);
+            slot = &conn;
+            break;
+        }
+        if (!slot) {
+            for (auto& conn : pool_) {
+                if (!conn.client) {
+                    slot = &conn;
+                    break;
+                }
+            }
+        }
+        if (!slot) {
+            // Pool is full: recycle the least recently used endpoint.
+            slot = &*std::min_element(
+                pool_.begin(), pool_.end(),
+                [](const PooledConnection& a, const PooledConnection& b) {
+                    return a.last_used_us < b.last_used_us;
+                });
+            close_connection(*slot);
+        }
+        slot->key = key;
+        slot->requests = 0;
+        slot->last_used_us = now_us;
+        slot->client = open_connection(ctx, url, &slot->sink);
+        if (!slot->client) return nullptr;
+        *out_reused = false;
+        ++pool_stats_.handshakes;
+        return slot;
+    }
+
+    static void prepare_request(esp_http_client_handle_t client,
+                                const char* method, const std::string& body,
+                                const std::string& authz,
+                                const std::string& if_none_match) {
         esp_http_client_method_t httpMethod = HTTP_METHOD_GET;
         if (strcmp(method, "POST") == 0) httpMethod = HTTP_METHOD_POST;
         else if (strcmp(method, "PUT") == 0) httpMethod = HTTP_METHOD_PUT;
         esp_http_client_set_method(client, httpMethod);
 
-        std::string authz;
-        if (auth && !token.empty()) {
-            authz = std::string("Bearer ") + token;
+        // Headers persist on a reused handle; reset them for every request.
+        if (!authz.empty()) {
             esp_http_client_set_header(client, "Authorization", authz.c_str());
+        } else {
+            esp_http_client_delete_header(client, "Authorization");
+        }
+        if (!if_none_match.empty()) {
+            esp_http_client_set_header(client, "If-None-Match",
+                                       if_none_match.c_str());
+        } else {
+            esp_http_client_delete_header(client, "If-None-Match");
         }
         if (!body.empty()) {
             esp_http_client_set_header(client, "Content-Type", "application/json");
             esp_http_client_set_post_field(client, body.c_str(), body.size());
+        } else {
+            esp_http_client_delete_header(client, "Content-Type");
+            esp_http_client_set_post_field(client, nullptr, 0);
+        }
+    }
+
+    // if_none_match / out_etag enable conditional GETs: a 304 comes back as
+    // ESP_OK with status 304 and an empty body.
+    esp_err_t perform_request(const char* method, const char* path,
+                              const std::string& body, std::string& out_resp,
+                              bool auth, int* out_status,
+                              const std::string& if_none_match = std::string(),
+                              std::string* out_etag = nullptr) {
+        std::lock_guard<std::mutex> req_lock(request_mutex_);
+        auto ctx = snapshot();
+        const std::string key =
+            ctx.scheme + "://" + ctx.host + ":" + std::to_string(ctx.port);
+        std::string url = key + path;
+
+        ESP_LOGI(CHAT_TAG, "HTTP %s %s", method, url.c_str());
+
+        std::string authz;
+        if (auth && !ctx.token.empty()) {
+            authz = std::string("Bearer ") + ctx.token;
         }
 
-        esp_err_t err = esp_http_client_perform(client);
+        const int64_t started_us = esp_timer_get_time();
+        bool reused = false;
+        PooledConnection* conn = nullptr;
+        esp_err_t err = ESP_FAIL;
+        const bool idempotent = is_idempotent(method);
+        // A reused socket may have been closed by the server while idle; in
+        // that case drop it and retry once on a fresh connection, unless the
+        // request may have reached the server and is not safe to repeat.
+        if (!idempotent) {
+            const int64_t now_us = esp_timer_get_time();
+            for (auto& pooled : pool_) {
+                if (pooled.client && pooled.key == key &&
+                    now_us - pooled.last_used_us >= kUnsafeReuseIdleUs) {
+                    close_connection(pooled);
+                }
+            }
+        }
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            conn = acquire_connection_locked(ctx, key, url, &reused);
+            if (!conn) return ESP_FAIL;
+            out_resp.clear();
+            if (out_etag) out_etag->clear();
+            conn->sink.out = &out_resp;
+            conn->sink.etag = out_etag;
+            prepare_request(conn->client, method, body, authz, if_none_match);
+            err = esp_http_client_perform(conn->client);
+            if (err == ESP_OK) break;
+            close_connection(*conn);
+            conn = nullptr;
+            if (!reused) break;
+            if (!is_unsent_request_error(err) &&
+                !(idempotent && is_stale_response_error(err))) {
+                if (is_stale_response_error(err)) {
+                    ++pool_stats_.unsafe_not_retried;
+                    ESP_LOGW(CHAT_TAG,
+                             "HTTP %s %s: pooled socket failed after send (%s); "
+                             "not resending a non-idempotent request",
+                             method, path, esp_err_to_name(err));
+                }
+                break;
+            }
+            ++pool_stats_.stale_recoveries;
+            ESP_LOGW(CHAT_TAG, "HTTP %s %s: pooled socket stale (%s); reconnecting",
+                     method, path, esp_err_to_name(err));
+        }
         if (err != ESP_OK) {
             ESP_LOGE(CHAT_TAG, "HTTP perform %s %s failed: %s", method, path,
                      esp_err_to_name(err));
-            esp_http_client_cleanup(client);
             return err;
         }
 
-        int status = esp_http_client_get_status_code(client);
-        int content_len = esp_http_client_get_content_length(client);
+        conn->sink.out = nullptr;
+        conn->sink.etag = nullptr;
+        ++conn->requests;
+        ++pool_stats_.requests;
+        if (reused) ++pool_stats_.reused;
+        conn->last_used_us = esp_timer_get_time();
+
+        int status = esp_http_client_get_status_code(conn->client);
+        int content_len = esp_http_client_get_content_length(conn->client);
+        const int elapsed_ms =
+            static_cast<int>((conn->last_used_us - started_us) / 1000);
         if (status >= 400) {
             std::string preview = out_resp.substr(0, std::min<size_t>(out_resp.size(), 160));
             ESP_LOGE(CHAT_TAG,
@@ -558,8 +826,13 @@ class ChatApiClient {
                      "HTTP %s %s status=%d len=%d body_len=%d",
                      method, path, status, content_len, (int)out_resp.size());
         }
+        ESP_LOGI(CHAT_TAG,
+                 "HTTP %s %s %dms %s (requests=%u handshakes=%u reused=%u)",
+                 method, path, elapsed_ms, reused ? "reused" : "new",
+                 static_cast<unsigned>(pool_stats_.requests),
+                 static_cast<unsigned>(pool_stats_.handshakes),
+                 static_cast<unsigned>(pool_stats_.reused));
 
-        esp_http_client_cleanup(client);
         if (out_status) *out_status = status;
         return ESP_OK;
     }
@@ -574,6 +847,8 @@ class ChatApiClient {
     std::string default_host_;
     int default_port_ = 8080;
     int request_timeout_ms_ = 15000;
+    std::array<PooledConnection, kMaxPooledConnections> pool_;
+    PoolStats pool_stats_;
 
     static bool is_ipv4_literal(const std::string& host) {
         if (host.empty()) return false;
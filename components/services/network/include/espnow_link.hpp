@@ -0,0 +1,625 @@
+// Reliable message layer on top of raw ESP-NOW frames.
+//
+// ESP-NOW carries at most 250 bytes per frame and gives no end-to-end
+// guarantee, so every frame here starts with a small header:
+//
+//   0    magic 0x4D
+//   1    version (high nibble) | kind (low nibble)
+//   2    flags (kFlagAckReq)
+//   3    fragment index
+//   4    fragment count
+//   5-6  message sequence, u16 LE
+//
+// Flooded broadcasts (kFlagFlood) extend the header so relays can forward
+// them without losing the sender:
+//
+//   7     TTL, hops left including this one
+//   8-13  originating MAC
+//
+// A message is split into up to kMaxFragments fragments. Unicast messages ask
+// for acknowledgement: the receiver answers every data frame with a bitmap of
+// the fragments it holds and the sender retransmits only the missing ones
+// after the ACK timeout. Broadcasts are sent once, best effort. Completed
+// (peer, seq) pairs are remembered per peer so retransmits and repeated
+// broadcasts are not delivered twice.
+//
+// In relay mode every flooded frame not seen before is rebroadcast once with
+// TTL - 1 after a random delay of up to relay_jitter_us, so neighbours that
+// heard the same frame do not all transmit at the same instant. A relay
+// that hears relay_suppress copies while waiting drops its own: the area
+// is already covered. Recently seen (origin, seq, fragment) triples live in
+// a bounded ring.
+//
+// All buffers are allocated once in the constructor. The class does no
+// locking and never reads a clock: the owner passes in the time and the
+// frame sender, which keeps it runnable on the host against a simulated link.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+namespace espnowrt {
+
+constexpr size_t kFrameMax = 250;  // ESP_NOW_MAX_DATA_LEN
+constexpr size_t kHeaderBytes = 7;
+constexpr size_t kFragPayload = kFrameMax - kHeaderBytes;
+constexpr size_t kMaxFragments = 8;
+constexpr size_t kMaxMessage = kFragPayload * kMaxFragments;
+constexpr size_t kFloodHeaderBytes = kHeaderBytes + 7;
+constexpr size_t kFloodFragPayload = kFrameMax - kFloodHeaderBytes;
+constexpr size_t kMaxFloodMessage = kFloodFragPayload * kMaxFragments;
+constexpr size_t kMacLen = 6;
+
+constexpr uint8_t kMagic = 0x4D;
+constexpr uint8_t kVersion = 1;
+constexpr uint8_t kFlagAckReq = 0x01;
+constexpr uint8_t kFlagFlood = 0x02;
+
+// Beacons are handled by the discovery layer (espnow_peers.hpp).
+enum class Kind : uint8_t { kData = 0, kAck = 1, kBeacon = 2 };
+
+using Mac = std::array<uint8_t, kMacLen>;
+
+inline bool is_broadcast(const Mac& mac) {
+    for (uint8_t b : mac) {
+        if (b != 0xFF) return false;
+    }
+    return true;
+}
+
+class Link {
+   public:
+    // Hands one frame to the radio; false if it could not be queued (the
+    // fragment is retried on the next pump).
+    using SendFn = std::function<bool(const Mac& dst, const uint8_t* frame, size_t len)>;
+
+    struct Config {
+        size_t tx_slots = 4;
+        size_t rx_slots = 4;
+        size_t inbox_depth = 8;
+        size_t peers = 8;
+        int64_t ack_timeout_us = 60 * 1000;
+        uint8_t max_retries = 6;
+        int64_t reassembly_timeout_us = 2 * 1000 * 1000;
+        // Start from a random value so a rebooted sender does not collide
+        // with sequences its peers still remember.
+        uint16_t first_seq = 1;
+        // Flooding: own broadcasts carry flood_ttl hops when non-zero; relay
+        // forwards other nodes' flooded frames. self must be set for either.
+        Mac self{};
+        uint8_t flood_ttl = 0;
+        bool relay = false;
+        int64_t relay_jitter_us = 60 * 1000;
+        uint8_t relay_suppress = 4;
+        size_t relay_slots = 16;
+        size_t seen_frames = 64;
+        uint32_t seed = 1;
+    };
+
+    struct Message {
+        Mac from{};
+        size_t len = 0;
+        uint8_t data[kMaxMessage];
+    };
+
+    struct Stats {
+        uint32_t sent = 0;          // messages accepted by send()
+        uint32_t delivered = 0;     // acknowledged, or fully sent if broadcast
+        uint32_t acked = 0;         // unicast messages acknowledged
+        uint32_t failed = 0;        // gave up after max_retries
+        uint32_t busy = 0;          // send() found every TX slot in use
+        uint32_t frames_tx = 0;
+        uint32_t frames_rx = 0;
+        uint32_t retransmits = 0;   // fragments sent again after a timeout
+        uint32_t link_refused = 0;  // SendFn returned false
+        uint32_t acks_tx = 0;
+        uint32_t acks_rx = 0;
+        uint32_t received = 0;      // messages queued for the consumer
+        uint32_t duplicates = 0;
+        uint32_t bad_frames = 0;
+        uint32_t inbox_full = 0;    // completed message held back, not acked
+        uint32_t rx_busy = 0;       // fragment of a new message, no free slot
+        uint32_t expired = 0;       // partial reassemblies given up
+        uint32_t relayed = 0;       // flooded frames forwarded
+        uint32_t relay_suppressed = 0;
+        uint32_t relay_dropped = 0;  // no free relay slot
+    };
+
+    enum class Send : uint8_t { kQueued, kTooLarge, kBusy };
+
+    explicit Link(SendFn send) : Link(std::move(send), Config{}) {}
+
+    Link(SendFn send, const Config& cfg)
+        : send_(std::move(send)),
+          cfg_(cfg),
+          tx_(cfg.tx_slots),
+          rx_(cfg.rx_slots),
+          inbox_(cfg.inbox_depth),
+          peers_(cfg.peers),
+          relays_(cfg.relay_slots),
+          seen_frames_(cfg.seen_frames),
+          next_seq_(cfg.first_seq),
+          rng_(cfg.seed ? cfg.seed : 1) {}
+
+    void set_flood(bool relay, uint8_t ttl) {
+        cfg_.relay = relay;
+        cfg_.flood_ttl = ttl;
+    }
+
+    // Queues `data` for `dst` and transmits what the radio accepts now.
+    Send send(const Mac& dst, const uint8_t* data, size_t len, int64_t now_us) {
+        const bool flood = cfg_.flood_ttl > 0 && is_broadcast(dst);
+        if (len == 0 || len > (flood ? kMaxFloodMessage : kMaxMessage)) {
+            return Send::kTooLarge;
+        }
+        TxSlot* slot = nullptr;
+        bool window_full = false;
+        for (auto& s : tx_) {
+            if (!s.active) {
+                if (!slot) slot = &s;
+                continue;
+            }
+            // Keep unacknowledged messages within half the receiver's
+            // duplicate window of the newest: then no more than kWindow
+            // other messages can complete while one is still retransmitted,
+            // and a late copy of it is still recognised.
+            if (!s.broadcast && uint16_t(next_seq_ - s.seq) >= Peer::kWindow / 2) {
+                window_full = true;
+            }
+        }
+        if (!slot || window_full) {
+            ++stats_.busy;
+            return Send::kBusy;
+        }
+        slot->active = true;
+        slot->dst = dst;
+        slot->broadcast = is_broadcast(dst);
+        slot->flood = flood;
+        slot->seq = next_seq_++;
+        slot->len = len;
+        const size_t frag = flood ? kFloodFragPayload : kFragPayload;
+        slot->frags = static_cast<uint8_t>((len + frag - 1) / frag);
+        slot->pending = all_bits(slot->frags);
+        slot->acked = 0;
+        slot->retries = 0;
+        slot->deadline_us = now_us + cfg_.ack_timeout_us;
+        memcpy(slot->data, data, len);
+        ++stats_.sent;
+        pump(now_us);
+        return Send::kQueued;
+    }
+
+    // Feeds one received frame. May answer with an ACK through SendFn.
+    void on_frame(const Mac& src, const uint8_t* frame, size_t len, int64_t now_us) {
+        ++stats_.frames_rx;
+        if (len < kHeaderBytes || frame[0] != kMagic || (frame[1] >> 4) != kVersion) {
+            ++stats_.bad_frames;
+            return;
+        }
+        const auto kind = static_cast<Kind>(frame[1] & 0x0F);
+        const uint8_t flags = frame[2];
+        const uint8_t idx = frame[3];
+        const uint8_t cnt = frame[4];
+        const uint16_t seq = uint16_t(frame[5] | (frame[6] << 8));
+        if (kind == Kind::kBeacon) return;
+        if (kind == Kind::kAck) {
+            if (len < kHeaderBytes + 1) {
+                ++stats_.bad_frames;
+                return;
+            }
+            on_ack(src, seq, frame[kHeaderBytes], now_us);
+            return;
+        }
+        if (kind != Kind::kData || cnt == 0 || cnt > kMaxFragments || idx >= cnt) {
+            ++stats_.bad_frames;
+            return;
+        }
+        const bool flood = (flags & kFlagFlood) != 0;
+        const size_t hdr = flood ? kFloodHeaderBytes : kHeaderBytes;
+        const size_t frag = flood ? kFloodFragPayload : kFragPayload;
+        if (len <= hdr) {
+            ++stats_.bad_frames;
+            return;
+        }
+        const size_t body = len - hdr;
+        // Every fragment but the last is full, so offsets follow from idx.
+        if (idx + 1 < cnt && body != frag) {
+            ++stats_.bad_frames;
+            return;
+        }
+        Mac from = src;
+        if (flood) {
+            memcpy(from.data(), frame + kHeaderBytes + 1, kMacLen);
+            if (from == cfg_.self || !note_flood(from, seq, idx, frame, len, now_us)) {
+                ++stats_.duplicates;
+                return;
+            }
+        }
+        deliver_fragment(from, seq, idx, cnt, frag, frame + hdr, body,
+                         (flags & kFlagAckReq) != 0 && !flood, now_us);
+    }
+
+    // Retransmits timed-out fragments, retries refused ones, forwards due
+    // relays and expires stale reassemblies. Call after on_frame and
+    // whenever next_deadline() passes.
+    void pump(int64_t now_us) {
+        for (auto& s : tx_) {
+            if (!s.active) continue;
+            if (!s.broadcast && s.pending == 0 && now_us >= s.deadline_us) {
+                if (s.retries >= cfg_.max_retries) {
+                    ++stats_.failed;
+                    s.active = false;
+                    continue;
+                }
+                ++s.retries;
+                s.pending = uint8_t(all_bits(s.frags) & ~s.acked);
+                for (uint8_t p = s.pending; p; p &= uint8_t(p - 1)) ++stats_.retransmits;
+            }
+            transmit(s, now_us);
+        }
+        for (auto& r : relays_) {
+            if (!r.active || now_us < r.due_us) continue;
+            if (!send_(kBroadcastMac, r.frame, r.len)) {
+                ++stats_.link_refused;
+                continue;
+            }
+            ++stats_.frames_tx;
+            ++stats_.relayed;
+            r.active = false;
+        }
+        for (auto& r : rx_) {
+            if (r.active && now_us - r.last_us > cfg_.reassembly_timeout_us) {
+                r.active = false;
+                ++stats_.expired;
+            }
+        }
+    }
+
+    // Earliest time pump() has work to do, or INT64_MAX when idle.
+    int64_t next_deadline() const {
+        int64_t t = INT64_MAX;
+        for (const auto& s : tx_) {
+            if (!s.active) continue;
+            t = std::min(t, s.pending ? int64_t(0) : s.deadline_us);
+        }
+        for (const auto& r : relays_) {
+            if (r.active) t = std::min(t, r.due_us);
+        }
+        for (const auto& r : rx_) {
+            if (r.active) t = std::min(t, r.last_us + cfg_.reassembly_timeout_us);
+        }
+        return t;
+    }
+
+    // Pops the oldest received message into `out`.
+    bool pop(Message* out) {
+        if (inbox_count_ == 0) return false;
+        const Message& m = inbox_[inbox_head_];
+        out->from = m.from;
+        out->len = m.len;
+        memcpy(out->data, m.data, m.len);
+        inbox_head_ = (inbox_head_ + 1) % inbox_.size();
+        --inbox_count_;
+        return true;
+    }
+
+    size_t in_flight() const {
+        size_t n = 0;
+        for (const auto& s : tx_) n += s.active ? 1 : 0;
+        return n;
+    }
+    size_t free_tx_slots() const { return tx_.size() - in_flight(); }
+    size_t inbox_depth() const { return inbox_count_; }
+    const Stats& stats() const { return stats_; }
+
+   private:
+    struct TxSlot {
+        bool active = false;
+        bool broadcast = false;
+        bool flood = false;
+        Mac dst{};
+        uint16_t seq = 0;
+        uint8_t frags = 0;
+        uint8_t pending = 0;  // fragments to (re)send now
+        uint8_t acked = 0;
+        uint8_t retries = 0;
+        int64_t deadline_us = 0;
+        size_t len = 0;
+        uint8_t data[kMaxMessage];
+    };
+
+    struct RxSlot {
+        bool active = false;
+        Mac from{};
+        uint16_t seq = 0;
+        uint8_t frags = 0;
+        uint8_t got = 0;
+        size_t len = 0;
+        int64_t last_us = 0;
+        uint8_t data[kMaxMessage];
+    };
+
+    // Recently completed sequences of one sender.
+    struct Peer {
+        static constexpr size_t kWindow = 16;
+        bool used = false;
+        Mac mac{};
+        std::array<uint16_t, kWindow> seqs{};
+        uint8_t count = 0;
+        uint8_t head = 0;
+        int64_t last_us = 0;
+    };
+
+    struct FrameId {
+        Mac origin{};
+        uint16_t seq = 0;
+        uint8_t idx = 0xFF;
+        bool operator==(const FrameId& o) const {
+            return seq == o.seq && idx == o.idx && origin == o.origin;
+        }
+    };
+
+    // A flooded frame waiting for its jittered rebroadcast.
+    struct Relay {
+        bool active = false;
+        FrameId id;
+        uint8_t heard = 0;
+        int64_t due_us = 0;
+        uint8_t len = 0;
+        uint8_t frame[kFrameMax];
+    };
+
+    static constexpr Mac kBroadcastMac = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+    uint32_t next_rand() {
+        rng_ ^= rng_ << 13;
+        rng_ ^= rng_ >> 17;
+        rng_ ^= rng_ << 5;
+        return rng_;
+    }
+
+    // Records a flooded frame; false if it was seen before. Schedules the
+    // rebroadcast in relay mode.
+    bool note_flood(const Mac& origin, uint16_t seq, uint8_t idx, const uint8_t* frame,
+                    size_t len, int64_t now_us) {
+        const FrameId id{origin, seq, idx};
+        for (const auto& f : seen_frames_) {
+            if (!(f == id)) continue;
+            for (auto& r : relays_) {
+                if (!r.active || !(r.id == id)) continue;
+                if (cfg_.relay_suppress && ++r.heard >= cfg_.relay_suppress) {
+                    r.active = false;
+                    ++stats_.relay_suppressed;
+                }
+                break;
+            }
+            return false;
+        }
+        seen_frames_[seen_head_] = id;
+        seen_head_ = (seen_head_ + 1) % seen_frames_.size();
+        const uint8_t ttl = frame[kHeaderBytes];
+        if (!cfg_.relay || ttl <= 1) return true;
+        Relay* r = nullptr;
+        for (auto& q : relays_) {
+            if (!q.active) {
+                r = &q;
+                break;
+            }
+        }
+        if (!r) {
+            ++stats_.relay_dropped;
+            return true;
+        }
+        r->active = true;
+        r->id = id;
+        r->heard = 1;
+        r->due_us = now_us + (cfg_.relay_jitter_us > 0
+                                  ? int64_t(next_rand() % uint32_t(cfg_.relay_jitter_us))
+                                  : 0);
+        r->len = uint8_t(len);
+        memcpy(r->frame, frame, len);
+        r->frame[kHeaderBytes] = uint8_t(ttl - 1);
+        return true;
+    }
+
+    void deliver_fragment(const Mac& src, uint16_t seq, uint8_t idx, uint8_t cnt,
+                          size_t frag, const uint8_t* body, size_t body_len,
+                          bool want_ack, int64_t now_us) {
+        if (seen(src, seq)) {
+            ++stats_.duplicates;
+            // Our earlier ACK was lost; confirm the whole message again.
+            if (want_ack) send_ack(src, seq, cnt, all_bits(cnt));
+            return;
+        }
+        RxSlot* slot = rx_slot(src, seq, cnt, now_us);
+        if (!slot) return;
+        const uint8_t bit = uint8_t(1u << idx);
+        if (!(slot->got & bit)) {
+            memcpy(slot->data + idx * frag, body, body_len);
+            if (idx + 1 == cnt) slot->len = idx * frag + body_len;
+            slot->got |= bit;
+        }
+        slot->last_us = now_us;
+        if (slot->got == all_bits(cnt)) {
+            if (inbox_count_ == inbox_.size()) {
+                // Leave the last fragment unacknowledged; the sender retries
+                // once the consumer has made room.
+                ++stats_.inbox_full;
+                slot->got &= uint8_t(~bit);
+            } else {
+                Message& m = inbox_[(inbox_head_ + inbox_count_) % inbox_.size()];
+                m.from = src;
+                m.len = slot->len;
+                memcpy(m.data, slot->data, slot->len);
+                ++inbox_count_;
+                ++stats_.received;
+                remember(src, seq, now_us);
+                slot->active = false;
+                if (want_ack) send_ack(src, seq, cnt, all_bits(cnt));
+                return;
+            }
+        }
+        if (want_ack) send_ack(src, seq, cnt, slot->got);
+    }
+
+    static_assert(kMaxFragments <= 8, "fragment bitmaps are one byte");
+
+    static uint8_t all_bits(uint8_t n) { return uint8_t((1u << n) - 1); }
+
+    void transmit(TxSlot& s, int64_t now_us) {
+        uint8_t frame[kFrameMax];
+        const size_t hdr = s.flood ? kFloodHeaderBytes : kHeaderBytes;
+        const size_t frag = s.flood ? kFloodFragPayload : kFragPayload;
+        while (s.pending) {
+            const uint8_t idx = uint8_t(__builtin_ctz(s.pending));
+            const size_t off = idx * frag;
+            const size_t body = std::min(frag, s.len - off);
+            frame[0] = kMagic;
+            frame[1] = uint8_t(kVersion << 4 | uint8_t(Kind::kData));
+            frame[2] = s.flood ? kFlagFlood : (s.broadcast ? 0 : kFlagAckReq);
+            frame[3] = idx;
+            frame[4] = s.frags;
+            frame[5] = uint8_t(s.seq & 0xFF);
+            frame[6] = uint8_t(s.seq >> 8);
+            if (s.flood) {
+                frame[kHeaderBytes] = cfg_.flood_ttl;
+                memcpy(frame + kHeaderBytes + 1, cfg_.self.data(), kMacLen);
+            }
+            memcpy(frame + hdr, s.data + off, body);
+            if (!send_(s.dst, frame, hdr + body)) {
+                ++stats_.link_refused;
+                return;
+            }
+            ++stats_.frames_tx;
+            s.pending &= uint8_t(~(1u << idx));
+            s.deadline_us = now_us + cfg_.ack_timeout_us;
+        }
+        if (s.broadcast) {
+            ++stats_.delivered;
+            s.active = false;
+        }
+    }
+
+    void on_ack(const Mac& src, uint16_t seq, uint8_t bitmap, int64_t now_us) {
+        ++stats_.acks_rx;
+        for (auto& s : tx_) {
+            if (!s.active || s.broadcast || s.seq != seq || s.dst != src) continue;
+            // The bitmap is everything the receiver holds now, not an
+            // increment: a reassembly it expired or evicted shows up as
+            // missing fragments again and they are resent.
+            s.acked = bitmap;
+            s.pending &= uint8_t(~bitmap);
+            if ((s.acked & all_bits(s.frags)) == all_bits(s.frags)) {
+                ++stats_.delivered;
+                ++stats_.acked;
+                s.active = false;
+            } else if (s.pending == 0 && bitmap) {
+                // Progress: give the rest a full timeout from now.
+                s.deadline_us = now_us + cfg_.ack_timeout_us;
+            }
+            return;
+        }
+    }
+
+    void send_ack(const Mac& dst, uint16_t seq, uint8_t cnt, uint8_t bitmap) {
+        uint8_t frame[kHeaderBytes + 1] = {
+            kMagic, uint8_t(kVersion << 4 | uint8_t(Kind::kAck)), 0, 0, cnt,
+            uint8_t(seq & 0xFF), uint8_t(seq >> 8), bitmap};
+        if (send_(dst, frame, sizeof(frame))) {
+            ++stats_.acks_tx;
+        } else {
+            ++stats_.link_refused;
+        }
+    }
+
+    RxSlot* rx_slot(const Mac& src, uint16_t seq, uint8_t cnt, int64_t now_us) {
+        RxSlot* victim = nullptr;
+        for (auto& r : rx_) {
+            if (r.active && r.from == src && r.seq == seq) {
+                if (r.frags == cnt) return &r;
+                ++stats_.bad_frames;
+                return nullptr;
+            }
+            if (!r.active) {
+                if (!victim || victim->active) victim = &r;
+            } else if (!victim || (victim->active && r.last_us < victim->last_us)) {
+                victim = &r;
+            }
+        }
+        // A reassembly its sender is still retransmitting keeps its slot; the
+        // new message goes unacknowledged and is retried.
+        if (victim->active && now_us - victim->last_us < 2 * cfg_.ack_timeout_us) {
+            ++stats_.rx_busy;
+            return nullptr;
+        }
+        if (victim->active) ++stats_.expired;
+        victim->active = true;
+        victim->from = src;
+        victim->seq = seq;
+        victim->frags = cnt;
+        victim->got = 0;
+        victim->len = 0;
+        victim->last_us = now_us;
+        return victim;
+    }
+
+    Peer* peer(const Mac& mac) {
+        for (auto& p : peers_) {
+            if (p.used && p.mac == mac) return &p;
+        }
+        return nullptr;
+    }
+
+    bool seen(const Mac& src, uint16_t seq) {
+        const Peer* p = peer(src);
+        if (!p) return false;
+        for (uint8_t i = 0; i < p->count; ++i) {
+            if (p->seqs[i] == seq) return true;
+        }
+        return false;
+    }
+
+    void remember(const Mac& src, uint16_t seq, int64_t now_us) {
+        Peer* p = peer(src);
+        if (!p) {
+            // Least recently heard sender makes room.
+            p = &peers_[0];
+            for (auto& q : peers_) {
+                if (!q.used) {
+                    p = &q;
+                    break;
+                }
+                if (q.last_us < p->last_us) p = &q;
+            }
+            *p = Peer{};
+            p->used = true;
+            p->mac = src;
+        }
+        p->seqs[p->head] = seq;
+        p->head = uint8_t((p->head + 1) % Peer::kWindow);
+        if (p->count < Peer::kWindow) ++p->count;
+        p->last_us = now_us;
+    }
+
+    SendFn send_;
+    Config cfg_;
+    std::vector<TxSlot> tx_;
+    std::vector<RxSlot> rx_;
+    std::vector<Message> inbox_;
+    size_t inbox_head_ = 0;
+    size_t inbox_count_ = 0;
+    std::vector<Peer> peers_;
+    std::vector<Relay> relays_;
+    std::vector<FrameId> seen_frames_;
+    size_t seen_head_ = 0;
+    uint16_t next_seq_;
+    uint32_t rng_;
+    Stats stats_;
+};
+
+}  // namespace espnowrt
@@ -0,0 +1,194 @@
+// ESP-NOW peer discovery: beacon frames and the peer table.
+//
+// Every node broadcasts a beacon (Kind::kBeacon in the espnow_link.hpp
+// header) carrying the Wi-Fi channel it sits on and its short_id:
+//
+//   0-6  link header, idx 0, cnt 1
+//   7    channel
+//   8    flags (kBeaconChannelFixed: the node cannot leave its channel)
+//   9    short_id length, at most kShortIdMax
+//   10-  short_id bytes
+//
+// The table remembers who was heard, on which channel, how strongly (RSSI,
+// smoothed) and when. It holds at most `capacity` peers so that it fits the
+// esp_now peer list; a new peer evicts the least recently heard one and the
+// caller unregisters it from esp_now. Like Link, the table takes the time as
+// an argument and has no locking.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "espnow_link.hpp"
+
+namespace espnowrt {
+
+constexpr size_t kShortIdMax = 16;
+constexpr uint8_t kBeaconChannelFixed = 0x01;
+
+struct Beacon {
+    uint8_t channel = 0;
+    uint8_t flags = 0;
+    std::string_view short_id;
+};
+
+inline bool is_beacon(const uint8_t* frame, size_t len) {
+    return len >= kHeaderBytes && frame[0] == kMagic && (frame[1] >> 4) == kVersion &&
+           static_cast<Kind>(frame[1] & 0x0F) == Kind::kBeacon;
+}
+
+// Writes a beacon into `out` (kFrameMax bytes); returns its length.
+inline size_t encode_beacon(uint16_t seq, const Beacon& b, uint8_t* out) {
+    const size_t id_len = b.short_id.size() < kShortIdMax ? b.short_id.size() : kShortIdMax;
+    out[0] = kMagic;
+    out[1] = uint8_t(kVersion << 4 | uint8_t(Kind::kBeacon));
+    out[2] = 0;
+    out[3] = 0;
+    out[4] = 1;
+    out[5] = uint8_t(seq & 0xFF);
+    out[6] = uint8_t(seq >> 8);
+    out[7] = b.channel;
+    out[8] = b.flags;
+    out[9] = uint8_t(id_len);
+    memcpy(out + 10, b.short_id.data(), id_len);
+    return 10 + id_len;
+}
+
+// `out->short_id` points into `frame`.
+inline bool parse_beacon(const uint8_t* frame, size_t len, Beacon* out) {
+    if (!is_beacon(frame, len) || len < 10) return false;
+    const size_t id_len = frame[9];
+    if (id_len > kShortIdMax || len < 10 + id_len) return false;
+    out->channel = frame[7];
+    out->flags = frame[8];
+    out->short_id = std::string_view(reinterpret_cast<const char*>(frame + 10), id_len);
+    return true;
+}
+
+class PeerTable {
+   public:
+    struct Peer {
+        bool used = false;
+        Mac mac{};
+        char short_id[kShortIdMax + 1] = {};
+        uint8_t channel = 0;
+        uint8_t flags = 0;
+        int8_t rssi = 0;  // dBm, smoothed
+        int64_t first_seen_us = 0;
+        int64_t last_seen_us = 0;
+        uint32_t beacons = 0;
+    };
+
+    struct Update {
+        Peer* peer = nullptr;
+        bool added = false;
+        bool evicted = false;
+        Mac evicted_mac{};
+    };
+
+    // esp_now keeps at most ESP_NOW_MAX_TOTAL_PEER_NUM (20) peers; the table
+    // never needs more, which bounds the scratch space below.
+    static constexpr size_t kMaxCapacity = 20;
+
+    explicit PeerTable(size_t capacity)
+        : peers_(capacity < kMaxCapacity ? capacity : kMaxCapacity) {}
+
+    Update on_beacon(const Mac& mac, const Beacon& b, int8_t rssi, int64_t now_us) {
+        Update u = upsert(mac, rssi, now_us);
+        Peer& p = *u.peer;
+        const size_t n = b.short_id.size() < kShortIdMax ? b.short_id.size() : kShortIdMax;
+        memcpy(p.short_id, b.short_id.data(), n);
+        p.short_id[n] = '\0';
+        p.channel = b.channel;
+        p.flags = b.flags;
+        ++p.beacons;
+        return u;
+    }
+
+    // Any other frame from a known peer refreshes it; unknown senders are
+    // only added through beacons.
+    void touch(const Mac& mac, int8_t rssi, int64_t now_us) {
+        if (Peer* p = find(mac)) {
+            p->rssi = smooth(p->rssi, rssi);
+            p->last_seen_us = now_us;
+        }
+    }
+
+    Peer* find(const Mac& mac) {
+        for (auto& p : peers_) {
+            if (p.used && p.mac == mac) return &p;
+        }
+        return nullptr;
+    }
+
+    // Peers heard within max_age_us on `channel`, strongest first.
+    size_t fresh(int64_t now_us, int64_t max_age_us, uint8_t channel, Mac* out,
+                 size_t cap) const {
+        // Called from the transport loop under its lock: no heap.
+        const Peer* list[kMaxCapacity];
+        size_t count = 0;
+        for (const auto& p : peers_) {
+            if (p.used && now_us - p.last_seen_us <= max_age_us && p.channel == channel) {
+                list[count++] = &p;
+            }
+        }
+        std::sort(list, list + count,
+                  [](const Peer* a, const Peer* b) { return a->rssi > b->rssi; });
+        const size_t n = count < cap ? count : cap;
+        for (size_t i = 0; i < n; ++i) out[i] = list[i]->mac;
+        return n;
+    }
+
+    const std::vector<Peer>& peers() const { return peers_; }
+
+    size_t size() const {
+        size_t n = 0;
+        for (const auto& p : peers_) n += p.used ? 1 : 0;
+        return n;
+    }
+
+   private:
+    static int8_t smooth(int8_t old, int8_t sample) {
+        return int8_t((3 * int(old) + int(sample)) / 4);
+    }
+
+    Update upsert(const Mac& mac, int8_t rssi, int64_t now_us) {
+        Update u;
+        if (Peer* p = find(mac)) {
+            p->rssi = smooth(p->rssi, rssi);
+            p->last_seen_us = now_us;
+            u.peer = p;
+            return u;
+        }
+        Peer* slot = nullptr;
+        for (auto& p : peers_) {
+            if (!p.used) {
+                slot = &p;
+                break;
+            }
+            if (!slot || p.last_seen_us < slot->last_seen_us) slot = &p;
+        }
+        if (slot->used) {
+            u.evicted = true;
+            u.evicted_mac = slot->mac;
+        }
+        *slot = Peer{};
+        slot->used = true;
+        slot->mac = mac;
+        slot->rssi = rssi;
+        slot->first_seen_us = now_us;
+        slot->last_seen_us = now_us;
+        u.peer = slot;
+        u.added = true;
+        return u;
+    }
+
+    std::vector<Peer> peers_;
+};
+
+}  // namespace espnowrt
@@ -0,0 +1,84 @@
+// ESP-NOW message transport: fragmentation, unicast ACK/retransmit and
+// duplicate suppression on top of esp_now (see espnow_link.hpp).
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ESPNOW_RT_MAX_MESSAGE 1944  // espnowrt::kMaxMessage
+#define ESPNOW_RT_MAX_FLOOD_MESSAGE 1888  // espnowrt::kMaxFloodMessage
+#define ESPNOW_RT_DEFAULT_TTL 4
+
+// Initialise esp_now (Wi-Fi must already be started), register the broadcast
+// peer and start the transport task. Safe to call again while running.
+int espnow_rt_start(void);
+
+// Stop the transport task and deinit esp_now. Undelivered messages are lost.
+void espnow_rt_stop(void);
+
+// Relay mode: broadcasts go out flooded with `ttl` hops (capped at
+// ESPNOW_RT_MAX_FLOOD_MESSAGE bytes) and flooded frames from other nodes are
+// rebroadcast once after a random delay. Kept across stop/start.
+void espnow_rt_set_relay(bool enable, uint8_t ttl);
+
+// short_id advertised in discovery beacons (at most 16 bytes).
+void espnow_rt_set_identity(const char* short_id);
+
+// Queue a message for `mac`. NULL means every nearby device: acknowledged
+// unicasts to the peers discovered on this channel when there are only a
+// few, otherwise (or in relay mode) one broadcast. Returns 0 when queued, -1
+// on bad args or not started, -2 if larger than ESPNOW_RT_MAX_MESSAGE, -3
+// when every send slot is busy. A unicast fan-out is queued to every peer or
+// to none (-3 when the free slots cannot cover all of them), so retrying
+// after -3 never sends a peer the same message twice.
+int espnow_rt_send(const uint8_t* mac, const void* data, size_t len);
+
+// Pop the oldest received message. Returns its length (truncated to out_cap)
+// and copies the sender into from_mac when non-NULL; 0 when none is waiting.
+size_t espnow_rt_recv(uint8_t* from_mac, void* out, size_t out_cap);
+
+typedef struct {
+    uint32_t sent;
+    uint32_t delivered;   // acknowledged, or fully sent if broadcast
+    uint32_t failed;      // unicast given up after retries
+    uint32_t busy;
+    uint32_t retransmits;
+    uint32_t received;
+    uint32_t duplicates;
+    uint32_t bad_frames;
+    uint32_t rx_dropped;  // raw frames lost because the RX queue was full
+    uint32_t mac_fail;    // esp_now send callback reported failure
+    uint32_t relayed;     // flooded frames forwarded for other nodes
+    uint32_t relay_suppressed;  // skipped, enough neighbours already had it
+    uint32_t acked;       // unicast messages acknowledged end to end
+    uint32_t mac_ok;      // esp_now send callback reported success
+    uint32_t peers;
+    uint32_t channel;
+    uint32_t discovery_ms;  // start to first peer; UINT32_MAX if none yet
+    uint32_t beacons_tx;
+    uint32_t beacons_rx;
+    uint32_t channel_hops;
+    uint32_t unicast_fanout;  // broadcasts sent as unicast to known peers
+} espnow_rt_stats_t;
+
+void espnow_rt_get_stats(espnow_rt_stats_t* out);
+
+typedef struct {
+    uint8_t mac[6];
+    char short_id[17];
+    uint8_t channel;
+    int8_t rssi;      // dBm, smoothed
+    uint32_t age_ms;  // since last heard
+} espnow_rt_peer_t;
+
+// Copy up to cap discovered peers into out; returns the count.
+size_t espnow_rt_get_peers(espnow_rt_peer_t* out, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
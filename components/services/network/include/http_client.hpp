@@ -13,6 +13,7 @@
 #include <sys/param.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <algorithm>
 #include <string>
 #include <utility>
 #include <atomic>
@@ -39,6 +40,10 @@
 #include "esp_http_client.h"
 
 #include "chat_api.hpp"
+#include "message_history.hpp"
+#include "net_executor.hpp"
+#include "outbox.hpp"
+#include "sync_cache.hpp"
 #include "mqtt_runtime.h"
 #include <notification_effects.hpp>
 
@@ -186,81 +191,15 @@ esp_err_t _http_client_event_handler(esp_http_client_event_t *evt) {
     return ESP_OK;
 }
 
-static constexpr uint32_t kHttpGetTaskStackWords = 6192;
-static StackType_t *http_get_task_stack = nullptr;
-static StaticTask_t http_get_task_buffer;
-static TaskHandle_t http_get_task_handle = nullptr;
-
-static constexpr uint32_t kHttpFriendsTaskStackWords = 6144;
-static StackType_t *http_get_friends_task_stack = nullptr;
-static StaticTask_t http_get_friends_task_buffer;
-static TaskHandle_t http_get_friends_task_handle = nullptr;
-static TaskHandle_t http_get_friends_waiter = nullptr;
-
-struct HttpFriendsTaskResult {
+struct FriendsFetchResult {
     esp_err_t err = ESP_FAIL;
     int status = 0;
     std::string payload;
 };
 
-static HttpFriendsTaskResult *http_get_friends_result = nullptr;
-
-static StackType_t *ensure_http_get_stack() {
-    if (http_get_task_stack) return http_get_task_stack;
-    size_t bytes = kHttpGetTaskStackWords * sizeof(StackType_t);
-    http_get_task_stack = static_cast<StackType_t *>(heap_caps_malloc(
-        bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
-    if (!http_get_task_stack) {
-        ESP_LOGE(TAG,
-                 "Failed to alloc http_get stack (bytes=%u free=%u largest=%u)",
-                 static_cast<unsigned>(bytes),
-                 static_cast<unsigned>(heap_caps_get_free_size(
-                     MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)),
-                 static_cast<unsigned>(heap_caps_get_largest_free_block(
-                     MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)));
-    }
-    return http_get_task_stack;
-}
-
-static StackType_t *ensure_http_friends_stack() {
-    if (http_get_friends_task_stack) return http_get_friends_task_stack;
-    size_t bytes = kHttpFriendsTaskStackWords * sizeof(StackType_t);
-    http_get_friends_task_stack = static_cast<StackType_t *>(heap_caps_malloc(
-        bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
-    if (!http_get_friends_task_stack) {
-        ESP_LOGE(TAG,
-                 "Failed to alloc http_get_friends stack (bytes=%u free=%u largest=%u)",
-                 static_cast<unsigned>(bytes),
-                 static_cast<unsigned>(heap_caps_get_free_size(
-                     MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)),
-                 static_cast<unsigned>(heap_caps_get_largest_free_block(
-                     MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)));
-    }
-    return http_get_friends_task_stack;
-}
-
-JsonDocument res;
-static std::mutex res_mutex;
-static std::atomic<bool> res_flag{false};
-
-static void fill_empty_messages(JsonDocument &target) {
-    StaticJsonDocument<128> emptyDoc;
-    emptyDoc.createNestedArray("messages");
-    std::string outBuf;
-    serializeJson(emptyDoc, outBuf);
-    deserializeJson(target, outBuf);
-}
-void http_get_message_task(void *pvParameters) {
-    ESP_LOGW(TAG, "Start http_get_message_task");
-    // Take ownership of heap arg and free after copy
-    std::string chat_from = *(std::string *)pvParameters;  // friend identifier
-    delete (std::string *)pvParameters;
-
-    auto finish_task = [&]() {
-        http_get_task_handle = nullptr;
-        vTaskDelete(NULL);
-    };
-
+// Runs on the network worker (see net_executor.hpp).
+static chatapi::MessageHistory fetch_message_history(
+    const std::string &chat_from) {
     // Prepare API client and ensure logged in
     auto &api = dev_chat_api();
     api.set_scheme("https");
@@ -269,7 +208,12 @@ void http_get_message_task(void *pvParameters) {
         ESP_LOGW(TAG,
                  "Chat API auth failed; continuing with cached token state");
     }
-    const std::string username = creds.username;
+
+    // Cached window + since-cursor; the server only sends what is new.
+    chatapi::sync::HistoryState cache;
+    chatapi::sync::load_history(chat_from, cache);
+    const std::string cursor = cache.cursor();
+    std::string etag;
 
     std::string response;
     int status = 0;
@@ -285,7 +229,9 @@ void http_get_message_task(void *pvParameters) {
     for (int attempt = 1; attempt <= kGetMessagesMaxAttempts; ++attempt) {
         response.clear();
         status = 0;
-        err = api.get_messages(chat_from, 20, response, &status);
+        err = api.get_messages_since(chat_from, chatapi::sync::kHistoryWindow,
+                                     cursor, cache.etag, response, &status,
+                                     &etag);
         if (err == ESP_OK || !is_retryable_fetch_error(err) ||
             attempt == kGetMessagesMaxAttempts) {
             break;
@@ -306,88 +252,62 @@ void http_get_message_task(void *pvParameters) {
                                           /*force_refresh=*/true) == ESP_OK) {
             response.clear();
             status = 0;
-            err = api.get_messages(chat_from, 20, response, &status);
+            err = api.get_messages_since(chat_from,
+                                         chatapi::sync::kHistoryWindow, cursor,
+                                         cache.etag, response, &status, &etag);
         }
     }
+    // On failure fall back to the cached window (empty if none) so the UI
+    // never sits on Loading....
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "get_messages failed: %s (status=%d)",
                  esp_err_to_name(err), status);
-        // Return empty messages to avoid indefinite Loading... UI
-        {
-            std::lock_guard<std::mutex> lock(res_mutex);
-            fill_empty_messages(res);
-        }
-        res_flag.store(true);
-        finish_task();
-        return;  // unreachable
+        return std::move(cache.history);
     }
-
-    // Transform server response into legacy shape used by Display
-    // Server:
-    // {"messages":[{"id","sender_id","receiver_id","content","is_read","created_at"},
-    // ...]} Legacy expected: {"messages":[{"message":"...","from":"<friend or
-    // me>"}, ...]}
-    StaticJsonDocument<3072> in;
-    if (deserializeJson(in, response) != DeserializationError::Ok) {
-        ESP_LOGE(TAG, "JSON parse error");
-        {
-            std::lock_guard<std::mutex> lock(res_mutex);
-            fill_empty_messages(res);
-        }
-        res_flag.store(true);
-        finish_task();
-        return;  // unreachable
+    const size_t cached_bytes = cache.history.arena_bytes();
+    if (status == 304) {
+        chatapi::sync::record_fetch("messages", status, response.size(),
+                                    cached_bytes, false);
+        return std::move(cache.history);
     }
     if (status < 200 || status >= 300) {
         ESP_LOGW(TAG, "get_messages non-OK HTTP status=%d", status);
-        {
-            std::lock_guard<std::mutex> lock(res_mutex);
-            fill_empty_messages(res);
-        }
-        res_flag.store(true);
-        finish_task();
-        return;  // unreachable
-    }
-
-    StaticJsonDocument<3072> out;
-    auto arr = out.createNestedArray("messages");
-    std::string my_id = api.user_id();
-    for (JsonObject m : in["messages"].as<JsonArray>()) {
-        JsonObject o = arr.createNestedObject();
-        o["message"] = m["content"].as<const char *>();
-        const char *mid = m["id"].as<const char *>();
-        if (!mid) mid = m["message_id"].as<const char *>();
-        if (mid && mid[0] != '\0') o["id"] = mid;
-        const char *created = m["created_at"].as<const char *>();
-        if (created && created[0] != '\0') o["created_at"] = created;
-        // Mark origin by comparing sender_id to self
-        const char *sender = m["sender_id"].as<const char *>();
-        if (sender && my_id.size() && my_id == sender) {
-            o["from"] = username.c_str();
-        } else {
-            o["from"] = chat_from.c_str();
-        }
-        bool is_read = false;
-        if (m.containsKey("is_read")) {
-            is_read = m["is_read"].as<bool>();
-            o["is_read"] = is_read;
-        }
-
-    }
-    // Serialize to buffer then parse into global res to keep type compatibility
-    std::string outBuf;
-    serializeJson(out, outBuf);
-    {
-        std::lock_guard<std::mutex> lock(res_mutex);
-        deserializeJson(res, outBuf);
+        return std::move(cache.history);
     }
-    res_flag.store(true);
-    finish_task();
+
+    // Server records carry sender_id; ours are the ones we sent.
+    const std::string my_id = api.user_id();
+    auto is_outgoing = [&](const char *sender, const char *, const char *) {
+        return sender && !my_id.empty() && my_id == sender;
+    };
+    chatapi::MessageHistory delta;
+    if (!chatapi::parse_message_history(response, is_outgoing, delta)) {
+        ESP_LOGE(TAG, "JSON parse error");
+        return std::move(cache.history);
+    }
+    // A full page after a cursor means the gap may not be contiguous with
+    // the cache; start the window over from this page.
+    const bool incremental =
+        !cursor.empty() && delta.size() < chatapi::sync::kHistoryWindow;
+    chatapi::sync::record_fetch("messages", status, response.size(),
+                                incremental ? cached_bytes : 0, incremental);
+    std::string().swap(response);
+    if (incremental) {
+        cache.history = chatapi::merge_message_history(
+            cache.history, delta, chatapi::sync::kHistoryWindow);
+    } else {
+        delta.sort_chronological();
+        cache.history = std::move(delta);
+    }
+    cache.etag = std::move(etag);
+    if (!chatapi::sync::save_history(chat_from, cache)) {
+        ESP_LOGW(TAG, "history cache write failed for %s", chat_from.c_str());
+    }
+    return std::move(cache.history);
 }
 
-static void http_get_friends_task(void *pvParameters) {
-    (void)pvParameters;
-    HttpFriendsTaskResult res;
+static FriendsFetchResult fetch_friends() {
+    FriendsFetchResult res;
 
     auto &api = dev_chat_api();
     api.set_scheme("https");
@@ -396,22 +316,69 @@ static void http_get_friends_task(void *pvParameters) {
         ESP_LOGW(TAG, "Friends fetch auth failed; attempting cached token");
     }
 
-    res.err = api.get_friends(res.payload, &res.status);
+    chatapi::sync::FriendsState cache;
+    chatapi::sync::load_friends(cache);
+    std::string etag;
+    res.err = api.get_friends(res.payload, &res.status, cache.etag, &etag);
     if (res.err == ESP_OK && res.status == 401) {
         if (chatapi::ensure_authenticated(api, creds, false,
                                           /*force_refresh=*/true) == ESP_OK) {
             res.payload.clear();
             res.status = 0;
-            res.err = api.get_friends(res.payload, &res.status);
+            res.err = api.get_friends(res.payload, &res.status, cache.etag,
+                                      &etag);
         }
     }
+    if (res.err != ESP_OK) return res;
 
-    http_get_friends_result = new HttpFriendsTaskResult(std::move(res));
-    if (http_get_friends_waiter) {
-        xTaskNotifyGive(http_get_friends_waiter);
+    if (res.status == 304) {
+        chatapi::sync::record_fetch("friends", res.status, res.payload.size(),
+                                    cache.body.size(), false);
+        // Callers only understand 2xx + body.
+        res.status = 200;
+        res.payload = std::move(cache.body);
+    } else if (res.status >= 200 && res.status < 300) {
+        chatapi::sync::record_fetch("friends", res.status, res.payload.size(),
+                                    0, false);
+        if (!etag.empty()) {
+            cache.etag = std::move(etag);
+            cache.body = res.payload;
+            chatapi::sync::save_friends(cache);
+        }
     }
-    http_get_friends_task_handle = nullptr;
-    vTaskDelete(NULL);
+    return res;
+}
+
+// Counters the server attaches to chat/messages/<user_id> pushes, e.g.
+// {"sender_id":"..","unread_count":3}. Older payloads carry neither.
+struct UnreadPush {
+    bool has_count = false;
+    int unread_count = 0;
+    std::string sender;
+};
+
+static UnreadPush parse_unread_push(const char *payload) {
+    UnreadPush push;
+    JsonDocument filter;
+    filter["unread_count"] = true;
+    filter["unread"]["total"] = true;
+    filter["sender_id"] = true;
+    filter["from"] = true;
+    JsonDocument doc;
+    if (deserializeJson(doc, payload, DeserializationOption::Filter(filter)) !=
+        DeserializationError::Ok) {
+        return push;
+    }
+    JsonVariantConst count = doc["unread_count"];
+    if (count.isNull()) count = doc["unread"]["total"];
+    if (count.is<int>()) {
+        push.has_count = true;
+        push.unread_count = count.as<int>();
+    }
+    const char *sender = doc["sender_id"].as<const char *>();
+    if (!sender) sender = doc["from"].as<const char *>();
+    if (sender) push.sender = sender;
+    return push;
 }
 
 static JsonDocument notif_res;
@@ -420,54 +387,12 @@ static std::atomic<bool> notif_res_flag{false};
 
 void http_get_notifications_task(void *pvParameters);
 
-static bool is_retryable_send_error(esp_err_t err) {
-    return (err == ESP_ERR_HTTP_WRITE_DATA || err == ESP_ERR_NO_MEM ||
-            err == ESP_ERR_HTTP_CONNECT || err == ESP_FAIL);
-}
-
 static bool is_retryable_fetch_error(esp_err_t err) {
     return (err == ESP_ERR_HTTP_FETCH_HEADER || err == ESP_ERR_HTTP_EAGAIN ||
             err == ESP_ERR_HTTP_CONNECT || err == ESP_ERR_NO_MEM ||
             err == ESP_FAIL);
 }
 
-static void send_message_via_api(const std::string &chat_to,
-                                 const std::string &message) {
-    auto &api = chatapi::shared_client(true);
-    api.set_scheme("https");
-    const auto creds = chatapi::load_credentials_from_nvs();
-    if (chatapi::ensure_authenticated(api, creds) != ESP_OK) {
-        ESP_LOGW(TAG,
-                 "Chat API auth failed; continuing with cached token state");
-    }
-
-    std::string dummy;
-    esp_err_t err = ESP_FAIL;
-    constexpr int kMaxAttempts = 3;
-    for (int attempt = 1; attempt <= kMaxAttempts; ++attempt) {
-        err = api.send_message(chat_to, message, &dummy);
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Message sent to %s", chat_to.c_str());
-            break;
-        }
-        ESP_LOGW(TAG,
-                 "send_message attempt %d/%d failed: %s (free=%u largest=%u)",
-                 attempt, kMaxAttempts, esp_err_to_name(err),
-                 static_cast<unsigned>(heap_caps_get_free_size(
-                     MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)),
-                 static_cast<unsigned>(heap_caps_get_largest_free_block(
-                     MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)));
-        if (!is_retryable_send_error(err) || attempt == kMaxAttempts) {
-            break;
-        }
-        vTaskDelay(pdMS_TO_TICKS(200));
-    }
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "send_message failed: %s", esp_err_to_name(err));
-    }
-
-}
-
 class HttpClient {
    public:
     static HttpClient &shared() {
@@ -505,43 +430,25 @@ class HttpClient {
         ESP_LOGI(TAG, "HttpClient initialized");
     }
 
-    esp_err_t refresh_unread_count() {
-        auto &api = dev_chat_api();
-        api.set_scheme("https");
-        const auto creds = chatapi::load_credentials_from_nvs();
-        if (chatapi::ensure_authenticated(api, creds) != ESP_OK) {
-            ESP_LOGW(TAG,
-                     "Chat API auth failed while refreshing unread count");
+    // from_deep_sleep: single request right after a timer wake; resumes the
+    // RTC-cached TLS session instead of doing a full handshake. That path runs
+    // inline since nothing else is queued yet; periodic refreshes go through
+    // the network worker at background priority.
+    esp_err_t refresh_unread_count(bool from_deep_sleep = false) {
+        auto &exec = netexec::Executor::shared();
+        if (from_deep_sleep || exec.in_worker()) {
+            return fetch_unread_count(from_deep_sleep);
         }
-
-        std::string response;
-        esp_err_t err = api.get_unread_count(response);
-        if (err != ESP_OK) {
-            ESP_LOGW(TAG, "get_unread_count failed: %s",
-                     esp_err_to_name(err));
-            unread_count_known_.store(false);
-            return err;
-        }
-
-        DynamicJsonDocument doc(response.size() + 128);
-        auto jerr = deserializeJson(doc, response);
-        if (jerr != DeserializationError::Ok) {
-            ESP_LOGE(TAG, "unread_count JSON parse error: %s", jerr.c_str());
-            unread_count_known_.store(false);
-            return ESP_FAIL;
-        }
-
-        int count = 0;
-        if (doc.containsKey("unread_count")) {
-            count = doc["unread_count"].as<int>();
-        } else if (doc.containsKey("count")) {
-            count = doc["count"].as<int>();
-        }
-        if (count < 0) count = 0;
-        apply_unread_count(count);
-        return ESP_OK;
+        auto result = exec.submit<esp_err_t>(
+            netexec::Priority::kBackground, "unread_count",
+            [this]() { return fetch_unread_count(false); });
+        if (!result.wait(kUnreadWaitMs)) return ESP_ERR_TIMEOUT;
+        return result.take();
     }
 
+    // Authoritative total pushed over MQTT; no HTTP round trip needed.
+    void apply_pushed_unread_count(int count) { apply_unread_count(count); }
+
     bool has_unread_messages() const { return unread_count_.load() > 0; }
     int unread_count() const { return unread_count_.load(); }
     bool unread_count_known() const { return unread_count_known_.load(); }
@@ -556,72 +463,129 @@ class HttpClient {
         notif_flag = true;
     }
 
-    void post_message(const std::string &chat_to,
-                      const std::string &message) {
-        // Run in caller task to avoid dedicated post-task stack overflow.
-        send_message_via_api(chat_to, message);
+    // relay_to: receiver id the phone app expects when the message leaves
+    // over the BLE relay (defaults to chat_to).
+    void post_message(const std::string &chat_to, const std::string &message,
+                      const std::string &relay_to = std::string()) {
+        // Persist first; delivery (Wi-Fi or BLE) happens from the outbox.
+        const std::string key = outbox::enqueue(chat_to, relay_to, message);
+        if (key.empty()) return;
+        auto flushed = outbox::schedule_flush(/*force=*/true);
+        // Wait so the follow-up history refresh already includes it; if the
+        // link is down the message simply stays queued.
+        if (flushed.valid() && !flushed.wait(kSendWaitMs)) {
+            ESP_LOGW(TAG, "outbox flush still running after %ums",
+                     static_cast<unsigned>(kSendWaitMs));
+        }
     }
 
-    JsonDocument get_message(std::string chat_from) {
-        // Launch task with heap-allocated argument to avoid dangling pointer
-        auto *arg = new std::string(chat_from);
-
+    chatapi::MessageHistory get_message(std::string chat_from) {
         ESP_LOGI(TAG, "Start get message!");
-        res_flag.store(false);
-        if (http_get_task_handle != nullptr) {
-            ESP_LOGW(TAG, "Previous http_get_message_task still running; "
-                           "skipping new request");
-            delete arg;
-            {
-                std::lock_guard<std::mutex> lock(res_mutex);
-                fill_empty_messages(res);
-                return res;
-            }
+        auto history = netexec::Executor::shared().submit<
+            chatapi::MessageHistory>(
+            netexec::Priority::kForeground, "get_messages",
+            [chat_from = std::move(chat_from)]() {
+                return fetch_message_history(chat_from);
+            });
+        // Timeout: return empty messages to let UI proceed
+        if (!history.wait(kHistoryWaitMs)) return chatapi::MessageHistory();
+        return history.take();
+    }
+
+    // Read receipts run on the network worker like every other request.
+    bool mark_message_read(const std::string &message_id) {
+        if (message_id.empty()) return false;
+        return run_mark_read("mark_read", [this, message_id]() {
+            return mark_message_read_now(message_id);
+        });
+    }
+
+    bool mark_all_messages_read(const std::string &friend_identifier) {
+        if (friend_identifier.empty()) return false;
+        return run_mark_read("mark_all_read", [this, friend_identifier]() {
+            return mark_all_messages_read_now(friend_identifier);
+        });
+    }
+
+    FriendsResponse fetch_friends_blocking(uint32_t timeout_ms = 12000) {
+        FriendsResponse out;
+        auto result = netexec::Executor::shared().submit<FriendsFetchResult>(
+            netexec::Priority::kForeground, "get_friends", &fetch_friends);
+        if (!result.valid()) {
+            out.err = ESP_ERR_NO_MEM;
+            return out;
         }
-        res_flag.store(false);
-        if (!ensure_http_get_stack()) {
-            ESP_LOGE(TAG, "http_get_message_task: stack alloc failed");
-            delete arg;
-            {
-                std::lock_guard<std::mutex> lock(res_mutex);
-                fill_empty_messages(res);
-                return res;
-            }
+        if (!result.wait(timeout_ms)) {
+            out.err = ESP_ERR_TIMEOUT;
+            return out;
         }
-        http_get_task_handle = xTaskCreateStaticPinnedToCore(
-            &http_get_message_task, "http_get_message_task",
-            kHttpGetTaskStackWords, arg, 5, http_get_task_stack,
-            &http_get_task_buffer, tskNO_AFFINITY);
-        if (!http_get_task_handle) {
-            ESP_LOGE(TAG, "Task create failed! free_heap=%u",
-                     (unsigned)heap_caps_get_free_size(MALLOC_CAP_DEFAULT));
-            delete arg;
-            {
-                std::lock_guard<std::mutex> lock(res_mutex);
-                fill_empty_messages(res);
-                return res;
+        FriendsFetchResult res = result.take();
+        out.err = res.err;
+        out.status = res.status;
+        out.payload = std::move(res.payload);
+        return out;
+    }
+
+    void start_notifications() {
+        auto &running = notifications_task_running_flag();
+        bool expected = false;
+        if (!running.compare_exchange_strong(expected, true)) {
+            return;
+        }
+        {
+            wifi_ap_record_t ap = {};
+            if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+                ESP_LOGI(TAG,
+                         "Skip starting notification task: Wi-Fi not connected");
+                running.store(false);
+                return;
             }
         }
-        // Wait with timeout to avoid indefinite freeze
-        const int timeout_ms = 7000;
-        int waited = 0;
-        while (!res_flag.load() && waited < timeout_ms) {
-            safe_task_wdt_reset_if_registered();
-            vTaskDelay(10 / portTICK_PERIOD_MS);
-            waited += 10;
+
+        TaskHandle_t handle = nullptr;
+        BaseType_t ok = xTaskCreatePinnedToCore(&http_get_notifications_task,
+                                                "http_get_notifications_task",
+                                                6000, NULL, 5, &handle, 0);
+        if (ok != pdPASS || handle == nullptr) {
+            ESP_LOGE(TAG, "Failed to start notification task (err=%ld)",
+                     static_cast<long>(ok));
+            running.store(false);
         }
-        if (!res_flag.load()) {
-            // Timeout: return empty messages to let UI proceed
-            std::lock_guard<std::mutex> lock(res_mutex);
-            fill_empty_messages(res);
+    }
+
+    static JsonDocument get_notifications() {
+        std::lock_guard<std::mutex> lock(notif_mutex);
+        if (!notif_res_flag.load()) {
+            JsonDocument doc;
+            JsonArray data = doc.createNestedArray("notifications");
+            return doc;
+        }
+
+        notif_res_flag.store(false);
+        return notif_res;
+    }
+
+   private:
+    static constexpr uint32_t kUnreadWaitMs = 15000;
+    static constexpr uint32_t kSendWaitMs = 20000;
+    static constexpr uint32_t kHistoryWaitMs = 7000;
+    static constexpr uint32_t kMarkReadWaitMs = 10000;
+
+    template <typename Fn>
+    bool run_mark_read(const char *label, Fn &&fn) {
+        auto &exec = netexec::Executor::shared();
+        if (exec.in_worker()) return fn();
+        auto result = exec.submit<bool>(netexec::Priority::kForeground, label,
+                                        std::forward<Fn>(fn));
+        if (!result.wait(kMarkReadWaitMs)) {
+            ESP_LOGW(TAG, "%s did not finish within %ums", label,
+                     static_cast<unsigned>(kMarkReadWaitMs));
+            return false;
         }
-        res_flag.store(false);
-        std::lock_guard<std::mutex> lock(res_mutex);
-        return res;
+        return result.take();
     }
 
-    bool mark_message_read(const std::string &message_id) {
-        if (message_id.empty()) return false;
+    bool mark_message_read_now(const std::string &message_id) {
         auto &api = dev_chat_api();
         api.set_scheme("https");
         const auto creds = chatapi::load_credentials_from_nvs();
@@ -651,8 +615,7 @@ class HttpClient {
         return true;
     }
 
-    bool mark_all_messages_read(const std::string &friend_identifier) {
-        if (friend_identifier.empty()) return false;
+    bool mark_all_messages_read_now(const std::string &friend_identifier) {
         auto &api = dev_chat_api();
         api.set_scheme("https");
         const auto creds = chatapi::load_credentials_from_nvs();
@@ -673,120 +636,52 @@ class HttpClient {
                      esp_err_to_name(err));
             return false;
         }
+        chatapi::sync::mark_history_read(friend_identifier);
         return true;
     }
 
-    FriendsResponse fetch_friends_blocking(uint32_t timeout_ms = 12000) {
-        FriendsResponse out;
-        if (http_get_friends_task_handle) {
-            out.err = ESP_ERR_INVALID_STATE;
-            return out;
-        }
-        if (!ensure_http_friends_stack()) {
-            out.err = ESP_ERR_NO_MEM;
-            return out;
-        }
-        http_get_friends_result = nullptr;
-        http_get_friends_waiter = xTaskGetCurrentTaskHandle();
-        http_get_friends_task_handle = xTaskCreateStaticPinnedToCore(
-            &http_get_friends_task, "http_get_friends_task",
-            kHttpFriendsTaskStackWords, nullptr, 5, http_get_friends_task_stack,
-            &http_get_friends_task_buffer, tskNO_AFFINITY);
-        if (!http_get_friends_task_handle) {
-            http_get_friends_waiter = nullptr;
-            out.err = ESP_ERR_NO_MEM;
-            return out;
-        }
 
-        TickType_t remaining_ticks =
-            timeout_ms ? pdMS_TO_TICKS(timeout_ms) : portMAX_DELAY;
-        constexpr TickType_t kWaitSliceTicks = pdMS_TO_TICKS(200);
-        const TickType_t wait_slice_ticks =
-            (kWaitSliceTicks > 0) ? kWaitSliceTicks : 1;
-        bool got_notify = false;
-        while (true) {
-            TickType_t wait_ticks = wait_slice_ticks;
-            if (remaining_ticks != portMAX_DELAY &&
-                wait_ticks > remaining_ticks) {
-                wait_ticks = remaining_ticks;
-            }
-            if (ulTaskNotifyTake(pdTRUE, wait_ticks) != 0) {
-                got_notify = true;
-                break;
-            }
-            // Caller may be watched by task WDT during this blocking wait.
-            safe_task_wdt_reset_if_registered();
-            if (remaining_ticks != portMAX_DELAY) {
-                if (remaining_ticks <= wait_ticks) break;
-                remaining_ticks -= wait_ticks;
-            }
-        }
-        if (!got_notify) {
-            http_get_friends_waiter = nullptr;
-            if (http_get_friends_result) {
-                out.err = http_get_friends_result->err;
-                out.status = http_get_friends_result->status;
-                out.payload = std::move(http_get_friends_result->payload);
-                delete http_get_friends_result;
-                http_get_friends_result = nullptr;
-            } else {
-                out.err = ESP_ERR_TIMEOUT;
-            }
-            return out;
-        }
-        http_get_friends_waiter = nullptr;
-        if (http_get_friends_result) {
-            out.err = http_get_friends_result->err;
-            out.status = http_get_friends_result->status;
-            out.payload = std::move(http_get_friends_result->payload);
-            delete http_get_friends_result;
-            http_get_friends_result = nullptr;
-        } else {
-            out.err = ESP_FAIL;
+    esp_err_t fetch_unread_count(bool from_deep_sleep) {
+        auto &api = dev_chat_api();
+        api.set_scheme("https");
+        const auto creds = chatapi::load_credentials_from_nvs();
+        if (chatapi::ensure_authenticated(api, creds) != ESP_OK) {
+            ESP_LOGW(TAG,
+                     "Chat API auth failed while refreshing unread count");
         }
-        return out;
-    }
 
-    void start_notifications() {
-        auto &running = notifications_task_running_flag();
-        bool expected = false;
-        if (!running.compare_exchange_strong(expected, true)) {
-            return;
-        }
-        {
-            wifi_ap_record_t ap = {};
-            if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
-                ESP_LOGI(TAG,
-                         "Skip starting notification task: Wi-Fi not connected");
-                running.store(false);
-                return;
-            }
+        std::string response;
+        int status = 0;
+        esp_err_t err = from_deep_sleep
+                            ? api.get_unread_count_on_wake(response, &status)
+                            : api.get_unread_count(response);
+        if (err == ESP_OK && status >= 400) err = ESP_FAIL;
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "get_unread_count failed: %s",
+                     esp_err_to_name(err));
+            unread_count_known_.store(false);
+            return err;
         }
 
-        TaskHandle_t handle = nullptr;
-        BaseType_t ok = xTaskCreatePinnedToCore(&http_get_notifications_task,
-                                                "http_get_notifications_task",
-                                                6000, NULL, 5, &handle, 0);
-        if (ok != pdPASS || handle == nullptr) {
-            ESP_LOGE(TAG, "Failed to start notification task (err=%ld)",
-                     static_cast<long>(ok));
-            running.store(false);
+        DynamicJsonDocument doc(response.size() + 128);
+        auto jerr = deserializeJson(doc, response);
+        if (jerr != DeserializationError::Ok) {
+            ESP_LOGE(TAG, "unread_count JSON parse error: %s", jerr.c_str());
+            unread_count_known_.store(false);
+            return ESP_FAIL;
         }
-    }
 
-    static JsonDocument get_notifications() {
-        std::lock_guard<std::mutex> lock(notif_mutex);
-        if (!notif_res_flag.load()) {
-            JsonDocument doc;
-            JsonArray data = doc.createNestedArray("notifications");
-            return doc;
+        int count = 0;
+        if (doc.containsKey("unread_count")) {
+            count = doc["unread_count"].as<int>();
+        } else if (doc.containsKey("count")) {
+            count = doc["count"].as<int>();
         }
-
-        notif_res_flag.store(false);
-        return notif_res;
+        if (count < 0) count = 0;
+        apply_unread_count(count);
+        return ESP_OK;
     }
 
-   private:
     void apply_unread_count(int count) {
         if (count < 0) count = 0;
         int previous = unread_count_.load();
@@ -866,18 +761,53 @@ inline void http_get_notifications_task(void *pvParameters) {
     }
     mqtt_rt_update_user(api_user_id.c_str());
 
+    // Sized for the largest publish the runtime accepts; kept for the life
+    // of the process since the task is restarted after Wi-Fi comes back.
+    static char *pop_buf = nullptr;
+    if (!pop_buf) pop_buf = mqtt_rt_alloc_pop_buffer();
+    if (!pop_buf) {
+        notifications_task_running_flag().store(false);
+        vTaskDelete(NULL);
+        return;
+    }
+
     int last_unread_count = -1;
-    int64_t last_poll_us = 0;
-    constexpr int64_t kUnreadPollIntervalUs = 5LL * 1000LL * 1000LL;
+    // HTTP is only used to reconcile after (re)connecting, when pushes may
+    // have been missed, or when a push carries no counters. The period adapts
+    // to link health: rare while MQTT is up, frequent while it is down.
+    uint32_t scheduled_connect_count = 0;
+    int64_t next_reconcile_us = 0;
+    int64_t next_housekeeping_us = 0;
+    uint32_t wakeups = 0;
+    constexpr int64_t kReconcileHealthyUs = 10LL * 60LL * 1000LL * 1000LL;
+    constexpr int64_t kReconcileDegradedUs = 60LL * 1000LL * 1000LL;
+    constexpr int64_t kReconcileRetryUs = 30LL * 1000LL * 1000LL;
+    constexpr int64_t kHousekeepingIntervalUs = 5LL * 1000LL * 1000LL;
 
     while (1) {
-        char buf[1024];
-        if (mqtt_rt_pop_message(buf, sizeof(buf))) {
+        // Sleep until MQTT data / link change or the nearest timer. Nothing
+        // spins here, so the core can enter light sleep between events.
+        int64_t now_us = esp_timer_get_time();
+        int64_t deadline_us = next_reconcile_us;
+        if (outbox::pending() > 0) {
+            deadline_us = std::min(deadline_us, next_housekeeping_us);
+        }
+        const int64_t wait_us = std::max<int64_t>(deadline_us - now_us, 0);
+        mqtt_rt_wait_event(static_cast<uint32_t>(
+            std::min<int64_t>(wait_us / 1000, UINT32_MAX - 1)));
+        ++wakeups;
+
+        char *buf = pop_buf;
+        while (mqtt_rt_pop_message(buf, MQTT_RT_POP_BUFFER_BYTES)) {
+            auto &client = HttpClient::shared();
+            const auto push = parse_unread_push(buf);
+
             StaticJsonDocument<1024> out;
             auto arr = out.createNestedArray("notifications");
             JsonObject o = arr.createNestedObject();
             o["notification_flag"] = "true";
             o["raw"] = buf;
+            if (!push.sender.empty()) o["sender"] = push.sender;
 
             std::string outBuf;
             serializeJson(out, outBuf);
@@ -887,8 +817,11 @@ inline void http_get_notifications_task(void *pvParameters) {
             }
             notif_res_flag.store(true);
 
-            auto &client = HttpClient::shared();
-            if (client.refresh_unread_count() != ESP_OK) {
+            if (push.has_count) {
+                client.apply_pushed_unread_count(push.unread_count);
+                notification_effects::signal_new_message();
+                last_unread_count = client.unread_count();
+            } else if (client.refresh_unread_count() != ESP_OK) {
                 client.force_unread_hint();
                 notification_effects::signal_new_message();
             } else if (client.has_unread_messages()) {
@@ -897,29 +830,54 @@ inline void http_get_notifications_task(void *pvParameters) {
             }
         }
 
-        const int64_t now_us = esp_timer_get_time();
-        if ((now_us - last_poll_us) >= kUnreadPollIntervalUs) {
-            last_poll_us = now_us;
+        now_us = esp_timer_get_time();
+        const bool mqtt_up = mqtt_rt_is_connected();
+        const uint32_t connect_count = mqtt_rt_connect_count();
+        if (mqtt_up && connect_count != scheduled_connect_count) {
+            // Fresh (re)connect: reconcile now (failures retry on their own
+            // timer below). A resumed session replays missed pushes itself,
+            // so after the first sync only the periodic check is needed.
+            const bool first_connect = scheduled_connect_count == 0;
+            scheduled_connect_count = connect_count;
+            next_reconcile_us = (first_connect || !mqtt_rt_session_present())
+                                    ? now_us
+                                    : now_us + kReconcileHealthyUs;
+        } else if (!mqtt_up) {
+            next_reconcile_us =
+                std::min(next_reconcile_us, now_us + kReconcileDegradedUs);
+        }
+        // The inbox keeps the newest pushes when a burst outgrows it; the
+        // server still has the evicted ones, so count them via HTTP now.
+        if (const uint32_t lost = mqtt_rt_take_overwritten(0)) {
+            ESP_LOGW(TAG, "%u push(es) overwritten before they were read",
+                     static_cast<unsigned>(lost));
+            next_reconcile_us = now_us;
+        }
+        if (now_us >= next_reconcile_us) {
             auto &client = HttpClient::shared();
-            const size_t free_internal = heap_caps_get_free_size(
-                MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
-            const size_t largest_internal = heap_caps_get_largest_free_block(
-                MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
-            if (http_get_task_handle != nullptr || free_internal < 12000 ||
-                largest_internal < 6000) {
-                vTaskDelay(pdMS_TO_TICKS(20));
-                continue;
-            }
             if (client.refresh_unread_count() == ESP_OK) {
                 const int current_unread = client.unread_count();
                 if (last_unread_count >= 0 && current_unread > last_unread_count) {
                     notification_effects::signal_new_message();
                 }
                 last_unread_count = current_unread;
+                next_reconcile_us =
+                    now_us + (mqtt_up ? kReconcileHealthyUs : kReconcileDegradedUs);
+                ESP_LOGI(TAG,
+                         "unread reconciled (%d, mqtt=%s #%u, wakeups=%u)",
+                         current_unread, mqtt_up ? "up" : "down",
+                         static_cast<unsigned>(connect_count),
+                         static_cast<unsigned>(wakeups));
+                wakeups = 0;
+            } else {
+                next_reconcile_us = now_us + kReconcileRetryUs;
             }
         }
 
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+        if (now_us >= next_housekeeping_us) {
+            next_housekeeping_us = now_us + kHousekeepingIntervalUs;
+            outbox::flush_if_due();
+        }
     }
 
     notifications_task_running_flag().store(false);
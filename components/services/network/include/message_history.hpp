@@ -0,0 +1,247 @@
+// Typed chat history shared by the HTTP and BLE fetch paths.
+//
+// Records are a flat vector; every string field is a span into one arena so
+// a 20-message history costs two allocations instead of a JsonDocument pool
+// plus per-field copies.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include <ArduinoJson.h>
+
+namespace chatapi {
+
+static const char* HISTORY_TAG = "MsgHistory";
+
+class MessageHistory {
+   public:
+    struct Span {
+        uint32_t off = 0;
+        uint32_t len = 0;
+    };
+
+    struct Record {
+        Span id;
+        Span created_at;
+        Span content;
+        bool outgoing = false;
+        bool has_read_flag = false;
+        bool is_read = false;
+
+        bool unread() const { return !(has_read_flag && is_read); }
+    };
+
+    MessageHistory() = default;
+    MessageHistory(MessageHistory&&) = default;
+    MessageHistory& operator=(MessageHistory&&) = default;
+    MessageHistory(const MessageHistory&) = delete;
+    MessageHistory& operator=(const MessageHistory&) = delete;
+
+    void clear() {
+        records_.clear();
+        arena_.clear();
+    }
+
+    void reserve(size_t records, size_t arena_bytes) {
+        records_.reserve(records);
+        arena_.reserve(arena_bytes);
+    }
+
+    void add(std::string_view id, std::string_view created_at,
+             std::string_view content, bool outgoing, bool has_read_flag,
+             bool is_read) {
+        Record r;
+        r.id = intern(id);
+        r.created_at = intern(created_at);
+        r.content = intern(content);
+        r.outgoing = outgoing;
+        r.has_read_flag = has_read_flag;
+        r.is_read = is_read;
+        records_.push_back(r);
+    }
+
+    // Oldest first; ties broken by id, matching the server's ordering.
+    void sort_chronological() {
+        std::stable_sort(records_.begin(), records_.end(),
+                         [this](const Record& a, const Record& b) {
+                             int cmp = view(a.created_at).compare(view(b.created_at));
+                             if (cmp == 0) return view(a.id) < view(b.id);
+                             return cmp < 0;
+                         });
+    }
+
+    void mark_read(size_t index) {
+        if (index >= records_.size()) return;
+        records_[index].has_read_flag = true;
+        records_[index].is_read = true;
+    }
+
+    size_t size() const { return records_.size(); }
+    bool empty() const { return records_.empty(); }
+    const std::vector<Record>& records() const { return records_; }
+    const Record& operator[](size_t index) const { return records_[index]; }
+
+    std::string_view view(const Span& span) const {
+        return std::string_view(arena_.data() + span.off, span.len);
+    }
+    std::string_view id(const Record& r) const { return view(r.id); }
+    std::string_view created_at(const Record& r) const {
+        return view(r.created_at);
+    }
+    std::string_view content(const Record& r) const { return view(r.content); }
+
+    size_t arena_bytes() const { return arena_.capacity(); }
+
+   private:
+    Span intern(std::string_view s) {
+        Span span;
+        span.off = static_cast<uint32_t>(arena_.size());
+        span.len = static_cast<uint32_t>(s.size());
+        arena_.append(s.data(), s.size());
+        return span;
+    }
+
+    std::vector<Record> records_;
+    std::string arena_;
+};
+
+// Decides whether a raw message was sent by this device's user. Receives the
+// raw sender_id / receiver_id / from fields (nullptr when absent or empty).
+using OutgoingResolver =
+    std::function<bool(const char* sender, const char* receiver,
+                       const char* from)>;
+
+// Parse a history payload in one pass into `out`. Accepts both
+// {"messages":[...]} (server) and {"payload":{"messages":[...]}} (BLE relay)
+// and both the current {content,sender_id,...} and the legacy
+// {message,from} record shapes. Returns false on a JSON error.
+inline bool parse_message_history(const char* json, size_t len,
+                                  const OutgoingResolver& is_outgoing,
+                                  MessageHistory& out) {
+    const int64_t started_us = esp_timer_get_time();
+    out.clear();
+
+    JsonDocument filter;
+    for (JsonObject f : {filter["messages"][0].to<JsonObject>(),
+                         filter["payload"]["messages"][0].to<JsonObject>()}) {
+        f["id"] = true;
+        f["message_id"] = true;
+        f["content"] = true;
+        f["message"] = true;
+        f["sender_id"] = true;
+        f["receiver_id"] = true;
+        f["from"] = true;
+        f["created_at"] = true;
+        f["is_read"] = true;
+    }
+
+    JsonDocument doc;
+    DeserializationError err = deserializeJson(
+        doc, json, len, DeserializationOption::Filter(filter));
+    if (err != DeserializationError::Ok) {
+        ESP_LOGW(HISTORY_TAG, "parse error: %s (len=%u)", err.c_str(),
+                 static_cast<unsigned>(len));
+        return false;
+    }
+
+    JsonArrayConst messages = doc["payload"]["messages"].as<JsonArrayConst>();
+    if (messages.isNull()) messages = doc["messages"].as<JsonArrayConst>();
+    if (messages.isNull()) return true;
+
+    // Every string we keep is a substring of the body, so len bounds the arena.
+    out.reserve(messages.size(), len);
+    auto non_empty = [](const char* s) -> const char* {
+        return (s && *s) ? s : nullptr;
+    };
+    for (JsonObjectConst m : messages) {
+        const char* content = m["content"].as<const char*>();
+        if (!content) content = m["message"].as<const char*>();
+        const char* id = m["id"].as<const char*>();
+        if (!id) id = m["message_id"].as<const char*>();
+        const char* created = m["created_at"].as<const char*>();
+        const bool has_read = !m["is_read"].isNull();
+        const bool outgoing =
+            is_outgoing(non_empty(m["sender_id"].as<const char*>()),
+                        non_empty(m["receiver_id"].as<const char*>()),
+                        non_empty(m["from"].as<const char*>()));
+        out.add(id ? id : "", created ? created : "", content ? content : "",
+                outgoing, has_read, has_read && m["is_read"].as<bool>());
+    }
+
+    ESP_LOGI(HISTORY_TAG, "parsed %u message(s) from %uB in %lldus (arena=%uB)",
+             static_cast<unsigned>(out.size()), static_cast<unsigned>(len),
+             static_cast<long long>(esp_timer_get_time() - started_us),
+             static_cast<unsigned>(out.arena_bytes()));
+    return true;
+}
+
+inline bool parse_message_history(const std::string& json,
+                                  const OutgoingResolver& is_outgoing,
+                                  MessageHistory& out) {
+    return parse_message_history(json.data(), json.size(), is_outgoing, out);
+}
+
+// Union of `base` and `delta` keyed by message id (delta wins, so read flags
+// picked up from the server replace cached ones), trimmed to the newest
+// `keep` records in chronological order.
+inline MessageHistory merge_message_history(const MessageHistory& base,
+                                            const MessageHistory& delta,
+                                            size_t keep) {
+    std::vector<std::pair<const MessageHistory*, size_t>> picked;
+    picked.reserve(base.size() + delta.size());
+    for (size_t i = 0; i < base.size(); ++i) {
+        const auto id = base.id(base[i]);
+        bool superseded = false;
+        if (!id.empty()) {
+            for (const auto& r : delta.records()) {
+                if (delta.id(r) == id) {
+                    superseded = true;
+                    break;
+                }
+            }
+        }
+        if (!superseded) picked.emplace_back(&base, i);
+    }
+    for (size_t i = 0; i < delta.size(); ++i) picked.emplace_back(&delta, i);
+
+    auto created = [](const std::pair<const MessageHistory*, size_t>& p) {
+        return p.first->created_at((*p.first)[p.second]);
+    };
+    auto id_of = [](const std::pair<const MessageHistory*, size_t>& p) {
+        return p.first->id((*p.first)[p.second]);
+    };
+    std::stable_sort(picked.begin(), picked.end(),
+                     [&](const auto& a, const auto& b) {
+                         int cmp = created(a).compare(created(b));
+                         if (cmp == 0) return id_of(a) < id_of(b);
+                         return cmp < 0;
+                     });
+    const size_t first = picked.size() > keep ? picked.size() - keep : 0;
+
+    MessageHistory out;
+    size_t arena = 0;
+    for (size_t i = first; i < picked.size(); ++i) {
+        const auto& r = (*picked[i].first)[picked[i].second];
+        arena += r.id.len + r.created_at.len + r.content.len;
+    }
+    out.reserve(picked.size() - first, arena);
+    for (size_t i = first; i < picked.size(); ++i) {
+        const MessageHistory& src = *picked[i].first;
+        const auto& r = src[picked[i].second];
+        out.add(src.id(r), src.created_at(r), src.content(r), r.outgoing,
+                r.has_read_flag, r.is_read);
+    }
+    return out;
+}
+
+}  // namespace chatapi
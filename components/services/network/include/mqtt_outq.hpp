@@ -0,0 +1,140 @@
+// Bounded outbound publish queue for the MQTT runtime.
+//
+// Callers (usually the UI task) only append here; the runtime's sender task
+// drains the queue while the broker link is up, so a publish never blocks on
+// the network and survives a disconnect or BLE pause. The queue is capped both
+// by entry count and by a byte budget (topic + payload).
+//
+// A coalescing publish replaces the payload of a still-queued publish on the
+// same topic instead of appending, so superseded state such as presence or
+// typing never reaches the broker. The entry keeps its place in line; its
+// generation changes so a sender that was mid-publish does not retire the
+// newer payload.
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace mqttrt {
+
+class OutQueue {
+   public:
+    struct Entry {
+        std::string topic;
+        std::string payload;
+        int qos = 0;
+        bool retain = false;
+        bool coalesce = false;
+        uint32_t gen = 0;
+        int64_t enqueued_us = 0;
+    };
+
+    struct Stats {
+        uint32_t enqueued = 0;
+        uint32_t sent = 0;
+        uint32_t coalesced = 0;  // replaced a queued publish on the same topic
+        uint32_t rejected = 0;   // over the entry cap or byte budget
+        uint32_t retried = 0;    // client refused; left queued for later
+        uint32_t peak_depth = 0;
+        uint32_t peak_bytes = 0;
+        uint32_t latency_max_ms = 0;
+        uint64_t latency_total_ms = 0;
+    };
+
+    enum class Push : uint8_t { kQueued, kCoalesced, kRejected };
+
+    OutQueue(size_t max_entries, size_t budget_bytes)
+        : max_entries_(max_entries), budget_bytes_(budget_bytes) {}
+
+    Push push(std::string_view topic, std::string_view payload, int qos,
+              bool retain, bool coalesce, int64_t now_us) {
+        if (coalesce) {
+            for (auto& e : q_) {
+                if (!e.coalesce || e.topic != topic) continue;
+                const size_t bytes = bytes_ - e.payload.size() + payload.size();
+                if (bytes > budget_bytes_) break;
+                bytes_ = bytes;
+                e.payload.assign(payload.data(), payload.size());
+                e.qos = qos;
+                e.retain = retain;
+                e.gen = next_gen_++;
+                ++stats_.coalesced;
+                note_peak();
+                return Push::kCoalesced;
+            }
+        }
+        const size_t cost = topic.size() + payload.size();
+        if (q_.size() >= max_entries_ || bytes_ + cost > budget_bytes_) {
+            ++stats_.rejected;
+            return Push::kRejected;
+        }
+        Entry e;
+        e.topic.assign(topic.data(), topic.size());
+        e.payload.assign(payload.data(), payload.size());
+        e.qos = qos;
+        e.retain = retain;
+        e.coalesce = coalesce;
+        e.gen = next_gen_++;
+        e.enqueued_us = now_us;
+        bytes_ += cost;
+        q_.push_back(std::move(e));
+        ++stats_.enqueued;
+        note_peak();
+        return Push::kQueued;
+    }
+
+    // Copies the oldest entry so it can be published without holding the
+    // caller's lock. Returns false when empty.
+    bool peek(Entry* out) const {
+        if (q_.empty() || !out) return false;
+        *out = q_.front();
+        return true;
+    }
+
+    // Retires the oldest entry once sent, unless it was coalesced meanwhile.
+    void sent(const Entry& e, int64_t now_us) {
+        if (q_.empty() || q_.front().gen != e.gen) return;
+        const uint32_t ms =
+            static_cast<uint32_t>((now_us - q_.front().enqueued_us) / 1000);
+        stats_.latency_total_ms += ms;
+        if (ms > stats_.latency_max_ms) stats_.latency_max_ms = ms;
+        ++stats_.sent;
+        bytes_ -= q_.front().topic.size() + q_.front().payload.size();
+        q_.pop_front();
+    }
+
+    void retry() { ++stats_.retried; }
+
+    bool empty() const { return q_.empty(); }
+    size_t depth() const { return q_.size(); }
+    size_t bytes() const { return bytes_; }
+    // Age of the oldest queued publish, 0 when empty.
+    uint32_t oldest_age_ms(int64_t now_us) const {
+        if (q_.empty()) return 0;
+        return static_cast<uint32_t>((now_us - q_.front().enqueued_us) / 1000);
+    }
+    Stats stats() const { return stats_; }
+
+   private:
+    void note_peak() {
+        if (q_.size() > stats_.peak_depth) {
+            stats_.peak_depth = static_cast<uint32_t>(q_.size());
+        }
+        if (bytes_ > stats_.peak_bytes) {
+            stats_.peak_bytes = static_cast<uint32_t>(bytes_);
+        }
+    }
+
+    std::deque<Entry> q_;
+    size_t bytes_ = 0;
+    size_t max_entries_;
+    size_t budget_bytes_;
+    uint32_t next_gen_ = 1;
+    Stats stats_;
+};
+
+}  // namespace mqttrt
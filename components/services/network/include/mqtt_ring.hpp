@@ -0,0 +1,203 @@
+// Bounded single-producer / single-consumer byte ring for MQTT payloads.
+//
+// Records are [u16 length][bytes], written contiguously modulo capacity, so
+// the MQTT task never allocates per message. Storage comes from PSRAM when
+// available. On overflow the ring either rejects the new record
+// (kDropNewest) or evicts the oldest ones (kOverwriteOldest).
+//
+// Payloads that arrive in chunks are written in place: begin() reserves the
+// slot, write() fills it at any offset and commit() makes it visible, so a
+// fragmented publish is copied exactly once.
+//
+// head_ is only written by the producer. tail_ is advanced by the consumer,
+// and by the producer when it evicts; both use CAS so a consumer that loses
+// the race discards its (possibly torn) copy and retries.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include "esp_heap_caps.h"
+
+namespace mqttrt {
+
+class ByteRing {
+   public:
+    enum class Overflow : uint8_t { kDropNewest, kOverwriteOldest };
+
+    struct Stats {
+        uint32_t pushed = 0;
+        uint32_t popped = 0;
+        uint32_t dropped = 0;      // rejected (too large or kDropNewest)
+        uint32_t overwritten = 0;  // evicted by kOverwriteOldest
+        uint32_t truncated = 0;    // consumer buffer smaller than record
+        uint32_t peak_bytes = 0;
+    };
+
+    static constexpr size_t kHeaderBytes = sizeof(uint16_t);
+
+    ByteRing() = default;
+    ByteRing(const ByteRing&) = delete;
+    ByteRing& operator=(const ByteRing&) = delete;
+    ~ByteRing() {
+        if (buf_) heap_caps_free(buf_);
+    }
+
+    // capacity is rounded up to a power of two so the free-running counters
+    // map to the same offset across uint32 wrap.
+    bool init(size_t capacity, Overflow policy) {
+        if (buf_) return true;
+        size_t pow2 = 64;
+        while (pow2 < capacity) pow2 <<= 1;
+        capacity = pow2;
+        buf_ = static_cast<uint8_t*>(
+            heap_caps_malloc(capacity, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+        if (!buf_) {
+            buf_ = static_cast<uint8_t*>(heap_caps_malloc(
+                capacity, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+        }
+        if (!buf_) return false;
+        capacity_ = static_cast<uint32_t>(capacity);
+        policy_ = policy;
+        return true;
+    }
+
+    bool ready() const { return buf_ != nullptr; }
+
+    // Producer side. Returns false if the record was dropped.
+    bool push(const void* data, size_t len) {
+        if (!begin(len)) return false;
+        write(0, data, len);
+        return commit();
+    }
+
+    // Producer side: reserves a record of total_len bytes. Only one record
+    // may be open at a time; it stays invisible to the consumer until commit.
+    bool begin(size_t total_len) {
+        abort();
+        const uint32_t need = static_cast<uint32_t>(kHeaderBytes + total_len);
+        if (!buf_ || total_len > 0xFFFF || need > capacity_) {
+            stats_.dropped++;
+            return false;
+        }
+        const uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+        while (capacity_ - (head - tail) < need) {
+            if (policy_ == Overflow::kDropNewest) {
+                stats_.dropped++;
+                return false;
+            }
+            const uint32_t next = tail + kHeaderBytes + read_len(tail);
+            if (tail_.compare_exchange_weak(tail, next,
+                                            std::memory_order_acq_rel)) {
+                stats_.overwritten++;
+                unseen_overwritten_.fetch_add(1, std::memory_order_relaxed);
+                tail = next;
+            }
+        }
+        const uint16_t len16 = static_cast<uint16_t>(total_len);
+        write_bytes(head, &len16, kHeaderBytes);
+        open_len_ = static_cast<uint32_t>(total_len);
+        open_ = true;
+        return true;
+    }
+
+    // Copies a chunk of the open record; bytes past its length are ignored.
+    void write(size_t offset, const void* data, size_t len) {
+        if (!open_ || offset >= open_len_) return;
+        len = std::min<size_t>(len, open_len_ - offset);
+        write_bytes(head_.load(std::memory_order_relaxed) + kHeaderBytes +
+                        static_cast<uint32_t>(offset),
+                    data, len);
+    }
+
+    bool commit() {
+        if (!open_) return false;
+        open_ = false;
+        const uint32_t head =
+            head_.load(std::memory_order_relaxed) + kHeaderBytes + open_len_;
+        head_.store(head, std::memory_order_release);
+        stats_.pushed++;
+        stats_.peak_bytes = std::max<uint32_t>(
+            stats_.peak_bytes, head - tail_.load(std::memory_order_acquire));
+        return true;
+    }
+
+    // Discards the open record, if any.
+    void abort() { open_ = false; }
+
+    // Consumer side. Copies the oldest record into out (NUL-terminated,
+    // truncated to cap - 1) and returns its original length, or -1 if empty.
+    int pop(char* out, size_t cap) {
+        if (!buf_ || !out || cap == 0) return -1;
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+        while (true) {
+            const uint32_t head = head_.load(std::memory_order_acquire);
+            if (tail == head) return -1;
+            const uint16_t len = read_len(tail);
+            const size_t n = std::min<size_t>(
+                std::min<size_t>(len, cap - 1), capacity_ - kHeaderBytes);
+            read_bytes(tail + kHeaderBytes, out, n);
+            const uint32_t next = tail + kHeaderBytes + len;
+            // Fails only if the producer evicted this record meanwhile; the
+            // copy may be torn, so reload and try the new oldest record.
+            if (tail_.compare_exchange_strong(tail, next,
+                                              std::memory_order_acq_rel)) {
+                out[n] = '\0';
+                stats_.popped++;
+                if (n < len) stats_.truncated++;
+                return len;
+            }
+        }
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) ==
+               tail_.load(std::memory_order_acquire);
+    }
+
+    Stats stats() const { return stats_; }
+
+    // Consumer side: records evicted since the previous call, so a consumer
+    // can tell it skipped messages and resync instead of silently losing them.
+    uint32_t take_overwritten() {
+        return unseen_overwritten_.exchange(0, std::memory_order_relaxed);
+    }
+
+   private:
+    uint16_t read_len(uint32_t pos) const {
+        uint16_t len = 0;
+        read_bytes(pos, &len, kHeaderBytes);
+        return len;
+    }
+
+    void write_bytes(uint32_t pos, const void* src, size_t len) {
+        const uint32_t off = pos % capacity_;
+        const size_t first = std::min<size_t>(len, capacity_ - off);
+        memcpy(buf_ + off, src, first);
+        memcpy(buf_, static_cast<const uint8_t*>(src) + first, len - first);
+    }
+
+    void read_bytes(uint32_t pos, void* dst, size_t len) const {
+        const uint32_t off = pos % capacity_;
+        const size_t first = std::min<size_t>(len, capacity_ - off);
+        memcpy(dst, buf_ + off, first);
+        memcpy(static_cast<uint8_t*>(dst) + first, buf_, len - first);
+    }
+
+    uint8_t* buf_ = nullptr;
+    uint32_t capacity_ = 0;
+    Overflow policy_ = Overflow::kOverwriteOldest;
+    bool open_ = false;
+    uint32_t open_len_ = 0;
+    // Free-running byte counters; unsigned wrap keeps head - tail valid.
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+    std::atomic<uint32_t> unseen_overwritten_{0};
+    Stats stats_;
+};
+
+}  // namespace mqttrt
@@ -7,6 +7,7 @@ extern "C" {
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 // Configure runtime (host, port, user_id for topic). Safe to call multiple times.
 int mqtt_rt_configure(const char* host, int port, const char* user_id);
@@ -24,19 +25,101 @@ int mqtt_rt_resume(void);
 // Update user for topic subscription; applies immediately if connected.
 int mqtt_rt_update_user(const char* user_id);
 
+// Largest publish the runtime delivers; bigger ones are dropped on arrival.
+// Pop buffers of MQTT_RT_POP_BUFFER_BYTES never truncate a message.
+#define MQTT_RT_MAX_PAYLOAD (16 * 1024)
+#define MQTT_RT_POP_BUFFER_BYTES (MQTT_RT_MAX_PAYLOAD + 1)
+
+// Allocates a MQTT_RT_POP_BUFFER_BYTES pop buffer, from PSRAM when available,
+// so consumers need not hold one on their stack. Release with
+// heap_caps_free(). Returns NULL when out of memory.
+char* mqtt_rt_alloc_pop_buffer(void);
+
 // Pop next personal message (chat/messages/<user_id>) if available.
 bool mqtt_rt_pop_message(char* out_json, size_t out_cap);
 
 // Lightweight helpers for additional MQTT topics (e.g., open chat rooms).
+// topic may use MQTT wildcards (+, #). Every matching listener receives a
+// copy; the broker subscription is shared while any listener uses it.
 int mqtt_rt_add_listener(const char* topic);
 void mqtt_rt_remove_listener(int listener_id);
 bool mqtt_rt_listener_pop(int listener_id, char* out_json, size_t out_cap);
 
+// Inbound ring counters. listener_id 0 selects the personal inbox.
+typedef struct {
+    uint32_t received;
+    uint32_t delivered;
+    uint32_t dropped;      // did not fit (larger than the ring)
+    uint32_t overwritten;  // oldest records evicted to make room
+    uint32_t truncated;    // popped into a smaller buffer
+    uint32_t peak_bytes;
+} mqtt_rt_ring_stats_t;
+
+bool mqtt_rt_get_ring_stats(int listener_id, mqtt_rt_ring_stats_t* out);
+
+// Both rings keep the newest records when a burst outgrows them. Returns how
+// many older records were evicted since the previous call for this ring
+// (listener_id 0 selects the personal inbox) and resets the count; callers
+// check it after draining and resync or show the gap.
+uint32_t mqtt_rt_take_overwritten(int listener_id);
+
+// Reassembly counters for publishes larger than the MQTT client buffer.
+typedef struct {
+    uint32_t fragmented;  // delivered in more than one chunk
+    uint32_t oversized;   // above the inbound size cap, dropped
+    uint32_t incomplete;  // abandoned before the last chunk arrived
+} mqtt_rt_rx_stats_t;
+
+void mqtt_rt_get_rx_stats(mqtt_rt_rx_stats_t* out);
+
+// Queue a publish; the runtime's sender task sends it once the link is up, so
+// this never blocks on the network. Returns 0 when queued, <0 if rejected
+// (bad args or the outbound budget is exhausted).
 int mqtt_rt_publish(const char* topic, const char* payload, int qos, bool retain);
 
+// Replace a still-queued publish on the same topic instead of appending, for
+// state where only the latest value matters (presence, typing).
+#define MQTT_RT_PUB_COALESCE 0x1u
+
+int mqtt_rt_publish_ex(const char* topic, const char* payload, int qos, bool retain,
+                       uint32_t flags);
+
+// Outbound queue counters and latency (enqueue to handed to the client).
+typedef struct {
+    uint32_t depth;          // publishes waiting now
+    uint32_t bytes;          // topic + payload bytes waiting now
+    uint32_t oldest_age_ms;  // age of the head of the queue
+    uint32_t enqueued;
+    uint32_t sent;
+    uint32_t coalesced;  // superseded by a newer publish on the same topic
+    uint32_t rejected;   // over the entry cap or byte budget
+    uint32_t retried;    // refused by the client, kept for a later attempt
+    uint32_t peak_depth;
+    uint32_t peak_bytes;
+    uint32_t latency_avg_ms;
+    uint32_t latency_max_ms;
+} mqtt_rt_tx_stats_t;
+
+void mqtt_rt_get_tx_stats(mqtt_rt_tx_stats_t* out);
+
 // Is client currently running/connected (best-effort)?
 bool mqtt_rt_is_running(void);
 
+// Number of successful broker connections since boot. A change means the
+// link dropped and came back, so pushed state may have been missed.
+uint32_t mqtt_rt_connect_count(void);
+
+// True while the client holds a live broker connection.
+bool mqtt_rt_is_connected(void);
+// True when the current connection resumed a persistent broker session, so
+// QoS1 messages published while offline are redelivered over MQTT.
+bool mqtt_rt_session_present(void);
+
+// Block the calling task until a personal message arrives, the link goes up
+// or down, or timeout_ms elapses (UINT32_MAX waits forever). Returns true if
+// woken by an event. Single consumer: the last caller becomes the waiter.
+bool mqtt_rt_wait_event(uint32_t timeout_ms);
+
 #ifdef __cplusplus
 }
 #endif
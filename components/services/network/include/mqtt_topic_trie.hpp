@@ -0,0 +1,157 @@
+// MQTT topic-filter trie for routing inbound publishes to listeners.
+//
+// One node per topic level; '+' and '#' are stored as ordinary children and
+// tried alongside the exact child while walking the published topic, so the
+// match cost grows with topic depth and the number of wildcard branches, not
+// with the number of subscriptions. Matching does not allocate.
+
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mqttrt {
+
+// Validates a subscription filter per MQTT 3.1.1 section 4.7.1: '+' must take a
+// whole level, '#' must take a whole level and be the last one.
+inline bool topic_filter_valid(std::string_view filter) {
+    if (filter.empty()) return false;
+    size_t start = 0;
+    while (true) {
+        const size_t slash = filter.find('/', start);
+        const std::string_view level = filter.substr(
+            start, slash == std::string_view::npos ? std::string_view::npos
+                                                   : slash - start);
+        const bool has_plus = level.find('+') != std::string_view::npos;
+        const bool has_hash = level.find('#') != std::string_view::npos;
+        if (has_plus && level.size() != 1) return false;
+        if (has_hash && (level.size() != 1 || slash != std::string_view::npos)) {
+            return false;
+        }
+        if (slash == std::string_view::npos) return true;
+        start = slash + 1;
+    }
+}
+
+template <typename T>
+class TopicTrie {
+   public:
+    void insert(std::string_view filter, T value) {
+        Node* node = &root_;
+        for_each_level(filter, [&](std::string_view level) {
+            auto it = node->children.find(level);
+            if (it == node->children.end()) {
+                it = node->children
+                         .emplace(std::string(level), std::make_unique<Node>())
+                         .first;
+            }
+            node = it->second.get();
+        });
+        node->values.push_back(value);
+        ++size_;
+    }
+
+    bool erase(std::string_view filter, const T& value) {
+        if (!erase_at(root_, filter, 0, value)) return false;
+        --size_;
+        return true;
+    }
+
+    // Calls fn(value) once per matching subscription. Topics starting with
+    // '$' are not matched by a leading wildcard.
+    template <typename Fn>
+    void match(std::string_view topic, Fn&& fn) const {
+        match_at(root_, topic, 0, topic.empty() || topic[0] != '$', fn);
+    }
+
+    size_t size() const { return size_; }
+
+   private:
+    struct Node {
+        std::map<std::string, std::unique_ptr<Node>, std::less<>> children;
+        std::vector<T> values;
+    };
+
+    template <typename Fn>
+    static void for_each_level(std::string_view s, Fn&& fn) {
+        size_t start = 0;
+        while (true) {
+            const size_t slash = s.find('/', start);
+            if (slash == std::string_view::npos) {
+                fn(s.substr(start));
+                return;
+            }
+            fn(s.substr(start, slash - start));
+            start = slash + 1;
+        }
+    }
+
+    // pos is the offset of the current level in topic, or npos once every
+    // level has been consumed.
+    template <typename Fn>
+    static void match_at(const Node& node, std::string_view topic, size_t pos,
+                         bool wildcards, Fn& fn) {
+        if (wildcards) {
+            // "a/#" also matches "a" itself.
+            auto hash = node.children.find(std::string_view("#"));
+            if (hash != node.children.end()) {
+                for (const auto& v : hash->second->values) fn(v);
+            }
+        }
+        if (pos == std::string_view::npos) {
+            for (const auto& v : node.values) fn(v);
+            return;
+        }
+        const size_t slash = topic.find('/', pos);
+        const std::string_view level =
+            topic.substr(pos, slash == std::string_view::npos
+                                  ? std::string_view::npos
+                                  : slash - pos);
+        const size_t next =
+            slash == std::string_view::npos ? std::string_view::npos : slash + 1;
+        auto exact = node.children.find(level);
+        if (exact != node.children.end()) {
+            match_at(*exact->second, topic, next, true, fn);
+        }
+        if (wildcards) {
+            auto plus = node.children.find(std::string_view("+"));
+            if (plus != node.children.end()) {
+                match_at(*plus->second, topic, next, true, fn);
+            }
+        }
+    }
+
+    // Returns true if value was removed; prunes nodes left empty.
+    static bool erase_at(Node& node, std::string_view filter, size_t pos,
+                         const T& value) {
+        if (pos == std::string_view::npos) {
+            auto it = std::find(node.values.begin(), node.values.end(), value);
+            if (it == node.values.end()) return false;
+            node.values.erase(it);
+            return true;
+        }
+        const size_t slash = filter.find('/', pos);
+        const std::string_view level =
+            filter.substr(pos, slash == std::string_view::npos
+                                   ? std::string_view::npos
+                                   : slash - pos);
+        auto child = node.children.find(level);
+        if (child == node.children.end()) return false;
+        const size_t next =
+            slash == std::string_view::npos ? std::string_view::npos : slash + 1;
+        if (!erase_at(*child->second, filter, next, value)) return false;
+        if (child->second->values.empty() && child->second->children.empty()) {
+            node.children.erase(child);
+        }
+        return true;
+    }
+
+    Node root_;
+    size_t size_ = 0;
+};
+
+}  // namespace mqttrt
@@ -0,0 +1,275 @@
+// Single long-lived network worker with a bounded priority queue.
+//
+// All ChatApiClient traffic issued through HttpClient runs on this one task,
+// so only one HTTP stack is resident and requests never contend for the
+// client's request mutex. Lower Priority values run first; FIFO within a
+// class. Callers block on a Future (binary semaphore) instead of polling.
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_task_wdt.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+namespace netexec {
+
+static const char* EXEC_TAG = "NetExec";
+
+enum class Priority : uint8_t {
+    kUser = 0,        // user-visible sends
+    kForeground = 1,  // history / contact loads a screen is waiting on
+    kBackground = 2,  // unread polls and other periodic checks
+};
+
+template <typename T>
+class Future {
+   public:
+    struct State {
+        SemaphoreHandle_t done = xSemaphoreCreateBinary();
+        bool completed = false;
+        T value{};
+        ~State() {
+            if (done) vSemaphoreDelete(done);
+        }
+    };
+
+    Future() = default;
+    explicit Future(std::shared_ptr<State> state) : state_(std::move(state)) {}
+
+    bool valid() const { return state_ && state_->done; }
+
+    // Returns true once the job ran to completion. False on timeout or if the
+    // job was dropped from the queue. Feeds the task WDT while waiting.
+    bool wait(uint32_t timeout_ms) {
+        if (!valid()) return false;
+        constexpr TickType_t kSliceTicks = pdMS_TO_TICKS(200);
+        TickType_t remaining =
+            timeout_ms ? pdMS_TO_TICKS(timeout_ms) : portMAX_DELAY;
+        while (true) {
+            TickType_t slice = kSliceTicks > 0 ? kSliceTicks : 1;
+            if (remaining != portMAX_DELAY && slice > remaining) slice = remaining;
+            if (xSemaphoreTake(state_->done, slice) == pdTRUE) {
+                // Keep the semaphore signalled for repeated waits.
+                xSemaphoreGive(state_->done);
+                return state_->completed;
+            }
+            if (esp_task_wdt_status(nullptr) == ESP_OK) {
+                (void)esp_task_wdt_reset();
+            }
+            if (remaining != portMAX_DELAY) {
+                if (remaining <= slice) return false;
+                remaining -= slice;
+            }
+        }
+    }
+
+    // Only meaningful after wait() returned true.
+    T take() { return std::move(state_->value); }
+
+   private:
+    std::shared_ptr<State> state_;
+};
+
+class Executor {
+   public:
+    struct Stats {
+        uint32_t executed = 0;
+        uint32_t rejected = 0;
+        uint32_t dropped = 0;
+        uint32_t max_depth = 0;
+        uint32_t max_wait_ms = 0;
+    };
+
+    static constexpr size_t kMaxQueuedJobs = 8;
+    static constexpr uint32_t kStackWords = 6192;
+
+    static Executor& shared() {
+        static Executor instance;
+        return instance;
+    }
+
+    // Submit `fn` (returning T) and get a Future for its result. Returns an
+    // invalid Future if the queue is full of equal-or-higher priority work.
+    template <typename T, typename Fn>
+    Future<T> submit(Priority prio, const char* label, Fn&& fn) {
+        auto state = std::make_shared<typename Future<T>::State>();
+        if (!state->done) return Future<T>();
+        auto job_fn = [state, fn = std::forward<Fn>(fn)](bool run) mutable {
+            if (run) {
+                state->value = fn();
+                state->completed = true;
+            }
+            xSemaphoreGive(state->done);
+        };
+        if (!enqueue(prio, label, std::move(job_fn))) return Future<T>();
+        return Future<T>(std::move(state));
+    }
+
+    // Fire-and-forget variant.
+    bool post(Priority prio, const char* label, std::function<void()> fn) {
+        return enqueue(prio, label, [fn = std::move(fn)](bool run) {
+            if (run) fn();
+        });
+    }
+
+    bool in_worker() const {
+        return task_handle_ != nullptr &&
+               xTaskGetCurrentTaskHandle() == task_handle_;
+    }
+
+    size_t depth() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.size();
+    }
+
+    Stats stats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+   private:
+    struct Job {
+        Priority prio = Priority::kBackground;
+        uint32_t seq = 0;
+        int64_t enqueued_us = 0;
+        const char* label = "";
+        // Called with true to execute, false when dropped unrun.
+        std::function<void(bool)> fn;
+    };
+
+    Executor() { queue_.reserve(kMaxQueuedJobs); }
+
+    static bool runs_before(const Job& a, const Job& b) {
+        if (a.prio != b.prio) return a.prio < b.prio;
+        return a.seq < b.seq;
+    }
+
+    // Heap comparator: the front of queue_ is the job that runs first.
+    static bool later(const Job& a, const Job& b) { return runs_before(b, a); }
+
+    bool ensure_started() {
+        if (task_handle_) return true;
+        if (!wake_) wake_ = xSemaphoreCreateCounting(kMaxQueuedJobs, 0);
+        if (!stack_) {
+            stack_ = static_cast<StackType_t*>(heap_caps_malloc(
+                kStackWords * sizeof(StackType_t),
+                MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+        }
+        if (!wake_ || !stack_) {
+            ESP_LOGE(EXEC_TAG, "start failed (free=%u largest=%u)",
+                     static_cast<unsigned>(heap_caps_get_free_size(
+                         MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)),
+                     static_cast<unsigned>(heap_caps_get_largest_free_block(
+                         MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)));
+            return false;
+        }
+        task_handle_ = xTaskCreateStaticPinnedToCore(
+            &Executor::task_main, "net_worker", kStackWords, this, 5, stack_,
+            &task_buffer_, tskNO_AFFINITY);
+        return task_handle_ != nullptr;
+    }
+
+    bool enqueue(Priority prio, const char* label,
+                 std::function<void(bool)> fn) {
+        Job dropped;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!ensure_started()) {
+                ++stats_.rejected;
+                return false;
+            }
+            Job job;
+            job.prio = prio;
+            job.seq = next_seq_++;
+            job.enqueued_us = esp_timer_get_time();
+            job.label = label;
+            job.fn = std::move(fn);
+            if (queue_.size() >= kMaxQueuedJobs) {
+                // Make room by dropping the newest lowest-priority job, but
+                // never in favour of equal or lower priority work.
+                auto victim = std::max_element(queue_.begin(), queue_.end(),
+                                               runs_before);
+                if (!runs_before(job, *victim)) {
+                    ++stats_.rejected;
+                    ESP_LOGW(EXEC_TAG, "queue full; rejected %s", label);
+                    return false;
+                }
+                dropped = std::move(*victim);
+                queue_.erase(victim);
+                // The victim can sit anywhere in the heap; erasing it breaks
+                // the heap order, so rebuild before pushing.
+                std::make_heap(queue_.begin(), queue_.end(), later);
+                ++stats_.dropped;
+            } else {
+                xSemaphoreGive(wake_);
+            }
+            queue_.push_back(std::move(job));
+            std::push_heap(queue_.begin(), queue_.end(), later);
+            stats_.max_depth = std::max<uint32_t>(
+                stats_.max_depth, static_cast<uint32_t>(queue_.size()));
+        }
+        if (dropped.fn) {
+            ESP_LOGW(EXEC_TAG, "queue full; dropped %s for %s", dropped.label,
+                     label);
+            dropped.fn(false);
+        }
+        return true;
+    }
+
+    bool pop(Job& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.empty()) return false;
+        std::pop_heap(queue_.begin(), queue_.end(), later);
+        out = std::move(queue_.back());
+        queue_.pop_back();
+        return true;
+    }
+
+    static void task_main(void* arg) {
+        auto* self = static_cast<Executor*>(arg);
+        while (true) {
+            xSemaphoreTake(self->wake_, portMAX_DELAY);
+            Job job;
+            if (!self->pop(job)) continue;
+            const int64_t started_us = esp_timer_get_time();
+            const uint32_t waited_ms =
+                static_cast<uint32_t>((started_us - job.enqueued_us) / 1000);
+            job.fn(true);
+            const uint32_t ran_ms = static_cast<uint32_t>(
+                (esp_timer_get_time() - started_us) / 1000);
+            {
+                std::lock_guard<std::mutex> lock(self->mutex_);
+                ++self->stats_.executed;
+                self->stats_.max_wait_ms =
+                    std::max(self->stats_.max_wait_ms, waited_ms);
+            }
+            ESP_LOGI(EXEC_TAG, "%s prio=%d wait=%ums run=%ums stack_hwm=%u",
+                     job.label, static_cast<int>(job.prio),
+                     static_cast<unsigned>(waited_ms),
+                     static_cast<unsigned>(ran_ms),
+                     static_cast<unsigned>(uxTaskGetStackHighWaterMark(nullptr)));
+        }
+    }
+
+    std::mutex mutex_;
+    std::vector<Job> queue_;  // binary heap ordered by runs_before
+    uint32_t next_seq_ = 0;
+    Stats stats_;
+    SemaphoreHandle_t wake_ = nullptr;
+    StackType_t* stack_ = nullptr;
+    StaticTask_t task_buffer_;
+    TaskHandle_t task_handle_ = nullptr;
+};
+
+}  // namespace netexec
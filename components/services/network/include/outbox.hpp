@@ -0,0 +1,418 @@
+// Durable outbox for outgoing chat messages.
+//
+// Every send is appended to /storage/outbox.log before any network I/O, so a
+// message typed while offline survives until Wi-Fi or the BLE relay comes
+// back. Each entry carries a client_message_id so the phone relay (and a
+// server that honours it) can drop the repeat an at-least-once retry may
+// produce; the server API does not document that deduplication yet.
+//
+// Log records: 'A' key api_receiver relay_receiver content (queued) and
+// 'D' key (delivered or dropped). Replay = A minus D; the file is compacted
+// once it is mostly D records.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+#include <ArduinoJson.h>
+#include <ble_rpc.hpp>
+#include <ble_uart.hpp>
+
+#include "chat_api.hpp"
+#include "net_executor.hpp"
+#include "storage_fs.hpp"
+
+extern EventGroupHandle_t s_wifi_event_group;
+
+namespace outbox {
+
+static const char* OUTBOX_TAG = "Outbox";
+
+struct Entry {
+    std::string key;
+    std::string api_receiver;    // server chat id (HTTP)
+    std::string relay_receiver;  // id the phone app expects (BLE)
+    std::string content;
+};
+
+struct FlushResult {
+    size_t sent = 0;
+    size_t dropped = 0;
+    size_t remaining = 0;
+};
+
+namespace detail {
+
+static constexpr size_t kMaxEntries = 64;
+static constexpr size_t kCompactAfterDone = 16;
+static constexpr int64_t kBackoffBaseUs = 2LL * 1000LL * 1000LL;
+static constexpr int64_t kBackoffMaxUs = 5LL * 60LL * 1000LL * 1000LL;
+// How long the phone gets to answer a relayed send with send_message_result.
+static constexpr uint32_t kBleAckTimeoutMs = 5000;
+
+struct State {
+    std::mutex mutex;
+    bool loaded = false;
+    std::vector<Entry> pending;
+    size_t done_records = 0;
+    uint32_t failures = 0;
+    int64_t next_attempt_us = 0;
+    std::atomic<bool> flush_queued{false};
+};
+
+inline State& state() {
+    static State s;
+    return s;
+}
+
+inline std::string log_path() { return storage_fs::path("outbox.log"); }
+
+inline std::string make_key() {
+    uint8_t raw[8];
+    esp_fill_random(raw, sizeof(raw));
+    char key[17];
+    for (size_t i = 0; i < sizeof(raw); ++i) {
+        snprintf(key + i * 2, 3, "%02x", raw[i]);
+    }
+    return std::string(key, 16);
+}
+
+inline void encode_add(std::string& buf, const Entry& e) {
+    storage_fs::put(buf, static_cast<uint8_t>('A'));
+    storage_fs::put_str(buf, e.key);
+    storage_fs::put_str(buf, e.api_receiver);
+    storage_fs::put_str(buf, e.relay_receiver);
+    storage_fs::put_str(buf, e.content);
+}
+
+inline void encode_done(std::string& buf, const std::string& key) {
+    storage_fs::put(buf, static_cast<uint8_t>('D'));
+    storage_fs::put_str(buf, key);
+}
+
+inline void load_locked(State& s) {
+    if (s.loaded) return;
+    s.loaded = true;
+    std::string buf;
+    if (!storage_fs::read_file(log_path(), buf)) return;
+    storage_fs::Reader r{buf};
+    while (!r.at_end()) {
+        const uint8_t type = r.get<uint8_t>();
+        if (type == 'A') {
+            Entry e;
+            e.key = std::string(r.get_str());
+            e.api_receiver = std::string(r.get_str());
+            e.relay_receiver = std::string(r.get_str());
+            e.content = std::string(r.get_str());
+            if (!r.ok) break;
+            s.pending.push_back(std::move(e));
+        } else if (type == 'D') {
+            const auto key = r.get_str();
+            if (!r.ok) break;
+            s.pending.erase(std::remove_if(s.pending.begin(), s.pending.end(),
+                                           [&](const Entry& e) {
+                                               return e.key == key;
+                                           }),
+                            s.pending.end());
+            ++s.done_records;
+        } else {
+            r.ok = false;
+            break;
+        }
+    }
+    if (!r.ok) {
+        ESP_LOGW(OUTBOX_TAG, "ignoring torn tail at %u/%u",
+                 static_cast<unsigned>(r.pos),
+                 static_cast<unsigned>(buf.size()));
+        // Rewrite so the next append does not land after garbage.
+        s.done_records = kCompactAfterDone;
+    }
+    ESP_LOGI(OUTBOX_TAG, "restored %u pending message(s)",
+             static_cast<unsigned>(s.pending.size()));
+}
+
+inline void compact_locked(State& s) {
+    if (s.pending.empty()) {
+        storage_fs::remove_file(log_path());
+    } else {
+        std::string buf;
+        for (const auto& e : s.pending) encode_add(buf, e);
+        storage_fs::write_file_atomic(log_path(), buf.data(), buf.size());
+    }
+    s.done_records = 0;
+}
+
+inline void mark_done_locked(State& s, const std::string& key) {
+    s.pending.erase(std::remove_if(s.pending.begin(), s.pending.end(),
+                                   [&](const Entry& e) { return e.key == key; }),
+                    s.pending.end());
+    if (s.pending.empty() ||
+        ++s.done_records >= kCompactAfterDone) {
+        compact_locked(s);
+        return;
+    }
+    std::string buf;
+    encode_done(buf, key);
+    storage_fs::append_file(log_path(), buf.data(), buf.size());
+}
+
+inline void schedule_backoff_locked(State& s) {
+    const uint32_t shift = std::min<uint32_t>(s.failures, 8);
+    int64_t delay = std::min(kBackoffBaseUs << shift, kBackoffMaxUs);
+    // +-25% jitter so devices behind one AP do not retry in lockstep.
+    delay += static_cast<int64_t>(esp_random() % (delay / 2 + 1)) - delay / 4;
+    ++s.failures;
+    s.next_attempt_us = esp_timer_get_time() + delay;
+    ESP_LOGW(OUTBOX_TAG, "flush failed %u time(s); retry in %lldms",
+             static_cast<unsigned>(s.failures),
+             static_cast<long long>(delay / 1000));
+}
+
+inline bool wifi_connected() {
+    if (s_wifi_event_group &&
+        (xEventGroupGetBits(s_wifi_event_group) & BIT0) != 0) {
+        return true;
+    }
+    wifi_ap_record_t ap = {};
+    return esp_wifi_sta_get_ap_info(&ap) == ESP_OK;
+}
+
+// HTTP 4xx other than auth/timeout/rate-limit will never succeed on retry.
+inline bool is_permanent_status(int status) {
+    return status >= 400 && status < 500 && status != 401 && status != 408 &&
+           status != 429;
+}
+
+enum class BleOutcome { kDelivered, kRejected, kFailed };
+
+// ble_uart_send() only means the frame reached the local TX queue, which is
+// dropped on disconnect or stall. A phone that announced
+// BLE_UART_PEER_ACKS_SEND_MESSAGE in its hello must answer with
+// send_message_result before the entry counts as delivered; without an answer
+// it stays queued and the retry is deduplicated by client_message_id. Apps
+// that never answer keep the old behaviour: queued for TX counts as sent, so
+// they are not resent the same message on every backoff cycle.
+inline BleOutcome send_over_ble(const Entry& e) {
+    JsonDocument doc;
+    doc["id"] = e.key;
+    doc["type"] = "send_message";
+    doc["payload"]["receiver_id"] = e.relay_receiver;
+    doc["payload"]["content"] = e.content;
+    doc["payload"]["client_message_id"] = e.key;
+    std::string json;
+    serializeJson(doc, json);
+    json.push_back('\n');
+    if ((ble_uart_peer_caps() & BLE_UART_PEER_ACKS_SEND_MESSAGE) == 0) {
+        if (ble_uart_send(reinterpret_cast<const uint8_t*>(json.data()),
+                          json.size()) == 0) {
+            return BleOutcome::kDelivered;
+        }
+        ESP_LOGW(OUTBOX_TAG, "%s: BLE TX queue rejected send", e.key.c_str());
+        return BleOutcome::kFailed;
+    }
+    blerpc::Call call = blerpc::start(e.key, json, {"send_message_result"});
+    if (!call.valid() || !blerpc::wait(call, kBleAckTimeoutMs)) {
+        ESP_LOGW(OUTBOX_TAG, "%s: no send_message_result from phone",
+                 e.key.c_str());
+        return BleOutcome::kFailed;
+    }
+    JsonDocument reply;
+    if (deserializeJson(reply, call.response()) != DeserializationError::Ok) {
+        return BleOutcome::kFailed;
+    }
+    if (reply["ok"].as<bool>()) return BleOutcome::kDelivered;
+    const int status = reply["status"] | 0;
+    ESP_LOGW(OUTBOX_TAG, "%s: phone reported failure (status=%d error=%s)",
+             e.key.c_str(), status, reply["error"] | "");
+    return is_permanent_status(status) ? BleOutcome::kRejected
+                                       : BleOutcome::kFailed;
+}
+
+}  // namespace detail
+
+inline size_t pending() {
+    auto& s = detail::state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    detail::load_locked(s);
+    return s.pending.size();
+}
+
+// Persist a message for delivery. Returns its idempotency key, or an empty
+// string if the outbox is full.
+inline std::string enqueue(const std::string& api_receiver,
+                           const std::string& relay_receiver,
+                           const std::string& content) {
+    auto& s = detail::state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    detail::load_locked(s);
+    if (s.pending.size() >= detail::kMaxEntries) {
+        ESP_LOGE(OUTBOX_TAG, "outbox full (%u); message rejected",
+                 static_cast<unsigned>(s.pending.size()));
+        return std::string();
+    }
+    Entry e;
+    e.key = detail::make_key();
+    e.api_receiver = api_receiver;
+    e.relay_receiver = relay_receiver.empty() ? api_receiver : relay_receiver;
+    e.content = content;
+    std::string buf;
+    detail::encode_add(buf, e);
+    if (!storage_fs::append_file(detail::log_path(), buf.data(), buf.size())) {
+        ESP_LOGW(OUTBOX_TAG, "append failed; %s kept in RAM only",
+                 e.key.c_str());
+    }
+    s.pending.push_back(std::move(e));
+    return s.pending.back().key;
+}
+
+// Deliver everything queued, oldest first. Runs on the network worker so the
+// whole batch shares one pooled HTTP connection. Stops at the first transport
+// failure and backs off.
+inline FlushResult flush_now() {
+    auto& s = detail::state();
+    FlushResult result;
+    std::vector<Entry> batch;
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        detail::load_locked(s);
+        batch = s.pending;
+    }
+    if (batch.empty()) return result;
+
+    const bool use_wifi = detail::wifi_connected();
+    const bool use_ble = !use_wifi && ble_uart_is_ready();
+    if (!use_wifi && !use_ble) {
+        result.remaining = batch.size();
+        return result;
+    }
+
+    chatapi::ChatApiClient* api = nullptr;
+    chatapi::Credentials creds;
+    if (use_wifi) {
+        api = &chatapi::shared_client(true);
+        api->set_scheme("https");
+        creds = chatapi::load_credentials_from_nvs();
+        if (chatapi::ensure_authenticated(*api, creds) != ESP_OK) {
+            ESP_LOGW(OUTBOX_TAG, "auth failed; trying cached token");
+        }
+    }
+
+    const int64_t started_us = esp_timer_get_time();
+    bool transport_failed = false;
+    for (const auto& e : batch) {
+        bool delivered = false;
+        bool drop = false;
+        if (use_ble) {
+            const auto outcome = detail::send_over_ble(e);
+            delivered = outcome == detail::BleOutcome::kDelivered;
+            drop = outcome == detail::BleOutcome::kRejected;
+        } else {
+            int status = 0;
+            esp_err_t err = api->send_message(e.api_receiver, e.content,
+                                              nullptr, &status, e.key);
+            if (err == ESP_OK && status == 401 &&
+                chatapi::ensure_authenticated(*api, creds, false,
+                                              /*force_refresh=*/true) ==
+                    ESP_OK) {
+                status = 0;
+                err = api->send_message(e.api_receiver, e.content, nullptr,
+                                        &status, e.key);
+            }
+            if (err == ESP_OK && status >= 200 && status < 300) {
+                delivered = true;
+            } else if (err == ESP_OK && detail::is_permanent_status(status)) {
+                ESP_LOGE(OUTBOX_TAG, "%s rejected with HTTP %d; dropping",
+                         e.key.c_str(), status);
+                drop = true;
+            } else {
+                ESP_LOGW(OUTBOX_TAG, "%s send failed: %s (status=%d)",
+                         e.key.c_str(), esp_err_to_name(err), status);
+            }
+        }
+        if (!delivered && !drop) {
+            transport_failed = true;
+            break;
+        }
+        std::lock_guard<std::mutex> lock(s.mutex);
+        detail::mark_done_locked(s, e.key);
+        if (delivered) ++result.sent;
+        else ++result.dropped;
+    }
+
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (transport_failed) {
+        detail::schedule_backoff_locked(s);
+    } else {
+        s.failures = 0;
+        s.next_attempt_us = 0;
+    }
+    result.remaining = s.pending.size();
+    ESP_LOGI(OUTBOX_TAG, "flush via %s: sent=%u dropped=%u remaining=%u in %lldms",
+             use_ble ? "ble" : "wifi", static_cast<unsigned>(result.sent),
+             static_cast<unsigned>(result.dropped),
+             static_cast<unsigned>(result.remaining),
+             static_cast<long long>((esp_timer_get_time() - started_us) / 1000));
+    return result;
+}
+
+// Queue a flush on the network worker. `force` skips the backoff window; use
+// it when a transport has just come up.
+inline netexec::Future<FlushResult> schedule_flush(bool force = false) {
+    auto& s = detail::state();
+    if (force) {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.failures = 0;
+        s.next_attempt_us = 0;
+    }
+    if (s.flush_queued.exchange(true)) return netexec::Future<FlushResult>();
+    auto future = netexec::Executor::shared().submit<FlushResult>(
+        netexec::Priority::kUser, "outbox_flush", [&s]() {
+            s.flush_queued.store(false);
+            return flush_now();
+        });
+    if (!future.valid()) s.flush_queued.store(false);
+    return future;
+}
+
+// Cheap periodic hook: schedules a flush only when something is queued and
+// the backoff window has passed.
+inline void flush_if_due() {
+    auto& s = detail::state();
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        detail::load_locked(s);
+        if (s.pending.empty()) return;
+        if (esp_timer_get_time() < s.next_attempt_us) return;
+    }
+    (void)schedule_flush();
+}
+
+// Transport edge (WIFI_CONNECTED_BIT set, BLE notify enabled). Called from
+// the Wi-Fi event loop and the BT host callbacks, so it only posts a job:
+// the pending check may mount SPIFFS and read the log. `which` must be a
+// string literal.
+inline void on_transport_ready(const char* which) {
+    (void)netexec::Executor::shared().post(
+        netexec::Priority::kUser, "outbox_ready", [which]() {
+            const size_t n = pending();
+            if (n == 0) return;
+            ESP_LOGI(OUTBOX_TAG, "%s ready; flushing %u message(s)", which,
+                     static_cast<unsigned>(n));
+            (void)schedule_flush(/*force=*/true);
+        });
+}
+
+}  // namespace outbox
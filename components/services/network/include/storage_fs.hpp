@@ -0,0 +1,177 @@
+// SPIFFS view of the "storage" partition.
+//
+// Used for state that outgrows the 16KB NVS partition (sync caches, outbox).
+// app_main mounts it on the network worker at boot so the first history or
+// outbox access does not pay for the mount (or a first-boot format); timer
+// wakes skip that and every helper calls ensure_mounted(), which is
+// idempotent, so storage still mounts on first access. A failed mount only
+// disables the callers' persistence.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+
+#include "esp_log.h"
+#include "esp_spiffs.h"
+
+namespace storage_fs {
+
+static const char* STORAGE_TAG = "StorageFS";
+static constexpr const char* kBasePath = "/storage";
+static constexpr const char* kPartitionLabel = "storage";
+
+inline bool ensure_mounted() {
+    static std::mutex mount_mutex;
+    static bool mounted = false;
+    static bool failed = false;
+    std::lock_guard<std::mutex> lock(mount_mutex);
+    if (mounted) return true;
+    if (failed) return false;
+
+    esp_vfs_spiffs_conf_t conf = {};
+    conf.base_path = kBasePath;
+    conf.partition_label = kPartitionLabel;
+    conf.max_files = 4;
+    // Only formats when the partition holds no valid filesystem, so an image
+    // uploaded with `pio run -t uploadfs` is preserved.
+    conf.format_if_mount_failed = true;
+    esp_err_t err = esp_vfs_spiffs_register(&conf);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGW(STORAGE_TAG, "mount %s failed: %s", kPartitionLabel,
+                 esp_err_to_name(err));
+        failed = true;
+        return false;
+    }
+    size_t total = 0, used = 0;
+    if (esp_spiffs_info(kPartitionLabel, &total, &used) == ESP_OK) {
+        ESP_LOGI(STORAGE_TAG, "mounted %s at %s (%u/%u bytes used)",
+                 kPartitionLabel, kBasePath, static_cast<unsigned>(used),
+                 static_cast<unsigned>(total));
+    }
+    mounted = true;
+    return true;
+}
+
+inline std::string path(const char* name) {
+    return std::string(kBasePath) + "/" + name;
+}
+
+inline std::string tmp_path(const std::string& file) { return file + ".tmp"; }
+
+// Write the new contents to `file`.tmp, then replace `file` with it. SPIFFS
+// rename() does not overwrite, so the old file is removed first: a reset
+// before the remove keeps the previous version, a reset between the remove
+// and the rename leaves only the complete .tmp, which read_file() picks up.
+inline bool write_file_atomic(const std::string& file, const void* data,
+                              size_t len) {
+    if (!ensure_mounted()) return false;
+    const std::string tmp = tmp_path(file);
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = len == 0 || fwrite(data, 1, len, f) == len;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) {
+        remove(tmp.c_str());
+        return false;
+    }
+    remove(file.c_str());
+    return rename(tmp.c_str(), file.c_str()) == 0;
+}
+
+// When `file` is missing but `file`.tmp exists, a write_file_atomic() was
+// cut off before its rename; finish it. A .tmp from a first write cut off
+// mid-fwrite can be short; the record Reader flags that as truncation.
+inline void recover_tmp(const std::string& file) {
+    struct stat st = {};
+    if (stat(file.c_str(), &st) == 0) return;
+    const std::string tmp = tmp_path(file);
+    if (rename(tmp.c_str(), file.c_str()) == 0) {
+        ESP_LOGW(STORAGE_TAG, "recovered %s from .tmp", file.c_str());
+    }
+}
+
+inline bool read_file(const std::string& file, std::string& out) {
+    out.clear();
+    if (!ensure_mounted()) return false;
+    recover_tmp(file);
+    FILE* f = fopen(file.c_str(), "rb");
+    if (!f) return false;
+    struct stat st = {};
+    if (stat(file.c_str(), &st) == 0 && st.st_size > 0) {
+        out.resize(static_cast<size_t>(st.st_size));
+        out.resize(fread(out.data(), 1, out.size(), f));
+    }
+    fclose(f);
+    return true;
+}
+
+inline bool append_file(const std::string& file, const void* data,
+                        size_t len) {
+    if (!ensure_mounted()) return false;
+    recover_tmp(file);
+    FILE* f = fopen(file.c_str(), "ab");
+    if (!f) return false;
+    bool ok = fwrite(data, 1, len, f) == len;
+    ok = (fclose(f) == 0) && ok;
+    return ok;
+}
+
+inline void remove_file(const std::string& file) {
+    if (!ensure_mounted()) return;
+    remove(file.c_str());
+    remove(tmp_path(file).c_str());
+}
+
+// Little-endian, length-prefixed record encoding shared by the on-flash
+// formats. Readers flag truncation instead of throwing so a torn tail from a
+// reset mid-write can simply be ignored.
+template <typename T>
+inline void put(std::string& out, T v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+inline void put_str(std::string& out, std::string_view s) {
+    const uint16_t len = static_cast<uint16_t>(std::min<size_t>(s.size(), 0xFFFF));
+    put(out, len);
+    out.append(s.data(), len);
+}
+
+struct Reader {
+    const std::string& buf;
+    size_t pos = 0;
+    bool ok = true;
+
+    bool at_end() const { return pos >= buf.size(); }
+
+    template <typename T>
+    T get() {
+        T v{};
+        if (pos + sizeof(T) > buf.size()) {
+            ok = false;
+            return v;
+        }
+        memcpy(&v, buf.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return v;
+    }
+
+    std::string_view get_str() {
+        const uint16_t len = get<uint16_t>();
+        if (!ok || pos + len > buf.size()) {
+            ok = false;
+            return std::string_view();
+        }
+        std::string_view s(buf.data() + pos, len);
+        pos += len;
+        return s;
+    }
+};
+
+}  // namespace storage_fs
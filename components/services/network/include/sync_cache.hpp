@@ -0,0 +1,220 @@
+// Flash-backed sync state for conditional / incremental chat API fetches.
+//
+// Per friend we keep the last ETag, the newest message id (the since-cursor)
+// and the merged history window; for the friend list, the ETag and the last
+// body. A 304 or an empty delta is then served from here instead of
+// re-downloading the full JSON.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "esp_log.h"
+
+#include "message_history.hpp"
+#include "storage_fs.hpp"
+
+namespace chatapi::sync {
+
+static const char* SYNC_TAG = "SyncCache";
+
+// Same window the UI asks the server for.
+static constexpr size_t kHistoryWindow = 20;
+
+struct Stats {
+    uint32_t requests = 0;
+    uint32_t not_modified = 0;
+    uint32_t deltas = 0;
+    uint32_t bytes_received = 0;
+    // Body bytes served from the cache instead of the network.
+    uint32_t bytes_saved = 0;
+};
+
+inline Stats& stats() {
+    static Stats s;
+    return s;
+}
+
+inline void record_fetch(const char* what, int status, size_t received,
+                         size_t served_from_cache, bool delta) {
+    auto& s = stats();
+    ++s.requests;
+    if (status == 304) ++s.not_modified;
+    if (delta) ++s.deltas;
+    s.bytes_received += static_cast<uint32_t>(received);
+    if (served_from_cache > received) {
+        s.bytes_saved += static_cast<uint32_t>(served_from_cache - received);
+    }
+    ESP_LOGI(SYNC_TAG,
+             "%s status=%d rx=%uB cached=%uB | session: req=%u 304=%u "
+             "delta=%u rx=%uB saved=%uB",
+             what, status, static_cast<unsigned>(received),
+             static_cast<unsigned>(served_from_cache),
+             static_cast<unsigned>(s.requests),
+             static_cast<unsigned>(s.not_modified),
+             static_cast<unsigned>(s.deltas),
+             static_cast<unsigned>(s.bytes_received),
+             static_cast<unsigned>(s.bytes_saved));
+}
+
+struct HistoryState {
+    std::string etag;
+    MessageHistory history;
+
+    // Newest message id, sent as since_id. Empty when nothing is cached.
+    std::string cursor() const {
+        if (history.empty()) return std::string();
+        return std::string(history.id(history[history.size() - 1]));
+    }
+};
+
+struct FriendsState {
+    std::string etag;
+    std::string body;
+};
+
+namespace detail {
+
+static constexpr uint32_t kHistoryMagic = 0x4D53594E;  // 'MSYN'
+static constexpr uint32_t kFriendsMagic = 0x46535944;  // 'FSYD'
+static constexpr uint8_t kVersion = 1;
+
+inline std::mutex& io_mutex() {
+    static std::mutex m;
+    return m;
+}
+
+inline uint32_t fnv1a(const std::string& s) {
+    uint32_t h = 2166136261u;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+inline std::string history_path(const std::string& friend_id) {
+    char name[24];
+    snprintf(name, sizeof(name), "m_%08lx.bin",
+             static_cast<unsigned long>(fnv1a(friend_id)));
+    return storage_fs::path(name);
+}
+
+inline std::string friends_path() { return storage_fs::path("friends.bin"); }
+
+}  // namespace detail
+
+inline bool load_history(const std::string& friend_id, HistoryState& out) {
+    out.etag.clear();
+    out.history.clear();
+    std::string buf;
+    {
+        std::lock_guard<std::mutex> lock(detail::io_mutex());
+        if (!storage_fs::read_file(detail::history_path(friend_id), buf)) {
+            return false;
+        }
+    }
+    storage_fs::Reader r{buf};
+    if (r.get<uint32_t>() != detail::kHistoryMagic ||
+        r.get<uint8_t>() != detail::kVersion) {
+        return false;
+    }
+    out.etag = std::string(r.get_str());
+    const uint16_t count = r.get<uint16_t>();
+    out.history.reserve(count, buf.size());
+    for (uint16_t i = 0; i < count && r.ok; ++i) {
+        const uint8_t flags = r.get<uint8_t>();
+        const auto id = r.get_str();
+        const auto created = r.get_str();
+        const auto content = r.get_str();
+        if (!r.ok) break;
+        out.history.add(id, created, content, flags & 0x1, flags & 0x2,
+                        flags & 0x4);
+    }
+    if (!r.ok) {
+        ESP_LOGW(SYNC_TAG, "corrupt history cache for %s; discarding",
+                 friend_id.c_str());
+        out.etag.clear();
+        out.history.clear();
+        return false;
+    }
+    return true;
+}
+
+inline bool save_history(const std::string& friend_id,
+                         const HistoryState& state) {
+    std::string buf;
+    buf.reserve(16 + state.etag.size() + state.history.arena_bytes() +
+                state.history.size() * 7);
+    storage_fs::put(buf, detail::kHistoryMagic);
+    storage_fs::put(buf, detail::kVersion);
+    storage_fs::put_str(buf, state.etag);
+    storage_fs::put(buf, static_cast<uint16_t>(state.history.size()));
+    for (const auto& rec : state.history.records()) {
+        const uint8_t flags = (rec.outgoing ? 0x1 : 0) |
+                              (rec.has_read_flag ? 0x2 : 0) |
+                              (rec.is_read ? 0x4 : 0);
+        storage_fs::put(buf, flags);
+        storage_fs::put_str(buf, state.history.id(rec));
+        storage_fs::put_str(buf, state.history.created_at(rec));
+        storage_fs::put_str(buf, state.history.content(rec));
+    }
+    std::lock_guard<std::mutex> lock(detail::io_mutex());
+    return storage_fs::write_file_atomic(detail::history_path(friend_id),
+                                         buf.data(), buf.size());
+}
+
+// Mirrors a successful read-all on the server so cached incoming records do
+// not come back as unread on the next 304 / empty delta.
+inline void mark_history_read(const std::string& friend_id) {
+    HistoryState state;
+    if (!load_history(friend_id, state)) return;
+    for (size_t i = 0; i < state.history.size(); ++i) {
+        if (!state.history[i].outgoing) state.history.mark_read(i);
+    }
+    // The server representation changed, so the old validator is stale.
+    state.etag.clear();
+    save_history(friend_id, state);
+}
+
+inline bool load_friends(FriendsState& out) {
+    out.etag.clear();
+    out.body.clear();
+    std::string buf;
+    {
+        std::lock_guard<std::mutex> lock(detail::io_mutex());
+        if (!storage_fs::read_file(detail::friends_path(), buf)) return false;
+    }
+    storage_fs::Reader r{buf};
+    if (r.get<uint32_t>() != detail::kFriendsMagic ||
+        r.get<uint8_t>() != detail::kVersion) {
+        return false;
+    }
+    out.etag = std::string(r.get_str());
+    const uint32_t len = r.get<uint32_t>();
+    if (!r.ok || r.pos + len > buf.size()) {
+        out.etag.clear();
+        return false;
+    }
+    out.body.assign(buf.data() + r.pos, len);
+    return true;
+}
+
+inline bool save_friends(const FriendsState& state) {
+    std::string buf;
+    buf.reserve(16 + state.etag.size() + state.body.size());
+    storage_fs::put(buf, detail::kFriendsMagic);
+    storage_fs::put(buf, detail::kVersion);
+    storage_fs::put_str(buf, state.etag);
+    storage_fs::put(buf, static_cast<uint32_t>(state.body.size()));
+    buf.append(state.body);
+    std::lock_guard<std::mutex> lock(detail::io_mutex());
+    return storage_fs::write_file_atomic(detail::friends_path(), buf.data(),
+                                         buf.size());
+}
+
+}  // namespace chatapi::sync
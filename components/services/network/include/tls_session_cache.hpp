@@ -0,0 +1,397 @@
+// TLS session resumption across deep sleep.
+//
+// The timer-wake path only needs one small HTTPS GET before going back to
+// sleep, and the full TLS handshake dominates its energy cost. The last
+// negotiated session (ID + ticket) is serialized into RTC memory, which
+// survives deep sleep, and offered again on the next wake so the server can
+// resume it with an abbreviated handshake.
+//
+// The session is serialized with mbedtls_ssl_session_save(), which includes
+// the server's leaf certificate under CONFIG_MBEDTLS_SSL_KEEP_PEER_CERTIFICATE,
+// so the RTC slot is sized for a session plus one certificate.
+
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <cctype>
+#include <ctime>
+#include <memory>
+
+#include "esp_attr.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#include "esp_crt_bundle.h"
+#endif
+
+// Resumption is detected by comparing the handshake bytes with the size of
+// the peer certificate, which mbedTLS only keeps with this option.
+#if !defined(MBEDTLS_SSL_KEEP_PEER_CERTIFICATE)
+#error "tls_session_cache.hpp needs CONFIG_MBEDTLS_SSL_KEEP_PEER_CERTIFICATE"
+#endif
+
+namespace tls_resume {
+
+static const char* RESUME_TAG = "TlsResume";
+
+static constexpr uint32_t kSessionMagic = 0x544C5352u;  // 'TLSR'
+static constexpr uint32_t kStatsMagic = 0x544C5355u;    // 'TLSU'
+// Session fields and ticket (~0.4 kB) plus a leaf certificate (1-2 kB).
+static constexpr size_t kMaxSessionBytes = 3072;
+// Servers commonly keep tickets for a few hours; anything older than that
+// since the full handshake that issued it is dropped before we offer it.
+static constexpr int64_t kSessionTtlSec = 6 * 60 * 60;
+
+struct StoredSession {
+    uint32_t magic;
+    uint32_t crc;
+    uint32_t host_hash;
+    int64_t issued_at_sec;  // full handshake; kept across resumptions
+    uint16_t len;
+    uint8_t blob[kMaxSessionBytes];
+};
+
+struct WakeStats {
+    uint32_t magic;
+    uint32_t wakes;
+    uint32_t resumed;
+    uint32_t full;
+    uint32_t failed;  // no completed handshake (connect/handshake/setup error)
+    uint32_t last_handshake_ms;
+};
+
+// Must survive deep sleep; validated by magic + CRC instead of zero-init.
+RTC_NOINIT_ATTR inline StoredSession s_stored_session;
+RTC_NOINIT_ATTR inline WakeStats s_wake_stats;
+
+inline uint32_t host_hash(const std::string& host, int port) {
+    std::string key = host + ":" + std::to_string(port);
+    return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(key.data()),
+                            key.size());
+}
+
+inline uint32_t session_crc(const StoredSession& s) {
+    uint32_t crc = esp_rom_crc32_le(
+        0, reinterpret_cast<const uint8_t*>(&s.host_hash), sizeof(s.host_hash));
+    crc = esp_rom_crc32_le(
+        crc, reinterpret_cast<const uint8_t*>(&s.issued_at_sec),
+        sizeof(s.issued_at_sec));
+    return esp_rom_crc32_le(crc, s.blob, s.len);
+}
+
+inline void invalidate_session() { s_stored_session.magic = 0; }
+
+inline WakeStats& wake_stats() {
+    if (s_wake_stats.magic != kStatsMagic) {
+        memset(&s_wake_stats, 0, sizeof(s_wake_stats));
+        s_wake_stats.magic = kStatsMagic;
+    }
+    return s_wake_stats;
+}
+
+// On success *issued_at_sec is when the full handshake behind the cached
+// session happened.
+inline bool load_session(const std::string& host, int port,
+                         mbedtls_ssl_session* out, int64_t* issued_at_sec) {
+    const StoredSession& s = s_stored_session;
+    if (s.magic != kSessionMagic || s.len == 0 || s.len > kMaxSessionBytes) {
+        return false;
+    }
+    if (s.host_hash != host_hash(host, port) || s.crc != session_crc(s)) {
+        invalidate_session();
+        return false;
+    }
+    const int64_t age = static_cast<int64_t>(time(nullptr)) - s.issued_at_sec;
+    if (age < 0 || age > kSessionTtlSec) {
+        ESP_LOGI(RESUME_TAG, "cached session expired (age=%llds)",
+                 static_cast<long long>(age));
+        invalidate_session();
+        return false;
+    }
+    if (mbedtls_ssl_session_load(out, s.blob, s.len) != 0) {
+        invalidate_session();
+        return false;
+    }
+    *issued_at_sec = s.issued_at_sec;
+    return true;
+}
+
+// issued_at_sec is the time of the full handshake the session comes from:
+// now after a full handshake, the cached value after a resumption, so that
+// resuming does not stretch the TTL past the server's ticket lifetime.
+inline void save_session(const std::string& host, int port,
+                         const mbedtls_ssl_context* ssl,
+                         int64_t issued_at_sec) {
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    size_t len = 0;
+    int rc = mbedtls_ssl_get_session(ssl, &session);
+    if (rc == 0) {
+        rc = mbedtls_ssl_session_save(&session, s_stored_session.blob,
+                                      sizeof(s_stored_session.blob), &len);
+    }
+    mbedtls_ssl_session_free(&session);
+    if (rc != 0 || len == 0) {
+        ESP_LOGW(RESUME_TAG, "session not cached (rc=-0x%04x len=%u)",
+                 static_cast<unsigned>(-rc), static_cast<unsigned>(len));
+        invalidate_session();
+        return;
+    }
+    s_stored_session.len = static_cast<uint16_t>(len);
+    s_stored_session.host_hash = host_hash(host, port);
+    s_stored_session.issued_at_sec = issued_at_sec;
+    s_stored_session.crc = session_crc(s_stored_session);
+    s_stored_session.magic = kSessionMagic;
+}
+
+struct HandshakeInfo {
+    bool offered = false;
+    bool completed = false;  // handshake finished (resumed or full)
+    bool resumed = false;
+    int handshake_ms = 0;
+    size_t handshake_rx_bytes = 0;
+};
+
+namespace detail {
+
+struct TlsContext {
+    mbedtls_net_context net;
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_entropy_context entropy;
+#if !CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+    mbedtls_x509_crt ca;
+#endif
+    size_t rx_bytes = 0;
+
+    TlsContext() {
+        mbedtls_net_init(&net);
+        mbedtls_ssl_init(&ssl);
+        mbedtls_ssl_config_init(&conf);
+        mbedtls_ctr_drbg_init(&drbg);
+        mbedtls_entropy_init(&entropy);
+#if !CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+        mbedtls_x509_crt_init(&ca);
+#endif
+    }
+
+    ~TlsContext() {
+        mbedtls_ssl_close_notify(&ssl);
+        mbedtls_net_free(&net);
+        mbedtls_ssl_free(&ssl);
+        mbedtls_ssl_config_free(&conf);
+        mbedtls_ctr_drbg_free(&drbg);
+        mbedtls_entropy_free(&entropy);
+#if !CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+        mbedtls_x509_crt_free(&ca);
+#endif
+    }
+};
+
+inline int counting_recv(void* ctx, unsigned char* buf, size_t len,
+                         uint32_t timeout_ms) {
+    auto* tls = static_cast<TlsContext*>(ctx);
+    int n = mbedtls_net_recv_timeout(&tls->net, buf, len, timeout_ms);
+    if (n > 0) tls->rx_bytes += static_cast<size_t>(n);
+    return n;
+}
+
+inline int counting_send(void* ctx, const unsigned char* buf, size_t len) {
+    return mbedtls_net_send(&static_cast<TlsContext*>(ctx)->net, buf, len);
+}
+
+inline bool header_contains(const std::string& headers, const char* needle) {
+    std::string lower(headers);
+    for (auto& c : lower) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    return lower.find(needle) != std::string::npos;
+}
+
+inline std::string dechunk(const std::string& body) {
+    std::string out;
+    size_t pos = 0;
+    while (pos < body.size()) {
+        size_t eol = body.find("\r\n", pos);
+        if (eol == std::string::npos) break;
+        size_t chunk = strtoul(body.c_str() + pos, nullptr, 16);
+        if (chunk == 0) break;
+        pos = eol + 2;
+        if (pos + chunk > body.size()) chunk = body.size() - pos;
+        out.append(body, pos, chunk);
+        pos += chunk + 2;
+    }
+    return out;
+}
+
+}  // namespace detail
+
+// Minimal HTTPS GET (Connection: close) that offers the RTC-cached session
+// and caches the newly negotiated one. Intended for the timer-wake path only;
+// everything else goes through the pooled esp_http_client in ChatApiClient.
+inline esp_err_t https_get(const std::string& host, int port,
+                           const std::string& path, const std::string& authz,
+                           std::string& out_body, int* out_status,
+                           HandshakeInfo* out_info, int timeout_ms = 10000) {
+    HandshakeInfo info;
+    std::unique_ptr<detail::TlsContext> tls(new (std::nothrow) detail::TlsContext());
+    if (!tls) return ESP_ERR_NO_MEM;
+
+    if (mbedtls_ctr_drbg_seed(&tls->drbg, mbedtls_entropy_func, &tls->entropy,
+                              nullptr, 0) != 0 ||
+        mbedtls_ssl_config_defaults(&tls->conf, MBEDTLS_SSL_IS_CLIENT,
+                                    MBEDTLS_SSL_TRANSPORT_STREAM,
+                                    MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+        return ESP_FAIL;
+    }
+    mbedtls_ssl_conf_authmode(&tls->conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_rng(&tls->conf, mbedtls_ctr_drbg_random, &tls->drbg);
+    mbedtls_ssl_conf_read_timeout(&tls->conf, static_cast<uint32_t>(timeout_ms));
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&tls->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+    if (esp_crt_bundle_attach(&tls->conf) != ESP_OK) return ESP_FAIL;
+#else
+    extern const unsigned char ca_cert_pem_start[] asm("_binary_ca_cert_pem_start");
+    extern const unsigned char ca_cert_pem_end[]   asm("_binary_ca_cert_pem_end");
+    if (mbedtls_x509_crt_parse(&tls->ca, ca_cert_pem_start,
+                               ca_cert_pem_end - ca_cert_pem_start) != 0) {
+        return ESP_FAIL;
+    }
+    mbedtls_ssl_conf_ca_chain(&tls->conf, &tls->ca, nullptr);
+#endif
+    if (mbedtls_ssl_setup(&tls->ssl, &tls->conf) != 0 ||
+        mbedtls_ssl_set_hostname(&tls->ssl, host.c_str()) != 0) {
+        return ESP_FAIL;
+    }
+
+    int64_t cached_issued_at_sec = 0;
+    {
+        mbedtls_ssl_session cached;
+        mbedtls_ssl_session_init(&cached);
+        if (load_session(host, port, &cached, &cached_issued_at_sec)) {
+            info.offered = (mbedtls_ssl_set_session(&tls->ssl, &cached) == 0);
+            if (!info.offered) invalidate_session();
+        }
+        mbedtls_ssl_session_free(&cached);
+    }
+
+    const std::string port_str = std::to_string(port);
+    if (mbedtls_net_connect(&tls->net, host.c_str(), port_str.c_str(),
+                            MBEDTLS_NET_PROTO_TCP) != 0) {
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    mbedtls_ssl_set_bio(&tls->ssl, tls.get(), detail::counting_send, nullptr,
+                        detail::counting_recv);
+
+    const int64_t hs_start_us = esp_timer_get_time();
+    int rc;
+    while ((rc = mbedtls_ssl_handshake(&tls->ssl)) != 0) {
+        if (rc != MBEDTLS_ERR_SSL_WANT_READ && rc != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            ESP_LOGW(RESUME_TAG, "handshake failed: -0x%04x (offered=%d)",
+                     static_cast<unsigned>(-rc), info.offered ? 1 : 0);
+            // A rejected or corrupt ticket must not poison the next wake.
+            invalidate_session();
+            if (out_info) *out_info = info;
+            return ESP_ERR_HTTP_CONNECT;
+        }
+    }
+    info.handshake_ms =
+        static_cast<int>((esp_timer_get_time() - hs_start_us) / 1000);
+    info.handshake_rx_bytes = tls->rx_bytes;
+    info.completed = true;
+    // A full handshake receives the server Certificate message, so at least
+    // the leaf certificate's DER bytes; an abbreviated one (ServerHello,
+    // ticket, Finished) receives no certificate and inherits the cached one.
+    const mbedtls_x509_crt* peer = mbedtls_ssl_get_peer_cert(&tls->ssl);
+    info.resumed = info.offered && peer && tls->rx_bytes < peer->raw.len;
+    if (info.offered && !info.resumed) {
+        ESP_LOGI(RESUME_TAG, "server declined cached session; full handshake");
+    }
+    save_session(host, port, &tls->ssl,
+                 info.resumed ? cached_issued_at_sec
+                              : static_cast<int64_t>(time(nullptr)));
+
+    std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + host +
+                          "\r\nAccept: application/json\r\nConnection: close\r\n";
+    if (!authz.empty()) request += "Authorization: " + authz + "\r\n";
+    request += "\r\n";
+    size_t written = 0;
+    while (written < request.size()) {
+        rc = mbedtls_ssl_write(
+            &tls->ssl,
+            reinterpret_cast<const unsigned char*>(request.data()) + written,
+            request.size() - written);
+        if (rc == MBEDTLS_ERR_SSL_WANT_READ || rc == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            continue;
+        }
+        if (rc <= 0) {
+            if (out_info) *out_info = info;
+            return ESP_ERR_HTTP_WRITE_DATA;
+        }
+        written += static_cast<size_t>(rc);
+    }
+
+    std::string raw;
+    unsigned char buf[256];
+    while (true) {
+        rc = mbedtls_ssl_read(&tls->ssl, buf, sizeof(buf));
+        if (rc == MBEDTLS_ERR_SSL_WANT_READ || rc == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            continue;
+        }
+        if (rc <= 0) break;  // close_notify, EOF or error: use what we have
+        raw.append(reinterpret_cast<const char*>(buf), static_cast<size_t>(rc));
+    }
+    if (out_info) *out_info = info;
+
+    const size_t header_end = raw.find("\r\n\r\n");
+    if (raw.compare(0, 5, "HTTP/") != 0 || header_end == std::string::npos) {
+        return ESP_ERR_HTTP_FETCH_HEADER;
+    }
+    const size_t sp = raw.find(' ');
+    if (out_status) *out_status = atoi(raw.c_str() + sp + 1);
+    const std::string headers = raw.substr(0, header_end);
+    out_body = raw.substr(header_end + 4);
+    if (detail::header_contains(headers, "transfer-encoding: chunked")) {
+        out_body = detail::dechunk(out_body);
+    }
+    return ESP_OK;
+}
+
+inline void record_wake(const HandshakeInfo& info) {
+    WakeStats& stats = wake_stats();
+    ++stats.wakes;
+    if (!info.completed) {
+        ++stats.failed;
+        ESP_LOGW(RESUME_TAG,
+                 "wake handshake: failed (offered=%d wakes=%u resumed=%u "
+                 "full=%u failed=%u)",
+                 info.offered ? 1 : 0, static_cast<unsigned>(stats.wakes),
+                 static_cast<unsigned>(stats.resumed),
+                 static_cast<unsigned>(stats.full),
+                 static_cast<unsigned>(stats.failed));
+        return;
+    }
+    if (info.resumed) ++stats.resumed;
+    else ++stats.full;
+    stats.last_handshake_ms = static_cast<uint32_t>(info.handshake_ms);
+    ESP_LOGI(RESUME_TAG,
+             "wake handshake: %s %dms rx=%uB (wakes=%u resumed=%u full=%u "
+             "failed=%u)",
+             info.resumed ? "resumed" : "full", info.handshake_ms,
+             static_cast<unsigned>(info.handshake_rx_bytes),
+             static_cast<unsigned>(stats.wakes),
+             static_cast<unsigned>(stats.resumed),
+             static_cast<unsigned>(stats.full),
+             static_cast<unsigned>(stats.failed));
+}
+
+}  // namespace tls_resume
@@ -14,6 +14,7 @@
 #include <nvs_rw.hpp>
 #include <ble_uart.hpp>
 #include <mqtt_runtime.h>
+#include "outbox.hpp"
 
 #include "lwip/err.h"
 #include "lwip/sys.h"
@@ -46,6 +47,7 @@ static std::atomic<bool> s_post_connect_task_running{false};
 static std::atomic<bool> s_ble_fallback_active{false};
 static std::atomic<bool> s_wifi_retry_task_running{false};
 static std::atomic<bool> s_wifi_driver_ready{false};
+static std::atomic<bool> s_outbox_flush_deferred{false};
 static std::mutex s_wifi_op_mutex;
 
 constexpr char kBleAutoFallbackKey[] = "ble_auto_fb";
@@ -91,6 +93,17 @@ class WiFi {
         s_ble_fallback_active.store(enabled);
     }
 
+    // Timer-wake boots go straight back to deep sleep, so the connect edge
+    // must not flush the outbox (SPIFFS mount + HTTP). Undeferring on a
+    // connected link delivers what the skipped edge would have.
+    static void defer_outbox_flush(bool defer) {
+        s_outbox_flush_deferred.store(defer);
+        if (!defer && s_wifi_event_group &&
+            (xEventGroupGetBits(s_wifi_event_group) & WIFI_CONNECTED_BIT)) {
+            outbox::on_transport_ready("wifi");
+        }
+    }
+
     static bool consume_ble_auto_defer_once() {
         if (get_nvs((char *)kBleAutoDeferOnceKey) != "1") return false;
         save_nvs((char *)kBleAutoDeferOnceKey, std::string("0"));
@@ -212,6 +225,8 @@ class WiFi {
     static void post_connect_task(void *pvParameters) {
         (void)pvParameters;
         (void)esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+        // WIFI_CONNECTED_BIT just rose: deliver anything queued offline.
+        if (!s_outbox_flush_deferred.load()) outbox::on_transport_ready("wifi");
         set_auto_ble_fallback(false);
         if (ble_uart_is_ready()) {
             ESP_LOGI(TAG, "Wi-Fi connected; disabling BLE bridge");
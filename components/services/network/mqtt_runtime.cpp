@@ -1,21 +1,41 @@
 // MQTT runtime singleton to allow pause/resume around BLE to save memory
 
 #include <string>
-#include <queue>
+#include <string_view>
+#include <map>
+#include <set>
 #include <mutex>
 #include <vector>
-#include <deque>
+#include <memory>
 #include <algorithm>
+#include <atomic>
 #include <cstring>
+#include <iterator>
 
+#include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "mqtt_client.h"
+#include "nvs.h"
 
 #include "mqtt_runtime.h"
+#include "mqtt_outq.hpp"
+#include "mqtt_ring.hpp"
+#include "mqtt_topic_trie.hpp"
 
 static const char* TAG = "MQTT_RT";
 
 namespace {
+// Outbound budget; a rejected publish returns an error to the caller.
+constexpr size_t kTxMaxEntries = 32;
+constexpr size_t kTxBudgetBytes = 8 * 1024;
+constexpr uint32_t kTxRetryMs = 1000;
+constexpr uint32_t kTxTaskStack = 3072;
+constexpr const char* kNvsNamespace = "mqtt_rt";
+constexpr const char* kNvsSubsKey = "subs";
+
 struct State {
     std::mutex m;
     std::string host;
@@ -23,38 +43,374 @@ struct State {
     std::string user_id;
     std::string topic; // chat/messages/<user_id>
     std::string uri;
+    std::string client_id;
     esp_mqtt_client_handle_t client = nullptr;
-    bool connected = false;
-    std::queue<std::string> queue;
+    // Held by the sender across a publish so stop cannot destroy the client
+    // underneath it. Lock order: tx_m, then m.
+    std::mutex tx_m;
+    TaskHandle_t tx_task = nullptr;
+    // Publishes waiting for the link; guarded by m.
+    mqttrt::OutQueue outq{kTxMaxEntries, kTxBudgetBytes};
+    // Link state: written from the MQTT event task, read lock-free from
+    // publishers and consumers on other tasks.
+    std::atomic<bool> connected{false};
+    std::atomic<uint32_t> connect_count{0};
+    std::atomic<bool> session_present{false};
+    // Consumer blocked in mqtt_rt_wait_event(); woken on data and link changes.
+    TaskHandle_t waiter = nullptr;
+    // Personal topic inbox; the notification task is the only consumer.
+    mqttrt::ByteRing inbox;
     int next_listener_id = 1;
     struct Listener {
         int id = 0;
-        std::string topic;
-        std::deque<std::string> queue;
+        std::string topic;  // subscription filter, may contain + / #
+        mqttrt::ByteRing ring;
         bool active = true;
     };
-    std::vector<Listener> listeners;
+    // shared_ptr so a consumer can pop outside S.m while remove_listener runs.
+    std::vector<std::shared_ptr<Listener>> listeners;
+    // Routes inbound topics to every matching listener; owned by `listeners`.
+    mqttrt::TopicTrie<std::shared_ptr<Listener>> routes;
+    // Listener count per filter; the broker subscription follows 0 <-> 1.
+    std::map<std::string, int, std::less<>> sub_refs;
+    // Filters the broker holds for client_id, as far as we know. A persistent
+    // session keeps them across reboots, so the set is mirrored in NVS and
+    // diffed against the desired set (personal topic + sub_refs) on connect.
+    std::set<std::string> broker_subs;
+    std::string broker_subs_client;  // client_id broker_subs was loaded for
+    std::string saved_subs;          // NVS blob last written
+    // Publish currently being reassembled; esp-mqtt delivers payloads larger
+    // than its buffer as several DATA events, only the first carrying a topic.
+    struct Inbound {
+        bool active = false;
+        bool to_inbox = false;
+        uint32_t total = 0;
+        std::vector<std::shared_ptr<Listener>> targets;
+    } rx;
+    uint32_t rx_fragmented = 0;
+    uint32_t rx_oversized = 0;
+    uint32_t rx_incomplete = 0;
+    uint32_t match_count = 0;
+    uint64_t match_us_total = 0;
+    uint32_t match_us_max = 0;
 } S;
 
+// Larger publishes are skipped rather than reassembled.
+constexpr uint32_t kMaxInboundPayload = MQTT_RT_MAX_PAYLOAD;
+// Every ring must hold at least one record of the largest accepted payload,
+// or begin() drops it after the size check above let it through.
+constexpr size_t kInboxRingBytes = 32 * 1024;
+constexpr size_t kListenerRingBytes = 32 * 1024;
+static_assert(kInboxRingBytes >= mqttrt::ByteRing::kHeaderBytes + kMaxInboundPayload,
+              "inbox ring smaller than the inbound payload cap");
+static_assert(kListenerRingBytes >= mqttrt::ByteRing::kHeaderBytes + kMaxInboundPayload,
+              "listener ring smaller than the inbound payload cap");
+
+static bool topic_equals(const std::string& topic, const char* data, int len)
+{
+    return len >= 0 && topic.size() == static_cast<size_t>(len) &&
+           memcmp(topic.data(), data, len) == 0;
+}
+
+static void fill_stats(const mqttrt::ByteRing& ring, mqtt_rt_ring_stats_t* out)
+{
+    const auto st = ring.stats();
+    out->received = st.pushed;
+    out->delivered = st.popped;
+    out->dropped = st.dropped;
+    out->overwritten = st.overwritten;
+    out->truncated = st.truncated;
+    out->peak_bytes = st.peak_bytes;
+}
+
+static void route_topic(const esp_mqtt_event_handle_t ev)
+{
+    auto &rx = S.rx;
+    rx.to_inbox = !S.topic.empty() && topic_equals(S.topic, ev->topic, ev->topic_len);
+    rx.targets.clear();
+    if (S.routes.size() == 0 || !ev->topic || ev->topic_len <= 0) return;
+    const int64_t t0 = esp_timer_get_time();
+    S.routes.match(std::string_view(ev->topic, ev->topic_len),
+                   [&](const std::shared_ptr<State::Listener>& listener) {
+                       if (listener->active) rx.targets.push_back(listener);
+                   });
+    const uint32_t us = static_cast<uint32_t>(esp_timer_get_time() - t0);
+    ++S.match_count;
+    S.match_us_total += us;
+    if (us > S.match_us_max) S.match_us_max = us;
+}
+
+// Writes each chunk straight into a slot reserved in every matching ring and
+// commits once the last chunk lands. Returns true when the personal inbox
+// received a complete message. Caller holds S.m.
+static bool on_data(const esp_mqtt_event_handle_t ev)
+{
+    auto &rx = S.rx;
+    const uint32_t offset = ev->current_data_offset > 0 ? ev->current_data_offset : 0;
+    const uint32_t total = ev->total_data_len > ev->data_len ? ev->total_data_len
+                                                             : ev->data_len;
+    if (offset == 0) {
+        if (rx.active) {
+            // The previous publish never completed (e.g. link dropped).
+            ++S.rx_incomplete;
+            if (rx.to_inbox) S.inbox.abort();
+            for (auto &listener : rx.targets) listener->ring.abort();
+        }
+        rx.active = false;
+        if (total > kMaxInboundPayload) {
+            ++S.rx_oversized;
+            ESP_LOGW(TAG, "dropping %u byte publish on %.*s (cap %u)",
+                     (unsigned)total, ev->topic_len, ev->topic ? ev->topic : "",
+                     (unsigned)kMaxInboundPayload);
+            return false;
+        }
+        route_topic(ev);
+        if (rx.to_inbox) rx.to_inbox = S.inbox.begin(total);
+        auto it = std::remove_if(rx.targets.begin(), rx.targets.end(),
+                                 [&](const std::shared_ptr<State::Listener>& l) {
+                                     return !l->ring.begin(total);
+                                 });
+        rx.targets.erase(it, rx.targets.end());
+        if (!rx.to_inbox && rx.targets.empty()) return false;
+        rx.active = true;
+        rx.total = total;
+        if (total > static_cast<uint32_t>(ev->data_len)) ++S.rx_fragmented;
+    } else if (!rx.active || total != rx.total) {
+        return false;  // continuation of a skipped or unrouted publish
+    }
+
+    if (rx.to_inbox) S.inbox.write(offset, ev->data, ev->data_len);
+    for (auto &listener : rx.targets) {
+        listener->ring.write(offset, ev->data, ev->data_len);
+    }
+    if (offset + static_cast<uint32_t>(ev->data_len) < rx.total) return false;
+
+    rx.active = false;
+    if (rx.to_inbox) S.inbox.commit();
+    for (auto &listener : rx.targets) listener->ring.commit();
+    rx.targets.clear();
+    return rx.to_inbox;
+}
+
+// Stable per-user client ID so the broker can resume the session after a
+// reconnect, BLE pause or deep sleep. Hashed to stay within the 23 bytes
+// every MQTT 3.1.1 broker must accept.
+static std::string client_id_for(const std::string& user_id)
+{
+    uint32_t h = 2166136261u;
+    for (unsigned char c : user_id) {
+        h ^= c;
+        h *= 16777619u;
+    }
+    char id[24];
+    snprintf(id, sizeof(id), "mobus-%08lx", static_cast<unsigned long>(h));
+    return id;
+}
+
+// NVS blob: the client id, then one filter per line.
+static std::string encode_subs(const std::string& client_id, const std::set<std::string>& subs)
+{
+    std::string out = client_id;
+    for (const auto& topic : subs) {
+        out.push_back('\n');
+        out += topic;
+    }
+    return out;
+}
+
+// Loads what the broker held for S.client_id when it was last saved. A blob
+// for another client id belongs to another user's session and is ignored.
+// Caller holds S.m.
+static void load_broker_subs_locked()
+{
+    S.broker_subs.clear();
+    S.saved_subs.clear();
+    S.broker_subs_client = S.client_id;
+    if (S.client_id.empty()) return;
+    nvs_handle_t h;
+    if (nvs_open(kNvsNamespace, NVS_READONLY, &h) != ESP_OK) return;
+    std::string blob;
+    size_t len = 0;
+    if (nvs_get_blob(h, kNvsSubsKey, nullptr, &len) == ESP_OK && len > 0) {
+        blob.resize(len);
+        if (nvs_get_blob(h, kNvsSubsKey, blob.data(), &len) != ESP_OK) blob.clear();
+    }
+    nvs_close(h);
+    size_t pos = blob.find('\n');
+    if (blob.compare(0, pos, S.client_id) != 0) return;
+    S.saved_subs = blob;
+    while (pos != std::string::npos) {
+        const size_t next = blob.find('\n', pos + 1);
+        S.broker_subs.insert(blob.substr(pos + 1, next == std::string::npos
+                                                      ? std::string::npos
+                                                      : next - pos - 1));
+        pos = next;
+    }
+    ESP_LOGI(TAG, "restored %u broker subscription(s) for %s",
+             (unsigned)S.broker_subs.size(), S.client_id.c_str());
+}
+
+static void save_broker_subs()
+{
+    std::string blob;
+    {
+        std::lock_guard<std::mutex> lk(S.m);
+        if (S.client_id.empty()) return;
+        blob = encode_subs(S.client_id, S.broker_subs);
+        if (blob == S.saved_subs) return;
+    }
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(kNvsNamespace, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(h, kNvsSubsKey, blob.data(), blob.size());
+        if (err == ESP_OK) err = nvs_commit(h);
+        nvs_close(h);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "saving subscriptions failed: %s", esp_err_to_name(err));
+        return;
+    }
+    std::lock_guard<std::mutex> lk(S.m);
+    S.saved_subs = std::move(blob);
+}
+
+// Brings the broker's subscriptions in line with the personal topic and the
+// listener filters. Runs on connect and after every change while connected;
+// changes made offline wait for the next connect. Called without S.m: the
+// client calls take esp-mqtt's API lock, which its task holds while it
+// waits for S.m in on_event.
+static void sync_subscriptions()
+{
+    std::vector<std::string> sub;
+    std::vector<std::string> unsub;
+    esp_mqtt_client_handle_t client;
+    {
+        std::lock_guard<std::mutex> lk(S.m);
+        if (!S.client || !S.connected) return;
+        client = S.client;
+        std::set<std::string> desired;
+        if (!S.topic.empty()) desired.insert(S.topic);
+        for (const auto& ref : S.sub_refs) desired.insert(ref.first);
+        std::set_difference(S.broker_subs.begin(), S.broker_subs.end(), desired.begin(),
+                            desired.end(), std::back_inserter(unsub));
+        std::set_difference(desired.begin(), desired.end(), S.broker_subs.begin(),
+                            S.broker_subs.end(), std::back_inserter(sub));
+    }
+    for (const auto& topic : unsub) {
+        if (esp_mqtt_client_unsubscribe(client, topic.c_str()) < 0) continue;
+        std::lock_guard<std::mutex> lk(S.m);
+        S.broker_subs.erase(topic);
+    }
+    for (const auto& topic : sub) {
+        if (esp_mqtt_client_subscribe(client, topic.c_str(), 1) < 0) continue;
+        std::lock_guard<std::mutex> lk(S.m);
+        S.broker_subs.insert(topic);
+    }
+    if (!sub.empty() || !unsub.empty()) {
+        ESP_LOGI(TAG, "subscriptions: +%u -%u", (unsigned)sub.size(), (unsigned)unsub.size());
+    }
+    save_broker_subs();
+}
+
+// Publishes queued entries in order while the link is up. Stops at the first
+// refusal and leaves the entry queued for the next connect or retry tick.
+static void drain_outq()
+{
+    mqttrt::OutQueue::Entry e;
+    while (true) {
+        std::lock_guard<std::mutex> tx(S.tx_m);
+        if (!S.client || !S.connected) return;
+        {
+            std::lock_guard<std::mutex> lk(S.m);
+            if (!S.outq.peek(&e)) return;
+        }
+        const int mid = esp_mqtt_client_publish(S.client, e.topic.c_str(),
+                                                e.payload.data(),
+                                                static_cast<int>(e.payload.size()),
+                                                e.qos, e.retain);
+        std::lock_guard<std::mutex> lk(S.m);
+        if (mid < 0) {
+            S.outq.retry();
+            ESP_LOGW(TAG, "publish to %s refused (depth=%u), retrying",
+                     e.topic.c_str(), (unsigned)S.outq.depth());
+            return;
+        }
+        S.outq.sent(e, esp_timer_get_time());
+    }
+}
+
+static void tx_task(void*)
+{
+    while (true) {
+        bool idle;
+        {
+            std::lock_guard<std::mutex> lk(S.m);
+            idle = S.outq.empty();
+        }
+        // Woken by new publishes and by CONNECTED; the timeout only matters
+        // while something is queued and the client refused it.
+        ulTaskNotifyTake(pdTRUE, idle ? portMAX_DELAY : pdMS_TO_TICKS(kTxRetryMs));
+        drain_outq();
+    }
+}
+
+static void wake_tx()
+{
+    TaskHandle_t task = S.tx_task;
+    if (task) xTaskNotifyGive(task);
+}
+
+static void wake_waiter()
+{
+    TaskHandle_t waiter = S.waiter;
+    if (waiter) xTaskNotifyGive(waiter);
+}
+
 static void on_event(void* handler_args, esp_event_base_t, int32_t event_id, void* event_data)
 {
     auto* ev = static_cast<esp_mqtt_event_handle_t>(event_data);
     if (!ev) return;
     if (event_id == MQTT_EVENT_CONNECTED) {
-        ESP_LOGI(TAG, "MQTT connected (uri=%s)", S.uri.c_str());
-        S.connected = true;
-        if (!S.topic.empty()) {
-            esp_mqtt_client_subscribe(S.client, S.topic.c_str(), 1);
+        {
+            std::lock_guard<std::mutex> lk(S.m);
+            S.session_present = ev->session_present != 0;
+            ESP_LOGI(TAG, "MQTT connected (uri=%s client=%s session=%s)", S.uri.c_str(),
+                     S.client_id.c_str(), S.session_present.load() ? "resumed" : "new");
+            // A resumed session kept our subscriptions (and queues QoS1
+            // messages for delivery right after this event), possibly from
+            // before a reboot; a new one holds nothing.
+            if (!S.session_present) S.broker_subs.clear();
+            S.connected = true;
+            ++S.connect_count;
         }
-        std::lock_guard<std::mutex> lk(S.m);
-        for (auto &listener : S.listeners) {
-            if (!listener.topic.empty()) {
-                esp_mqtt_client_subscribe(S.client, listener.topic.c_str(), 1);
+        sync_subscriptions();
+        wake_waiter();
+        wake_tx();
+    } else if (event_id == MQTT_EVENT_DISCONNECTED) {
+        const auto st = S.inbox.stats();
+        ESP_LOGW(TAG, "MQTT disconnected (inbox rx=%u dropped=%u overwritten=%u peak=%uB)",
+                 (unsigned)st.pushed, (unsigned)st.dropped,
+                 (unsigned)st.overwritten, (unsigned)st.peak_bytes);
+        if (S.rx_fragmented || S.rx_oversized || S.rx_incomplete) {
+            ESP_LOGI(TAG, "rx: fragmented=%u oversized=%u incomplete=%u",
+                     (unsigned)S.rx_fragmented, (unsigned)S.rx_oversized,
+                     (unsigned)S.rx_incomplete);
+        }
+        if (S.match_count > 0) {
+            ESP_LOGI(TAG, "topic match: %u msgs, %u routes, avg=%uus max=%uus",
+                     (unsigned)S.match_count, (unsigned)S.routes.size(),
+                     (unsigned)(S.match_us_total / S.match_count),
+                     (unsigned)S.match_us_max);
+        }
+        {
+            std::lock_guard<std::mutex> lk(S.m);
+            if (!S.outq.empty()) {
+                ESP_LOGI(TAG, "tx: %u publishes (%uB) held until reconnect",
+                         (unsigned)S.outq.depth(), (unsigned)S.outq.bytes());
             }
         }
-    } else if (event_id == MQTT_EVENT_DISCONNECTED) {
-        ESP_LOGW(TAG, "MQTT disconnected");
         S.connected = false;
+        wake_waiter();
     } else if (event_id == MQTT_EVENT_ERROR) {
         if (ev->error_handle) {
             ESP_LOGE(
@@ -71,30 +427,12 @@ static void on_event(void* handler_args, esp_event_base_t, int32_t event_id, voi
             ESP_LOGE(TAG, "MQTT error event without error_handle");
         }
     } else if (event_id == MQTT_EVENT_DATA) {
-        std::string payload(ev->data, ev->data_len);
-        std::string topic;
-        if (ev->topic && ev->topic_len > 0) {
-            topic.assign(ev->topic, ev->topic_len);
-        }
-        bool matched = false;
+        bool personal = false;
         {
             std::lock_guard<std::mutex> lk(S.m);
-            if (!S.topic.empty() && topic == S.topic) {
-                S.queue.push(payload);
-                matched = true;
-            }
-            if (!matched) {
-                for (auto &listener : S.listeners) {
-                    if (listener.active && !listener.topic.empty() &&
-                        listener.topic == topic) {
-                        listener.queue.push_back(payload);
-                        matched = true;
-                        break;
-                    }
-                }
-            }
+            personal = on_data(ev);
         }
-        (void)matched;
+        if (personal) wake_waiter();
     }
 }
 } // namespace
@@ -108,6 +446,10 @@ int mqtt_rt_configure(const char* host, int port, const char* user_id)
         S.user_id = user_id;
         S.topic = std::string("chat/messages/") + S.user_id;
     }
+    if (!S.inbox.init(kInboxRingBytes, mqttrt::ByteRing::Overflow::kOverwriteOldest)) {
+        ESP_LOGE(TAG, "inbox ring alloc failed");
+        return -2;
+    }
     return 0;
 }
 
@@ -115,11 +457,26 @@ int mqtt_rt_start(void)
 {
     if (S.client) return 0; // already started
     if (S.host.empty()) return -1;
+    if (!S.tx_task &&
+        xTaskCreate(&tx_task, "mqtt_tx", kTxTaskStack, nullptr, 5, &S.tx_task) != pdPASS) {
+        S.tx_task = nullptr;
+        ESP_LOGE(TAG, "sender task create failed");
+        return -4;
+    }
     S.uri = std::string("mqtt://") + S.host + ":" + std::to_string(S.port);
     ESP_LOGI(TAG, "MQTT start: host=%s port=%d user_id=%s uri=%s",
              S.host.c_str(), S.port, S.user_id.c_str(), S.uri.c_str());
     esp_mqtt_client_config_t cfg = {};
     cfg.broker.address.uri = S.uri.c_str();
+    if (!S.user_id.empty()) {
+        S.client_id = client_id_for(S.user_id);
+        cfg.credentials.client_id = S.client_id.c_str();
+        std::lock_guard<std::mutex> lk(S.m);
+        if (S.broker_subs_client != S.client_id) load_broker_subs_locked();
+        cfg.session.disable_clean_session = true;
+    } else {
+        S.client_id.clear();
+    }
     cfg.network.disable_auto_reconnect = false;
     cfg.session.keepalive = 30;
     cfg.task.stack_size = 4096;
@@ -137,6 +494,8 @@ int mqtt_rt_start(void)
 
 void mqtt_rt_stop(void)
 {
+    // Queued publishes stay in S.outq and go out after the next start.
+    std::lock_guard<std::mutex> tx(S.tx_m);
     if (S.client) {
         esp_mqtt_client_stop(S.client);
         esp_mqtt_client_destroy(S.client);
@@ -153,31 +512,38 @@ int mqtt_rt_resume(void)
 int mqtt_rt_update_user(const char* user_id)
 {
     if (!user_id || !*user_id) return -1;
-    S.user_id = user_id;
-    S.topic = std::string("chat/messages/") + S.user_id;
-    if (S.connected && S.client) {
-        esp_mqtt_client_subscribe(S.client, S.topic.c_str(), 1);
+    {
+        std::lock_guard<std::mutex> lk(S.m);
+        S.user_id = user_id;
+        S.topic = std::string("chat/messages/") + S.user_id;
     }
+    sync_subscriptions();
     return 0;
 }
 
+char* mqtt_rt_alloc_pop_buffer(void)
+{
+    auto* buf = static_cast<char*>(
+        heap_caps_malloc(MQTT_RT_POP_BUFFER_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    if (!buf) {
+        buf = static_cast<char*>(heap_caps_malloc(MQTT_RT_POP_BUFFER_BYTES,
+                                                  MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    }
+    if (!buf) ESP_LOGE(TAG, "pop buffer alloc failed");
+    return buf;
+}
+
 bool mqtt_rt_pop_message(char* out_json, size_t out_cap)
 {
-    if (!out_json || out_cap == 0) return false;
-    std::lock_guard<std::mutex> lk(S.m);
-    if (S.queue.empty()) return false;
-    std::string s = std::move(S.queue.front()); S.queue.pop();
-    size_t n = s.size(); if (n >= out_cap) n = out_cap - 1;
-    memcpy(out_json, s.data(), n);
-    out_json[n] = 0;
-    return true;
+    return S.inbox.pop(out_json, out_cap) >= 0;
 }
 
 namespace {
-State::Listener* find_listener(int id)
+std::shared_ptr<State::Listener> find_listener(int id)
 {
+    std::lock_guard<std::mutex> lk(S.m);
     for (auto &listener : S.listeners) {
-        if (listener.id == id) return &listener;
+        if (listener->id == id) return listener;
     }
     return nullptr;
 }
@@ -185,71 +551,161 @@ State::Listener* find_listener(int id)
 
 int mqtt_rt_add_listener(const char* topic)
 {
-    if (!topic || !*topic) return -1;
+    if (!topic || !mqttrt::topic_filter_valid(topic)) return -1;
     std::string topic_str(topic);
     int id;
-    std::string subscribe_topic;
+    auto listener = std::make_shared<State::Listener>();
+    if (!listener->ring.init(kListenerRingBytes,
+                             mqttrt::ByteRing::Overflow::kOverwriteOldest)) {
+        ESP_LOGE(TAG, "listener ring alloc failed for %s", topic);
+        return -1;
+    }
     {
         std::lock_guard<std::mutex> lk(S.m);
         id = S.next_listener_id++;
-        State::Listener listener;
-        listener.id = id;
-        listener.topic = std::move(topic_str);
-        listener.active = true;
-        subscribe_topic = listener.topic;
+        listener->id = id;
+        listener->topic = std::move(topic_str);
+        listener->active = true;
+        S.routes.insert(listener->topic, listener);
+        ++S.sub_refs[listener->topic];
         S.listeners.push_back(std::move(listener));
     }
-    if (!subscribe_topic.empty() && S.client && S.connected) {
-        esp_mqtt_client_subscribe(S.client, subscribe_topic.c_str(), 1);
-    }
+    sync_subscriptions();
     return id;
 }
 
 void mqtt_rt_remove_listener(int listener_id)
 {
     if (listener_id <= 0) return;
-    std::string topic;
     {
         std::lock_guard<std::mutex> lk(S.m);
-        auto it = std::remove_if(S.listeners.begin(), S.listeners.end(),
-                                 [&](const State::Listener& l) {
-                                     if (l.id == listener_id) {
-                                         topic = l.topic;
-                                         return true;
-                                     }
-                                     return false;
-                                 });
-        if (it != S.listeners.end()) {
-            S.listeners.erase(it, S.listeners.end());
-        }
-    }
-    if (!topic.empty() && S.client && S.connected) {
-        esp_mqtt_client_unsubscribe(S.client, topic.c_str());
+        auto it = std::find_if(S.listeners.begin(), S.listeners.end(),
+                               [&](const std::shared_ptr<State::Listener>& l) {
+                                   return l->id == listener_id;
+                               });
+        if (it == S.listeners.end()) return;
+        auto listener = *it;
+        S.listeners.erase(it);
+        S.routes.erase(listener->topic, listener);
+        // The broker subscription stays while another listener (or the
+        // personal inbox) still uses the filter.
+        auto ref = S.sub_refs.find(listener->topic);
+        if (ref != S.sub_refs.end() && --ref->second <= 0) S.sub_refs.erase(ref);
+        const auto st = listener->ring.stats();
+        ESP_LOGI(TAG, "listener %d (%s): rx=%u dropped=%u overwritten=%u peak=%uB",
+                 listener->id, listener->topic.c_str(), (unsigned)st.pushed,
+                 (unsigned)st.dropped, (unsigned)st.overwritten,
+                 (unsigned)st.peak_bytes);
     }
+    sync_subscriptions();
 }
 
 bool mqtt_rt_listener_pop(int listener_id, char* out_json, size_t out_cap)
 {
     if (listener_id <= 0 || !out_json || out_cap == 0) return false;
-    std::lock_guard<std::mutex> lk(S.m);
-    auto* listener = find_listener(listener_id);
-    if (!listener || listener->queue.empty()) return false;
-    std::string payload = std::move(listener->queue.front());
-    listener->queue.pop_front();
-    size_t n = payload.size();
-    if (n >= out_cap) n = out_cap - 1;
-    memcpy(out_json, payload.data(), n);
-    out_json[n] = 0;
-    return true;
+    auto listener = find_listener(listener_id);
+    if (!listener) return false;
+    return listener->ring.pop(out_json, out_cap) >= 0;
+}
+
+uint32_t mqtt_rt_take_overwritten(int listener_id)
+{
+    if (listener_id == 0) return S.inbox.take_overwritten();
+    auto listener = find_listener(listener_id);
+    return listener ? listener->ring.take_overwritten() : 0;
 }
 
 int mqtt_rt_publish(const char* topic, const char* payload, int qos, bool retain)
 {
-    if (!topic || !payload || !S.client) return -1;
-    return esp_mqtt_client_publish(S.client, topic, payload, 0, qos, retain);
+    return mqtt_rt_publish_ex(topic, payload, qos, retain, 0);
+}
+
+int mqtt_rt_publish_ex(const char* topic, const char* payload, int qos, bool retain,
+                       uint32_t flags)
+{
+    if (!topic || !*topic || !payload) return -1;
+    mqttrt::OutQueue::Push res;
+    {
+        std::lock_guard<std::mutex> lk(S.m);
+        res = S.outq.push(topic, payload, qos, retain,
+                          (flags & MQTT_RT_PUB_COALESCE) != 0,
+                          esp_timer_get_time());
+    }
+    if (res == mqttrt::OutQueue::Push::kRejected) {
+        ESP_LOGW(TAG, "tx queue full, dropping publish to %s", topic);
+        return -2;
+    }
+    if (S.connected) wake_tx();
+    return 0;
+}
+
+void mqtt_rt_get_tx_stats(mqtt_rt_tx_stats_t* out)
+{
+    if (!out) return;
+    std::lock_guard<std::mutex> lk(S.m);
+    const auto st = S.outq.stats();
+    out->depth = static_cast<uint32_t>(S.outq.depth());
+    out->bytes = static_cast<uint32_t>(S.outq.bytes());
+    out->oldest_age_ms = S.outq.oldest_age_ms(esp_timer_get_time());
+    out->enqueued = st.enqueued;
+    out->sent = st.sent;
+    out->coalesced = st.coalesced;
+    out->rejected = st.rejected;
+    out->retried = st.retried;
+    out->peak_depth = st.peak_depth;
+    out->peak_bytes = st.peak_bytes;
+    out->latency_avg_ms = st.sent ? static_cast<uint32_t>(st.latency_total_ms / st.sent) : 0;
+    out->latency_max_ms = st.latency_max_ms;
 }
 
 bool mqtt_rt_is_running(void)
 {
     return S.client != nullptr;
 }
+
+uint32_t mqtt_rt_connect_count(void)
+{
+    return S.connect_count;
+}
+
+bool mqtt_rt_get_ring_stats(int listener_id, mqtt_rt_ring_stats_t* out)
+{
+    if (!out) return false;
+    if (listener_id == 0) {
+        fill_stats(S.inbox, out);
+        return true;
+    }
+    auto listener = find_listener(listener_id);
+    if (!listener) return false;
+    fill_stats(listener->ring, out);
+    return true;
+}
+
+void mqtt_rt_get_rx_stats(mqtt_rt_rx_stats_t* out)
+{
+    if (!out) return;
+    std::lock_guard<std::mutex> lk(S.m);
+    out->fragmented = S.rx_fragmented;
+    out->oversized = S.rx_oversized;
+    out->incomplete = S.rx_incomplete;
+}
+
+bool mqtt_rt_session_present(void)
+{
+    return S.connected && S.session_present;
+}
+
+bool mqtt_rt_is_connected(void)
+{
+    return S.client != nullptr && S.connected;
+}
+
+bool mqtt_rt_wait_event(uint32_t timeout_ms)
+{
+    S.waiter = xTaskGetCurrentTaskHandle();
+    // Data may have landed before the waiter was registered.
+    if (!S.inbox.empty()) return true;
+    TickType_t ticks = (timeout_ms == UINT32_MAX) ? portMAX_DELAY
+                                                  : pdMS_TO_TICKS(timeout_ms);
+    return ulTaskNotifyTake(pdTRUE, ticks) != 0;
+}
@@ -3,17 +3,18 @@
 #include <cstdint>
 #include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 
-#include <ArduinoJson.h>
-
 #include "ui/core/input_adapter.hpp"
 #include "ui/core/screen.hpp"
 
 namespace ui::messagebox {
 
+// Borrowed from the screen's MessageHistory; rebuilt whenever it changes.
 struct ViewEntry {
-    JsonObject obj;
+    std::string_view message;
+    bool incoming = true;
 };
 
 struct ViewState : public ui::ScreenStateBase {
@@ -82,9 +83,7 @@ class Renderer : public ui::IScreenRenderer {
         if (api.begin_frame) api.begin_frame();
 
         for (size_t i = 0; i < state.message_views.size(); i++) {
-            JsonObject msg = state.message_views[i].obj;
-            std::string message = msg["message"].as<std::string>();
-            std::string message_from = msg["from"].as<std::string>();
+            const ViewEntry& entry = state.message_views[i];
 
             int cursor_y = state.offset_y + (state.font_height * (i + 1));
             const int line_top = cursor_y;
@@ -92,9 +91,10 @@ class Renderer : public ui::IScreenRenderer {
             if (line_bottom <= 0 || line_top >= api.screen_height) continue;
             if (line_top < 0 || line_bottom > api.screen_height) continue;
 
-            const bool incoming = (message_from != state.my_name);
-            if (api.draw_prefix) api.draw_prefix(cursor_y, incoming, state.font_height);
-            if (api.draw_text) api.draw_text(cursor_y, message);
+            if (api.draw_prefix) {
+                api.draw_prefix(cursor_y, entry.incoming, state.font_height);
+            }
+            if (api.draw_text) api.draw_text(cursor_y, std::string(entry.message));
         }
 
         if (api.draw_header) api.draw_header(state.header_text, state.chat_to);
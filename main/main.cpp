@@ -520,9 +520,25 @@ void app_main(void) {
     WiFi::BootResult wifi_boot_result = WiFi::BootResult::kInitError;
     bool ble_only_boot = false;
     bool network_connected = false;
+    // A timer wake only refreshes the unread count and goes back to sleep
+    // (below), so it neither mounts SPIFFS nor flushes the outbox; storage
+    // mounts on first access if the wake falls through to a normal boot.
+    const esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
+    const bool timer_wake = (wakeup_reason == ESP_SLEEP_WAKEUP_TIMER);
     if (!post_reset_boot) {
+        if (timer_wake) {
+            WiFi::defer_outbox_flush(true);
+        } else {
+            // SPIFFS mount (and first-boot format) runs on the network worker
+            // while Wi-Fi comes up, ahead of the first history / outbox access.
+            netexec::Executor::shared().post(
+                netexec::Priority::kUser, "storage_mount",
+                []() { (void)storage_fs::ensure_mounted(); });
+        }
         profiler.run_step("Wi-Fi init", [&]() { wifi_boot_result = wifi.main(); });
         network_connected = (wifi_boot_result == WiFi::BootResult::kConnected);
+        // Timer wake without a network is a normal boot after all.
+        if (timer_wake && !network_connected) WiFi::defer_outbox_flush(false);
         ble_only_boot =
             (wifi_boot_result == WiFi::BootResult::kBleFallbackActive ||
              wifi_boot_result == WiFi::BootResult::kBleDeferred ||
@@ -584,7 +600,6 @@ void app_main(void) {
     const int sleep_time_sec = 30;
     esp_sleep_enable_timer_wakeup(sleep_time_sec * uS_TO_S_FACTOR);
 
-    esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
     auto boot_led_animation = [&]() {
         for (int i = 0; i < 50; i++) {
             neopixel.set_color(i, i, i);
@@ -601,10 +616,10 @@ void app_main(void) {
         profiler.run_step("Boot display", [&]() { oled.BootDisplay(); });
         profiler.run_step("Boot LED animation", boot_led_animation);
 
-    } else if (wakeup_reason == ESP_SLEEP_WAKEUP_TIMER && !post_reset_boot &&
-               network_connected) {
+    } else if (timer_wake && !post_reset_boot && network_connected) {
         HttpClient& http_client = HttpClient::shared();
-        esp_err_t unread_err = http_client.refresh_unread_count();
+        esp_err_t unread_err =
+            http_client.refresh_unread_count(/*from_deep_sleep=*/true);
         if (unread_err != ESP_OK) {
             ESP_LOGW(TAG, "Failed to refresh unread count: %s",
                      esp_err_to_name(unread_err));
@@ -0,0 +1,363 @@
+// Host fuzz test and throughput bench for bleframe::Decoder (ble_frame.hpp).
+//
+// roundtrip  A random mix of v1 binary frames (kJson with arbitrary bytes,
+//            kJsonLzd with compressed JSON), newline-terminated text lines
+//            and bare JSON objects (nested, with braces and escaped quotes
+//            inside strings) is cut into random GATT-write sizes and fed to
+//            the decoder with the firmware's ring and frame sizes. The
+//            frames must come out exactly, in order, with the right types.
+// garbage    Random bytes (magic bytes and truncated headers included), a
+//            newline and then a clean stream of frames, followed by enough
+//            padding to complete any header the garbage started. The clean
+//            frames must be the last ones delivered, nothing may exceed the
+//            frame cap, and ASan must stay quiet.
+// bench      MB/s and allocations per frame for the decoder on newline JSON,
+//            bare JSON objects, binary and LZD1 frames, and for the
+//            std::string append / find / erase reassembly it replaced, fed
+//            in 244-byte writes (MTU 247 minus the ATT header).
+//
+// Build and run from the repo root:
+//   g++ -O2 -std=c++17 -Itools/host_stubs -Icomponents/services/ble/include
+//       tools/ble_frame_test/ble_frame_test.cpp -o /tmp/ble_frame_test
+//   /tmp/ble_frame_test --rounds 2000
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ble_frame.hpp"
+
+static std::atomic<uint64_t> g_allocs{0};
+
+// The replacements go through out-of-line helpers so GCC does not pair an
+// inlined malloc with a delete and warn (-Wmismatched-new-delete).
+__attribute__((noinline)) static void* counted_alloc(size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) static void counted_free(void* p) { std::free(p); }
+
+void* operator new(size_t n) { return counted_alloc(n); }
+void* operator new[](size_t n) { return counted_alloc(n); }
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete(void* p, size_t) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t) noexcept { counted_free(p); }
+
+namespace {
+
+// Same sizes as ble_uart.cpp.
+constexpr size_t kRxRingBytes = 16 * 1024;
+constexpr size_t kRxMaxFrame = 12 * 1024;
+constexpr size_t kWriteBytes = 244;
+
+struct Frame {
+    bleframe::Type type;
+    std::string data;
+    bool operator==(const Frame& o) const { return type == o.type && data == o.data; }
+};
+
+std::string random_word(std::mt19937& rng, size_t max) {
+    static const char kChars[] = "abcdefghijklmnopqrstuvwxyz0123456789 _-:";
+    std::string s;
+    const size_t n = 1 + rng() % max;
+    for (size_t i = 0; i < n; ++i) s += kChars[rng() % (sizeof(kChars) - 1)];
+    return s;
+}
+
+// A JSON-ish object whose strings contain braces and escaped quotes, the
+// cases the brace counter has to get right.
+std::string random_object(std::mt19937& rng, int depth = 0) {
+    std::string s = "{";
+    const int fields = 1 + rng() % 5;
+    for (int f = 0; f < fields; ++f) {
+        if (f) s += ',';
+        s += "\"" + random_word(rng, 8) + "\":";
+        switch (rng() % 5) {
+            case 0:
+                s += "\"" + random_word(rng, 20) + "\"";
+                break;
+            case 1:
+                s += "\"br{ce}s \\\"q\\\" \\\\\"";
+                break;
+            case 4:
+                // A lone escaped quote followed by braces.
+                s += "\"x\\\"}{\"";
+                break;
+            case 2:
+                s += std::to_string(rng() % 100000);
+                break;
+            default:
+                s += depth < 3 ? random_object(rng, depth + 1) : "null";
+                break;
+        }
+    }
+    return s + "}";
+}
+
+std::string app_json(std::mt19937& rng, size_t messages) {
+    std::string s = "{\"type\":\"messages\",\"messages\":[";
+    for (size_t i = 0; i < messages; ++i) {
+        if (i) s += ',';
+        s += "{\"id\":\"" + std::to_string(rng()) + "\",\"message_id\":\"m" +
+             std::to_string(i) + "\",\"from\":\"u1\",\"message\":\"" + random_word(rng, 40) +
+             "\",\"payload\":{\"sender_id\":\"u1\",\"receiver_id\":\"u2\",\"content\":\"" +
+             random_word(rng, 40) +
+             "\",\"created_at\":\"2025-03-04T05:06:07.000Z\",\"is_read\":false}}";
+    }
+    return s + "]}";
+}
+
+void add_frame(std::mt19937& rng, std::string& wire, std::vector<Frame>& want) {
+    switch (rng() % 5) {
+        case 0: {  // binary, arbitrary bytes
+            std::string p(rng() % 600, '\0');
+            for (auto& c : p) c = static_cast<char>(rng());
+            if (p.empty()) p = "x";
+            bleframe::encode(bleframe::Type::kJson, p.data(), p.size(), wire);
+            want.push_back({bleframe::Type::kJson, p});
+            break;
+        }
+        case 1: {  // compressed JSON
+            const std::string json = app_json(rng, 1 + rng() % 8);
+            std::string z;
+            lzd::encode(json, z);
+            bleframe::encode(bleframe::Type::kJsonLzd, z.data(), z.size(), wire);
+            want.push_back({bleframe::Type::kJson, json});
+            break;
+        }
+        case 2: {  // legacy line
+            const std::string line = random_word(rng, 80);
+            wire += line + (rng() % 2 ? "\n" : "\r\n");
+            // The decoder keeps the '\r'; handle_frame_from_phone trims it.
+            want.push_back({bleframe::Type::kText, line + (wire[wire.size() - 2] == '\r'
+                                                               ? "\r"
+                                                               : "")});
+            break;
+        }
+        default: {  // bare JSON object, optionally newline-terminated
+            const std::string obj = rng() % 2 ? random_object(rng) : app_json(rng, 2);
+            wire += obj;
+            if (rng() % 2) wire += '\n';
+            want.push_back({bleframe::Type::kText, obj});
+            break;
+        }
+    }
+}
+
+std::vector<Frame> feed_all(bleframe::Decoder& dec, const std::string& wire, std::mt19937& rng,
+                            size_t* max_len = nullptr) {
+    std::vector<Frame> got;
+    size_t pos = 0;
+    while (pos < wire.size()) {
+        const size_t n = std::min<size_t>(wire.size() - pos, 1 + rng() % kWriteBytes);
+        dec.feed(reinterpret_cast<const uint8_t*>(wire.data()) + pos, n,
+                 [&](bleframe::Type t, std::string_view f) {
+                     if (max_len) *max_len = std::max(*max_len, f.size());
+                     got.push_back({t, std::string(f)});
+                 });
+        pos += n;
+    }
+    return got;
+}
+
+void describe_mismatch(const std::vector<Frame>& got, const std::vector<Frame>& want) {
+    size_t i = 0;
+    while (i < got.size() && i < want.size() && got[i] == want[i]) ++i;
+    fprintf(stderr, "  got %zu frames, want %zu; first difference at %zu\n", got.size(),
+            want.size(), i);
+    if (i < got.size()) {
+        fprintf(stderr, "  got  type=%d len=%zu\n", int(got[i].type), got[i].data.size());
+    }
+    if (i < want.size()) {
+        fprintf(stderr, "  want type=%d len=%zu\n", int(want[i].type), want[i].data.size());
+    }
+}
+
+bool roundtrip(uint32_t rounds, uint32_t seed) {
+    std::mt19937 rng(seed);
+    for (uint32_t r = 0; r < rounds; ++r) {
+        bleframe::Decoder dec;
+        dec.init(kRxRingBytes, kRxMaxFrame);
+        std::string wire;
+        std::vector<Frame> want;
+        const int frames = 1 + rng() % 40;
+        for (int i = 0; i < frames; ++i) add_frame(rng, wire, want);
+        const auto got = feed_all(dec, wire, rng);
+        const auto st = dec.stats();
+        if (got != want || st.crc_errors || st.bad_headers || st.decode_errors ||
+            st.overflows || st.oversized) {
+            fprintf(stderr, "roundtrip round %u failed (crc=%u hdr=%u lzd=%u)\n", r,
+                    st.crc_errors, st.bad_headers, st.decode_errors);
+            describe_mismatch(got, want);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool garbage(uint32_t rounds, uint32_t seed) {
+    std::mt19937 rng(seed);
+    for (uint32_t r = 0; r < rounds; ++r) {
+        bleframe::Decoder dec;
+        dec.init(kRxRingBytes, kRxMaxFrame);
+        std::string wire;
+        const size_t junk = rng() % 200;
+        for (size_t i = 0; i < junk; ++i) {
+            const uint32_t k = rng() % 8;
+            wire += k == 0 ? char(bleframe::kMagic) : k == 1 ? char(bleframe::kVersion)
+                                                             : char(rng());
+        }
+        // A torn binary frame: valid header, payload cut short.
+        if (rng() % 2) {
+            std::string torn;
+            const std::string p = random_word(rng, 100);
+            bleframe::encode(bleframe::Type::kJson, p.data(), p.size(), torn);
+            wire += torn.substr(0, rng() % torn.size());
+        }
+        wire += '\n';
+        std::vector<Frame> want;
+        const int frames = 1 + rng() % 10;
+        for (int i = 0; i < frames; ++i) add_frame(rng, wire, want);
+        // Completes any header the junk opened so the decoder rescans.
+        wire += std::string(kRxMaxFrame + bleframe::kHeaderBytes, '\n');
+        size_t max_len = 0;
+        const auto got = feed_all(dec, wire, rng, &max_len);
+        const bool tail_ok =
+            got.size() >= want.size() &&
+            std::equal(want.begin(), want.end(), got.end() - want.size());
+        if (!tail_ok || max_len > kRxMaxFrame) {
+            fprintf(stderr, "garbage round %u failed (max_len=%zu)\n", r, max_len);
+            describe_mismatch(std::vector<Frame>(got.end() - std::min(got.size(), want.size()),
+                                                 got.end()),
+                              want);
+            return false;
+        }
+    }
+    return true;
+}
+
+// The reassembly ble_uart.cpp used before the decoder.
+class LegacyRx {
+   public:
+    template <typename Sink>
+    void feed(const uint8_t* d, size_t l, Sink&& sink) {
+        rx_buffer_.append(reinterpret_cast<const char*>(d), l);
+        size_t idx;
+        while ((idx = rx_buffer_.find('\n')) != std::string::npos) {
+            std::string frame = rx_buffer_.substr(0, idx);
+            rx_buffer_.erase(0, idx + 1);
+            if (!frame.empty()) sink(frame);
+        }
+        auto extract_json = [&]() -> bool {
+            size_t start = rx_buffer_.find('{');
+            if (start == std::string::npos) {
+                rx_buffer_.clear();
+                return false;
+            }
+            bool in_string = false;
+            bool escape = false;
+            int depth = 0;
+            for (size_t i = start; i < rx_buffer_.size(); ++i) {
+                const char c = rx_buffer_[i];
+                if (in_string) {
+                    if (escape) escape = false;
+                    else if (c == '\\') escape = true;
+                    else if (c == '"') in_string = false;
+                } else if (c == '"') {
+                    in_string = true;
+                } else if (c == '{') {
+                    depth++;
+                } else if (c == '}' && --depth == 0) {
+                    std::string frame = rx_buffer_.substr(start, i - start + 1);
+                    rx_buffer_.erase(0, i + 1);
+                    sink(frame);
+                    return true;
+                }
+            }
+            if (start > 0) rx_buffer_.erase(0, start);
+            return false;
+        };
+        int guard = 0;
+        while (extract_json() && guard++ < 4) {
+        }
+    }
+
+   private:
+    std::string rx_buffer_;
+};
+
+template <typename Rx>
+void bench_one(const char* label, Rx& rx, const std::string& wire, size_t frames_per_pass,
+               uint32_t passes) {
+    uint64_t delivered = 0;
+    const uint64_t a0 = g_allocs.load();
+    const auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t p = 0; p < passes; ++p) {
+        for (size_t pos = 0; pos < wire.size(); pos += kWriteBytes) {
+            const size_t n = std::min(kWriteBytes, wire.size() - pos);
+            rx.feed(reinterpret_cast<const uint8_t*>(wire.data()) + pos, n,
+                    [&](auto&&...) { ++delivered; });
+        }
+    }
+    const double s =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    const uint64_t frames = uint64_t(frames_per_pass) * passes;
+    printf("bench %-22s %7.1f MB/s  %5.2f alloc/frame  %s\n", label,
+           wire.size() * double(passes) / s / 1e6,
+           double(g_allocs.load() - a0) / frames, delivered == frames ? "" : "(frame count!)");
+}
+
+void bench(uint32_t passes) {
+    std::mt19937 rng(3);
+    std::vector<std::string> docs;
+    for (int i = 0; i < 64; ++i) docs.push_back(app_json(rng, 1 + rng() % 6));
+
+    std::string text, bare, binary, packed;
+    for (const auto& d : docs) {
+        text += d + "\n";
+        bare += d;
+        bleframe::encode(bleframe::Type::kJson, d.data(), d.size(), binary);
+        std::string z;
+        lzd::encode(d, z);
+        bleframe::encode(bleframe::Type::kJsonLzd, z.data(), z.size(), packed);
+    }
+    bleframe::Decoder dec;
+    dec.init(kRxRingBytes, kRxMaxFrame);
+    LegacyRx legacy;
+    bench_one("decoder text json", dec, text, docs.size(), passes);
+    bench_one("decoder binary json", dec, binary, docs.size(), passes);
+    bench_one("decoder lzd1 json", dec, packed, docs.size(), passes);
+    bench_one("decoder bare json", dec, bare, docs.size(), passes);
+    bench_one("legacy text json", legacy, text, docs.size(), passes);
+    bench_one("legacy bare json", legacy, bare, docs.size(), passes);
+    printf("wire bytes per pass: text %zu, binary %zu, lzd1 %zu\n", text.size(), binary.size(),
+           packed.size());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    uint32_t rounds = 500;
+    uint32_t passes = 2000;
+    uint32_t seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--rounds")) rounds = strtoul(argv[i + 1], nullptr, 10);
+        if (!strcmp(argv[i], "--passes")) passes = strtoul(argv[i + 1], nullptr, 10);
+        if (!strcmp(argv[i], "--seed")) seed = strtoul(argv[i + 1], nullptr, 10);
+    }
+    const bool rt = roundtrip(rounds, seed);
+    printf("roundtrip: %s (%u rounds)\n", rt ? "ok" : "FAIL", rounds);
+    const bool gb = garbage(rounds, seed + 1);
+    printf("garbage:   %s (%u rounds)\n", gb ? "ok" : "FAIL", rounds);
+    if (passes) bench(passes);
+    return rt && gb ? 0 : 1;
+}
@@ -0,0 +1,306 @@
+// Host benchmark and fuzz test for the LZD1 codec (ble_lzd.hpp).
+//
+// ratio     Compresses app-shaped JSON frames (messages, friends, pending
+//           requests, friend request results) of several sizes, plus any
+//           files named on the command line (e.g. payloads captured from
+//           the relay), and prints wire bytes against raw bytes per kind.
+// speed     Decoder throughput in MB/s of output, fed in one piece and in
+//           two pieces (the wrapped-ring case in ble_frame.hpp), and the
+//           encoder throughput for reference.
+// fuzz      roundtrip: random JSON and random bytes must decode back exactly
+//           whatever the split points, and fail cleanly with a buffer one
+//           byte too small. corrupt: truncated, bit-flipped and random token
+//           streams must either decode within the buffer or be rejected;
+//           the output buffer is exactly cap bytes of heap, so ASan catches
+//           any overrun.
+//
+// Build and run from the repo root:
+//   g++ -O2 -std=c++17 -Icomponents/services/ble/include
+//       tools/ble_lzd_bench/ble_lzd_bench.cpp -o /tmp/ble_lzd_bench
+//   /tmp/ble_lzd_bench --rounds 20000 [payload files...]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ble_lzd.hpp"
+
+namespace {
+
+std::string word(std::mt19937& rng, size_t min, size_t max) {
+    static const char kChars[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+    std::string s;
+    const size_t n = min + rng() % (max - min + 1);
+    for (size_t i = 0; i < n; ++i) s += kChars[rng() % (sizeof(kChars) - 1)];
+    return s;
+}
+
+std::string uuid(std::mt19937& rng) {
+    static const char kHex[] = "0123456789abcdef";
+    std::string s;
+    for (int i = 0; i < 36; ++i) {
+        s += (i == 8 || i == 13 || i == 18 || i == 23) ? '-' : kHex[rng() % 16];
+    }
+    return s;
+}
+
+std::string messages_json(std::mt19937& rng, size_t n) {
+    std::string s = "{\"id\":\"" + std::to_string(rng()) + "\",\"type\":\"messages\",\"messages\":[";
+    for (size_t i = 0; i < n; ++i) {
+        if (i) s += ',';
+        const std::string from = uuid(rng);
+        s += "{\"id\":\"" + uuid(rng) + "\",\"message_id\":\"" + uuid(rng) + "\",\"from\":\"" +
+             from + "\",\"message\":\"" + word(rng, 4, 60) +
+             "\",\"payload\":{\"sender_id\":\"" + from + "\",\"receiver_id\":\"" + uuid(rng) +
+             "\",\"content\":\"" + word(rng, 4, 60) + "\",\"created_at\":\"2025-0" +
+             std::to_string(1 + rng() % 9) + "-1" + std::to_string(rng() % 10) + "T0" +
+             std::to_string(rng() % 10) + ":1" + std::to_string(rng() % 10) +
+             ":22.123Z\",\"is_read\":" + (rng() % 2 ? "true" : "false") + "}}";
+    }
+    return s + "]}";
+}
+
+std::string friends_json(std::mt19937& rng, size_t n) {
+    std::string s = "{\"type\":\"friends\",\"friends\":[";
+    for (size_t i = 0; i < n; ++i) {
+        if (i) s += ',';
+        const std::string name = word(rng, 3, 12);
+        const unsigned unread = rng() % 4;
+        s += "{\"id\":\"" + uuid(rng) + "\",\"friend_id\":\"" + uuid(rng) +
+             "\",\"user_name\":\"" + name + "\",\"display_name\":\"" + name +
+             "\",\"nickname\":\"\",\"login_id\":\"" + name + "\",\"short_id\":\"" +
+             word(rng, 6, 6) + "\",\"username\":\"" + name +
+             "\",\"unread_count\":" + std::to_string(unread) +
+             ",\"has_unread\":" + (unread ? "true" : "false") + "}";
+    }
+    return s + "]}";
+}
+
+std::string pending_json(std::mt19937& rng, size_t n) {
+    std::string s = "{\"type\":\"pending_requests\",\"requests\":[";
+    for (size_t i = 0; i < n; ++i) {
+        if (i) s += ',';
+        s += "{\"request_id\":\"" + uuid(rng) + "\",\"username\":\"" + word(rng, 3, 12) + "\"}";
+    }
+    return s + "]}";
+}
+
+std::string result_json(std::mt19937& rng) {
+    return rng() % 2 ? "{\"type\":\"friend_request_result\",\"ok\":true,\"error\":null}"
+                     : "{\"type\":\"friend_request_result\",\"ok\":false,\"error\":\"" +
+                           word(rng, 8, 30) + "\"}";
+}
+
+struct Sample {
+    std::string kind;
+    std::string data;
+};
+
+std::vector<Sample> corpus(std::mt19937& rng) {
+    std::vector<Sample> out;
+    for (size_t n : {1, 5, 20}) {
+        for (int k = 0; k < 20; ++k) {
+            out.push_back({"messages x" + std::to_string(n), messages_json(rng, n)});
+            out.push_back({"friends x" + std::to_string(n), friends_json(rng, n)});
+            out.push_back({"pending x" + std::to_string(n), pending_json(rng, n)});
+        }
+    }
+    for (int k = 0; k < 20; ++k) out.push_back({"friend_request_result", result_json(rng)});
+    return out;
+}
+
+void ratio(const std::vector<Sample>& samples) {
+    std::vector<std::string> kinds;
+    for (const auto& s : samples) {
+        if (std::find(kinds.begin(), kinds.end(), s.kind) == kinds.end()) kinds.push_back(s.kind);
+    }
+    size_t all_raw = 0;
+    size_t all_wire = 0;
+    for (const auto& k : kinds) {
+        size_t raw = 0;
+        size_t wire = 0;
+        size_t count = 0;
+        for (const auto& s : samples) {
+            if (s.kind != k) continue;
+            std::string z;
+            lzd::encode(s.data, z);
+            raw += s.data.size();
+            wire += z.size();
+            ++count;
+        }
+        all_raw += raw;
+        all_wire += wire;
+        printf("ratio %-24s avg %6zu -> %6zu B  (%5.1f%%)\n", k.c_str(), raw / count,
+               wire / count, 100.0 * wire / raw);
+    }
+    printf("ratio %-24s     %6zu -> %6zu B  (%5.1f%%)\n", "total", all_raw, all_wire,
+           100.0 * all_wire / all_raw);
+}
+
+double now_s() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void speed(const std::vector<Sample>& samples, uint32_t passes) {
+    std::vector<std::string> packed;
+    size_t raw = 0;
+    size_t max_raw = 0;
+    for (const auto& s : samples) {
+        packed.emplace_back();
+        lzd::encode(s.data, packed.back());
+        raw += s.data.size();
+        max_raw = std::max(max_raw, s.data.size());
+    }
+    std::vector<uint8_t> out(max_raw);
+    size_t check = 0;
+    for (int split = 0; split < 2; ++split) {
+        const double t0 = now_s();
+        for (uint32_t p = 0; p < passes; ++p) {
+            for (const auto& z : packed) {
+                const auto* in = reinterpret_cast<const uint8_t*>(z.data());
+                lzd::Decoder dec(out.data(), out.size());
+                if (split) {
+                    const size_t half = z.size() / 2;
+                    dec.feed(in, half);
+                    dec.feed(in + half, z.size() - half);
+                } else {
+                    dec.feed(in, z.size());
+                }
+                if (!dec.finish()) std::abort();
+                check += dec.size();
+            }
+        }
+        const double s = now_s() - t0;
+        printf("speed decode %-12s %7.1f MB/s\n", split ? "two pieces" : "one piece",
+               raw * double(passes) / s / 1e6);
+    }
+    const uint32_t enc_passes = std::max<uint32_t>(passes / 20, 1);
+    const double t0 = now_s();
+    for (uint32_t p = 0; p < enc_passes; ++p) {
+        for (const auto& s : samples) {
+            std::string z;
+            lzd::encode(s.data, z);
+            check += z.size();
+        }
+    }
+    printf("speed encode              %7.1f MB/s  (%zu)\n",
+           raw * double(enc_passes) / (now_s() - t0) / 1e6, check & 1);
+}
+
+// Decodes in random pieces into a heap buffer of exactly cap bytes.
+bool decode_split(const std::string& z, size_t cap, std::mt19937& rng, std::string* out) {
+    std::unique_ptr<uint8_t[]> buf(new uint8_t[cap ? cap : 1]);
+    lzd::Decoder dec(buf.get(), cap);
+    const auto* in = reinterpret_cast<const uint8_t*>(z.data());
+    size_t pos = 0;
+    bool ok = true;
+    while (pos < z.size() && ok) {
+        const size_t n = std::min<size_t>(z.size() - pos, 1 + rng() % 64);
+        ok = dec.feed(in + pos, n);
+        pos += n;
+    }
+    if (dec.size() > cap) std::abort();
+    if (!ok || !dec.finish()) return false;
+    if (out) out->assign(reinterpret_cast<const char*>(buf.get()), dec.size());
+    return true;
+}
+
+bool fuzz(uint32_t rounds, uint32_t seed) {
+    std::mt19937 rng(seed);
+    uint32_t rejected = 0;
+    uint32_t accepted = 0;
+    for (uint32_t r = 0; r < rounds; ++r) {
+        std::string raw;
+        switch (rng() % 4) {
+            case 0: raw = messages_json(rng, 1 + rng() % 6); break;
+            case 1: raw = friends_json(rng, 1 + rng() % 6); break;
+            case 2: raw.resize(rng() % 2000); for (auto& c : raw) c = char(rng()); break;
+            default: {
+                // Long runs exercise overlapping matches and max-length tokens.
+                raw.assign(rng() % 3000, char('a' + rng() % 3));
+                raw += word(rng, 0, 50);
+                break;
+            }
+        }
+        std::string z;
+        lzd::encode(raw, z);
+        std::string back;
+        if (!decode_split(z, raw.size(), rng, &back) || back != raw) {
+            fprintf(stderr, "roundtrip failed: raw=%zu wire=%zu round=%u\n", raw.size(),
+                    z.size(), r);
+            return false;
+        }
+        if (!raw.empty() && decode_split(z, raw.size() - 1, rng, nullptr)) {
+            fprintf(stderr, "decode into a short buffer succeeded: raw=%zu\n", raw.size());
+            return false;
+        }
+
+        // Corrupt streams: must not overrun, may or may not be rejected.
+        std::string bad = z;
+        switch (rng() % 3) {
+            case 0:
+                bad.resize(rng() % (bad.size() + 1));
+                break;
+            case 1:
+                for (int k = 0; k < 1 + int(rng() % 4) && !bad.empty(); ++k) {
+                    bad[rng() % bad.size()] ^= char(1 << (rng() % 8));
+                }
+                break;
+            default:
+                bad.resize(rng() % 300);
+                for (auto& c : bad) c = char(rng());
+                break;
+        }
+        if (decode_split(bad, rng() % 4096, rng, nullptr)) {
+            ++accepted;
+        } else {
+            ++rejected;
+        }
+    }
+    printf("fuzz corrupt streams: %u rejected, %u decoded within the buffer\n", rejected,
+           accepted);
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    uint32_t rounds = 5000;
+    uint32_t passes = 200;
+    uint32_t seed = 1;
+    std::vector<Sample> samples;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--rounds") && i + 1 < argc) {
+            rounds = strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--passes") && i + 1 < argc) {
+            passes = strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = strtoul(argv[++i], nullptr, 10);
+        } else {
+            std::ifstream f(argv[i], std::ios::binary);
+            if (!f) {
+                fprintf(stderr, "cannot read %s\n", argv[i]);
+                return 2;
+            }
+            samples.push_back({std::string("file ") + argv[i],
+                               std::string(std::istreambuf_iterator<char>(f), {})});
+        }
+    }
+    std::mt19937 rng(seed);
+    const auto generated = corpus(rng);
+    samples.insert(samples.end(), generated.begin(), generated.end());
+    ratio(samples);
+    if (passes) speed(samples, passes);
+    const bool ok = fuzz(rounds, seed);
+    printf("fuzz roundtrip: %s (%u rounds)\n", ok ? "ok" : "FAIL", rounds);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,354 @@
+// Host simulator for the ESP-NOW flood relay (espnowrt::Link).
+//
+// Places N virtual nodes at random in a square, connects every pair within
+// radio range and runs the real transport code on each of them. The radio
+// model is a shared 1 Mbps channel (ESP-NOW's default rate) with carrier
+// sense and random backoff, half-duplex nodes, collisions at receivers that
+// hear two overlapping frames (hidden terminals included) and independent
+// random loss per reception.
+//
+// Every run is repeated without relaying as a baseline and reports the
+// delivery ratio (over all N-1 receivers and over receivers connected to
+// the origin), channel airtime and end-to-end latency.
+//
+// Build and run from the repo root:
+//   g++ -O2 -std=c++17 -Icomponents/services/network/include
+//       tools/espnow_sim/flood_sim.cpp -o /tmp/flood_sim
+//   /tmp/flood_sim --nodes 30 --area 800 --range 250 --loss 0.1 --ttl 4
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "espnow_link.hpp"
+
+namespace {
+
+struct Options {
+    int nodes = 30;
+    double area_m = 800;
+    double range_m = 250;
+    double loss = 0.1;
+    int messages = 100;
+    int interval_ms = 250;
+    int min_len = 16;
+    int max_len = 400;
+    int ttl = 4;
+    int jitter_ms = 60;
+    int suppress = 4;
+    uint32_t seed = 1;
+};
+
+constexpr int64_t kSlotUs = 20;
+constexpr int64_t kDifsUs = 50;
+constexpr int kCwSlots = 16;
+constexpr size_t kMacQueue = 8;  // esp_now_send refuses beyond this
+
+// 802.11b long preamble + PLCP header, then MAC header/FCS and body at 1 Mbps.
+int64_t airtime_us(size_t len) { return 192 + int64_t(len + 43) * 8; }
+
+struct Frame {
+    std::vector<uint8_t> bytes;
+};
+
+struct Tx {
+    int src = -1;
+    int64_t end_us = 0;
+    Frame frame;
+    std::vector<int> receivers;
+    std::vector<bool> corrupt;  // per receiver
+};
+
+struct Node {
+    double x = 0, y = 0;
+    espnowrt::Mac mac{};
+    std::unique_ptr<espnowrt::Link> link;
+    std::deque<Frame> macq;
+    int64_t backoff_us = -1;  // <0: not contending
+    int tx = -1;              // index into active transmissions
+    std::vector<int> hearing; // active transmissions this node can hear
+};
+
+struct Result {
+    double delivery = 0;
+    double delivery_reachable = 0;
+    double airtime_pct = 0;
+    double airtime_ms_per_msg = 0;
+    double latency_avg_ms = 0;
+    double latency_p95_ms = 0;
+    double latency_max_ms = 0;
+    uint32_t frames = 0;
+    uint32_t collisions = 0;
+    uint32_t relayed = 0;
+    uint32_t suppressed = 0;
+};
+
+Result run(const Options& o, bool relay) {
+    std::mt19937 rng(o.seed);
+    std::uniform_real_distribution<double> pos(0, o.area_m);
+    std::uniform_real_distribution<double> unit(0, 1);
+    const int n = o.nodes;
+
+    std::vector<Node> nodes(n);
+    for (int i = 0; i < n; ++i) {
+        nodes[i].x = pos(rng);
+        nodes[i].y = pos(rng);
+        nodes[i].mac = {0x02, 0, 0, 0, uint8_t(i >> 8), uint8_t(i)};
+    }
+    std::vector<std::vector<int>> nbr(n);
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            if (i != j && std::hypot(nodes[i].x - nodes[j].x, nodes[i].y - nodes[j].y) <= o.range_m) {
+                nbr[i].push_back(j);
+            }
+        }
+    }
+    // reach[i][j]: j is connected to i at all (within ttl hops when relaying).
+    std::vector<std::vector<bool>> reach(n, std::vector<bool>(n, false));
+    for (int i = 0; i < n; ++i) {
+        std::vector<int> hops(n, -1);
+        std::deque<int> q{i};
+        hops[i] = 0;
+        while (!q.empty()) {
+            const int u = q.front();
+            q.pop_front();
+            for (int v : nbr[u]) {
+                if (hops[v] < 0) {
+                    hops[v] = hops[u] + 1;
+                    q.push_back(v);
+                }
+            }
+        }
+        for (int j = 0; j < n; ++j) {
+            reach[i][j] = hops[j] > 0 && hops[j] <= (relay ? o.ttl : 1);
+        }
+    }
+
+    int64_t now = 0;
+    for (int i = 0; i < n; ++i) {
+        espnowrt::Link::Config cfg;
+        cfg.self = nodes[i].mac;
+        cfg.seed = o.seed * 7919u + uint32_t(i) + 1;
+        cfg.first_seq = uint16_t(rng());
+        cfg.relay = relay;
+        cfg.flood_ttl = relay ? uint8_t(o.ttl) : 0;
+        cfg.relay_jitter_us = int64_t(o.jitter_ms) * 1000;
+        cfg.relay_suppress = uint8_t(o.suppress);
+        auto send = [&nodes, i](const espnowrt::Mac&, const uint8_t* f, size_t len) {
+            if (nodes[i].macq.size() >= kMacQueue) return false;
+            nodes[i].macq.push_back(Frame{std::vector<uint8_t>(f, f + len)});
+            return true;
+        };
+        nodes[i].link = std::make_unique<espnowrt::Link>(send, cfg);
+    }
+
+    std::vector<Tx> txs;  // active transmissions
+    struct Sent {
+        int origin;
+        int64_t at_us;
+        std::vector<bool> got;
+    };
+    std::vector<Sent> sent;
+    std::vector<double> latencies;
+    int64_t busy_us = 0;
+    Result r;
+
+    const espnowrt::Mac bcast = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    const int64_t interval_us = int64_t(o.interval_ms) * 1000;
+    const int64_t end_us = interval_us * o.messages + 3 * 1000 * 1000;
+    espnowrt::Link::Message msg;
+
+    for (; now < end_us; now += kSlotUs) {
+        // Traffic: one broadcast per interval from a random node.
+        if (now % interval_us == 0 && int(sent.size()) < o.messages) {
+            const int origin = int(rng() % n);
+            const size_t len = o.min_len + rng() % (o.max_len - o.min_len + 1);
+            std::vector<uint8_t> payload(len);
+            const uint32_t id = uint32_t(sent.size());
+            memcpy(payload.data(), &id, sizeof(id));
+            sent.push_back({origin, now, std::vector<bool>(n, false)});
+            nodes[origin].link->send(bcast, payload.data(), payload.size(), now);
+        }
+
+        // Finish transmissions ending in this slot.
+        for (size_t t = 0; t < txs.size();) {
+            if (txs[t].end_us > now) {
+                ++t;
+                continue;
+            }
+            Tx done = std::move(txs[t]);
+            txs.erase(txs.begin() + t);
+            nodes[done.src].tx = -1;
+            for (auto& nd : nodes) {
+                for (auto& h : nd.hearing) {
+                    if (h == int(t)) h = -1;
+                    else if (h > int(t)) --h;
+                }
+                nd.hearing.erase(std::remove(nd.hearing.begin(), nd.hearing.end(), -1),
+                                 nd.hearing.end());
+                if (nd.tx > int(t)) --nd.tx;
+            }
+            for (size_t k = 0; k < done.receivers.size(); ++k) {
+                const int v = done.receivers[k];
+                if (done.corrupt[k]) {
+                    ++r.collisions;
+                    continue;
+                }
+                if (unit(rng) < o.loss) continue;
+                nodes[v].link->on_frame(nodes[done.src].mac, done.frame.bytes.data(),
+                                        done.frame.bytes.size(), now);
+            }
+        }
+
+        // Channel access: carrier sense, backoff, start.
+        for (int i = 0; i < n; ++i) {
+            Node& nd = nodes[i];
+            if (nd.tx >= 0 || nd.macq.empty()) continue;
+            if (nd.backoff_us < 0) nd.backoff_us = kDifsUs + kSlotUs * int64_t(rng() % kCwSlots);
+            if (!nd.hearing.empty()) continue;  // medium busy: freeze
+            nd.backoff_us -= kSlotUs;
+            if (nd.backoff_us > 0) continue;
+            nd.backoff_us = -1;
+            Tx tx;
+            tx.src = i;
+            tx.frame = std::move(nd.macq.front());
+            nd.macq.pop_front();
+            const int64_t dur = airtime_us(tx.frame.bytes.size());
+            tx.end_us = now + dur;
+            busy_us += dur;
+            ++r.frames;
+            const int id = int(txs.size());
+            // Half duplex: whatever this node was receiving is lost.
+            for (int h : nd.hearing) {
+                auto& other = txs[h];
+                for (size_t k = 0; k < other.receivers.size(); ++k) {
+                    if (other.receivers[k] == i) other.corrupt[k] = true;
+                }
+            }
+            for (int v : nbr[i]) {
+                Node& rx = nodes[v];
+                bool bad = rx.tx >= 0 || !rx.hearing.empty();
+                for (int h : rx.hearing) {
+                    auto& other = txs[h];
+                    for (size_t k = 0; k < other.receivers.size(); ++k) {
+                        if (other.receivers[k] == v) other.corrupt[k] = true;
+                    }
+                }
+                tx.receivers.push_back(v);
+                tx.corrupt.push_back(bad);
+                rx.hearing.push_back(id);
+            }
+            nd.tx = id;
+            txs.push_back(std::move(tx));
+        }
+
+        for (int i = 0; i < n; ++i) {
+            Node& nd = nodes[i];
+            if (nd.link->next_deadline() <= now) nd.link->pump(now);
+            while (nd.link->pop(&msg)) {
+                uint32_t id = 0;
+                memcpy(&id, msg.data, sizeof(id));
+                if (id >= sent.size() || sent[id].got[i]) continue;
+                sent[id].got[i] = true;
+                latencies.push_back(double(now - sent[id].at_us) / 1000.0);
+            }
+        }
+    }
+
+    double got = 0, want = 0, got_reach = 0, want_reach = 0;
+    for (const auto& s : sent) {
+        for (int j = 0; j < n; ++j) {
+            if (j == s.origin) continue;
+            want += 1;
+            got += s.got[j];
+            if (reach[s.origin][j]) {
+                want_reach += 1;
+                got_reach += s.got[j];
+            }
+        }
+    }
+    for (const auto& nd : nodes) {
+        r.relayed += nd.link->stats().relayed;
+        r.suppressed += nd.link->stats().relay_suppressed;
+    }
+    r.delivery = want ? got / want : 0;
+    r.delivery_reachable = want_reach ? got_reach / want_reach : 0;
+    // Sum of transmit time over the run, not de-duplicated for spatial reuse.
+    r.airtime_pct = 100.0 * double(busy_us) / double(end_us);
+    r.airtime_ms_per_msg = sent.empty() ? 0 : double(busy_us) / 1000.0 / double(sent.size());
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        double sum = 0;
+        for (double l : latencies) sum += l;
+        r.latency_avg_ms = sum / double(latencies.size());
+        r.latency_p95_ms = latencies[size_t(0.95 * double(latencies.size() - 1))];
+        r.latency_max_ms = latencies.back();
+    }
+    return r;
+}
+
+void print(const char* label, const Result& r) {
+    printf("%-9s delivery %5.1f%% (reachable %5.1f%%)  airtime %6.1f ms/msg (%5.1f%%)  "
+           "latency avg %6.1f p95 %6.1f max %6.1f ms  frames %u collisions %u "
+           "relayed %u suppressed %u\n",
+           label, 100 * r.delivery, 100 * r.delivery_reachable, r.airtime_ms_per_msg,
+           r.airtime_pct, r.latency_avg_ms, r.latency_p95_ms, r.latency_max_ms, r.frames,
+           r.collisions, r.relayed, r.suppressed);
+}
+
+void usage() {
+    fprintf(stderr,
+            "usage: flood_sim [--nodes N] [--area M] [--range M] [--loss P] [--messages N]\n"
+            "                 [--interval MS] [--min-len B] [--max-len B] [--ttl N]\n"
+            "                 [--jitter MS] [--suppress K] [--seed S]\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        const char* v = argv[++i];
+        if (a == "--nodes") o.nodes = atoi(v);
+        else if (a == "--area") o.area_m = atof(v);
+        else if (a == "--range") o.range_m = atof(v);
+        else if (a == "--loss") o.loss = atof(v);
+        else if (a == "--messages") o.messages = atoi(v);
+        else if (a == "--interval") o.interval_ms = atoi(v);
+        else if (a == "--min-len") o.min_len = atoi(v);
+        else if (a == "--max-len") o.max_len = atoi(v);
+        else if (a == "--ttl") o.ttl = atoi(v);
+        else if (a == "--jitter") o.jitter_ms = atoi(v);
+        else if (a == "--suppress") o.suppress = atoi(v);
+        else if (a == "--seed") o.seed = uint32_t(strtoul(v, nullptr, 10));
+        else {
+            usage();
+            return 2;
+        }
+    }
+    const int max_len = int(espnowrt::kMaxFloodMessage);
+    if (o.nodes < 2 || o.min_len < 4 || o.max_len < o.min_len || o.max_len > max_len ||
+        o.ttl < 1 || o.ttl > 255 || o.interval_ms <= 0) {
+        usage();
+        return 2;
+    }
+    printf("%d nodes, %.0f m square, range %.0f m, loss %.0f%%, %d messages of %d-%d bytes "
+           "every %d ms, ttl %d, jitter %d ms, suppress %d\n",
+           o.nodes, o.area_m, o.range_m, 100 * o.loss, o.messages, o.min_len, o.max_len,
+           o.interval_ms, o.ttl, o.jitter_ms, o.suppress);
+    print("direct", run(o, false));
+    print("relay", run(o, true));
+    return 0;
+}
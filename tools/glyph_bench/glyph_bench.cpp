@@ -0,0 +1,177 @@
+// Host benchmark for the OLED glyph cache (glyphcache::GlyphCache).
+//
+// Draws a line of mixed ASCII and katakana into a 128x64 1-bpp frame, the
+// sprite layout the display uses, and reports characters per millisecond
+// for three paths:
+//
+//   direct  the shape of the old per-character loop: substr() into a
+//           std::string, a font choice that scans a glyph table for the
+//           codepoint (as the u8g2 fonts' metric lookup does), then a
+//           per-pixel draw call for every pixel of the cell.
+//   cached  next_codepoint + GlyphCache::find + blit_1bpp, all hits.
+//   miss    the same with the cache cleared before every line, so each
+//           character is rasterized and inserted once per line.
+//
+// There is no LovyanGFX on the host, so "direct" is a model of the work the
+// old loop did, not the library itself; the cached path is the real code.
+//
+// Build and run from the repo root:
+//   g++ -O2 -std=c++17 -Icomponents/display/src/runtime
+//       tools/glyph_bench/glyph_bench.cpp -o /tmp/glyph_bench
+//   /tmp/glyph_bench --lines 20000
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "glyph_cache.hpp"
+
+namespace {
+
+constexpr int kFrameW = 128;
+constexpr int kFrameH = 64;
+constexpr size_t kStride = glyphcache::row_bytes(kFrameW);
+
+struct Font {
+    int w;
+    int h;
+    std::vector<uint32_t> codepoints;  // glyph table, scanned linearly
+};
+
+// Latin base font (Font2-sized cells) and a Japanese fallback.
+Font make_font(int w, int h, uint32_t first, uint32_t last) {
+    Font f{w, h, {}};
+    for (uint32_t cp = first; cp <= last; ++cp) f.codepoints.push_back(cp);
+    return f;
+}
+
+const Font kLatin = make_font(8, 16, 0x20, 0x7E);
+const Font kKana = make_font(12, 12, 0x3000, 0x30FF);
+
+bool glyph_pixel(uint32_t cp, int x, int y) {
+    return ((cp * 2654435761u) >> ((x * 3 + y * 5) % 29)) & 1u;
+}
+
+const Font* select_font(uint32_t cp) {
+    const Font* f = (cp >= 0x3000u && cp <= 0x30FFu) ? &kKana : &kLatin;
+    for (uint32_t c : f->codepoints) {
+        if (c == cp) return f;
+    }
+    return &kLatin;
+}
+
+// Keeps the per-pixel calls from being folded into the loop, like the
+// library's virtual drawPixel path.
+__attribute__((noinline)) void draw_pixel(uint8_t* frame, int x, int y, bool on) {
+    if (x < 0 || y < 0 || x >= kFrameW || y >= kFrameH) return;
+    uint8_t& b = frame[size_t(y) * kStride + size_t(x >> 3)];
+    const uint8_t m = uint8_t(0x80u >> (x & 7));
+    b = on ? uint8_t(b | m) : uint8_t(b & ~m);
+}
+
+size_t utf8_len(uint8_t c) {
+    if ((c & 0xE0u) == 0xC0u) return 2;
+    if ((c & 0xF0u) == 0xE0u) return 3;
+    if ((c & 0xF8u) == 0xF0u) return 4;
+    return 1;
+}
+
+int draw_direct(uint8_t* frame, const std::string& text) {
+    int x = 0;
+    int chars = 0;
+    for (size_t p = 0; p < text.size();) {
+        const size_t len = utf8_len(uint8_t(text[p]));
+        if (p + len > text.size()) break;
+        const std::string ch = text.substr(p, len);
+        const char* q = ch.data();
+        const uint32_t cp = glyphcache::next_codepoint(q, q + ch.size());
+        const Font* f = select_font(cp);
+        for (int gy = 0; gy < f->h; ++gy) {
+            for (int gx = 0; gx < f->w; ++gx) {
+                draw_pixel(frame, x + gx, gy, glyph_pixel(cp, gx, gy));
+            }
+        }
+        x += f->w;
+        p += len;
+        ++chars;
+    }
+    return chars;
+}
+
+const glyphcache::Glyph* load(glyphcache::GlyphCache& cache, uint32_t cp) {
+    const Font* f = select_font(cp);
+    uint8_t bits[glyphcache::bitmap_bytes(glyphcache::kMaxSide, glyphcache::kMaxSide)] = {};
+    const size_t rb = glyphcache::row_bytes(f->w);
+    for (int y = 0; y < f->h; ++y) {
+        for (int x = 0; x < f->w; ++x) {
+            if (glyph_pixel(cp, x, y)) bits[size_t(y) * rb + size_t(x >> 3)] |= 0x80u >> (x & 7);
+        }
+    }
+    return cache.insert(&cache, cp, f->w, f->h, f->w, f->h, bits);
+}
+
+int draw_cached(uint8_t* frame, glyphcache::GlyphCache& cache, const std::string& text) {
+    int x = 0;
+    int chars = 0;
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+        const uint32_t cp = glyphcache::next_codepoint(p, end);
+        if (cp == 0) break;
+        const glyphcache::Glyph* g = cache.find(&cache, cp);
+        if (!g) g = load(cache, cp);
+        glyphcache::blit_1bpp(frame, kStride, kFrameW, kFrameH, x, 0, cache.bits(*g), g->w,
+                              g->h, true, true);
+        x += g->advance;
+        ++chars;
+    }
+    return chars;
+}
+
+template <typename Fn>
+void run(const char* name, int lines, Fn&& draw_line) {
+    long chars = 0;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < lines; ++i) chars += draw_line();
+    const double ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0)
+            .count();
+    std::printf("%-7s %8ld chars %9.2f ms %10.0f chars/ms\n", name, chars, ms, chars / ms);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int lines = 20000;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (!std::strcmp(argv[i], "--lines")) lines = std::atoi(argv[++i]);
+    }
+
+    const std::string text = "Mobus モールス TEST 123 カタカナ";
+    std::vector<uint8_t> frame(kStride * kFrameH);
+    std::vector<uint8_t> memory(32 * 1024);
+    glyphcache::GlyphCache cache;
+    if (!cache.attach(memory.data(), memory.size())) return 1;
+
+    // The two paths must draw the same pixels.
+    std::vector<uint8_t> expect(frame.size());
+    draw_direct(expect.data(), text);
+    draw_cached(frame.data(), cache, text);
+    if (expect != frame) {
+        std::printf("cached output differs from direct output\n");
+        return 1;
+    }
+
+    run("direct", lines, [&] { return draw_direct(frame.data(), text); });
+    run("cached", lines, [&] { return draw_cached(frame.data(), cache, text); });
+    run("miss", lines, [&] {
+        cache.clear();
+        return draw_cached(frame.data(), cache, text);
+    });
+    std::printf("glyphs=%u pool=%zu/%zu bytes\n", cache.stats().glyphs,
+                cache.stats().pool_used, cache.stats().pool_size);
+    return 0;
+}
@@ -0,0 +1,17 @@
+// Host stand-in for esp_log.h.
+#pragma once
+
+#include <cstdio>
+
+#ifdef HOST_STUBS_QUIET
+#define HOST_STUB_LOG(level, tag, fmt, ...) ((void)(tag))
+#else
+#define HOST_STUB_LOG(level, tag, fmt, ...) \
+    std::fprintf(stderr, level " (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#endif
+
+#define ESP_LOGE(tag, fmt, ...) HOST_STUB_LOG("E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) HOST_STUB_LOG("W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) HOST_STUB_LOG("I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) ((void)(tag))
+#define ESP_LOGV(tag, fmt, ...) ((void)(tag))
@@ -0,0 +1,20 @@
+// Host stand-in for freertos/FreeRTOS.h. One tick is one millisecond.
+#pragma once
+
+#include <cstdint>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t StackType_t;
+struct StaticTask_t {};
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) (static_cast<TickType_t>(ms))
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES 3
@@ -0,0 +1,63 @@
+// Host stand-in for freertos/semphr.h: counting semaphores on a mutex and a
+// condition variable. A mutex-type semaphore is a binary one that starts given.
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "FreeRTOS.h"
+
+struct HostSemaphore {
+    std::mutex m;
+    std::condition_variable cv;
+    UBaseType_t count = 0;
+    UBaseType_t max = 1;
+    bool heap = false;
+};
+typedef HostSemaphore* SemaphoreHandle_t;
+struct StaticSemaphore_t {
+    HostSemaphore sem;
+};
+
+inline SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) {
+    auto* s = new HostSemaphore;
+    s->max = max;
+    s->count = initial;
+    s->heap = true;
+    return s;
+}
+inline SemaphoreHandle_t xSemaphoreCreateBinary() { return xSemaphoreCreateCounting(1, 0); }
+inline SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* buf) {
+    buf->sem.max = 1;
+    buf->sem.count = 0;
+    return &buf->sem;
+}
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return xSemaphoreCreateCounting(1, 1); }
+inline void vSemaphoreDelete(SemaphoreHandle_t s) {
+    // Static semaphores live in caller storage; only heap ones are freed.
+    if (s && s->heap) delete s;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+    std::lock_guard<std::mutex> lock(s->m);
+    if (s->count >= s->max) return pdFALSE;
+    ++s->count;
+    s->cv.notify_one();
+    return pdTRUE;
+}
+inline BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t s, BaseType_t*) {
+    return xSemaphoreGive(s);
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(s->m);
+    auto ready = [s] { return s->count > 0; };
+    if (ticks == portMAX_DELAY) {
+        s->cv.wait(lock, ready);
+    } else if (!s->cv.wait_for(lock, std::chrono::milliseconds(ticks), ready)) {
+        return pdFALSE;
+    }
+    --s->count;
+    return pdTRUE;
+}
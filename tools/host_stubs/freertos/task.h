@@ -0,0 +1,93 @@
+// Host stand-in for freertos/task.h. Tasks are detached std::threads; each
+// thread carries its own handle and notification counters.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "FreeRTOS.h"
+
+struct HostTask {
+    std::mutex m;
+    std::condition_variable cv;
+    uint32_t notify[3] = {};
+};
+typedef HostTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+inline TaskHandle_t& host_current_task() {
+    thread_local TaskHandle_t self = nullptr;
+    return self;
+}
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+    auto& self = host_current_task();
+    if (!self) self = new HostTask;  // threads not created through the stubs
+    return self;
+}
+
+inline TaskHandle_t host_spawn(TaskFunction_t fn, void* arg) {
+    auto* task = new HostTask;
+    std::thread([task, fn, arg] {
+        host_current_task() = task;
+        fn(arg);
+    }).detach();
+    return task;
+}
+
+inline TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char*, uint32_t,
+                                                  void* arg, UBaseType_t, StackType_t*,
+                                                  StaticTask_t*, BaseType_t) {
+    return host_spawn(fn, arg);
+}
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char*, uint32_t, void* arg,
+                                          UBaseType_t, TaskHandle_t* out, BaseType_t) {
+    TaskHandle_t t = host_spawn(fn, arg);
+    if (out) *out = t;
+    return pdPASS;
+}
+inline BaseType_t xTaskCreate(TaskFunction_t fn, const char*, uint32_t, void* arg, UBaseType_t,
+                              TaskHandle_t* out) {
+    TaskHandle_t t = host_spawn(fn, arg);
+    if (out) *out = t;
+    return pdPASS;
+}
+inline void vTaskDelete(TaskHandle_t) {}
+inline void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) { return 0; }
+
+inline BaseType_t xTaskNotifyGiveIndexed(TaskHandle_t t, UBaseType_t index) {
+    std::lock_guard<std::mutex> lock(t->m);
+    ++t->notify[index];
+    t->cv.notify_all();
+    return pdPASS;
+}
+inline BaseType_t xTaskNotifyGive(TaskHandle_t t) { return xTaskNotifyGiveIndexed(t, 0); }
+
+inline uint32_t ulTaskNotifyTakeIndexed(UBaseType_t index, BaseType_t clear, TickType_t ticks) {
+    TaskHandle_t t = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(t->m);
+    auto ready = [t, index] { return t->notify[index] > 0; };
+    if (ticks == portMAX_DELAY) {
+        t->cv.wait(lock, ready);
+    } else {
+        t->cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+    }
+    const uint32_t value = t->notify[index];
+    if (value) t->notify[index] = clear ? 0 : value - 1;
+    return value;
+}
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+    return ulTaskNotifyTakeIndexed(0, clear, ticks);
+}
+inline BaseType_t xTaskNotifyStateClearIndexed(TaskHandle_t t, UBaseType_t index) {
+    if (!t) t = xTaskGetCurrentTaskHandle();
+    std::lock_guard<std::mutex> lock(t->m);
+    t->notify[index] = 0;
+    return pdTRUE;
+}
@@ -0,0 +1,227 @@
+// Host stand-in for esp-mqtt's mqtt_client.h with a scripted broker.
+//
+// The client never opens a socket. A test plays the broker through the
+// hostmqtt:: helpers, which call the registered event handler on the
+// calling thread the way the esp-mqtt task would: connect(), disconnect(),
+// and deliver() split a publish into MQTT_EVENT_DATA chunks of the client's
+// receive buffer size. Subscribe/unsubscribe/publish calls are recorded.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "esp_err.h"
+
+typedef const char* esp_event_base_t;
+#define ESP_EVENT_ANY_ID -1
+
+typedef enum {
+    MQTT_EVENT_ANY = -1,
+    MQTT_EVENT_ERROR = 0,
+    MQTT_EVENT_CONNECTED,
+    MQTT_EVENT_DISCONNECTED,
+    MQTT_EVENT_SUBSCRIBED,
+    MQTT_EVENT_UNSUBSCRIBED,
+    MQTT_EVENT_PUBLISHED,
+    MQTT_EVENT_DATA,
+    MQTT_EVENT_BEFORE_CONNECT,
+    MQTT_EVENT_DELETED,
+} esp_mqtt_event_id_t;
+
+typedef struct {
+    esp_err_t esp_tls_last_esp_err;
+    int esp_tls_stack_err;
+    int esp_tls_cert_verify_flags;
+    int error_type;
+    int connect_return_code;
+    int esp_transport_sock_errno;
+} esp_mqtt_error_codes_t;
+
+struct esp_mqtt_client;
+typedef struct esp_mqtt_client* esp_mqtt_client_handle_t;
+
+typedef struct {
+    esp_mqtt_event_id_t event_id;
+    esp_mqtt_client_handle_t client;
+    char* data;
+    int data_len;
+    int total_data_len;
+    int current_data_offset;
+    char* topic;
+    int topic_len;
+    int msg_id;
+    int session_present;
+    esp_mqtt_error_codes_t* error_handle;
+    bool retain;
+    int qos;
+    bool dup;
+} esp_mqtt_event_t;
+typedef esp_mqtt_event_t* esp_mqtt_event_handle_t;
+
+typedef struct {
+    struct {
+        struct {
+            const char* uri;
+        } address;
+    } broker;
+    struct {
+        const char* client_id;
+    } credentials;
+    struct {
+        bool disable_clean_session;
+        int keepalive;
+    } session;
+    struct {
+        bool disable_auto_reconnect;
+    } network;
+    struct {
+        int stack_size;
+    } task;
+    struct {
+        int size;
+    } buffer;
+} esp_mqtt_client_config_t;
+
+typedef void (*esp_event_handler_t)(void*, esp_event_base_t, int32_t, void*);
+
+struct esp_mqtt_client {
+    std::string uri;
+    std::string client_id;
+    bool clean_session = true;
+    int buffer_size = 1024;  // esp-mqtt default receive buffer
+    esp_event_handler_t handler = nullptr;
+    void* handler_arg = nullptr;
+    bool started = false;
+};
+
+namespace hostmqtt {
+
+struct Op {
+    enum Kind { kSubscribe, kUnsubscribe, kPublish } kind;
+    std::string topic;
+    std::string payload;
+};
+
+struct Broker {
+    std::mutex m;
+    esp_mqtt_client_handle_t client = nullptr;
+    std::vector<Op> ops;
+    int next_msg_id = 1;
+};
+
+inline Broker& broker() {
+    static Broker b;
+    return b;
+}
+
+inline std::vector<Op> take_ops() {
+    std::lock_guard<std::mutex> lock(broker().m);
+    std::vector<Op> out;
+    out.swap(broker().ops);
+    return out;
+}
+
+inline void dispatch(esp_mqtt_event_t& ev) {
+    esp_mqtt_client_handle_t c = broker().client;
+    if (!c || !c->handler) return;
+    ev.client = c;
+    c->handler(c->handler_arg, "MQTT_EVENTS", ev.event_id, &ev);
+}
+
+inline void connect(bool session_present) {
+    esp_mqtt_event_t ev = {};
+    ev.event_id = MQTT_EVENT_CONNECTED;
+    ev.session_present = session_present ? 1 : 0;
+    dispatch(ev);
+}
+
+inline void disconnect() {
+    esp_mqtt_event_t ev = {};
+    ev.event_id = MQTT_EVENT_DISCONNECTED;
+    dispatch(ev);
+}
+
+// Delivers one publish; chunk 0 uses the client's buffer size.
+inline void deliver(const std::string& topic, const std::string& payload, int chunk = 0) {
+    esp_mqtt_client_handle_t c = broker().client;
+    if (!c) return;
+    if (chunk <= 0) chunk = c->buffer_size;
+    std::string t = topic;
+    std::string p = payload;
+    int offset = 0;
+    do {
+        const int n = std::min<int>(chunk, int(p.size()) - offset);
+        esp_mqtt_event_t ev = {};
+        ev.event_id = MQTT_EVENT_DATA;
+        // Like esp-mqtt, only the first chunk carries the topic.
+        ev.topic = offset == 0 ? &t[0] : nullptr;
+        ev.topic_len = offset == 0 ? int(t.size()) : 0;
+        ev.data = &p[0] + offset;
+        ev.data_len = n;
+        ev.total_data_len = int(p.size());
+        ev.current_data_offset = offset;
+        ev.qos = 1;
+        dispatch(ev);
+        offset += n;
+    } while (offset < int(p.size()));
+}
+
+}  // namespace hostmqtt
+
+inline esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t* cfg) {
+    auto* c = new esp_mqtt_client;
+    if (cfg->broker.address.uri) c->uri = cfg->broker.address.uri;
+    if (cfg->credentials.client_id) c->client_id = cfg->credentials.client_id;
+    c->clean_session = !cfg->session.disable_clean_session;
+    if (cfg->buffer.size > 0) c->buffer_size = cfg->buffer.size;
+    std::lock_guard<std::mutex> lock(hostmqtt::broker().m);
+    hostmqtt::broker().client = c;
+    return c;
+}
+
+inline esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t c, esp_mqtt_event_id_t,
+                                                esp_event_handler_t handler, void* arg) {
+    c->handler = handler;
+    c->handler_arg = arg;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t c) {
+    c->started = true;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t c) {
+    c->started = false;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t c) {
+    std::lock_guard<std::mutex> lock(hostmqtt::broker().m);
+    if (hostmqtt::broker().client == c) hostmqtt::broker().client = nullptr;
+    delete c;
+    return ESP_OK;
+}
+
+inline int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t, const char* topic, int) {
+    std::lock_guard<std::mutex> lock(hostmqtt::broker().m);
+    hostmqtt::broker().ops.push_back({hostmqtt::Op::kSubscribe, topic, {}});
+    return hostmqtt::broker().next_msg_id++;
+}
+
+inline int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t, const char* topic) {
+    std::lock_guard<std::mutex> lock(hostmqtt::broker().m);
+    hostmqtt::broker().ops.push_back({hostmqtt::Op::kUnsubscribe, topic, {}});
+    return hostmqtt::broker().next_msg_id++;
+}
+
+inline int esp_mqtt_client_publish(esp_mqtt_client_handle_t, const char* topic, const char* data,
+                                   int len, int, int) {
+    std::lock_guard<std::mutex> lock(hostmqtt::broker().m);
+    hostmqtt::broker().ops.push_back(
+        {hostmqtt::Op::kPublish, topic, std::string(data, data ? size_t(len) : 0)});
+    return hostmqtt::broker().next_msg_id++;
+}
@@ -0,0 +1,75 @@
+// Host stand-in for nvs.h. Each key is a file <dir>/<namespace>.<key> so
+// values survive a process restart, which is how tests model a reboot. The
+// directory is $HOST_NVS_DIR, or /tmp/host_nvs.
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <sys/stat.h>
+
+#include "esp_err.h"
+
+#define ESP_ERR_NVS_BASE 0x1100
+#define ESP_ERR_NVS_NOT_FOUND (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_INVALID_LENGTH (ESP_ERR_NVS_BASE + 0x0c)
+
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+
+inline std::string& host_nvs_namespace(nvs_handle_t h) {
+    static std::string names[16];
+    return names[h % 16];
+}
+
+inline std::string host_nvs_path(nvs_handle_t h, const char* key) {
+    const char* dir = std::getenv("HOST_NVS_DIR");
+    std::string base = dir ? dir : "/tmp/host_nvs";
+    mkdir(base.c_str(), 0755);
+    return base + "/" + host_nvs_namespace(h) + "." + key;
+}
+
+inline esp_err_t nvs_open(const char* name, nvs_open_mode_t, nvs_handle_t* out) {
+    static nvs_handle_t next = 1;
+    *out = next++;
+    host_nvs_namespace(*out) = name;
+    return ESP_OK;
+}
+inline void nvs_close(nvs_handle_t) {}
+inline esp_err_t nvs_commit(nvs_handle_t) { return ESP_OK; }
+
+inline esp_err_t nvs_set_blob(nvs_handle_t h, const char* key, const void* value, size_t len) {
+    FILE* f = std::fopen(host_nvs_path(h, key).c_str(), "wb");
+    if (!f) return ESP_FAIL;
+    const bool ok = std::fwrite(value, 1, len, f) == len;
+    return (std::fclose(f) == 0 && ok) ? ESP_OK : ESP_FAIL;
+}
+
+inline esp_err_t nvs_get_blob(nvs_handle_t h, const char* key, void* out, size_t* len) {
+    FILE* f = std::fopen(host_nvs_path(h, key).c_str(), "rb");
+    if (!f) return ESP_ERR_NVS_NOT_FOUND;
+    std::string data;
+    char buf[256];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) data.append(buf, n);
+    std::fclose(f);
+    if (!out) {
+        *len = data.size();
+        return ESP_OK;
+    }
+    if (*len < data.size()) return ESP_ERR_NVS_INVALID_LENGTH;
+    data.copy(static_cast<char*>(out), data.size());
+    *len = data.size();
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_set_str(nvs_handle_t h, const char* key, const char* value) {
+    return nvs_set_blob(h, key, value, std::char_traits<char>::length(value) + 1);
+}
+inline esp_err_t nvs_get_str(nvs_handle_t h, const char* key, char* out, size_t* len) {
+    return nvs_get_blob(h, key, out, len);
+}
+inline esp_err_t nvs_erase_key(nvs_handle_t h, const char* key) {
+    return std::remove(host_nvs_path(h, key).c_str()) == 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
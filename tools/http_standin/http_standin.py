@@ -0,0 +1,362 @@
+#!/usr/bin/env python3
+"""Local HTTP(S) stand-in for the chat API and a connection-reuse benchmark.
+
+serve   Runs a keep-alive HTTP/1.1 server that answers the /api/* routes the
+        firmware calls with small JSON bodies. --idle-close closes sockets
+        that stay idle that long, like the production server's keep-alive
+        timeout, so pooled sockets go stale. Counts connections (one TCP/TLS
+        handshake each) and repeated POST bodies (a non-idempotent request
+        sent twice). Point the device at it with the NVS keys server_host /
+        server_port / server_scheme; ChatApiClient logs per-request latency
+        and its handshake/reuse counters.
+
+bench   Starts the server in-process and replays a request mix against it
+        with three client policies. These are Python models of the policies,
+        not ChatApiClient itself: the numbers show what each policy does to
+        handshakes and duplicate POSTs, not the firmware's latency.
+          new     a fresh connection for every request (no pooling)
+          retry   one keep-alive connection; any failure on a reused socket
+                  is resent once on a fresh one (the earlier pool policy)
+          pooled  one keep-alive connection with ChatApiClient's policy:
+                  resend once on a fresh socket if the request never left,
+                  or if it is a GET; other requests do not reuse a socket
+                  idle for 5 s or more.
+        --drop-after-post makes the server process some POSTs and then
+        close without answering (a response lost in flight), which is when
+        resending a non-idempotent request creates a duplicate. Prints
+        handshakes, p50/p99 latency, resends, failures surfaced to the
+        caller, and POSTs the server stored twice. --server-dedupes makes
+        the stand-in drop a repeated client_message_id instead (the API does
+        not document that; it shows what such a server would absorb).
+
+Usage (from the repo root):
+  python3 tools/http_standin/http_standin.py bench --tls --requests 400
+  python3 tools/http_standin/http_standin.py bench --drop-after-post 0.1
+  python3 tools/http_standin/http_standin.py serve --tls --port 8443
+"""
+
+import argparse
+import hashlib
+import http.client
+import json
+import os
+import random
+import socket
+import ssl
+import subprocess
+import tempfile
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+UNSAFE_REUSE_IDLE_S = 5.0
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.connections = 0
+        self.requests = 0
+        self.post_bodies = {}
+        self.deduplicated = 0
+        self.dedupe_keys = False
+
+    def snapshot(self):
+        with self.lock:
+            dup = sum(n - 1 for n in self.post_bodies.values() if n > 1)
+            return {"connections": self.connections, "requests": self.requests,
+                    "duplicate_posts": dup, "deduplicated": self.deduplicated}
+
+
+def make_handler(stats, delay_ms, idle_close, drop_after_post, seed=2):
+    rng = random.Random(seed)
+
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+        disable_nagle_algorithm = True
+        # Read timeout between requests: the server-side keep-alive limit.
+        timeout = idle_close if idle_close > 0 else None
+
+        def setup(self):
+            super().setup()
+            with stats.lock:
+                stats.connections += 1
+
+        def log_message(self, fmt, *args):
+            pass
+
+        def reply(self, obj, status=200):
+            body = json.dumps(obj).encode()
+            self.send_response(status)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def serve(self, method):
+            length = int(self.headers.get("Content-Length") or 0)
+            body = self.rfile.read(length) if length else b""
+            if self.path == "/__stats":
+                self.reply(stats.snapshot())
+                return
+            with stats.lock:
+                stats.requests += 1
+                if method == "POST":
+                    try:
+                        msg_id = json.loads(body or b"{}").get(
+                            "client_message_id")
+                    except ValueError:
+                        msg_id = None
+                    if msg_id and stats.dedupe_keys:
+                        # --server-dedupes: a repeat of a stored
+                        # client_message_id is dropped, not stored twice.
+                        key = "id:" + msg_id
+                        if key in stats.post_bodies:
+                            stats.deduplicated += 1
+                        stats.post_bodies[key] = 1
+                    else:
+                        key = hashlib.sha1(self.path.encode() +
+                                           body).hexdigest()
+                        stats.post_bodies[key] = (
+                            stats.post_bodies.get(key, 0) + 1)
+            if delay_ms:
+                time.sleep(delay_ms / 1000.0)
+            if method == "POST" and rng.random() < drop_after_post:
+                # Processed, but the response never makes it back.
+                self.close_connection = True
+                return
+            if self.path.startswith("/api/messages/unread/count"):
+                self.reply({"count": 0})
+            elif self.path.startswith("/api/auth/login"):
+                self.reply({"token": "t", "user_id": "u1"})
+            else:
+                self.reply({"ok": True})
+
+        def do_GET(self):
+            self.serve("GET")
+
+        def do_POST(self):
+            self.serve("POST")
+
+        def do_PUT(self):
+            self.serve("PUT")
+
+    return Handler
+
+
+def self_signed(tmp):
+    cert = os.path.join(tmp, "cert.pem")
+    key = os.path.join(tmp, "key.pem")
+    subprocess.run(["openssl", "req", "-x509", "-newkey", "ec",
+                    "-pkeyopt", "ec_paramgen_curve:prime256v1", "-nodes",
+                    "-keyout", key, "-out", cert, "-days", "1",
+                    "-subj", "/CN=localhost"],
+                   check=True, stdout=subprocess.DEVNULL,
+                   stderr=subprocess.DEVNULL)
+    return cert, key
+
+
+def start_server(args, stats):
+    server = ThreadingHTTPServer(
+        (args.host, args.port),
+        make_handler(stats, args.delay_ms, args.idle_close,
+                     args.drop_after_post))
+    server.daemon_threads = True
+    if args.tls:
+        cert, key = args.cert, args.key
+        if not cert:
+            cert, key = self_signed(tempfile.mkdtemp())
+        ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        ctx.load_cert_chain(cert, key)
+        server.socket = ctx.wrap_socket(server.socket, server_side=True)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+
+class UnsentError(Exception):
+    pass
+
+
+class ResponseError(Exception):
+    pass
+
+
+class Client:
+    def __init__(self, host, port, tls, policy):
+        self.host, self.port, self.tls = host, port, tls
+        self.policy = policy
+        self.pooled = policy != "new"
+        self.ctx = None
+        if tls:
+            self.ctx = ssl.create_default_context()
+            self.ctx.check_hostname = False
+            self.ctx.verify_mode = ssl.CERT_NONE
+        self.conn = None
+        self.last_used = 0.0
+        self.handshakes = 0
+        self.resends = 0
+        self.failures = 0
+        self.not_resent = 0
+
+    def open(self):
+        if self.tls:
+            conn = http.client.HTTPSConnection(self.host, self.port,
+                                               context=self.ctx, timeout=5)
+        else:
+            conn = http.client.HTTPConnection(self.host, self.port, timeout=5)
+        conn.connect()
+        conn.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.handshakes += 1
+        return conn
+
+    def close(self):
+        if self.conn:
+            self.conn.close()
+            self.conn = None
+
+    def attempt(self, method, path, body):
+        headers = {"Content-Type": "application/json"} if body else {}
+        if not self.pooled:
+            headers["Connection"] = "close"
+        try:
+            self.conn.request(method, path, body=body, headers=headers)
+        except (OSError, http.client.HTTPException) as e:
+            raise UnsentError(e)
+        try:
+            resp = self.conn.getresponse()
+            resp.read()
+        except (OSError, http.client.HTTPException) as e:
+            raise ResponseError(e)
+        return resp.status
+
+    def request(self, method, path, body=None):
+        idempotent = method == "GET"
+        strict = self.policy == "pooled"
+        now = time.monotonic()
+        if not self.pooled:
+            self.close()
+        elif (strict and self.conn and not idempotent and
+              now - self.last_used >= UNSAFE_REUSE_IDLE_S):
+            self.close()
+        for _ in range(2):
+            reused = self.conn is not None
+            try:
+                if not self.conn:
+                    self.conn = self.open()
+                status = self.attempt(method, path, body)
+                self.last_used = time.monotonic()
+                if not self.pooled:
+                    self.close()
+                return status
+            except (UnsentError, ResponseError, OSError) as e:
+                self.close()
+                if not reused:
+                    break
+                if strict and isinstance(e, ResponseError) and not idempotent:
+                    self.not_resent += 1
+                    break
+                self.resends += 1
+        self.failures += 1
+        return None
+
+
+def workload(n, seed, gap_ms):
+    rng = random.Random(seed)
+    for i in range(n):
+        r = rng.random()
+        if r < 0.6:
+            req = ("GET", "/api/messages/unread/count", None)
+        elif r < 0.8:
+            body = json.dumps({"receiver_id": "f1", "content": "hi %d" % i,
+                               "client_message_id": "m%d" % i})
+            req = ("POST", "/api/messages/send", body)
+        elif r < 0.9:
+            req = ("GET", "/api/messages/f1?limit=20", None)
+        else:
+            body = json.dumps({"friend_code": "C%d" % i})
+            req = ("POST", "/api/friends/request", body)
+        # Mostly bursts, sometimes a pause longer than the idle limit.
+        gap = gap_ms if rng.random() < 0.1 else rng.uniform(0, 20)
+        yield req, gap / 1000.0
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    v = sorted(values)
+    return v[min(len(v) - 1, int(p * len(v)))]
+
+
+def bench(args):
+    for policy in ("new", "retry", "pooled"):
+        stats = Stats()
+        stats.dedupe_keys = args.server_dedupes
+        server = start_server(args, stats)
+        port = server.server_address[1]
+        client = Client("127.0.0.1", port, args.tls, policy)
+        lat = []
+        for (method, path, body), gap in workload(args.requests, 1,
+                                                  args.gap_ms):
+            time.sleep(gap)
+            t0 = time.perf_counter()
+            status = client.request(method, path, body)
+            if status is not None:
+                lat.append((time.perf_counter() - t0) * 1000.0)
+        client.close()
+        srv = stats.snapshot()
+        server.shutdown()
+        server.server_close()
+        print("%-7s requests=%d handshakes=%d p50=%.2fms p99=%.2fms "
+              "resent=%d not_resent=%d failed=%d duplicate_posts=%d "
+              "deduplicated=%d" %
+              (policy, args.requests, client.handshakes,
+               percentile(lat, 0.50), percentile(lat, 0.99), client.resends,
+               client.not_resent, client.failures, srv["duplicate_posts"],
+               srv["deduplicated"]))
+
+
+def serve(args):
+    stats = Stats()
+    stats.dedupe_keys = args.server_dedupes
+    server = start_server(args, stats)
+    print("listening on %s://%s:%d (idle close %.1fs)" %
+          ("https" if args.tls else "http", args.host,
+           server.server_address[1], args.idle_close))
+    try:
+        while True:
+            time.sleep(10)
+            print(json.dumps(stats.snapshot()))
+    except KeyboardInterrupt:
+        server.shutdown()
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    p.add_argument("mode", choices=("serve", "bench"))
+    p.add_argument("--host", default="127.0.0.1")
+    p.add_argument("--port", type=int, default=0)
+    p.add_argument("--tls", action="store_true")
+    p.add_argument("--cert")
+    p.add_argument("--key")
+    p.add_argument("--delay-ms", type=float, default=2.0,
+                   help="server think time per request")
+    p.add_argument("--idle-close", type=float, default=1.0,
+                   help="close keep-alive sockets idle this long (s)")
+    p.add_argument("--drop-after-post", type=float, default=0.0,
+                   help="fraction of POSTs processed but left unanswered")
+    p.add_argument("--server-dedupes", action="store_true",
+                   help="drop POSTs repeating a stored client_message_id")
+    p.add_argument("--requests", type=int, default=400)
+    p.add_argument("--gap-ms", type=float, default=1500.0,
+                   help="occasional pause between requests")
+    args = p.parse_args()
+    if args.mode == "serve":
+        if not args.port:
+            args.port = 8443 if args.tls else 8080
+        serve(args)
+    else:
+        bench(args)
+
+
+if __name__ == "__main__":
+    main()
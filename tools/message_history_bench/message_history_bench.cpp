@@ -0,0 +1,454 @@
+// Host check and micro-benchmark for chatapi::parse_message_history
+// (message_history.hpp).
+//
+// check  Hand-written payloads in every shape the parser accepts (server
+//        {"messages":[...]}, BLE relay {"payload":{"messages":[...]}},
+//        legacy {message,from} records, missing is_read, unknown fields,
+//        malformed JSON), then generated histories whose parsed records are
+//        compared field by field with what the generator wrote. Also checks
+//        merge_message_history() dedup, ordering and trimming.
+// bench  Time and heap allocations per parse for parse_message_history and
+//        for the parse / rebuild / serialize / reparse round trip it
+//        replaced in http_get_message_task, on generated server histories
+//        of 1, 5, 20 and 50 messages and on recorded payload files given
+//        on the command line.
+//
+// Allocations are counted by interposing malloc (glibc), which catches both
+// operator new and ArduinoJson's default allocator.
+//
+// Build and run from the repo root (ArduinoJson 7 from the PlatformIO
+// libdeps, or any checkout's src/ directory):
+//   g++ -O2 -std=c++17 -DHOST_STUBS_QUIET -Itools/host_stubs
+//       -I.pio/libdeps/esp32dev/ArduinoJson/src
+//       -Icomponents/services/network/include
+//       tools/message_history_bench/message_history_bench.cpp
+//       -o /tmp/message_history_bench
+//   /tmp/message_history_bench --iters 20000 [recorded payload files...]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "message_history.hpp"
+
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+extern "C" void __libc_free(void*);
+
+static std::atomic<uint64_t> g_allocs{0};
+
+extern "C" void* malloc(size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(n);
+}
+extern "C" void* calloc(size_t n, size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+extern "C" void* realloc(void* p, size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(p, n);
+}
+extern "C" void free(void* p) { __libc_free(p); }
+
+namespace {
+
+using chatapi::MessageHistory;
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                    \
+    do {                                                               \
+        if (!(cond)) {                                                 \
+            std::printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            ++g_failures;                                              \
+        }                                                              \
+    } while (0)
+
+const char* kMyId = "5f0c7a1e-2b3d-4e6f-8a9b-0c1d2e3f4a5b";
+
+// Same rule as http_get_message_task: a record is ours when sender_id is
+// our user id.
+bool by_sender(const char* sender, const char*, const char*) {
+    return sender && std::strcmp(sender, kMyId) == 0;
+}
+
+// Same rule as the BLE relay path for legacy records: "from" names the
+// local user.
+bool by_from(const char* sender, const char*, const char* from) {
+    if (sender) return std::strcmp(sender, kMyId) == 0;
+    return from && std::strcmp(from, "me") == 0;
+}
+
+// ---------------------------------------------------------------------------
+// Generator
+
+struct SourceMessage {
+    std::string id;
+    std::string sender;
+    std::string receiver;
+    std::string content;
+    std::string created_at;
+    bool outgoing = false;
+    int is_read = -1;  // -1: field absent
+};
+
+std::string uuid(std::mt19937& rng) {
+    static const char* hex = "0123456789abcdef";
+    std::string s;
+    for (int i = 0; i < 36; ++i) {
+        if (i == 8 || i == 13 || i == 18 || i == 23) {
+            s += '-';
+        } else {
+            s += hex[rng() & 15];
+        }
+    }
+    return s;
+}
+
+// Chat text: mostly ASCII words, sometimes Japanese, an escaped quote or a
+// newline, which the parser must hand back unescaped.
+std::string chat_text(std::mt19937& rng) {
+    static const char* words[] = {"ok",    "see",  "you",    "at",
+                                  "the",   "bus",  "stop",   "later",
+                                  "了解",  "今",   "向かう", "ね"};
+    std::string s;
+    const int n = 1 + static_cast<int>(rng() % 12);
+    for (int i = 0; i < n; ++i) {
+        if (i) s += ' ';
+        s += words[rng() % (sizeof(words) / sizeof(words[0]))];
+    }
+    switch (rng() % 8) {
+        case 0:
+            s += " \"quoted\"";
+            break;
+        case 1:
+            s += "\nline two";
+            break;
+        default:
+            break;
+    }
+    return s;
+}
+
+std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+std::vector<SourceMessage> make_history(std::mt19937& rng, size_t count) {
+    const std::string peer = uuid(rng);
+    std::vector<SourceMessage> msgs(count);
+    for (size_t i = 0; i < count; ++i) {
+        SourceMessage& m = msgs[i];
+        m.id = uuid(rng);
+        m.outgoing = rng() & 1;
+        m.sender = m.outgoing ? kMyId : peer;
+        m.receiver = m.outgoing ? peer : kMyId;
+        m.content = chat_text(rng);
+        char ts[40];
+        std::snprintf(ts, sizeof(ts), "2026-10-16T%02u:%02u:%02u.%03uZ",
+                      static_cast<unsigned>(8 + i / 60 % 12),
+                      static_cast<unsigned>(i % 60),
+                      static_cast<unsigned>(rng() % 60),
+                      static_cast<unsigned>(rng() % 1000));
+        m.created_at = ts;
+        m.is_read = static_cast<int>(rng() % 3) - 1;
+    }
+    return msgs;
+}
+
+// Server shape as returned by GET /api/messages/<friend>.
+std::string server_json(const std::vector<SourceMessage>& msgs) {
+    std::string s = "{\"messages\":[";
+    for (size_t i = 0; i < msgs.size(); ++i) {
+        const SourceMessage& m = msgs[i];
+        if (i) s += ',';
+        s += "{\"id\":\"" + m.id + "\",\"sender_id\":\"" + m.sender +
+             "\",\"receiver_id\":\"" + m.receiver + "\",\"content\":\"" +
+             json_escape(m.content) + "\"";
+        if (m.is_read >= 0) {
+            s += ",\"is_read\":";
+            s += m.is_read ? "true" : "false";
+        }
+        s += ",\"created_at\":\"" + m.created_at + "\"}";
+    }
+    s += "]}";
+    return s;
+}
+
+// ---------------------------------------------------------------------------
+// Replaced path: parse, rebuild the legacy {message,from} shape in a second
+// document, serialize, and parse again into the shared result document.
+// Written against the ArduinoJson 7 API the tree now uses; in 7.x the old
+// StaticJsonDocument<3072> is a deprecated alias of the heap-backed
+// JsonDocument, so this is what the firmware actually ran.
+
+bool legacy_round_trip(const std::string& body, const char* username,
+                       const char* chat_from, JsonDocument& res) {
+    JsonDocument in;
+    if (deserializeJson(in, body) != DeserializationError::Ok) return false;
+    JsonDocument out;
+    JsonArray arr = out["messages"].to<JsonArray>();
+    for (JsonObject m : in["messages"].as<JsonArray>()) {
+        JsonObject o = arr.add<JsonObject>();
+        o["message"] = m["content"].as<const char*>();
+        const char* mid = m["id"].as<const char*>();
+        if (!mid) mid = m["message_id"].as<const char*>();
+        if (mid && mid[0] != '\0') o["id"] = mid;
+        const char* created = m["created_at"].as<const char*>();
+        if (created && created[0] != '\0') o["created_at"] = created;
+        const char* sender = m["sender_id"].as<const char*>();
+        o["from"] = (sender && std::strcmp(sender, kMyId) == 0) ? username
+                                                                 : chat_from;
+        if (!m["is_read"].isNull()) o["is_read"] = m["is_read"].as<bool>();
+    }
+    std::string buf;
+    serializeJson(out, buf);
+    return deserializeJson(res, buf) == DeserializationError::Ok;
+}
+
+// ---------------------------------------------------------------------------
+// check
+
+void check_parsed(const MessageHistory& h,
+                  const std::vector<SourceMessage>& src) {
+    CHECK(h.size() == src.size());
+    for (size_t i = 0; i < h.size() && i < src.size(); ++i) {
+        const auto& r = h[i];
+        CHECK(h.id(r) == src[i].id);
+        CHECK(h.content(r) == src[i].content);
+        CHECK(h.created_at(r) == src[i].created_at);
+        CHECK(r.outgoing == src[i].outgoing);
+        CHECK(r.has_read_flag == (src[i].is_read >= 0));
+        CHECK(r.is_read == (src[i].is_read == 1));
+    }
+}
+
+void run_check(std::mt19937& rng) {
+    std::printf("check\n");
+    const int before = g_failures;
+    MessageHistory h;
+
+    {
+        const std::string body =
+            std::string("{\"messages\":[") +
+            "{\"id\":\"m1\",\"sender_id\":\"" + kMyId +
+            "\",\"receiver_id\":\"peer\",\"content\":\"hi\",\"is_read\":true,"
+            "\"created_at\":\"2026-10-16T10:00:00Z\",\"attachments\":[1,2]},"
+            "{\"id\":\"m2\",\"sender_id\":\"peer\",\"receiver_id\":\"" +
+            kMyId +
+            "\",\"content\":\"yo \\\"there\\\"\","
+            "\"created_at\":\"2026-10-16T10:00:05Z\"}]}";
+        CHECK(chatapi::parse_message_history(body, by_sender, h));
+        CHECK(h.size() == 2);
+        if (h.size() == 2) {
+            CHECK(h.id(h[0]) == "m1");
+            CHECK(h.content(h[0]) == "hi");
+            CHECK(h[0].outgoing);
+            CHECK(h[0].has_read_flag && h[0].is_read);
+            CHECK(h.content(h[1]) == "yo \"there\"");
+            CHECK(!h[1].outgoing);
+            CHECK(!h[1].has_read_flag && !h[1].is_read);
+        }
+        // The arena is reserved at the body length; growing it mid-parse
+        // would at least double the capacity past that.
+        CHECK(h.arena_bytes() <= body.size());
+    }
+    {
+        const std::string body =
+            "{\"type\":\"messages\",\"payload\":{\"messages\":["
+            "{\"message_id\":\"b1\",\"message\":\"legacy\",\"from\":\"me\"},"
+            "{\"message_id\":\"b2\",\"message\":\"other\",\"from\":\"alice\","
+            "\"is_read\":false}]}}";
+        CHECK(chatapi::parse_message_history(body, by_from, h));
+        CHECK(h.size() == 2);
+        if (h.size() == 2) {
+            CHECK(h.id(h[0]) == "b1");
+            CHECK(h.content(h[0]) == "legacy");
+            CHECK(h[0].outgoing);
+            CHECK(h.created_at(h[0]).empty());
+            CHECK(!h[1].outgoing);
+            CHECK(h[1].has_read_flag && !h[1].is_read);
+        }
+    }
+    {
+        CHECK(chatapi::parse_message_history(std::string("{}"), by_sender, h));
+        CHECK(h.empty());
+        CHECK(!chatapi::parse_message_history(
+            std::string("{\"messages\":[{\"id\":"), by_sender, h));
+    }
+
+    for (size_t n : {0u, 1u, 7u, 20u, 64u}) {
+        const auto src = make_history(rng, n);
+        const std::string body = server_json(src);
+        MessageHistory fresh;
+        CHECK(chatapi::parse_message_history(body, by_sender, fresh));
+        check_parsed(fresh, src);
+        if (n) CHECK(fresh.arena_bytes() <= body.size());
+    }
+
+    {
+        // Delta re-sends the last three base records with is_read flipped
+        // and adds two newer ones; keep 20 of the 22 unique records.
+        auto base_src = make_history(rng, 20);
+        for (auto& m : base_src) m.is_read = 0;
+        std::vector<SourceMessage> delta_src(base_src.end() - 3,
+                                             base_src.end());
+        for (auto& m : delta_src) m.is_read = 1;
+        auto newer = make_history(rng, 2);
+        newer[0].created_at = "2026-10-17T00:00:00Z";
+        newer[1].created_at = "2026-10-17T00:00:01Z";
+        for (auto& m : newer) m.is_read = 1;
+        delta_src.insert(delta_src.end(), newer.begin(), newer.end());
+
+        MessageHistory base, delta;
+        CHECK(chatapi::parse_message_history(server_json(base_src), by_sender,
+                                             base));
+        CHECK(chatapi::parse_message_history(server_json(delta_src),
+                                             by_sender, delta));
+        base.sort_chronological();
+        const MessageHistory merged =
+            chatapi::merge_message_history(base, delta, 20);
+        CHECK(merged.size() == 20);
+        size_t read = 0;
+        for (size_t i = 0; i < merged.size(); ++i) {
+            if (merged[i].is_read) ++read;
+            if (i) {
+                CHECK(merged.created_at(merged[i - 1]) <=
+                      merged.created_at(merged[i]));
+            }
+            for (size_t j = 0; j < i; ++j) {
+                CHECK(merged.id(merged[j]) != merged.id(merged[i]));
+            }
+        }
+        CHECK(read == 5);
+    }
+
+    std::printf("  %s\n", g_failures == before ? "ok" : "FAILED");
+}
+
+// ---------------------------------------------------------------------------
+// bench
+
+struct Result {
+    double us = 0;
+    double allocs = 0;
+};
+
+template <typename F>
+Result measure(int iters, F&& fn) {
+    fn();  // warm up
+    const uint64_t a0 = g_allocs.load();
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iters; ++i) fn();
+    const auto t1 = std::chrono::steady_clock::now();
+    const uint64_t a1 = g_allocs.load();
+    Result r;
+    r.us = std::chrono::duration<double, std::micro>(t1 - t0).count() / iters;
+    r.allocs = static_cast<double>(a1 - a0) / iters;
+    return r;
+}
+
+volatile size_t g_sink = 0;
+
+void bench_one(const char* label, const std::string& body, int iters) {
+    MessageHistory h;
+    bool ok = chatapi::parse_message_history(body, by_sender, h);
+    if (!ok) {
+        std::printf("  %-24s %6zu B  parse error, skipped\n", label,
+                    body.size());
+        return;
+    }
+    const size_t records = h.size();
+
+    const Result typed = measure(iters, [&] {
+        chatapi::parse_message_history(body, by_sender, h);
+        size_t n = 0;
+        for (const auto& r : h.records()) n += h.content(r).size();
+        g_sink = g_sink + n;
+    });
+
+    JsonDocument res;
+    const Result legacy = measure(iters, [&] {
+        legacy_round_trip(body, "me", "alice", res);
+        size_t n = 0;
+        for (JsonObjectConst m : res["messages"].as<JsonArrayConst>()) {
+            const char* s = m["message"].as<const char*>();
+            if (s) n += std::strlen(s);
+        }
+        g_sink = g_sink + n;
+    });
+
+    std::printf(
+        "  %-24s %6zu B %3zu msg  typed %8.2f us %5.1f alloc   "
+        "round trip %8.2f us %5.1f alloc  (x%.1f)\n",
+        label, body.size(), records, typed.us, typed.allocs, legacy.us,
+        legacy.allocs, typed.us > 0 ? legacy.us / typed.us : 0.0);
+}
+
+void run_bench(std::mt19937& rng, int iters,
+               const std::vector<std::string>& files) {
+    std::printf("bench (%d iterations each)\n", iters);
+    for (size_t n : {1u, 5u, 20u, 50u}) {
+        char label[32];
+        std::snprintf(label, sizeof(label), "generated %zu", n);
+        bench_one(label, server_json(make_history(rng, n)), iters);
+    }
+    for (const auto& path : files) {
+        std::ifstream f(path, std::ios::binary);
+        if (!f) {
+            std::printf("  %s: cannot open\n", path.c_str());
+            continue;
+        }
+        std::stringstream ss;
+        ss << f.rdbuf();
+        const char* base = std::strrchr(path.c_str(), '/');
+        bench_one(base ? base + 1 : path.c_str(), ss.str(), iters);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int iters = 20000;
+    unsigned seed = 1;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--iters") && i + 1 < argc) {
+            iters = std::atoi(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    std::mt19937 rng(seed);
+
+    run_check(rng);
+    if (iters > 0) run_bench(rng, iters, files);
+
+    if (g_failures) {
+        std::printf("%d failure(s)\n", g_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Host test for the MQTT runtime's inbound path (mqtt_runtime.cpp) against a
+// scripted broker stand-in (tools/host_stubs/mqtt_client.h).
+//
+// The broker delivers publishes of 1 KB to 16 KB in MQTT_EVENT_DATA chunks
+// of the esp-mqtt receive buffer (1 KB), to the personal topic and to an
+// open-chat room listener, and the test pops them with buffers from
+// mqtt_rt_alloc_pop_buffer() the way the notification task and the open
+// chat screen do. Every message must come out intact: no drops, no
+// truncation. Then:
+//
+//   burst      a backlog of random 1-16 KB publishes arrives before the
+//              consumer runs (a resumed session replaying while the device
+//              slept); popped ones must still be whole and the evicted
+//              ones must be reported once by mqtt_rt_take_overwritten().
+//   oversized  a publish one byte over MQTT_RT_MAX_PAYLOAD is skipped.
+//
+// Build and run from the repo root:
+//   g++ -O2 -std=c++17 -pthread -DHOST_STUBS_QUIET -Itools/host_stubs
+//       -Icomponents/services/network/include
+//       tools/mqtt_broker_sim/mqtt_broker_sim.cpp
+//       components/services/network/mqtt_runtime.cpp -o /tmp/mqtt_broker_sim
+//   /tmp/mqtt_broker_sim
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "esp_heap_caps.h"
+#include "mqtt_client.h"
+#include "mqtt_runtime.h"
+
+namespace {
+
+const char* kUser = "u1234";
+const std::string kPersonal = std::string("chat/messages/") + kUser;
+const std::string kRoom = "chat/open/lobby";
+
+// JSON-shaped payload of exactly `len` bytes with a recognizable body.
+std::string payload(size_t len, uint32_t seed) {
+    std::string head = "{\"id\":\"" + std::to_string(seed) + "\",\"message\":\"";
+    std::string s = head;
+    std::mt19937 rng(seed);
+    while (s.size() + 2 < len) s.push_back(char('a' + rng() % 26));
+    s += "\"}";
+    s.resize(len, ' ');
+    return s;
+}
+
+int failures = 0;
+
+void expect(bool ok, const char* what, size_t len) {
+    if (!ok) {
+        std::printf("FAIL %s (len=%zu)\n", what, len);
+        ++failures;
+    }
+}
+
+void print_ring(const char* name, int listener_id) {
+    mqtt_rt_ring_stats_t st = {};
+    mqtt_rt_get_ring_stats(listener_id, &st);
+    std::printf("%-8s received=%u delivered=%u dropped=%u overwritten=%u truncated=%u peak=%uB\n",
+                name, st.received, st.delivered, st.dropped, st.overwritten, st.truncated,
+                st.peak_bytes);
+}
+
+}  // namespace
+
+int main() {
+    if (mqtt_rt_configure("broker.local", 1883, kUser) != 0 || mqtt_rt_start() != 0) {
+        std::printf("runtime start failed\n");
+        return 1;
+    }
+    hostmqtt::connect(false);
+    const int room = mqtt_rt_add_listener("chat/open/+");
+    char* inbox_buf = mqtt_rt_alloc_pop_buffer();
+    char* room_buf = mqtt_rt_alloc_pop_buffer();
+    if (room <= 0 || !inbox_buf || !room_buf) return 1;
+
+    // One at a time, every size from 1 KB to the cap.
+    size_t bytes = 0;
+    int messages = 0;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (size_t len = 1024; len <= MQTT_RT_MAX_PAYLOAD; len += 512) {
+        const std::string p = payload(len, uint32_t(len));
+        hostmqtt::deliver(kPersonal, p);
+        hostmqtt::deliver(kRoom, p);
+        expect(mqtt_rt_pop_message(inbox_buf, MQTT_RT_POP_BUFFER_BYTES) &&
+                   std::strlen(inbox_buf) == len && p == inbox_buf,
+               "personal message altered", len);
+        expect(mqtt_rt_listener_pop(room, room_buf, MQTT_RT_POP_BUFFER_BYTES) &&
+                   std::strlen(room_buf) == len && p == room_buf,
+               "room message altered", len);
+        bytes += 2 * len;
+        messages += 2;
+    }
+    const double ms = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - t0)
+                          .count();
+    std::printf("sizes    %d messages, %zu bytes, %.2f ms (%.1f MB/s)\n", messages, bytes, ms,
+                bytes / ms / 1000.0);
+    print_ring("inbox", 0);
+    print_ring("room", room);
+
+    // Backlog burst before the consumer runs.
+    std::mt19937 rng(7);
+    std::vector<std::string> sent;
+    for (int i = 0; i < 40; ++i) {
+        sent.push_back(payload(1024 + rng() % (MQTT_RT_MAX_PAYLOAD - 1023), 1000 + i));
+        hostmqtt::deliver(kPersonal, sent.back());
+    }
+    int popped = 0;
+    size_t next = 0;
+    while (mqtt_rt_pop_message(inbox_buf, MQTT_RT_POP_BUFFER_BYTES)) {
+        // Survivors are the newest ones, in order.
+        while (next < sent.size() && sent[next] != inbox_buf) ++next;
+        expect(next < sent.size(), "burst message altered or reordered", std::strlen(inbox_buf));
+        ++popped;
+    }
+    expect(popped > 0 && next == sent.size() - 1, "newest burst message missing", 0);
+    // Every eviction is reported to the consumer once, then the count resets.
+    const uint32_t lost = mqtt_rt_take_overwritten(0);
+    expect(lost == sent.size() - popped, "overwritten count not reported", lost);
+    expect(mqtt_rt_take_overwritten(0) == 0, "overwritten count not reset", 0);
+    std::printf("burst    %zu sent, %d popped intact, %u reported overwritten\n",
+                sent.size(), popped, static_cast<unsigned>(lost));
+
+    // One byte over the cap is skipped before it reaches a ring.
+    hostmqtt::deliver(kPersonal, payload(MQTT_RT_MAX_PAYLOAD + 1, 9));
+    mqtt_rt_rx_stats_t rx = {};
+    mqtt_rt_get_rx_stats(&rx);
+    expect(rx.oversized == 1 && !mqtt_rt_pop_message(inbox_buf, MQTT_RT_POP_BUFFER_BYTES),
+           "oversized publish delivered", MQTT_RT_MAX_PAYLOAD + 1);
+    std::printf("rx       fragmented=%u oversized=%u incomplete=%u\n", rx.fragmented,
+                rx.oversized, rx.incomplete);
+    print_ring("inbox", 0);
+
+    mqtt_rt_remove_listener(room);
+    heap_caps_free(inbox_buf);
+    heap_caps_free(room_buf);
+    std::printf(failures ? "FAILED (%d)\n" : "ok\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+// Host test for the MQTT runtime's persistent-session subscriptions
+// (mqtt_runtime.cpp) across reboots, against the scripted broker in
+// tools/host_stubs/mqtt_client.h. Each boot is a fresh process (the binary
+// re-runs itself); the host NVS stub keeps its values in files in between.
+//
+//   boot 1  new session: personal topic + room a subscribed; room b is
+//           entered and left while online; power is lost with room a open.
+//   boot 2  the broker resumed the session (session_present=1) and still
+//           holds room a. Room c was opened before the link came up. The
+//           runtime must unsubscribe a and subscribe c, nothing else.
+//   boot 3  the broker dropped the session (session_present=0): only the
+//           personal topic is subscribed again.
+//
+// The broker is scripted, not mosquitto: the test decides session_present
+// itself and only records SUBSCRIBE/UNSUBSCRIBE. It does not cover how a
+// real broker stores the session, when it expires it, or the QoS 1 messages
+// it queues for an offline client; see the README for a manual run against
+// mosquitto.
+//
+// Build and run from the repo root:
+//   g++ -O2 -std=c++17 -pthread -DHOST_STUBS_QUIET -Itools/host_stubs
+//       -Icomponents/services/network/include
+//       tools/mqtt_broker_sim/session_sim.cpp
+//       components/services/network/mqtt_runtime.cpp -o /tmp/session_sim
+//   /tmp/session_sim
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "mqtt_client.h"
+#include "mqtt_runtime.h"
+
+namespace {
+
+const std::string kPersonal = "chat/messages/u1";
+
+std::string describe(const std::vector<hostmqtt::Op>& ops) {
+    std::string out;
+    for (const auto& op : ops) {
+        if (op.kind == hostmqtt::Op::kPublish) continue;
+        if (!out.empty()) out += " ";
+        out += (op.kind == hostmqtt::Op::kSubscribe ? "+" : "-") + op.topic;
+    }
+    return out;
+}
+
+bool expect_ops(const char* step, const std::string& want) {
+    const std::string got = describe(hostmqtt::take_ops());
+    std::printf("%-28s %s\n", step, got.empty() ? "(none)" : got.c_str());
+    if (got != want) {
+        std::printf("FAIL %s: want \"%s\"\n", step, want.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool boot(int n) {
+    if (mqtt_rt_configure("broker.local", 1883, "u1") != 0 || mqtt_rt_start() != 0) return false;
+    bool ok = true;
+    if (n == 1) {
+        hostmqtt::connect(false);
+        ok &= expect_ops("boot1 connect (new)", "+" + kPersonal);
+        mqtt_rt_add_listener("chat/open/a");
+        ok &= expect_ops("boot1 enter room a", "+chat/open/a");
+        const int b = mqtt_rt_add_listener("chat/open/b");
+        mqtt_rt_remove_listener(b);
+        ok &= expect_ops("boot1 enter/leave room b", "+chat/open/b -chat/open/b");
+        // Power lost with room a still open.
+    } else if (n == 2) {
+        mqtt_rt_add_listener("chat/open/c");
+        ok &= expect_ops("boot2 enter room c offline", "");
+        hostmqtt::connect(true);
+        ok &= expect_ops("boot2 connect (resumed)", "-chat/open/a +chat/open/c");
+    } else {
+        hostmqtt::connect(false);
+        ok &= expect_ops("boot3 connect (new)", "+" + kPersonal);
+        hostmqtt::disconnect();
+        hostmqtt::connect(true);
+        ok &= expect_ops("boot3 reconnect (resumed)", "");
+    }
+    return ok;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc == 3 && !std::strcmp(argv[1], "--boot")) return boot(std::atoi(argv[2])) ? 0 : 1;
+
+    char dir[] = "/tmp/session_sim_nvs_XXXXXX";
+    if (!mkdtemp(dir)) return 1;
+    setenv("HOST_NVS_DIR", dir, 1);
+    int failures = 0;
+    for (int n = 1; n <= 3; ++n) {
+        const std::string cmd = std::string(argv[0]) + " --boot " + std::to_string(n);
+        if (std::system(cmd.c_str()) != 0) ++failures;
+    }
+    std::printf(failures ? "FAILED\n" : "ok\n");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,323 @@
+// Host stress test and benchmark for mqttrt::ByteRing (mqtt_ring.hpp).
+//
+// stress    One producer thread and one consumer thread share a small ring,
+//           as the MQTT task and a UI task do. Each record carries its
+//           sequence number and a pattern derived from it; some are pushed in
+//           one go, others through begin()/write()/commit() in random chunks,
+//           and some pops use a short buffer. The consumer checks every
+//           record it gets (pattern, truncation, increasing sequence).
+//             drop       kDropNewest: the records popped must be exactly the
+//                        records push() accepted, in order.
+//             overwrite  kOverwriteOldest: no torn record may come out, and
+//                        popped + overwritten must equal pushed.
+// bench     Messages per second and allocations per message for the ring
+//           and for the mutex + std::deque<std::string> queue it replaced,
+//           on one thread and across a producer/consumer pair.
+//
+// Build and run from the repo root:
+//   g++ -O2 -std=c++17 -pthread -Itools/host_stubs
+//       -Icomponents/services/network/include
+//       tools/mqtt_ring_test/mqtt_ring_test.cpp -o /tmp/mqtt_ring_test
+//   /tmp/mqtt_ring_test --records 2000000
+//
+// --mode drop|overwrite|all picks the stress runs, --bench 0 skips the
+// benchmark. Under -fsanitize=thread use --mode drop: in overwrite mode the
+// consumer may copy bytes the producer is overwriting, by design (the copy
+// is discarded when the CAS on tail fails), and TSan reports that race.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mqtt_ring.hpp"
+
+// Counts heap allocations so the bench can show what each queue costs per
+// message.
+static std::atomic<uint64_t> g_allocs{0};
+
+// The replacements go through out-of-line helpers so GCC does not pair an
+// inlined malloc with a delete and warn (-Wmismatched-new-delete).
+__attribute__((noinline)) static void* counted_alloc(size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) static void counted_free(void* p) { std::free(p); }
+
+void* operator new(size_t n) { return counted_alloc(n); }
+void* operator new[](size_t n) { return counted_alloc(n); }
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete(void* p, size_t) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t) noexcept { counted_free(p); }
+
+namespace {
+
+using mqttrt::ByteRing;
+
+constexpr size_t kSeqBytes = sizeof(uint32_t);
+constexpr size_t kMaxRecord = 1500;
+
+uint8_t pattern(uint32_t seq, size_t i) {
+    return static_cast<uint8_t>(seq * 31u + i * 7u + (i >> 8));
+}
+
+void fill(uint32_t seq, uint8_t* buf, size_t len) {
+    memcpy(buf, &seq, kSeqBytes);
+    for (size_t i = kSeqBytes; i < len; ++i) buf[i] = pattern(seq, i);
+}
+
+// Checks the n bytes the consumer got; returns the sequence number or -1.
+int64_t check(const char* buf, size_t n) {
+    if (n < kSeqBytes) return -1;
+    uint32_t seq;
+    memcpy(&seq, buf, kSeqBytes);
+    for (size_t i = kSeqBytes; i < n; ++i) {
+        if (static_cast<uint8_t>(buf[i]) != pattern(seq, i)) return -1;
+    }
+    return seq;
+}
+
+struct StressResult {
+    bool ok = true;
+    uint32_t pushed = 0;
+    uint32_t accepted = 0;
+    uint32_t popped = 0;
+    uint32_t short_pops = 0;
+    ByteRing::Stats stats;
+};
+
+StressResult stress(ByteRing::Overflow policy, uint32_t records, size_t capacity,
+                    uint32_t seed) {
+    StressResult r;
+    ByteRing ring;
+    if (!ring.init(capacity, policy)) {
+        r.ok = false;
+        return r;
+    }
+    std::vector<uint32_t> accepted;
+    std::vector<uint32_t> popped;
+    accepted.reserve(records);
+    popped.reserve(records);
+    std::atomic<bool> done{false};
+    std::atomic<bool> failed{false};
+
+    std::thread producer([&] {
+        std::mt19937 rng(seed);
+        std::vector<uint8_t> buf(kMaxRecord);
+        for (uint32_t seq = 0; seq < records; ++seq) {
+            const size_t len = kSeqBytes + rng() % (kMaxRecord - kSeqBytes + 1);
+            fill(seq, buf.data(), len);
+            bool ok;
+            if (rng() % 2) {
+                ok = ring.push(buf.data(), len);
+            } else {
+                // Chunked, like a fragmented MQTT_EVENT_DATA.
+                ok = ring.begin(len);
+                if (ok) {
+                    size_t off = 0;
+                    while (off < len) {
+                        const size_t n = std::min<size_t>(len - off, 1 + rng() % 400);
+                        ring.write(off, buf.data() + off, n);
+                        off += n;
+                    }
+                    ok = ring.commit();
+                }
+            }
+            if (ok) accepted.push_back(seq);
+            if ((seq & 0x7) == 0) std::this_thread::yield();
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    std::thread consumer([&] {
+        std::mt19937 rng(seed ^ 0x5bd1e995u);
+        std::vector<char> out(kMaxRecord + 1);
+        int64_t last = -1;
+        while (true) {
+            const bool finished = done.load(std::memory_order_acquire);
+            const size_t cap = (rng() % 16 == 0) ? 16 : out.size();
+            const int len = ring.pop(out.data(), cap);
+            if (len < 0) {
+                if (finished) break;
+                std::this_thread::yield();
+                continue;
+            }
+            const size_t n = std::min<size_t>(static_cast<size_t>(len), cap - 1);
+            const int64_t seq = check(out.data(), n);
+            if (out[n] != '\0' || seq < 0 || seq <= last ||
+                static_cast<size_t>(len) > kMaxRecord) {
+                fprintf(stderr, "bad record: len=%d cap=%zu seq=%lld last=%lld\n", len,
+                        cap, static_cast<long long>(seq), static_cast<long long>(last));
+                failed.store(true);
+                break;
+            }
+            if (n < static_cast<size_t>(len)) ++r.short_pops;
+            last = seq;
+            popped.push_back(static_cast<uint32_t>(seq));
+        }
+    });
+
+    producer.join();
+    consumer.join();
+    r.pushed = records;
+    r.accepted = static_cast<uint32_t>(accepted.size());
+    r.popped = static_cast<uint32_t>(popped.size());
+    r.stats = ring.stats();
+    r.ok = !failed.load() && ring.empty();
+    if (policy == ByteRing::Overflow::kDropNewest) {
+        r.ok = r.ok && popped == accepted && r.stats.overwritten == 0 &&
+               r.stats.dropped == records - r.accepted;
+    } else {
+        r.ok = r.ok && r.accepted == records &&
+               r.stats.popped + r.stats.overwritten == r.stats.pushed;
+    }
+    r.ok = r.ok && r.stats.truncated == r.short_pops;
+    return r;
+}
+
+// What mqtt_runtime used before the rings.
+class DequeQueue {
+   public:
+    bool push(const void* data, size_t len) {
+        std::string s(static_cast<const char*>(data), len);
+        std::lock_guard<std::mutex> lock(m_);
+        q_.push_back(std::move(s));
+        return true;
+    }
+    int pop(char* out, size_t cap) {
+        std::string s;
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            if (q_.empty()) return -1;
+            s = std::move(q_.front());
+            q_.pop_front();
+        }
+        const size_t n = std::min(s.size(), cap - 1);
+        memcpy(out, s.data(), n);
+        out[n] = '\0';
+        return static_cast<int>(s.size());
+    }
+
+   private:
+    std::mutex m_;
+    std::deque<std::string> q_;
+};
+
+struct BenchResult {
+    double msgs_per_s = 0;
+    double allocs_per_msg = 0;
+};
+
+double seconds_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+template <typename Q>
+BenchResult bench_single(Q& q, uint32_t n, size_t len) {
+    std::vector<uint8_t> in(len);
+    std::vector<char> out(len + 1);
+    fill(1, in.data(), len);
+    const uint64_t a0 = g_allocs.load();
+    const auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < n; ++i) {
+        q.push(in.data(), len);
+        if (q.pop(out.data(), out.size()) < 0) std::abort();
+    }
+    BenchResult r;
+    r.msgs_per_s = n / seconds_since(t0);
+    r.allocs_per_msg = double(g_allocs.load() - a0) / n;
+    return r;
+}
+
+template <typename Q>
+BenchResult bench_spsc(Q& q, uint32_t n, size_t len) {
+    std::vector<uint8_t> in(len);
+    fill(1, in.data(), len);
+    const uint64_t a0 = g_allocs.load();
+    const auto t0 = std::chrono::steady_clock::now();
+    std::thread consumer([&] {
+        std::vector<char> out(len + 1);
+        for (uint32_t got = 0; got < n;) {
+            if (q.pop(out.data(), out.size()) >= 0) {
+                ++got;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    for (uint32_t i = 0; i < n;) {
+        if (q.push(in.data(), len)) {
+            ++i;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+    BenchResult r;
+    r.msgs_per_s = n / seconds_since(t0);
+    // The consumer's std::vector is one allocation, not per message.
+    r.allocs_per_msg = double(g_allocs.load() - a0 - 1) / n;
+    return r;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    uint32_t records = 500000;
+    uint32_t bench_msgs = 1000000;
+    uint32_t seed = 1;
+    const char* mode = "all";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--records")) records = strtoul(argv[i + 1], nullptr, 10);
+        if (!strcmp(argv[i], "--bench")) bench_msgs = strtoul(argv[i + 1], nullptr, 10);
+        if (!strcmp(argv[i], "--seed")) seed = strtoul(argv[i + 1], nullptr, 10);
+        if (!strcmp(argv[i], "--mode")) mode = argv[i + 1];
+    }
+
+    bool ok = true;
+    const struct {
+        const char* name;
+        ByteRing::Overflow policy;
+    } modes[] = {{"drop", ByteRing::Overflow::kDropNewest},
+                 {"overwrite", ByteRing::Overflow::kOverwriteOldest}};
+    for (const auto& m : modes) {
+        if (strcmp(mode, "all") && strcmp(mode, m.name)) continue;
+        const StressResult r = stress(m.policy, records, 4096, seed);
+        printf("stress %-9s %s pushed=%u accepted=%u popped=%u dropped=%u "
+               "overwritten=%u truncated=%u peak=%uB\n",
+               m.name, r.ok ? "ok  " : "FAIL", r.pushed, r.accepted, r.popped,
+               r.stats.dropped, r.stats.overwritten, r.stats.truncated,
+               r.stats.peak_bytes);
+        ok = ok && r.ok;
+    }
+
+    for (size_t len : {64, 512, 4096}) {
+        if (bench_msgs == 0) break;
+        ByteRing ring;
+        ring.init(32 * 1024, ByteRing::Overflow::kDropNewest);
+        DequeQueue dq;
+        const BenchResult r1 = bench_single(ring, bench_msgs, len);
+        const BenchResult d1 = bench_single(dq, bench_msgs, len);
+        const BenchResult r2 = bench_spsc(ring, bench_msgs, len);
+        const BenchResult d2 = bench_spsc(dq, bench_msgs, len);
+        printf("bench %4zuB  1 thread: ring %6.2f M/s (%.2f alloc/msg)  deque %6.2f M/s "
+               "(%.2f alloc/msg)\n",
+               len, r1.msgs_per_s / 1e6, r1.allocs_per_msg, d1.msgs_per_s / 1e6,
+               d1.allocs_per_msg);
+        printf("bench %4zuB  2 threads: ring %6.2f M/s (%.2f alloc/msg)  deque %6.2f M/s "
+               "(%.2f alloc/msg)\n",
+               len, r2.msgs_per_s / 1e6, r2.allocs_per_msg, d2.msgs_per_s / 1e6,
+               d2.allocs_per_msg);
+    }
+    return ok ? 0 : 1;
+}
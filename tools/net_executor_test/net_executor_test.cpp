@@ -0,0 +1,251 @@
+// Host test for netexec::Executor (net_executor.hpp).
+//
+// ordering  The worker is held on a gate job while a burst of jobs with
+//           random priorities is submitted, more than the queue holds, so
+//           jobs get dropped and rejected. A reference model applies the same
+//           rules (drop the job that would run last, never in favour of equal
+//           or lower priority work). After the gate opens the jobs must run in
+//           exactly the model's order, dropped futures must report false and
+//           rejected submissions must return an invalid future.
+// mixed     User, foreground and background producers submit concurrently,
+//           as the screens and the unread poller do; prints the queue wait
+//           per class (p50/p99) and the executor stats.
+//
+// Build and run from the repo root:
+//   g++ -O2 -std=c++17 -pthread -DHOST_STUBS_QUIET -Itools/host_stubs
+//       -Icomponents/services/network/include
+//       tools/net_executor_test/net_executor_test.cpp -o /tmp/net_executor_test
+//   /tmp/net_executor_test --rounds 2000
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "net_executor.hpp"
+
+namespace {
+
+using netexec::Executor;
+using netexec::Future;
+using netexec::Priority;
+
+constexpr size_t kCap = Executor::kMaxQueuedJobs;
+
+struct Model {
+    struct Entry {
+        int prio;
+        int seq;
+    };
+    std::vector<Entry> queue;
+    std::vector<int> dropped;
+    std::vector<int> rejected;
+
+    static bool runs_before(const Entry& a, const Entry& b) {
+        if (a.prio != b.prio) return a.prio < b.prio;
+        return a.seq < b.seq;
+    }
+
+    void submit(int prio, int seq) {
+        Entry e{prio, seq};
+        if (queue.size() >= kCap) {
+            auto victim = std::max_element(queue.begin(), queue.end(), runs_before);
+            if (!runs_before(e, *victim)) {
+                rejected.push_back(seq);
+                return;
+            }
+            dropped.push_back(victim->seq);
+            queue.erase(victim);
+        }
+        queue.push_back(e);
+    }
+
+    std::vector<int> order() const {
+        auto q = queue;
+        std::sort(q.begin(), q.end(), runs_before);
+        std::vector<int> out;
+        for (const auto& e : q) out.push_back(e.seq);
+        return out;
+    }
+};
+
+bool ordering_round(std::mt19937& rng) {
+    auto& ex = Executor::shared();
+    SemaphoreHandle_t started = xSemaphoreCreateBinary();
+    SemaphoreHandle_t gate = xSemaphoreCreateBinary();
+    auto gate_done = ex.submit<bool>(Priority::kUser, "gate", [&] {
+        xSemaphoreGive(started);
+        xSemaphoreTake(gate, portMAX_DELAY);
+        return true;
+    });
+    if (!gate_done.valid() || xSemaphoreTake(started, 5000) != pdTRUE) {
+        std::printf("gate job did not start\n");
+        return false;
+    }
+
+    std::mutex ran_mutex;
+    std::vector<int> ran;
+    Model model;
+    const int jobs = int(kCap) + int(rng() % (kCap * 2));
+    std::vector<Future<int>> futures;
+    for (int seq = 0; seq < jobs; ++seq) {
+        const int prio = int(rng() % 3);
+        model.submit(prio, seq);
+        futures.push_back(ex.submit<int>(Priority(prio), "job", [&, seq] {
+            std::lock_guard<std::mutex> lock(ran_mutex);
+            ran.push_back(seq);
+            return seq;
+        }));
+    }
+    xSemaphoreGive(gate);
+    gate_done.wait(5000);
+
+    bool ok = true;
+    for (int seq = 0; seq < jobs; ++seq) {
+        const bool rejected = std::count(model.rejected.begin(), model.rejected.end(), seq) > 0;
+        const bool dropped = std::count(model.dropped.begin(), model.dropped.end(), seq) > 0;
+        if (rejected) {
+            if (futures[seq].valid()) ok = false;
+            continue;
+        }
+        const bool completed = futures[seq].wait(5000);
+        if (completed == dropped) ok = false;
+        if (completed && futures[seq].take() != seq) ok = false;
+    }
+    std::vector<int> got;
+    {
+        std::lock_guard<std::mutex> lock(ran_mutex);
+        got = ran;
+    }
+    if (got != model.order()) ok = false;
+    if (!ok) {
+        std::printf("order mismatch (%d jobs)\n  want:", jobs);
+        for (int s : model.order()) std::printf(" %d", s);
+        std::printf("\n  got: ");
+        for (int s : got) std::printf(" %d", s);
+        std::printf("\n");
+    }
+    vSemaphoreDelete(started);
+    vSemaphoreDelete(gate);
+    return ok;
+}
+
+struct ClassStats {
+    std::mutex m;
+    std::vector<double> wait_ms;
+    int accepted = 0;
+    int rejected = 0;
+    int dropped = 0;
+};
+
+double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, size_t(p * double(v.size())))];
+}
+
+void mixed(int per_producer) {
+    auto& ex = Executor::shared();
+    const Executor::Stats before = ex.stats();
+    const char* names[3] = {"user", "foreground", "background"};
+    // Producers per class and the pause between submissions; background
+    // work arrives in bursts like the unread poller's fan-out.
+    const int producers[3] = {1, 2, 2};
+    const int pause_us[3] = {900, 400, 0};
+    ClassStats cls[3];
+
+    std::vector<std::thread> threads;
+    for (int c = 0; c < 3; ++c) {
+        for (int p = 0; p < producers[c]; ++p) {
+            threads.emplace_back([&, c, p] {
+                std::mt19937 rng(unsigned(c * 100 + p));
+                for (int i = 0; i < per_producer; ++i) {
+                    const auto t0 = std::chrono::steady_clock::now();
+                    auto f = ex.submit<double>(Priority(c), names[c], [t0, &rng] {
+                        const double waited =
+                            std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - t0)
+                                .count();
+                        // Stand-in for a short request.
+                        std::this_thread::sleep_for(std::chrono::microseconds(100));
+                        return waited;
+                    });
+                    if (!f.valid()) {
+                        std::lock_guard<std::mutex> lock(cls[c].m);
+                        ++cls[c].rejected;
+                    } else if (c == 2) {
+                        // Background callers do not block on the result.
+                        std::thread([f, &cls]() mutable {
+                            const bool done = f.wait(0);
+                            std::lock_guard<std::mutex> lock(cls[2].m);
+                            if (done) {
+                                ++cls[2].accepted;
+                                cls[2].wait_ms.push_back(f.take());
+                            } else {
+                                ++cls[2].dropped;
+                            }
+                        }).detach();
+                    } else {
+                        const bool done = f.wait(0);
+                        std::lock_guard<std::mutex> lock(cls[c].m);
+                        if (done) {
+                            ++cls[c].accepted;
+                            cls[c].wait_ms.push_back(f.take());
+                        } else {
+                            ++cls[c].dropped;
+                        }
+                    }
+                    const int jitter = pause_us[c] ? int(rng() % pause_us[c]) : 50;
+                    std::this_thread::sleep_for(std::chrono::microseconds(jitter));
+                }
+            });
+        }
+    }
+    for (auto& t : threads) t.join();
+    // Let the detached background waiters finish.
+    while (true) {
+        std::lock_guard<std::mutex> lock(cls[2].m);
+        if (cls[2].accepted + cls[2].dropped + cls[2].rejected >= producers[2] * per_producer) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::printf("%-10s %8s %8s %8s %9s %9s\n", "class", "ran", "dropped", "rejected", "p50 ms",
+                "p99 ms");
+    for (int c = 0; c < 3; ++c) {
+        std::printf("%-10s %8d %8d %8d %9.2f %9.2f\n", names[c], cls[c].accepted, cls[c].dropped,
+                    cls[c].rejected, percentile(cls[c].wait_ms, 0.50),
+                    percentile(cls[c].wait_ms, 0.99));
+    }
+    const Executor::Stats after = ex.stats();
+    std::printf("executed=%u dropped=%u rejected=%u max_depth=%u max_wait=%ums\n",
+                after.executed - before.executed, after.dropped - before.dropped,
+                after.rejected - before.rejected, after.max_depth, after.max_wait_ms);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int rounds = 2000;
+    int per_producer = 2000;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (!std::strcmp(argv[i], "--rounds")) rounds = std::atoi(argv[++i]);
+        if (!std::strcmp(argv[i], "--jobs")) per_producer = std::atoi(argv[++i]);
+    }
+
+    std::mt19937 rng(1);
+    for (int r = 0; r < rounds; ++r) {
+        if (!ordering_round(rng)) {
+            std::printf("ordering: FAILED in round %d\n", r);
+            return 1;
+        }
+    }
+    std::printf("ordering: %d rounds ok\n", rounds);
+    mixed(per_producer);
+    return 0;
+}
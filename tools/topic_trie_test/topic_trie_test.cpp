@@ -0,0 +1,320 @@
+// Host test and benchmark for mqttrt::TopicTrie (mqtt_topic_trie.hpp).
+//
+// fuzz      Random subscription filters over a small level alphabet (so
+//           '+', '#', empty levels and '$' topics collide often) are
+//           inserted, matched against random topics and erased again. After
+//           every step the trie's matches must equal, as a multiset, those of
+//           a plain reference matcher written straight from MQTT 3.1.1
+//           section 4.7. topic_filter_valid() is checked against a reference
+//           validator on random strings.
+// bench     Per-publish match cost with a few hundred to a few thousand
+//           subscriptions shaped like the app's topics (per-user and
+//           per-chat routes plus some wildcards), for the trie and for the
+//           linear scan over every listener it replaced. Also counts heap
+//           allocations made while matching.
+//
+// Build and run from the repo root:
+//   g++ -O2 -std=c++17 -Icomponents/services/network/include
+//       tools/topic_trie_test/topic_trie_test.cpp -o /tmp/topic_trie_test
+//   /tmp/topic_trie_test --rounds 2000
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mqtt_topic_trie.hpp"
+
+static std::atomic<uint64_t> g_allocs{0};
+
+// The replacements go through out-of-line helpers so GCC does not pair an
+// inlined malloc with a delete and warn (-Wmismatched-new-delete).
+__attribute__((noinline)) static void* counted_alloc(size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) static void counted_free(void* p) { std::free(p); }
+
+void* operator new(size_t n) { return counted_alloc(n); }
+void* operator new[](size_t n) { return counted_alloc(n); }
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete(void* p, size_t) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t) noexcept { counted_free(p); }
+
+namespace {
+
+std::vector<std::string> split(const std::string& s) {
+    std::vector<std::string> out;
+    size_t start = 0;
+    while (true) {
+        const size_t slash = s.find('/', start);
+        if (slash == std::string::npos) {
+            out.push_back(s.substr(start));
+            return out;
+        }
+        out.push_back(s.substr(start, slash - start));
+        start = slash + 1;
+    }
+}
+
+// MQTT 3.1.1 section 4.7.1.
+bool ref_valid(const std::string& filter) {
+    if (filter.empty()) return false;
+    const auto levels = split(filter);
+    for (size_t i = 0; i < levels.size(); ++i) {
+        const std::string& l = levels[i];
+        if (l.find('+') != std::string::npos && l != "+") return false;
+        if (l.find('#') != std::string::npos && (l != "#" || i + 1 != levels.size())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// MQTT 3.1.1 sections 4.7.1 and 4.7.2.
+bool ref_match(const std::string& filter, const std::string& topic) {
+    const auto f = split(filter);
+    const auto t = split(topic);
+    if (!topic.empty() && topic[0] == '$' && (f[0] == "+" || f[0] == "#")) return false;
+    for (size_t i = 0; i < f.size(); ++i) {
+        if (f[i] == "#") return true;
+        if (i >= t.size()) return false;
+        if (f[i] != "+" && f[i] != t[i]) return false;
+    }
+    return f.size() == t.size();
+}
+
+// Non-allocating version of ref_match, so the linear-scan baseline measures
+// the scan rather than std::string churn. Checked against ref_match by fuzz.
+bool scan_match(std::string_view f, std::string_view t) {
+    constexpr size_t npos = std::string_view::npos;
+    if (!t.empty() && t[0] == '$' && (f[0] == '+' || f[0] == '#')) return false;
+    size_t fi = 0;
+    size_t ti = 0;
+    while (true) {
+        const size_t fe = f.find('/', fi);
+        const std::string_view fl = f.substr(fi, fe == npos ? npos : fe - fi);
+        if (fl == "#") return true;
+        if (ti == npos) return false;
+        const size_t te = t.find('/', ti);
+        const std::string_view tl = t.substr(ti, te == npos ? npos : te - ti);
+        if (fl != "+" && fl != tl) return false;
+        ti = te == npos ? npos : te + 1;
+        if (fe == npos) return ti == npos;
+        fi = fe + 1;
+    }
+}
+
+struct Sub {
+    std::string filter;
+    int id;
+};
+
+std::string random_path(std::mt19937& rng, const char* const* alphabet, size_t n,
+                        size_t max_levels) {
+    const size_t levels = 1 + rng() % max_levels;
+    std::string s;
+    for (size_t i = 0; i < levels; ++i) {
+        if (i) s += '/';
+        s += alphabet[rng() % n];
+    }
+    return s;
+}
+
+std::string random_filter(std::mt19937& rng) {
+    static const char* const kLevels[] = {"a", "b", "", "$SYS", "+", "+", "#"};
+    while (true) {
+        std::string f = random_path(rng, kLevels, 7, 4);
+        if (ref_valid(f)) return f;
+    }
+}
+
+std::string random_topic(std::mt19937& rng) {
+    static const char* const kLevels[] = {"a", "b", "", "$SYS", "c"};
+    while (true) {
+        std::string t = random_path(rng, kLevels, 5, 5);
+        if (!t.empty()) return t;
+    }
+}
+
+bool check_topic(const mqttrt::TopicTrie<int>& trie, const std::vector<Sub>& subs,
+                 const std::string& topic) {
+    std::vector<int> got;
+    trie.match(topic, [&](int id) { got.push_back(id); });
+    std::vector<int> want;
+    for (const auto& s : subs) {
+        const bool m = ref_match(s.filter, topic);
+        if (m != scan_match(s.filter, topic)) {
+            fprintf(stderr, "scan_match('%s', '%s') disagrees with ref_match\n",
+                    s.filter.c_str(), topic.c_str());
+            return false;
+        }
+        if (m) want.push_back(s.id);
+    }
+    std::sort(got.begin(), got.end());
+    std::sort(want.begin(), want.end());
+    if (got == want) return true;
+    fprintf(stderr, "mismatch for topic '%s': got %zu, want %zu\n", topic.c_str(),
+            got.size(), want.size());
+    for (const auto& s : subs) {
+        const bool in_got = std::count(got.begin(), got.end(), s.id) > 0;
+        if (in_got != ref_match(s.filter, topic)) {
+            fprintf(stderr, "  filter '%s' (id %d): trie=%d ref=%d\n", s.filter.c_str(),
+                    s.id, in_got, !in_got);
+        }
+    }
+    return false;
+}
+
+bool fuzz(uint32_t rounds, uint32_t seed) {
+    std::mt19937 rng(seed);
+    for (uint32_t r = 0; r < rounds; ++r) {
+        mqttrt::TopicTrie<int> trie;
+        std::vector<Sub> subs;
+        int next_id = 0;
+        const int steps = 20 + rng() % 60;
+        for (int step = 0; step < steps; ++step) {
+            if (subs.empty() || rng() % 3) {
+                // Same filter under several ids happens on the device too
+                // (two screens listening on one chat).
+                Sub s{rng() % 4 == 0 && !subs.empty() ? subs[rng() % subs.size()].filter
+                                                      : random_filter(rng),
+                      next_id++};
+                trie.insert(s.filter, s.id);
+                subs.push_back(s);
+            } else {
+                const size_t i = rng() % subs.size();
+                if (!trie.erase(subs[i].filter, subs[i].id)) {
+                    fprintf(stderr, "erase('%s', %d) failed\n", subs[i].filter.c_str(),
+                            subs[i].id);
+                    return false;
+                }
+                subs.erase(subs.begin() + i);
+            }
+            if (trie.size() != subs.size()) {
+                fprintf(stderr, "size %zu, want %zu\n", trie.size(), subs.size());
+                return false;
+            }
+            for (int q = 0; q < 8; ++q) {
+                if (!check_topic(trie, subs, random_topic(rng))) return false;
+            }
+            // Erasing something never inserted must fail and change nothing.
+            if (trie.erase(random_filter(rng), -1)) {
+                fprintf(stderr, "erase of an unknown value succeeded\n");
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool fuzz_valid(uint32_t count, uint32_t seed) {
+    std::mt19937 rng(seed);
+    static const char kChars[] = "ab+#/";
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string s;
+        const size_t len = rng() % 9;
+        for (size_t k = 0; k < len; ++k) s += kChars[rng() % 5];
+        if (mqttrt::topic_filter_valid(s) != ref_valid(s)) {
+            fprintf(stderr, "topic_filter_valid('%s') = %d, want %d\n", s.c_str(),
+                    mqttrt::topic_filter_valid(s), ref_valid(s));
+            return false;
+        }
+    }
+    return true;
+}
+
+// Filters shaped like the app's: one personal inbox per user, chat routes,
+// presence with '+' and a few catch-alls.
+std::vector<std::string> app_filters(size_t n, std::mt19937& rng) {
+    std::vector<std::string> out;
+    for (size_t i = 0; out.size() < n; ++i) {
+        const std::string user = "u" + std::to_string(i);
+        out.push_back("mobus/user/" + user + "/inbox");
+        out.push_back("mobus/chat/" + user + "/u" + std::to_string(rng() % 1000));
+        if (i % 10 == 0) out.push_back("mobus/presence/+/" + user);
+        if (i % 50 == 0) out.push_back("mobus/user/" + user + "/#");
+    }
+    out.resize(n);
+    return out;
+}
+
+std::vector<std::string> app_topics(size_t n, std::mt19937& rng, size_t users) {
+    std::vector<std::string> out;
+    for (size_t i = 0; i < n; ++i) {
+        const std::string user = "u" + std::to_string(rng() % users);
+        switch (rng() % 3) {
+            case 0: out.push_back("mobus/user/" + user + "/inbox"); break;
+            case 1: out.push_back("mobus/chat/" + user + "/u" + std::to_string(rng() % 1000)); break;
+            default: out.push_back("mobus/presence/u7/" + user); break;
+        }
+    }
+    return out;
+}
+
+void bench(size_t subs_n, uint32_t iters) {
+    std::mt19937 rng(7);
+    const auto filters = app_filters(subs_n, rng);
+    mqttrt::TopicTrie<int> trie;
+    for (size_t i = 0; i < filters.size(); ++i) trie.insert(filters[i], int(i));
+    const auto topics = app_topics(1024, rng, subs_n / 2 + 1);
+
+    uint64_t sink = 0;
+    const uint64_t a0 = g_allocs.load();
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iters; ++i) {
+        trie.match(topics[i & 1023], [&](int id) { sink += id; });
+    }
+    const double trie_ns =
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0)
+            .count() / iters;
+    const uint64_t allocs = g_allocs.load() - a0;
+
+    // The old path: compare the topic with every listener's filter.
+    uint64_t sink2 = 0;
+    t0 = std::chrono::steady_clock::now();
+    const uint32_t scan_iters = std::max<uint32_t>(iters / 20, 1000);
+    for (uint32_t i = 0; i < scan_iters; ++i) {
+        const std::string& t = topics[i & 1023];
+        for (size_t k = 0; k < filters.size(); ++k) {
+            if (scan_match(filters[k], t)) sink2 += k;
+        }
+    }
+    const double scan_ns =
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0)
+            .count() / scan_iters;
+    printf("bench subs=%5zu  trie %7.0f ns/match (%llu allocs)  linear scan %9.0f ns/match"
+           "  (%llu %llu)\n",
+           subs_n, trie_ns, static_cast<unsigned long long>(allocs), scan_ns,
+           static_cast<unsigned long long>(sink & 1), static_cast<unsigned long long>(sink2 & 1));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    uint32_t rounds = 500;
+    uint32_t iters = 1000000;
+    uint32_t seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--rounds")) rounds = strtoul(argv[i + 1], nullptr, 10);
+        if (!strcmp(argv[i], "--iters")) iters = strtoul(argv[i + 1], nullptr, 10);
+        if (!strcmp(argv[i], "--seed")) seed = strtoul(argv[i + 1], nullptr, 10);
+    }
+    const bool valid_ok = fuzz_valid(rounds * 100, seed);
+    printf("filter validation: %s\n", valid_ok ? "ok" : "FAIL");
+    const bool match_ok = fuzz(rounds, seed);
+    printf("match fuzz: %s (%u rounds)\n", match_ok ? "ok" : "FAIL", rounds);
+    if (iters) {
+        for (size_t n : {100, 300, 1000, 3000}) bench(n, iters);
+    }
+    return valid_ok && match_ok ? 0 : 1;
+}